@@ -81,6 +81,9 @@ cdef extern from "xmmsclient/xmmsclient.h":
 	bint xmmsc_io_in_handle  (xmmsc_connection_t *c)
 	int  xmmsc_io_fd_get     (xmmsc_connection_t *c)
 
+	void xmmsc_batch_begin (xmmsc_connection_t *c)
+	void xmmsc_batch_end   (xmmsc_connection_t *c) nogil
+
 	char *xmmsc_get_last_error (xmmsc_connection_t *c)
 
 	xmmsc_result_t *xmmsc_quit(xmmsc_connection_t *c)
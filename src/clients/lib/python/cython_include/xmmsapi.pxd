@@ -2,8 +2,8 @@ from xmmsvalue cimport Collection, XmmsValue
 from cxmmsvalue cimport *
 from cxmmsclient cimport *
 
-cdef bint ResultNotifier(xmmsv_t *res, void *o)
-cdef void ResultDestroyNotifier(void *o)
+cdef bint ResultNotifier(xmmsv_t *res, void *o) with gil
+cdef void ResultDestroyNotifier(void *o) with gil
 
 from xmmsutils cimport *
 cdef inline char *check_playlist(object playlist):
@@ -101,13 +101,15 @@ cdef class XmmsCore:
 	cpdef want_ioout(self)
 	cpdef set_need_out_fun(self, fun)
 	cpdef get_fd(self)
+	cpdef batch_begin(self)
+	cpdef batch_end(self)
 	cpdef connect(self, path=*, disconnect_func=*)
 	cdef XmmsResult _create_result(self, cb, xmmsc_result_t *res, Cls)
 	cdef XmmsResult create_result(self, cb, xmmsc_result_t *res)
 	cdef XmmsResult create_vis_result(self, cb, xmmsc_result_t *res, VisResultCommand cmd)
 
-cdef void python_need_out_fun(int i, void *obj)
-cdef void python_disconnect_fun(void *obj)
+cdef void python_need_out_fun(int i, void *obj) with gil
+cdef void python_disconnect_fun(void *obj) with gil
 cpdef userconfdir_get()
 
 cdef class XmmsApi(XmmsCore):
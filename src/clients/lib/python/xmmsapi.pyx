@@ -72,7 +72,7 @@ cdef _install_select():
 	select = _sel
 _install_select()
 
-cdef bint ResultNotifier(xmmsv_t *res, void *o):
+cdef bint ResultNotifier(xmmsv_t *res, void *o) with gil:
 	cdef object xres
 	xres = <object> o
 	try:
@@ -83,7 +83,7 @@ cdef bint ResultNotifier(xmmsv_t *res, void *o):
 		traceback.print_exception(*exc)
 		return False
 
-cdef void ResultDestroyNotifier(void *o):
+cdef void ResultDestroyNotifier(void *o) with gil:
 	cdef XmmsResult obj
 	obj = <XmmsResult>o
 	obj._cb = None
@@ -364,12 +364,12 @@ class VisualizationError(Exception):
 	pass
 
 
-cdef void python_need_out_fun(int i, void *obj):
+cdef void python_need_out_fun(int i, void *obj) with gil:
 	cdef object o
 	o = <object> obj
 	o._needout_cb(i)
 
-cdef void python_disconnect_fun(void *obj):
+cdef void python_disconnect_fun(void *obj) with gil:
 	cdef object o
 	o = <object> obj
 	o._disconnect_cb()
@@ -505,6 +505,32 @@ cdef class XmmsCore:
 		"""
 		return xmmsc_io_fd_get(self.conn)
 
+	cpdef batch_begin(self):
+		"""
+		batch_begin()
+
+		Start a batch of commands. Commands issued after this call are
+		only queued until batch_end() is called, then they are all sent
+		at once and their replies collected in a single round trip.
+		Results of commands in the batch must not be waited for before
+		the batch has ended.
+		"""
+		xmmsc_batch_begin(self.conn)
+
+	cpdef batch_end(self):
+		"""
+		batch_end()
+
+		End a batch of commands started with batch_begin(). Blocks until
+		every command of the batch has been replied to, then runs the
+		callbacks of their results in the order the replies arrived.
+		Other threads may run while waiting.
+		"""
+		cdef xmmsc_connection_t *conn = self.conn
+		# the callbacks run from here take the GIL back themselves
+		with nogil:
+			xmmsc_batch_end(conn)
+
 	cpdef connect(self, path=None, disconnect_func=None):
 		"""
 		connect(path=None, disconnect_func=None)
@@ -109,6 +109,18 @@ namespace Xmms
 
 	}
 
+	void Client::batchBegin()
+	{
+		check( connected_ );
+		xmmsc_batch_begin( conn_ );
+	}
+
+	void Client::batchEnd()
+	{
+		check( connected_ );
+		xmmsc_batch_end( conn_ );
+	}
+
 	MainloopInterface& Client::getMainLoop() 
 	{
 
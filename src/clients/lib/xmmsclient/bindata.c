@@ -56,6 +56,32 @@ xmmsc_bindata_retrieve (xmmsc_connection_t *c, const char *hash)
 	                       XMMSV_LIST_ENTRY_STR (hash), XMMSV_LIST_END);
 }
 
+/**
+ * Retrieve part of a file from the servers bindata directory, based
+ * on the hash. Large files can be retrieved in chunks this way, the
+ * result is shorter than length at the end of the file.
+ *
+ * @param c The connection structure.
+ * @param hash The hash of the file.
+ * @param offset The offset of the first byte to retrieve.
+ * @param length The maximum number of bytes to retrieve.
+ */
+xmmsc_result_t *
+xmmsc_bindata_retrieve_range (xmmsc_connection_t *c, const char *hash,
+                              int offset, int length)
+{
+	x_check_conn (c, NULL);
+	x_api_error_if (offset < 0, "with negative offset", NULL);
+	x_api_error_if (length <= 0, "with empty range", NULL);
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_BINDATA,
+	                       XMMS_IPC_CMD_GET_DATA_RANGE,
+	                       XMMSV_LIST_ENTRY_STR (hash),
+	                       XMMSV_LIST_ENTRY_INT (offset),
+	                       XMMSV_LIST_ENTRY_INT (length),
+	                       XMMSV_LIST_END);
+}
+
 /**
  * Remove a file with associated with the hash from the server
  */
@@ -0,0 +1,184 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Collection sync benchmark.
+ *
+ * Saves a number of playlists on a running daemon and times the
+ * collection sync after writing all of them, after no change, after
+ * changing a single playlist and after changing a percentage of them.
+ * Use a throwaway daemon, the playlists are removed at the end but the
+ * database keeps its size.
+ *
+ *   xmms2-coll-bench [-n playlists] [-e entries] [-c percent changed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <xmmsclient/xmmsclient.h>
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* Wait for a command, returns 0 if it failed. */
+static int
+finish (xmmsc_connection_t *conn, xmmsc_result_t *res)
+{
+	const char *err;
+	xmmsv_t *val;
+	int ok = 1;
+
+	xmmsc_result_wait (res);
+
+	val = xmmsc_result_get_value (res);
+	if (xmmsv_get_error (val, &err)) {
+		fprintf (stderr, "Command failed: %s\n", err);
+		ok = 0;
+	}
+
+	xmmsc_result_unref (res);
+
+	return ok;
+}
+
+static int
+save_playlist (xmmsc_connection_t *conn, int n, int entries, int extra)
+{
+	xmmsv_coll_t *coll;
+	char name[32];
+	int i;
+
+	coll = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+	for (i = 0; i < entries + extra; i++) {
+		xmmsv_coll_idlist_append (coll, n * entries + i + 1);
+	}
+
+	snprintf (name, sizeof (name), "bench-%05d", n);
+	i = finish (conn, xmmsc_coll_save (conn, coll, name,
+	                                   XMMS_COLLECTION_NS_PLAYLISTS));
+	xmmsv_coll_unref (coll);
+
+	return i;
+}
+
+static double
+timed_sync (xmmsc_connection_t *conn)
+{
+	double start = now ();
+
+	finish (conn, xmmsc_coll_sync (conn));
+
+	return now () - start;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "usage: %s [-n playlists] [-e entries] "
+	         "[-c percent changed]\n", prog);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t *conn;
+	int playlists = 10000, entries = 20, changed = 1;
+	char name[32];
+	double start;
+	int opt, i;
+
+	while ((opt = getopt (argc, argv, "n:e:c:")) != -1) {
+		switch (opt) {
+			case 'n':
+				playlists = atoi (optarg);
+				break;
+			case 'e':
+				entries = atoi (optarg);
+				break;
+			case 'c':
+				changed = atoi (optarg);
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (playlists <= 0 || entries <= 0 || changed < 0 || changed > 100) {
+		usage (argv[0]);
+	}
+
+	conn = xmmsc_init ("collbench");
+	if (!conn) {
+		fprintf (stderr, "Could not allocate the connection\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!xmmsc_connect (conn, getenv ("XMMS_PATH"))) {
+		fprintf (stderr, "Could not connect: %s\n", xmmsc_get_last_error (conn));
+		return EXIT_FAILURE;
+	}
+
+	/* start from a synced state */
+	timed_sync (conn);
+
+	start = now ();
+	for (i = 0; i < playlists; i++) {
+		if (!save_playlist (conn, i, entries, 0)) {
+			xmmsc_unref (conn);
+			return EXIT_FAILURE;
+		}
+	}
+	printf ("saved %d playlists of %d entries: %8.3f s\n",
+	        playlists, entries, now () - start);
+
+	printf ("sync, all new:              %8.3f s\n", timed_sync (conn));
+	printf ("sync, unchanged:            %8.3f s\n", timed_sync (conn));
+
+	save_playlist (conn, 0, entries, 1);
+	printf ("sync, 1 changed:            %8.3f s\n", timed_sync (conn));
+
+	start = now ();
+	for (i = 0; i < playlists * changed / 100; i++) {
+		save_playlist (conn, i * (100 / (changed ? changed : 1)), entries, 2);
+	}
+	printf ("changed %d playlists:       %8.3f s\n",
+	        playlists * changed / 100, now () - start);
+	printf ("sync, %d%% changed:           %8.3f s\n",
+	        changed, timed_sync (conn));
+
+	for (i = 0; i < playlists; i++) {
+		snprintf (name, sizeof (name), "bench-%05d", i);
+		finish (conn, xmmsc_coll_remove (conn, name,
+		                                 XMMS_COLLECTION_NS_PLAYLISTS));
+	}
+	printf ("sync, all removed:          %8.3f s\n", timed_sync (conn));
+
+	xmmsc_unref (conn);
+
+	return EXIT_SUCCESS;
+}
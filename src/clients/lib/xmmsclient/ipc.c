@@ -33,11 +33,29 @@
 #include "xmmsc/xmmsc_sockets.h"
 
 
+/* Initial number of slots of the results table, must be a power of two */
+#define XMMSC_IPC_RESULTS_MIN_SIZE 64
+
+/* Maximum number of queued messages handed to a single write */
+#define XMMSC_IPC_WRITE_MAX_MSGS 64
+
 struct xmmsc_ipc_St {
 	xmms_ipc_transport_t *transport;
 	xmms_ipc_msg_t *read_msg;
-	x_list_t *results_list;
+
+	/* registered results, an open addressing table keyed by cookie */
+	xmmsc_result_t **results;
+	unsigned int results_size;
+	unsigned int results_count;
+
 	x_queue_t *out_msg;
+
+	/* batch state, replies are held back in batch_in until the end */
+	bool batch;
+	uint32_t batch_cookie;
+	unsigned int batch_pending;
+	x_queue_t *batch_in;
+
 	char *error;
 	bool disconnect;
 	void *lockdata;
@@ -108,18 +126,32 @@ xmmsc_ipc_io_out_callback (xmmsc_ipc_t *ipc)
 	x_return_val_if_fail (!ipc->disconnect, false);
 
 	while (!x_queue_is_empty (ipc->out_msg)) {
-		xmms_ipc_msg_t *msg = x_queue_peek_head (ipc->out_msg);
-		if (xmms_ipc_msg_write_transport (msg, ipc->transport, &disco)) {
+		xmms_ipc_msg_t *msgs[XMMSC_IPC_WRITE_MAX_MSGS];
+		x_list_t *n;
+		int i, count, written;
+
+		/* hand as many queued messages as possible to one write */
+		count = 0;
+		for (n = ipc->out_msg->head; n && count < XMMSC_IPC_WRITE_MAX_MSGS;
+		     n = x_list_next (n)) {
+			msgs[count++] = n->data;
+		}
+
+		written = xmms_ipc_msg_write_transport_many (msgs, count,
+		                                             ipc->transport, &disco);
+		for (i = 0; i < written; i++) {
 			x_queue_pop_head (ipc->out_msg);
-			xmms_ipc_msg_destroy (msg);
-		} else {
+			xmms_ipc_msg_destroy (msgs[i]);
+		}
+
+		if (disco || !written) {
 			break;
 		}
 	}
 
 	if (disco) {
 		xmmsc_ipc_disconnect (ipc);
-	} else {
+	} else if (!ipc->batch) {
 		if (ipc->need_out_callback)
 			ipc->need_out_callback (xmmsc_ipc_io_out (ipc),
 			                        ipc->need_out_data);
@@ -170,8 +202,11 @@ xmmsc_ipc_init (void)
 	xmmsc_ipc_t *ipc;
 	ipc = x_new0 (xmmsc_ipc_t, 1);
 	ipc->disconnect = false;
-	ipc->results_list = NULL;
+	ipc->results = NULL;
+	ipc->results_size = 0;
+	ipc->results_count = 0;
 	ipc->out_msg = x_queue_new ();
+	ipc->batch_in = x_queue_new ();
 
 	return ipc;
 }
@@ -202,6 +237,54 @@ xmmsc_ipc_lock_set (xmmsc_ipc_t *ipc, void *lock, void (*lockfunc)(void *), void
 	ipc->unlockfunc = unlockfunc;
 }
 
+static unsigned int
+xmmsc_ipc_results_slot (xmmsc_ipc_t *ipc, uint32_t cookie)
+{
+	/* cookies are sequential, spread them over the table */
+	return (cookie * 2654435761U) & (ipc->results_size - 1);
+}
+
+static void
+xmmsc_ipc_results_insert (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
+{
+	unsigned int i;
+
+	i = xmmsc_ipc_results_slot (ipc, xmmsc_result_cookie_get (res));
+	while (ipc->results[i]) {
+		i = (i + 1) & (ipc->results_size - 1);
+	}
+
+	ipc->results[i] = res;
+	ipc->results_count++;
+}
+
+static bool
+xmmsc_ipc_results_resize (xmmsc_ipc_t *ipc, unsigned int size)
+{
+	xmmsc_result_t **old = ipc->results;
+	unsigned int i, old_size = ipc->results_size;
+
+	ipc->results = x_new0 (xmmsc_result_t *, size);
+	if (!ipc->results) {
+		x_oom ();
+		ipc->results = old;
+		return false;
+	}
+
+	ipc->results_size = size;
+	ipc->results_count = 0;
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i]) {
+			xmmsc_ipc_results_insert (ipc, old[i]);
+		}
+	}
+
+	free (old);
+
+	return true;
+}
+
 void
 xmmsc_ipc_result_register (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 {
@@ -209,7 +292,18 @@ xmmsc_ipc_result_register (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 	x_return_if_fail (res);
 
 	xmmsc_ipc_lock (ipc);
-	ipc->results_list = x_list_prepend (ipc->results_list, res);
+
+	/* keep the table at most half full, so that probe chains stay short */
+	if ((ipc->results_count + 1) * 2 > ipc->results_size &&
+	    !xmmsc_ipc_results_resize (ipc, ipc->results_size ?
+	                                    ipc->results_size * 2 :
+	                                    XMMSC_IPC_RESULTS_MIN_SIZE)) {
+		xmmsc_ipc_unlock (ipc);
+		return;
+	}
+
+	xmmsc_ipc_results_insert (ipc, res);
+
 	xmmsc_ipc_unlock (ipc);
 }
 
@@ -217,18 +311,20 @@ xmmsc_result_t *
 xmmsc_ipc_result_lookup (xmmsc_ipc_t *ipc, uint32_t cookie)
 {
 	xmmsc_result_t *res = NULL;
-	x_list_t *n;
+	unsigned int i;
 
 	x_return_val_if_fail (ipc, NULL);
 
 	xmmsc_ipc_lock (ipc);
 
-	for (n = ipc->results_list; n; n = x_list_next (n)) {
-		xmmsc_result_t *tmp = n->data;
-
-		if (cookie == xmmsc_result_cookie_get (tmp)) {
-			res = tmp;
-			break;
+	if (ipc->results_count > 0) {
+		i = xmmsc_ipc_results_slot (ipc, cookie);
+		while (ipc->results[i]) {
+			if (xmmsc_result_cookie_get (ipc->results[i]) == cookie) {
+				res = ipc->results[i];
+				break;
+			}
+			i = (i + 1) & (ipc->results_size - 1);
 		}
 	}
 
@@ -240,22 +336,44 @@ xmmsc_ipc_result_lookup (xmmsc_ipc_t *ipc, uint32_t cookie)
 void
 xmmsc_ipc_result_unregister (xmmsc_ipc_t *ipc, xmmsc_result_t *res)
 {
-	x_list_t *n;
+	unsigned int i, j, k, mask;
 
 	x_return_if_fail (ipc);
 	x_return_if_fail (res);
 
 	xmmsc_ipc_lock (ipc);
 
-	for (n = ipc->results_list; n; n = x_list_next (n)) {
-		xmmsc_result_t *tmp = n->data;
+	if (ipc->results_count == 0) {
+		xmmsc_ipc_unlock (ipc);
+		return;
+	}
 
-		if (xmmsc_result_cookie_get (res) == xmmsc_result_cookie_get (tmp)) {
-			ipc->results_list = x_list_delete_link (ipc->results_list, n);
-			break;
+	mask = ipc->results_size - 1;
+
+	i = xmmsc_ipc_results_slot (ipc, xmmsc_result_cookie_get (res));
+	while (ipc->results[i] && ipc->results[i] != res) {
+		i = (i + 1) & mask;
+	}
+
+	if (!ipc->results[i]) {
+		xmmsc_ipc_unlock (ipc);
+		return;
+	}
+
+	/* shift back the following entries of the probe chain that would
+	 * no longer be reachable through the freed slot */
+	for (j = (i + 1) & mask; ipc->results[j]; j = (j + 1) & mask) {
+		k = xmmsc_ipc_results_slot (ipc,
+		                            xmmsc_result_cookie_get (ipc->results[j]));
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			ipc->results[i] = ipc->results[j];
+			i = j;
 		}
 	}
 
+	ipc->results[i] = NULL;
+	ipc->results_count--;
+
 	xmmsc_ipc_unlock (ipc);
 }
 
@@ -277,6 +395,12 @@ xmmsc_ipc_wait_for_event (xmmsc_ipc_t *ipc, unsigned int timeout)
 	x_return_if_fail (ipc);
 	x_return_if_fail (!ipc->disconnect);
 
+	/* data that was already read ahead won't make the socket readable */
+	if (xmms_ipc_transport_pending (ipc->transport)) {
+		xmmsc_ipc_io_in_callback (ipc);
+		return;
+	}
+
 	tmout.tv_sec = timeout;
 	tmout.tv_usec = 0;
 
@@ -304,6 +428,63 @@ xmmsc_ipc_wait_for_event (xmmsc_ipc_t *ipc, unsigned int timeout)
 	}
 }
 
+/**
+ * Start holding back outgoing messages and incoming replies.
+ *
+ * @param first_cookie the cookie of the first message in the batch
+ */
+void
+xmmsc_ipc_batch_begin (xmmsc_ipc_t *ipc, uint32_t first_cookie)
+{
+	x_return_if_fail (ipc);
+	x_return_if_fail (!ipc->batch);
+
+	ipc->batch = true;
+	ipc->batch_cookie = first_cookie;
+	ipc->batch_pending = 0;
+}
+
+/**
+ * Flush the messages queued since #xmmsc_ipc_batch_begin, wait for
+ * all of their replies and then dispatch everything that was received
+ * in the meantime, in order of arrival.
+ */
+void
+xmmsc_ipc_batch_end (xmmsc_ipc_t *ipc)
+{
+	xmms_ipc_msg_t *msg;
+
+	x_return_if_fail (ipc);
+	x_return_if_fail (ipc->batch);
+
+	while (!ipc->disconnect &&
+	       (xmmsc_ipc_io_out (ipc) || ipc->batch_pending > 0)) {
+		xmmsc_ipc_wait_for_event (ipc, 5);
+	}
+
+	ipc->batch = false;
+	ipc->batch_pending = 0;
+
+	while ((msg = x_queue_pop_head (ipc->batch_in))) {
+		if (ipc->disconnect) {
+			xmms_ipc_msg_destroy (msg);
+		} else {
+			xmmsc_ipc_exec_msg (ipc, msg);
+		}
+	}
+
+	if (!ipc->disconnect && ipc->need_out_callback) {
+		ipc->need_out_callback (xmmsc_ipc_io_out (ipc), ipc->need_out_data);
+	}
+}
+
+bool
+xmmsc_ipc_batch_active (xmmsc_ipc_t *ipc)
+{
+	x_return_val_if_fail (ipc, false);
+	return ipc->batch;
+}
+
 bool
 xmmsc_ipc_msg_write (xmmsc_ipc_t *ipc, xmms_ipc_msg_t *msg, uint32_t cookie)
 {
@@ -312,6 +493,14 @@ xmmsc_ipc_msg_write (xmmsc_ipc_t *ipc, xmms_ipc_msg_t *msg, uint32_t cookie)
 	xmms_ipc_msg_set_cookie (msg, cookie);
 	x_queue_push_tail (ipc->out_msg, msg);
 
+	if (ipc->batch) {
+		/* signal and broadcast registrations are not replied to */
+		if (xmms_ipc_msg_get_object (msg) != XMMS_IPC_OBJECT_SIGNAL) {
+			ipc->batch_pending++;
+		}
+		return true;
+	}
+
 	if (ipc->need_out_callback) {
 		ipc->need_out_callback (1, ipc->need_out_data);
 	}
@@ -326,7 +515,7 @@ xmmsc_ipc_destroy (xmmsc_ipc_t *ipc)
 	if (!ipc)
 		return;
 
-	x_list_free (ipc->results_list);
+	free (ipc->results);
 	if (ipc->transport) {
 		xmms_ipc_transport_destroy (ipc->transport);
 	}
@@ -335,6 +524,14 @@ xmmsc_ipc_destroy (xmmsc_ipc_t *ipc)
 		x_queue_free (ipc->out_msg);
 	}
 
+	if (ipc->batch_in) {
+		xmms_ipc_msg_t *msg;
+		while ((msg = x_queue_pop_head (ipc->batch_in))) {
+			xmms_ipc_msg_destroy (msg);
+		}
+		x_queue_free (ipc->batch_in);
+	}
+
 	if (ipc->read_msg) {
 		xmms_ipc_msg_destroy (ipc->read_msg);
 	}
@@ -388,6 +585,18 @@ static void
 xmmsc_ipc_exec_msg (xmmsc_ipc_t *ipc, xmms_ipc_msg_t *msg)
 {
 	xmmsc_result_t *res;
+	uint32_t cmd;
+
+	if (ipc->batch) {
+		cmd = xmms_ipc_msg_get_cmd (msg);
+		if ((cmd == XMMS_IPC_CMD_REPLY || cmd == XMMS_IPC_CMD_ERROR) &&
+		    xmms_ipc_msg_get_cookie (msg) - ipc->batch_cookie < 0x80000000U &&
+		    ipc->batch_pending > 0) {
+			ipc->batch_pending--;
+		}
+		x_queue_push_tail (ipc->batch_in, msg);
+		return;
+	}
 
 	res = xmmsc_ipc_result_lookup (ipc, xmms_ipc_msg_get_cookie (msg));
 
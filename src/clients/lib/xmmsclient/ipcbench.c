@@ -0,0 +1,211 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Result dispatch stress benchmark.
+ *
+ * Registers a number of broadcasts, then sends a batch of pipelined
+ * commands to a running daemon before reading any reply, and measures
+ * the time spent handling the replies. Every reply is looked up among
+ * all outstanding results, so this shows how dispatch scales with
+ * their number.
+ *
+ *   xmms2-ipc-bench [-n commands] [-b broadcasts] [-r rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/time.h>
+
+#include <xmmsclient/xmmsclient.h>
+
+typedef struct {
+	int replies;
+	int errors;
+} bench_state_t;
+
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int
+count_reply (xmmsv_t *val, void *udata)
+{
+	bench_state_t *state = udata;
+
+	if (xmmsv_is_error (val)) {
+		state->errors++;
+	}
+	state->replies++;
+
+	return 0;
+}
+
+static int
+ignore_broadcast (xmmsv_t *val, void *udata)
+{
+	return 1;
+}
+
+/* Send commands pipelined and handle replies until all of them are in.
+ * Returns 0 when the connection broke.
+ */
+static int
+run_round (xmmsc_connection_t *conn, int commands,
+           double *submit, double *dispatch)
+{
+	bench_state_t state = { 0, 0 };
+	struct pollfd pfd;
+	xmmsc_result_t *res;
+	double start;
+	int i;
+
+	start = now ();
+	for (i = 0; i < commands; i++) {
+		res = xmmsc_playback_status (conn);
+		xmmsc_result_notifier_set (res, count_reply, &state);
+		xmmsc_result_unref (res);
+	}
+	*submit = now () - start;
+
+	*dispatch = 0;
+
+	pfd.fd = xmmsc_io_fd_get (conn);
+
+	while (state.replies < commands) {
+		pfd.events = POLLIN;
+		if (xmmsc_io_want_out (conn)) {
+			pfd.events |= POLLOUT;
+		}
+
+		if (poll (&pfd, 1, -1) == -1) {
+			perror ("poll");
+			return 0;
+		}
+
+		if (pfd.revents & (POLLERR | POLLHUP)) {
+			fprintf (stderr, "Connection to the server lost\n");
+			return 0;
+		}
+
+		if ((pfd.revents & POLLOUT) && !xmmsc_io_out_handle (conn)) {
+			return 0;
+		}
+
+		if (pfd.revents & POLLIN) {
+			start = now ();
+			if (!xmmsc_io_in_handle (conn)) {
+				return 0;
+			}
+			*dispatch += now () - start;
+		}
+	}
+
+	if (state.errors) {
+		fprintf (stderr, "%d commands failed\n", state.errors);
+	}
+
+	return 1;
+}
+
+static void
+usage (const char *prog)
+{
+	fprintf (stderr, "usage: %s [-n commands] [-b broadcasts] [-r rounds]\n",
+	         prog);
+	exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t *conn;
+	xmmsc_result_t *res;
+	double submit, dispatch, best_submit = 0, best_dispatch = 0;
+	int commands = 100000, broadcasts = 0, rounds = 3;
+	int opt, i;
+
+	while ((opt = getopt (argc, argv, "n:b:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				commands = atoi (optarg);
+				break;
+			case 'b':
+				broadcasts = atoi (optarg);
+				break;
+			case 'r':
+				rounds = atoi (optarg);
+				break;
+			default:
+				usage (argv[0]);
+		}
+	}
+
+	if (commands <= 0 || broadcasts < 0 || rounds <= 0) {
+		usage (argv[0]);
+	}
+
+	conn = xmmsc_init ("ipcbench");
+	if (!conn) {
+		fprintf (stderr, "Could not allocate the connection\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!xmmsc_connect (conn, getenv ("XMMS_PATH"))) {
+		fprintf (stderr, "Could not connect: %s\n", xmmsc_get_last_error (conn));
+		return EXIT_FAILURE;
+	}
+
+	/* stay registered for the whole run, as a busy client would */
+	for (i = 0; i < broadcasts; i++) {
+		res = xmmsc_broadcast_playback_volume_changed (conn);
+		xmmsc_result_notifier_set (res, ignore_broadcast, NULL);
+		xmmsc_result_unref (res);
+	}
+
+	for (i = 0; i < rounds; i++) {
+		if (!run_round (conn, commands, &submit, &dispatch)) {
+			xmmsc_unref (conn);
+			return EXIT_FAILURE;
+		}
+
+		printf ("round %d: submit %.3f s, dispatch %.3f s (%.0f replies/s)\n",
+		        i + 1, submit, dispatch, commands / dispatch);
+
+		if (i == 0 || dispatch < best_dispatch) {
+			best_submit = submit;
+			best_dispatch = dispatch;
+		}
+	}
+
+	printf ("%d commands, %d broadcasts: best dispatch %.3f s, "
+	        "%.2f us per reply (submit %.3f s)\n",
+	        commands, broadcasts, best_dispatch,
+	        best_dispatch * 1000000.0 / commands, best_submit);
+
+	xmmsc_unref (conn);
+
+	return EXIT_SUCCESS;
+}
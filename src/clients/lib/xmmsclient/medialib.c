@@ -356,6 +356,35 @@ xmmsc_broadcast_medialib_entry_changed (xmmsc_connection_t *c)
 	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_UPDATE);
 }
 
+/**
+ * Request the medialib_entries_changed broadcast. This will be called
+ * once when many entries change at the same time on the serverside,
+ * for instance through #xmmsc_medialib_properties_set. The argument
+ * will be a list of medialib ids. medialib_entry_changed is still
+ * emitted for each of them.
+ */
+xmmsc_result_t *
+xmmsc_broadcast_medialib_entries_changed (xmmsc_connection_t *c)
+{
+	x_check_conn (c, NULL);
+
+	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MEDIALIB_ENTRIES_UPDATE);
+}
+
+/**
+ * Request the medialib_gain_scan_progress broadcast. This will be
+ * called each time the server finished measuring an entry queued with
+ * #xmmsc_medialib_gain_scan. The argument is a dict with the keys
+ * "id", "total", "done" and "failed".
+ */
+xmmsc_result_t *
+xmmsc_broadcast_medialib_gain_scan_progress (xmmsc_connection_t *c)
+{
+	x_check_conn (c, NULL);
+
+	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MEDIALIB_GAIN_SCAN_PROGRESS);
+}
+
 /**
  * Associate a int value with a medialib entry. Uses default
  * source which is client/&lt;clientname&gt;
@@ -476,6 +505,80 @@ xmmsc_medialib_entry_property_remove_with_source (xmmsc_connection_t *c,
 	                       XMMSV_LIST_END);
 }
 
+/**
+ * Set or remove many properties in one go. The changes are applied
+ * by the server in a single transaction and announced with one
+ * medialib_entries_changed broadcast.
+ *
+ * @param changes A list of dicts with the keys "id", "source", "key"
+ * and "value". A change without a value removes the property.
+ */
+xmmsc_result_t *
+xmmsc_medialib_properties_set (xmmsc_connection_t *c, xmmsv_t *changes)
+{
+	x_check_conn (c, NULL);
+	x_api_error_if (!changes, "with a NULL list of changes", NULL);
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_MEDIALIB,
+	                       XMMS_IPC_CMD_PROPERTIES_SET,
+	                       XMMSV_LIST_ENTRY (xmmsv_ref (changes)),
+	                       XMMSV_LIST_END);
+}
+
+/**
+ * Set or remove properties on all the entries matched by a
+ * collection. Like #xmmsc_medialib_properties_set the changes are
+ * applied in a single transaction.
+ *
+ * @param coll The collection matching the entries to change.
+ * @param source The source to write to, or NULL for the default
+ * source which is client/&lt;clientname&gt;
+ * @param properties A dict of the properties to set, a none value
+ * removes the property.
+ */
+xmmsc_result_t *
+xmmsc_medialib_coll_properties_set (xmmsc_connection_t *c, xmmsv_coll_t *coll,
+                                    const char *source, xmmsv_t *properties)
+{
+	char tmp[256];
+
+	x_check_conn (c, NULL);
+	x_api_error_if (!coll, "with a NULL collection", NULL);
+	x_api_error_if (!properties, "with a NULL dict of properties", NULL);
+
+	if (!source) {
+		snprintf (tmp, 256, "client/%s", c->clientname);
+		source = tmp;
+	}
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_MEDIALIB,
+	                       XMMS_IPC_CMD_PROPERTIES_SET_COLL,
+	                       XMMSV_LIST_ENTRY_COLL (coll),
+	                       XMMSV_LIST_ENTRY_STR (source),
+	                       XMMSV_LIST_ENTRY (xmmsv_ref (properties)),
+	                       XMMSV_LIST_END);
+}
+
+/**
+ * Measure the loudness of all the entries matched by a collection. The
+ * server stores the track and album gain and peak it finds in the
+ * medialib, where the replaygain effect picks them up. The result is
+ * the number of entries queued.
+ *
+ * @param coll The collection matching the entries to measure.
+ */
+xmmsc_result_t *
+xmmsc_medialib_gain_scan (xmmsc_connection_t *c, xmmsv_coll_t *coll)
+{
+	x_check_conn (c, NULL);
+	x_api_error_if (!coll, "with a NULL collection", NULL);
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_MEDIALIB,
+	                       XMMS_IPC_CMD_GAIN_SCAN,
+	                       XMMSV_LIST_ENTRY_COLL (coll),
+	                       XMMSV_LIST_END);
+}
+
 /** @} */
 
 #define GOODCHAR(a) ((((a) >= 'a') && ((a) <= 'z')) || \
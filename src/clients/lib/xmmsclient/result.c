@@ -198,7 +198,10 @@ xmmsc_result_restart (xmmsc_result_t *res)
 		return;
 	}
 
+	/* the results are registered by cookie */
+	xmmsc_ipc_result_unregister (res->ipc, res);
 	res->cookie = xmmsc_write_signal_msg (res->c, res->restart_signal);
+	xmmsc_ipc_result_register (res->ipc, res);
 }
 
 static bool
@@ -342,6 +345,8 @@ xmmsc_result_wait (xmmsc_result_t *res)
 {
 	const char *err = NULL;
 	x_return_if_fail (res);
+	x_api_error_if (xmmsc_ipc_batch_active (res->ipc),
+	                "inside a batch, replies arrive at xmmsc_batch_end",);
 
 	while (!res->parsed && !(err = xmmsc_ipc_error_get (res->ipc))) {
 		xmmsc_ipc_wait_for_event (res->ipc, 5);
@@ -347,12 +347,38 @@ xmmsc_write_msg_to_ipc (xmmsc_connection_t *c, xmms_ipc_msg_t *msg)
 	return cookie;
 }
 
+/* the arguments of a signal or broadcast request */
+static xmms_ipc_msg_t *
+xmmsc_signal_msg_new (xmmsc_connection_t *c, int cmd, int signalid)
+{
+	xmms_ipc_msg_t *msg;
+	xmmsv_t *args;
+
+	msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, cmd);
+
+	if (c->coalesce > 0) {
+		args = xmmsv_build_list (XMMSV_LIST_ENTRY_INT (signalid),
+		                         XMMSV_LIST_ENTRY_INT (c->coalesce),
+		                         XMMSV_LIST_END);
+	} else {
+		args = xmmsv_build_list (XMMSV_LIST_ENTRY_INT (signalid),
+		                         XMMSV_LIST_END);
+	}
+
+	xmms_ipc_msg_put_value (msg, args);
+	xmmsv_unref (args);
+
+	return msg;
+}
+
 xmmsc_result_t *
 xmmsc_send_broadcast_msg (xmmsc_connection_t *c, int signalid)
 {
-	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_CMD_BROADCAST,
-	                       XMMSV_LIST_ENTRY_INT (signalid),
-	                       XMMSV_LIST_END);
+	xmms_ipc_msg_t *msg;
+
+	msg = xmmsc_signal_msg_new (c, XMMS_IPC_CMD_BROADCAST, signalid);
+
+	return xmmsc_send_msg (c, msg);
 }
 
 
@@ -360,16 +386,9 @@ uint32_t
 xmmsc_write_signal_msg (xmmsc_connection_t *c, int signalid)
 {
 	xmms_ipc_msg_t *msg;
-	xmmsv_t *args;
 	uint32_t cookie;
 
-	msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_CMD_SIGNAL);
-
-	args = xmmsv_build_list (XMMSV_LIST_ENTRY_INT (signalid),
-	                         XMMSV_LIST_END);
-
-	xmms_ipc_msg_put_value (msg, args);
-	xmmsv_unref (args);
+	msg = xmmsc_signal_msg_new (c, XMMS_IPC_CMD_SIGNAL, signalid);
 
 	cookie = xmmsc_write_msg_to_ipc (c, msg);
 
@@ -380,9 +399,10 @@ xmmsc_result_t *
 xmmsc_send_signal_msg (xmmsc_connection_t *c, int signalid)
 {
 	xmmsc_result_t *res;
+	xmms_ipc_msg_t *msg;
 
-	res = xmmsc_send_cmd (c, XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_CMD_SIGNAL,
-	                      XMMSV_LIST_ENTRY_INT (signalid), XMMSV_LIST_END);
+	msg = xmmsc_signal_msg_new (c, XMMS_IPC_CMD_SIGNAL, signalid);
+	res = xmmsc_send_msg (c, msg);
 
 	xmmsc_result_restartable (res, signalid);
 
@@ -477,6 +497,72 @@ xmmsc_io_want_out (xmmsc_connection_t *c)
 	return xmmsc_ipc_io_out (c->ipc);
 }
 
+/**
+ * Ask the server to coalesce the broadcasts and signals requested
+ * after this call.
+ *
+ * Instead of one message per event, the server then delivers at most
+ * one message per interval for each request. State broadcasts and
+ * signals, like the playback status or playtime, only deliver their
+ * latest value. Medialib entry broadcasts deliver a list of all the
+ * ids that changed during the interval instead of a single id, and
+ * config value changes are merged into one dict.
+ *
+ * @param c connection to set the coalescing interval on
+ * @param interval the interval in milliseconds, 0 to disable
+ */
+void
+xmmsc_broadcast_coalesce_set (xmmsc_connection_t *c, int interval)
+{
+	x_check_conn (c,);
+	x_api_error_if (interval < 0, "with a negative interval",);
+
+	c->coalesce = interval;
+}
+
+/**
+ * Start a batch of commands.
+ *
+ * Commands sent after this call are only queued, nothing is written
+ * to the server until #xmmsc_batch_end is called. The whole batch is
+ * then written with as few writes as possible and all the replies are
+ * collected before any result notifier runs, so N commands cost a
+ * single round trip instead of N.
+ *
+ * Results of commands in the batch must not be waited for with
+ * #xmmsc_result_wait before the batch has ended.
+ *
+ * @param c connection to batch commands on
+ */
+void
+xmmsc_batch_begin (xmmsc_connection_t *c)
+{
+	x_check_conn (c,);
+	x_api_error_if (xmmsc_ipc_batch_active (c->ipc),
+	                "with a batch already in progress",);
+
+	xmmsc_ipc_batch_begin (c->ipc, c->cookie);
+}
+
+/**
+ * End a batch of commands.
+ *
+ * Blocks until every command of the batch has been written and
+ * replied to, then runs the notifiers of the results in the order
+ * the replies arrived.
+ *
+ * @param c connection the batch was started on
+ */
+void
+xmmsc_batch_end (xmmsc_connection_t *c)
+{
+	x_check_conn (c,);
+	x_api_error_if (!xmmsc_ipc_batch_active (c->ipc),
+	                "without a batch in progress",);
+
+	xmmsc_ipc_batch_end (c->ipc);
+}
+
 /**
  * Write pending data.
  *
@@ -389,14 +389,16 @@ cli_server_property_setup (command_action_t *action)
 		{ "string", 's',  0, G_OPTION_ARG_NONE, NULL, _("Force the value to be treated as a string."), NULL },
 		{ "delete", 'D',  0, G_OPTION_ARG_NONE, NULL, _("Delete the selected property."), NULL },
 		{ "source", 'S',  0, G_OPTION_ARG_STRING, NULL, _("Property source."), NULL },
+		{ "match",  'm',  0, G_OPTION_ARG_STRING, NULL, _("Set or delete the property on all media matching the pattern."), "pattern" },
 		{ NULL }
 	};
 	command_action_fill (action, "server property", &cli_server_property, COMMAND_REQ_CONNECTION | COMMAND_REQ_CACHE, flags,
-	                     _("[-i | -s | -D] [-S] <mid> [name [value]]"),
+	                     _("[-i | -s | -D] [-S] <mid | -m pattern> [name [value]]"),
 	                     _("Get or set properties for a given media.\n"
 	                     "If no name or value is provided, list all properties.\n"
 	                     "If only a name is provided, display the value of the property.\n"
 	                     "If both a name and a value are provided, set the new value of the property.\n\n"
+	                     "With --match, the property is set or deleted on all the media matching the pattern at once, instead of a single media.\n\n"
 	                     "By default, set operations use client specific source and list, display operations use source-preference.\n"
 	                     "Use the --source option to override this behaviour.\n\n"
 	                     "By default, the value will be used to determine whether it should be saved as a string or an integer.\n"
@@ -2031,11 +2033,12 @@ gboolean
 cli_server_property (cli_infos_t *infos, command_context_t *ctx)
 {
 	xmmsc_result_t *res;
+	xmmsc_coll_t *query = NULL;
 
-	gint mid;
+	gint mid = 0, argoffset = 1;
 	gchar *default_source = NULL;
 	gboolean delete, fint, fstring, retval = TRUE;
-	const gchar *source, *propname, *propval;
+	const gchar *source, *propname, *propval, *pattern;
 
 	delete = fint = fstring = FALSE;
 
@@ -2053,7 +2056,13 @@ cli_server_property (cli_infos_t *infos, command_context_t *ctx)
 		return FALSE;
 	}
 
-	if (!command_arg_int_get (ctx, 0, &mid)) {
+	if (command_flag_string_get (ctx, "match", &pattern)) {
+		if (!xmmsc_coll_parse (pattern, &query)) {
+			g_printf (_("Error: failed to parse the pattern!\n"));
+			return FALSE;
+		}
+		argoffset = 0;
+	} else if (!command_arg_int_get (ctx, 0, &mid)) {
 		g_printf ("Error: you must provide a media-id!\n");
 		return FALSE;
 	}
@@ -2064,23 +2073,41 @@ cli_server_property (cli_infos_t *infos, command_context_t *ctx)
 		source = default_source;
 	}
 
-	if (!command_arg_string_get (ctx, 1, &propname)) {
+	if (!command_arg_string_get (ctx, argoffset, &propname)) {
 		propname = NULL;
 		propval = NULL;
-	} else if (!command_arg_string_get (ctx, 2, &propval)) {
+	} else if (!command_arg_string_get (ctx, argoffset + 1, &propval)) {
 		propval = NULL;
 	}
 
+	if (query && (!propname || (!propval && !delete))) {
+		g_printf (_("Error: --match requires a property and a value, "
+		            "or --delete!\n"));
+		retval = FALSE;
+		goto finish;
+	}
+
 	if (delete) {
 		if (!propname) {
 			g_printf (_("Error: you must provide a property to delete!\n"));
 			retval = FALSE;
 			goto finish;
 		}
-		res = xmmsc_medialib_entry_property_remove_with_source (infos->sync,
-		                                                        mid,
-		                                                        source,
-		                                                        propname);
+		if (query) {
+			xmmsv_t *props = xmmsv_new_dict ();
+			xmmsv_t *none = xmmsv_new_none ();
+
+			xmmsv_dict_set (props, propname, none);
+			res = xmmsc_medialib_coll_properties_set (infos->sync, query,
+			                                          source, props);
+			xmmsv_unref (none);
+			xmmsv_unref (props);
+		} else {
+			res = xmmsc_medialib_entry_property_remove_with_source (infos->sync,
+			                                                        mid,
+			                                                        source,
+			                                                        propname);
+		}
 		xmmsc_result_wait (res);
 		done (res, infos);
 	} else if (!propval) {
@@ -2102,7 +2129,18 @@ cli_server_property (cli_infos_t *infos, command_context_t *ctx)
 		fstring =  !cons & !fint;
 		fint = cons | fint;
 
-		if (fint) {
+		if (query) {
+			xmmsv_t *props = xmmsv_new_dict ();
+
+			if (fint) {
+				xmmsv_dict_set_int (props, propname, value);
+			} else {
+				xmmsv_dict_set_string (props, propname, propval);
+			}
+			res = xmmsc_medialib_coll_properties_set (infos->sync, query,
+			                                          source, props);
+			xmmsv_unref (props);
+		} else if (fint) {
 			res = xmmsc_medialib_entry_property_set_int_with_source (infos->sync,
 			                                                         mid,
 			                                                         source,
@@ -2123,6 +2161,10 @@ cli_server_property (cli_infos_t *infos, command_context_t *ctx)
 finish:
 	g_free (default_source);
 
+	if (query) {
+		xmmsc_coll_unref (query);
+	}
+
 	return retval;
 }
 
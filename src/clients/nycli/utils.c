@@ -954,10 +954,12 @@ coll_idlist_to_string (xmmsv_coll_t *coll)
 	gint32 entry;
 	gboolean first = TRUE;
 	GString *s;
+	xmmsv_t *ids;
 
 	s = g_string_new ("(");
 
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &it);
+	ids = xmmsv_coll_idlist_copy (coll);
+	xmmsv_get_list_iter (ids, &it);
 	for (xmmsv_list_iter_first (it);
 	     xmmsv_list_iter_valid (it);
 	     xmmsv_list_iter_next (it)) {
@@ -972,6 +974,7 @@ coll_idlist_to_string (xmmsv_coll_t *coll)
 		g_string_append_printf (s, "%d", entry);
 	}
 	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (ids);
 
 	g_string_append_c (s, ')');
 
@@ -23,6 +23,7 @@ G_BEGIN_DECLS
 
 gchar *xmms_bindata_calculate_md5 (const guchar *data, gsize size, gchar ret[33]);
 gboolean xmms_bindata_plugin_add (const guchar *data, gsize size, gchar hash[33]);
+gboolean xmms_bindata_plugin_add_lazy (const guchar *data, gsize size, const gchar *url, gint64 offset, gchar hash[33]);
 
 G_END_DECLS
 
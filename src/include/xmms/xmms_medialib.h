@@ -42,6 +42,7 @@
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_SAMPLE_FMT "sample_format"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_SAMPLERATE "samplerate"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD "lmod"
+#define XMMS_MEDIALIB_ENTRY_PROPERTY_ETAG "etag"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_TRACK "gain_track"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_ALBUM "gain_album"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_TRACK "peak_track"
@@ -81,6 +82,13 @@
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_WEBSITE_PUBLISHER "website_publisher"
 #define XMMS_MEDIALIB_ENTRY_PROPERTY_WEBSITE_COPYRIGHT "website_copyright"
 
+/** Browse property identifying the version of a file, used to skip
+ *  unchanged files on re-import. Transports format it with
+ *  #XMMS_MEDIALIB_BROWSE_STAT_FORMAT from mtime, size and inode. */
+#define XMMS_MEDIALIB_BROWSE_PROPERTY_STAT "stat"
+#define XMMS_MEDIALIB_BROWSE_STAT_FORMAT \
+	"%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GUINT64_FORMAT
+
 G_BEGIN_DECLS
 
 typedef gint32 xmms_medialib_entry_t;
@@ -393,6 +393,16 @@ xmms_config_property_t *xmms_output_config_lookup (xmms_output_t *output, const
  */
 xmms_medialib_entry_t xmms_output_current_id (xmms_output_t *output);
 
+/**
+ * Publish a value in the output section of the server stats, for
+ * example the measured latency of the device.
+ *
+ * @param output an output object
+ * @param key the name of the value
+ * @param value the current value
+ */
+void xmms_output_stats_set (xmms_output_t *output, const gchar *key, gint value);
+
 /** @} */
 
 G_END_DECLS
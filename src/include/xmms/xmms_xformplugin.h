@@ -49,7 +49,7 @@
 
 
 
-#define XMMS_XFORM_API_VERSION 7
+#define XMMS_XFORM_API_VERSION 8
 
 #include "xmms/xmms_error.h"
 #include "xmms/xmms_plugin.h"
@@ -149,6 +149,19 @@ typedef struct xmms_xform_methods_St {
 	 * This is called without init() beeing called.
 	 */
 	gboolean (*browse)(xmms_xform_t *, const gchar *, xmms_error_t *);
+
+	/**
+	 * Reinitialisation method.
+	 *
+	 * Called when the chain goes on with the next entry without
+	 * being set up anew, such as the next track of a cue sheet.
+	 * #xmms_xform_entry_get already returns the new entry. Effects
+	 * without this method are never carried over to another entry.
+	 *
+	 * @returns TRUE if the xform is ready for the new entry, FALSE
+	 * if the chain has to be set up anew.
+	 */
+	gboolean (*reinit)(xmms_xform_t *);
 } xmms_xform_methods_t;
 
 #define XMMS_XFORM_METHODS_INIT(m) memset (&m, 0, sizeof (xmms_xform_methods_t))
@@ -296,6 +309,32 @@ gint xmms_xform_read (xmms_xform_t *xform, gpointer buf, gint siz, xmms_error_t
 gint64 xmms_xform_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err);
 gboolean xmms_xform_iseos (xmms_xform_t *xform);
 
+/**
+ * Report a sync point while decoding.
+ *
+ * Decoders that can't seek exactly on their own call this for every
+ * frame they decode, with the number of samples before the frame and
+ * the offset of the frame in the data read with #xmms_xform_read. The
+ * points are stored per medialib entry so later seeks can start
+ * decoding at a known frame boundary.
+ *
+ * @param xform
+ * @param sample sample position of the frame, counted from the first frame
+ * @param offset byte offset of the frame in the input
+ */
+void xmms_xform_seek_index_add (xmms_xform_t *xform, gint64 sample, gint64 offset);
+
+/**
+ * Find the closest sync point before a sample.
+ *
+ * @param xform
+ * @param sample sample position to seek to
+ * @param found filled in with the sample position of the sync point
+ * @param offset filled in with the byte offset of the sync point
+ * @returns TRUE if a sync point was found
+ */
+gboolean xmms_xform_seek_index_lookup (xmms_xform_t *xform, gint64 sample, gint64 *found, gint64 *offset);
+
 const xmms_stream_type_t *xmms_xform_get_out_stream_type (xmms_xform_t *xform);
 
 gboolean xmms_magic_add (const gchar *desc, const gchar *mime, ...);
@@ -50,6 +50,8 @@ typedef enum {
 	XMMS_IPC_SIGNAL_QUIT,
 	XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
 	XMMS_IPC_SIGNAL_MEDIAINFO_READER_UNINDEXED,
+	XMMS_IPC_SIGNAL_MEDIALIB_ENTRIES_UPDATE,
+	XMMS_IPC_SIGNAL_MEDIALIB_GAIN_SCAN_PROGRESS,
 	XMMS_IPC_SIGNAL_END
 } xmms_ipc_signals_t;
 
@@ -136,7 +138,10 @@ typedef enum {
 	XMMS_IPC_CMD_PROPERTY_SET_INT,
 	XMMS_IPC_CMD_PROPERTY_REMOVE,
 	XMMS_IPC_CMD_MOVE_URL,
-	XMMS_IPC_CMD_MLIB_ADD_URL
+	XMMS_IPC_CMD_MLIB_ADD_URL,
+	XMMS_IPC_CMD_PROPERTIES_SET,
+	XMMS_IPC_CMD_PROPERTIES_SET_COLL,
+	XMMS_IPC_CMD_GAIN_SCAN
 } xmms_ipc_medialib_cmds_t;
 
 /* Collection methods */
@@ -158,7 +163,8 @@ typedef enum {
 	XMMS_IPC_CMD_GET_DATA = XMMS_IPC_CMD_FIRST,
 	XMMS_IPC_CMD_ADD_DATA,
 	XMMS_IPC_CMD_REMOVE_DATA,
-	XMMS_IPC_CMD_LIST_DATA
+	XMMS_IPC_CMD_LIST_DATA,
+	XMMS_IPC_CMD_GET_DATA_RANGE
 } xmms_ipc_bindata_cmds_t;
 
 /* visualization methods */
@@ -30,6 +30,7 @@ typedef void (*xmms_ipc_destroy_func) (xmms_ipc_transport_t *);
 
 void xmms_ipc_transport_destroy (xmms_ipc_transport_t *ipct);
 int xmms_ipc_transport_read (xmms_ipc_transport_t *ipct, char *buffer, int len);
+int xmms_ipc_transport_pending (xmms_ipc_transport_t *ipct);
 int xmms_ipc_transport_write (xmms_ipc_transport_t *ipct, char *buffer, int len);
 xmms_socket_t xmms_ipc_transport_fd_get (xmms_ipc_transport_t *ipct);
 xmms_ipc_transport_t * xmms_ipc_server_accept (xmms_ipc_transport_t *ipct);
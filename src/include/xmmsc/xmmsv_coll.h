@@ -50,6 +50,7 @@ size_t xmmsv_coll_idlist_get_size (xmmsv_coll_t *coll);
 xmmsv_coll_type_t xmmsv_coll_get_type (xmmsv_coll_t *coll);
 const int32_t *xmmsv_coll_get_idlist (xmmsv_coll_t *coll) XMMS_DEPRECATED;
 struct xmmsv_St *xmmsv_coll_idlist_get (xmmsv_coll_t *coll);
+struct xmmsv_St *xmmsv_coll_idlist_copy (xmmsv_coll_t *coll);
 
 void xmmsv_coll_attribute_set (xmmsv_coll_t *coll, const char *key, const char *value);
 int xmmsv_coll_attribute_remove (xmmsv_coll_t *coll, const char *key);
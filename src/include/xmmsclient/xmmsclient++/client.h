@@ -101,6 +101,27 @@ namespace Xmms
 			QuitSignal&
 			broadcastQuit();
 
+			/** Start a batch of commands.
+			 *  Commands issued after this call are only queued until
+			 *  batchEnd is called, then they are sent together and their
+			 *  replies are collected in a single round trip.
+			 *
+			 *  @note Do not wait for the results of commands in the batch
+			 *        before the batch has ended.
+			 *
+			 *  @throw connection_error If the client isn't connected.
+			 */
+			void batchBegin();
+
+			/** End a batch of commands.
+			 *  Blocks until every command of the batch has been replied
+			 *  to, then runs the callbacks in the order the replies
+			 *  arrived.
+			 *
+			 *  @throw connection_error If the client isn't connected.
+			 */
+			void batchEnd();
+
 			// Subsystems
 
 			const Bindata    bindata;
@@ -57,6 +57,11 @@ int xmmsc_io_out_handle (xmmsc_connection_t *c);
 int xmmsc_io_in_handle (xmmsc_connection_t *c);
 int xmmsc_io_fd_get (xmmsc_connection_t *c);
 
+void xmmsc_broadcast_coalesce_set (xmmsc_connection_t *c, int interval);
+
+void xmmsc_batch_begin (xmmsc_connection_t *c);
+void xmmsc_batch_end (xmmsc_connection_t *c);
+
 char *xmmsc_get_last_error (xmmsc_connection_t *c);
 
 xmmsc_result_t *xmmsc_quit(xmmsc_connection_t *c);
@@ -244,6 +249,10 @@ xmmsc_result_t *xmmsc_medialib_entry_property_set_str_with_source (xmmsc_connect
 xmmsc_result_t *xmmsc_medialib_entry_property_remove (xmmsc_connection_t *c, int id, const char *key);
 xmmsc_result_t *xmmsc_medialib_entry_property_remove_with_source (xmmsc_connection_t *c, int id, const char *source, const char *key);
 
+xmmsc_result_t *xmmsc_medialib_properties_set (xmmsc_connection_t *c, xmmsv_t *changes);
+xmmsc_result_t *xmmsc_medialib_coll_properties_set (xmmsc_connection_t *c, xmmsv_coll_t *coll, const char *source, xmmsv_t *properties);
+xmmsc_result_t *xmmsc_medialib_gain_scan (xmmsc_connection_t *c, xmmsv_coll_t *coll);
+
 /* XForm object */
 xmmsc_result_t *xmmsc_xform_media_browse (xmmsc_connection_t *c, const char *url);
 xmmsc_result_t *xmmsc_xform_media_browse_encoded (xmmsc_connection_t *c, const char *url);
@@ -251,11 +260,14 @@ xmmsc_result_t *xmmsc_xform_media_browse_encoded (xmmsc_connection_t *c, const c
 /* Bindata object */
 xmmsc_result_t *xmmsc_bindata_add (xmmsc_connection_t *c, const unsigned char *data, unsigned int len);
 xmmsc_result_t *xmmsc_bindata_retrieve (xmmsc_connection_t *c, const char *hash);
+xmmsc_result_t *xmmsc_bindata_retrieve_range (xmmsc_connection_t *c, const char *hash, int offset, int length);
 xmmsc_result_t *xmmsc_bindata_remove (xmmsc_connection_t *c, const char *hash);
 xmmsc_result_t *xmmsc_bindata_list (xmmsc_connection_t *c);
 
 /* broadcasts */
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_changed (xmmsc_connection_t *c);
+xmmsc_result_t *xmmsc_broadcast_medialib_entries_changed (xmmsc_connection_t *c);
+xmmsc_result_t *xmmsc_broadcast_medialib_gain_scan_progress (xmmsc_connection_t *c);
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_added (xmmsc_connection_t *c);
 
 
@@ -52,6 +52,9 @@ struct xmmsc_connection_St {
 
 	char *clientname;
 
+	/** coalescing interval asked for with broadcasts and signals, in ms */
+	int coalesce;
+
 	/** data array for visualization connections */
 	int visc;
 	xmmsc_visualization_t **visv;
@@ -39,6 +39,9 @@ void xmmsc_ipc_lock_set (xmmsc_ipc_t *ipc, void *lock, void (*lockfunc)(void *),
 void xmmsc_ipc_disconnect_set (xmmsc_ipc_t *ipc, void (*disconnect_callback) (void *), void *, xmmsc_user_data_free_func_t);
 void xmmsc_ipc_need_out_callback_set (xmmsc_ipc_t *ipc, void (*callback) (int, void *), void *userdata, xmmsc_user_data_free_func_t);
 bool xmmsc_ipc_msg_write (xmmsc_ipc_t *ipc, xmms_ipc_msg_t *msg, uint32_t cookie);
+void xmmsc_ipc_batch_begin (xmmsc_ipc_t *ipc, uint32_t first_cookie);
+void xmmsc_ipc_batch_end (xmmsc_ipc_t *ipc);
+bool xmmsc_ipc_batch_active (xmmsc_ipc_t *ipc);
 void xmmsc_ipc_disconnect (xmmsc_ipc_t *ipc);
 bool xmmsc_ipc_disconnected (xmmsc_ipc_t *ipc);
 void xmmsc_ipc_destroy (xmmsc_ipc_t *ipc);
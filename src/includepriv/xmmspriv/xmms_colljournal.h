@@ -0,0 +1,35 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_COLLJOURNAL_H__
+#define __XMMS_COLLJOURNAL_H__
+
+#include <glib.h>
+#include "xmmsc/xmmsv_coll.h"
+
+/* Called for every journaled label change: either the new collection,
+ * the label it now aliases, or neither when the label was removed. */
+typedef void (*xmms_coll_journal_replay_func_t) (guint nsid, const gchar *name, xmmsv_coll_t *coll, const gchar *alias, gpointer udata);
+
+gint xmms_coll_journal_replay (xmms_coll_journal_replay_func_t func, gpointer udata);
+void xmms_coll_journal_open (void);
+void xmms_coll_journal_close (void);
+void xmms_coll_journal_append (guint nsid, const gchar *name, xmmsv_coll_t *coll, const gchar *alias);
+void xmms_coll_journal_flush (void);
+void xmms_coll_journal_rotate (void);
+void xmms_coll_journal_discard (void);
+
+#endif
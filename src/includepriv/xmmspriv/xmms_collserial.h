@@ -41,6 +41,7 @@
 
 void xmms_collection_dag_restore (xmms_coll_dag_t *dag);
 void xmms_collection_dag_save (xmms_coll_dag_t *dag);
+void xmms_collection_dag_save_delta (xmms_coll_dag_t *dag, GHashTable **dirty);
 
 
 #endif
@@ -0,0 +1,28 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_GAINSCAN_H__
+#define __XMMS_PRIV_GAINSCAN_H__
+
+#include <glib.h>
+#include "xmms/xmms_object.h"
+
+void xmms_gainscan_init (xmms_object_t *medialib);
+void xmms_gainscan_shutdown (void);
+
+gint xmms_gainscan_queue (GList *entries);
+
+#endif
@@ -11,5 +11,6 @@ void on_config_ipcsocket_change (xmms_object_t *object, xmmsv_t *data, gpointer
 gboolean xmms_ipc_setup_server (const gchar *path);
 
 gboolean xmms_ipc_has_pending (guint signalid);
+xmmsv_t *xmms_ipc_client_stats (void);
 
 #endif
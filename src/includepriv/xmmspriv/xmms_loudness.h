@@ -0,0 +1,35 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_LOUDNESS_H__
+#define __XMMS_PRIV_LOUDNESS_H__
+
+#include <glib.h>
+
+/* loudness of silence, and the absolute gate */
+#define XMMS_LOUDNESS_SILENCE -70.0
+
+typedef struct xmms_loudness_St xmms_loudness_t;
+
+xmms_loudness_t *xmms_loudness_new (gint channels, gint rate);
+void xmms_loudness_free (xmms_loudness_t *meter);
+
+void xmms_loudness_add_frames (xmms_loudness_t *meter, const gfloat *buf, gint frames);
+
+gdouble xmms_loudness_integrated (xmms_loudness_t **meters, gint n);
+gdouble xmms_loudness_true_peak (xmms_loudness_t *meter);
+
+#endif
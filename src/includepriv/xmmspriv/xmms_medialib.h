@@ -45,5 +45,10 @@ gboolean xmms_medialib_entry_property_set_int_source (xmms_medialib_session_t *s
 guint32 xmms_medialib_source_to_id (xmms_medialib_session_t *session, const gchar *source);
 void xmms_medialib_add_recursive (xmms_medialib_t *medialib, const gchar *playlist, const gchar *path, xmms_error_t *error);
 void xmms_medialib_insert_recursive (xmms_medialib_t *medialib, const gchar *playlist, gint32 pos, const gchar *path, xmms_error_t *error);
+void xmms_medialib_import_files (xmms_medialib_t *medialib, GList *files, xmms_error_t *error);
+void xmms_medialib_move_recursive (xmms_medialib_t *medialib, const gchar *from, const gchar *to);
+void xmms_medialib_replace (xmms_medialib_t *medialib, const gchar *from, const gchar *to);
+void xmms_medialib_remove_recursive (xmms_medialib_t *medialib, const gchar *url);
+void xmms_medialib_remove_vanished (xmms_medialib_t *medialib, const gchar *url);
 
 #endif
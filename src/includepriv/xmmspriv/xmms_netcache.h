@@ -0,0 +1,28 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_NETCACHE_H__
+#define __XMMS_PRIV_NETCACHE_H__
+
+#include <glib.h>
+#include "xmmspriv/xmms_xform.h"
+
+void xmms_netcache_init (void);
+
+xmms_xform_t *xmms_netcache_xform_wrap (xmms_xform_t *prev, xmms_medialib_entry_t entry, GList *goal_hints);
+xmmsv_t *xmms_netcache_stats (void);
+
+#endif
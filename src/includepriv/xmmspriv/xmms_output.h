@@ -40,4 +40,6 @@ guint32 xmms_output_latency (xmms_output_t *output);
 
 gboolean xmms_output_plugin_switch (xmms_output_t *output, xmms_output_plugin_t *new_plugin);
 
+xmmsv_t *xmms_output_stats (xmms_output_t *output);
+
 #endif
@@ -0,0 +1,34 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PARTYSHUFFLE_H__
+#define __XMMS_PARTYSHUFFLE_H__
+
+#include <glib.h>
+#include "xmmspriv/xmms_collection.h"
+#include "xmms/xmms_medialib.h"
+
+typedef struct xmms_partyshuffle_St xmms_partyshuffle_t;
+
+xmms_partyshuffle_t *xmms_partyshuffle_new (void);
+void xmms_partyshuffle_free (xmms_partyshuffle_t *ps);
+
+void xmms_partyshuffle_entry_changed (xmms_partyshuffle_t *ps, xmms_medialib_entry_t entry);
+void xmms_partyshuffle_invalidate (xmms_partyshuffle_t *ps);
+
+xmms_medialib_entry_t xmms_partyshuffle_draw (xmms_partyshuffle_t *ps, xmms_coll_dag_t *dag, xmmsv_coll_t *plcoll, xmmsv_coll_t *source);
+
+#endif
@@ -43,6 +43,7 @@ typedef struct xmms_playlist_St xmms_playlist_t;
 #include "xmms/xmms_error.h"
 #include "xmms/xmms_medialib.h"
 #include "xmmspriv/xmms_mediainfo.h"
+#include "xmmspriv/xmms_collection.h"
 
 /*
  * Public functions
@@ -60,6 +61,7 @@ void xmms_playlist_add_entry (xmms_playlist_t *playlist, const gchar *plname, xm
 void xmms_playlist_insert_entry (xmms_playlist_t *playlist, const gchar *plname, guint32 pos, xmms_medialib_entry_t file, xmms_error_t *err);
 
 xmms_mediainfo_reader_t *xmms_playlist_mediainfo_reader_get (xmms_playlist_t *playlist);
+xmms_coll_dag_t *xmms_playlist_colldag_get (xmms_playlist_t *playlist);
 
 
 GTree *xmms_playlist_changed_msg_new (xmms_playlist_t *playlist, xmms_playlist_changed_actions_t type, xmms_medialib_entry_t id, const gchar *plname);
@@ -0,0 +1,35 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_SEEKINDEX_H__
+#define __XMMS_PRIV_SEEKINDEX_H__
+
+#include <glib.h>
+#include "xmms/xmms_medialib.h"
+
+typedef struct xmms_seek_index_St xmms_seek_index_t;
+
+void xmms_seek_index_init (void);
+
+xmms_seek_index_t *xmms_seek_index_load (xmms_medialib_entry_t entry, const gchar *decoder, gint64 size, gint64 mtime);
+void xmms_seek_index_save (xmms_seek_index_t *idx);
+void xmms_seek_index_free (xmms_seek_index_t *idx);
+void xmms_seek_index_remove (xmms_medialib_entry_t entry);
+
+void xmms_seek_index_add (xmms_seek_index_t *idx, gint64 sample, gint64 offset);
+gboolean xmms_seek_index_lookup (xmms_seek_index_t *idx, gint64 sample, gint64 *found, gint64 *offset);
+
+#endif
@@ -36,6 +36,11 @@ gboolean xmms_xform_plugin_verify (xmms_plugin_t *plugin);
 
 xmms_xform_t *xmms_xform_chain_setup (xmms_medialib_entry_t entry, GList *goal_formats, gboolean rehash);
 xmms_xform_t *xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats, gboolean rehash);
+xmms_xform_t *xmms_xform_chain_setup_decoder (xmms_medialib_entry_t entry, GList *goal_formats);
+void xmms_xform_plan_cache_invalidate (void);
+gboolean xmms_xform_chain_continue (xmms_xform_t *chain, xmms_medialib_entry_t entry);
+
+gboolean xmms_segment_continue (xmms_xform_t *xform, gint startms, gint stopms);
 
 gint64 xmms_xform_this_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err);
 int xmms_xform_this_read (xmms_xform_t *xform, gpointer buf, int siz, xmms_error_t *err);
@@ -30,6 +30,9 @@
 #include "xmmsc/xmmsc_stdint.h"
 #include "xmmsc/xmmsv_coll.h"
 
+/* Upper bound of the data gathered for a single write of many messages */
+#define XMMS_IPC_MSG_GATHER_MAX 65536
+
 struct xmms_ipc_msg_St {
 	xmmsv_t *bb;
 	uint32_t xfered;
@@ -217,6 +220,86 @@ xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
 	return (len == msg->xfered);
 }
 
+/**
+ * Try to write several messages to transport with a single write.
+ * The first message may already be partially written, the others
+ * must be untouched. Partially written messages keep track of the
+ * amount of data written, just like #xmms_ipc_msg_write_transport.
+ *
+ * @returns the number of messages that were fully written.
+ *               disconnected is set if transport was disconnected
+ */
+int
+xmms_ipc_msg_write_transport_many (xmms_ipc_msg_t **msgs, int count,
+                                   xmms_ipc_transport_t *transport,
+                                   bool *disconnected)
+{
+	char *buf, *p;
+	unsigned int len, total;
+	int ret, i, n;
+
+	x_return_val_if_fail (msgs, 0);
+	x_return_val_if_fail (transport, 0);
+
+	/* gather as many messages as fit, but always at least one */
+	total = 0;
+	for (n = 0; n < count; n++) {
+		xmmsv_bitbuffer_align (msgs[n]->bb);
+		len = xmmsv_bitbuffer_len (msgs[n]->bb) / 8 - msgs[n]->xfered;
+		if (n > 0 && total + len > XMMS_IPC_MSG_GATHER_MAX) {
+			break;
+		}
+		total += len;
+	}
+
+	if (n <= 1) {
+		return (count > 0 &&
+		        xmms_ipc_msg_write_transport (msgs[0], transport,
+		                                      disconnected)) ? 1 : 0;
+	}
+
+	buf = malloc (total);
+	if (!buf) {
+		x_oom ();
+		return 0;
+	}
+
+	for (p = buf, i = 0; i < n; i++) {
+		len = xmmsv_bitbuffer_len (msgs[i]->bb) / 8 - msgs[i]->xfered;
+		memcpy (p, xmmsv_bitbuffer_buffer (msgs[i]->bb) + msgs[i]->xfered,
+		        len);
+		p += len;
+	}
+
+	ret = xmms_ipc_transport_write (transport, buf, total);
+	free (buf);
+
+	if (ret == SOCKET_ERROR) {
+		if (!xmms_socket_error_recoverable () && disconnected) {
+			*disconnected = true;
+		}
+		return 0;
+	} else if (!ret) {
+		if (disconnected) {
+			*disconnected = true;
+		}
+		return 0;
+	}
+
+	/* account the written data to the messages it came from */
+	for (i = 0; i < n; i++) {
+		len = xmmsv_bitbuffer_len (msgs[i]->bb) / 8 - msgs[i]->xfered;
+		if ((unsigned int) ret < len) {
+			msgs[i]->xfered += ret;
+			break;
+		}
+		msgs[i]->xfered += len;
+		ret -= len;
+	}
+
+	return i;
+}
+
 /**
  * Try to read message from transport into msg.
  *
@@ -27,6 +27,7 @@
 #include "xmmsc/xmmsc_unistd.h"
 #include "url.h"
 #include "socket_tcp.h"
+#include "transport.h"
 
 static void
 xmms_ipc_tcp_destroy (xmms_ipc_transport_t *ipct)
@@ -118,7 +119,7 @@ xmms_ipc_tcp_client_init (const xmms_url_t *url, int ipv6)
 		return NULL;
 	}
 
-	ipct = x_new0 (xmms_ipc_transport_t, 1);
+	ipct = xmms_ipc_transport_new ();
 	ipct->fd = fd;
 	ipct->path = strdup (url->host);
 	ipct->read_func = xmms_ipc_tcp_read;
@@ -155,7 +156,7 @@ xmms_ipc_tcp_accept (xmms_ipc_transport_t *transport)
 		setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, reuseaddr, sizeof (_reuseaddr));
 		setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, nodelay, sizeof (_nodelay));
 
-		ret = x_new0 (xmms_ipc_transport_t, 1);
+		ret = xmms_ipc_transport_new ();
 		ret->fd = fd;
 		ret->read_func = xmms_ipc_tcp_read;
 		ret->write_func = xmms_ipc_tcp_write;
@@ -225,7 +226,7 @@ xmms_ipc_tcp_server_init (const xmms_url_t *url, int ipv6)
 		return NULL;
 	}
 
-	ipct = x_new0 (xmms_ipc_transport_t, 1);
+	ipct = xmms_ipc_transport_new ();
 	ipct->fd = fd;
 	ipct->path = strdup (url->host);
 	ipct->read_func = xmms_ipc_tcp_read;
@@ -32,6 +32,7 @@
 #include "xmmsc/xmmsc_util.h"
 #include "url.h"
 #include "socket_unix.h"
+#include "transport.h"
 
 static void
 xmms_ipc_usocket_destroy (xmms_ipc_transport_t *ipct)
@@ -105,7 +106,7 @@ xmms_ipc_usocket_client_init (const xmms_url_t *url)
 		return NULL;
 	}
 
-	ipct = x_new0 (xmms_ipc_transport_t, 1);
+	ipct = xmms_ipc_transport_new ();
 	ipct->fd = fd;
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
@@ -147,7 +148,7 @@ xmms_ipc_usocket_accept (xmms_ipc_transport_t *transport)
 		}
 
 
-		ret = x_new0 (xmms_ipc_transport_t, 1);
+		ret = xmms_ipc_transport_new ();
 		ret->fd = fd;
 		ret->read_func = xmms_ipc_usocket_read;
 		ret->write_func = xmms_ipc_usocket_write;
@@ -208,7 +209,7 @@ xmms_ipc_usocket_server_init (const xmms_url_t *url)
 		return NULL;
 	}
 
-	ipct = x_new0 (xmms_ipc_transport_t, 1);
+	ipct = xmms_ipc_transport_new ();
 	ipct->fd = fd;
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
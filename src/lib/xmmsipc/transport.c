@@ -22,21 +22,110 @@
 #include "socket_unix.h"
 #include "socket_tcp.h"
 #include "url.h"
+#include "transport.h"
+
+/* Size of the read ahead buffer, many small messages fit in one read */
+#define XMMS_IPC_TRANSPORT_RBUF_SIZE 32768
+
+/* The public transport, followed by state kept out of the installed
+ * header.
+ */
+typedef struct xmms_ipc_transport_priv_St {
+	xmms_ipc_transport_t ipct;
+
+	/* data read ahead from the socket, not yet handed out */
+	char *rbuf;
+	int rbuf_len;
+	int rbuf_pos;
+} xmms_ipc_transport_priv_t;
+
+#define XMMS_IPC_TRANSPORT_PRIV(ipct) ((xmms_ipc_transport_priv_t *) (ipct))
+
+/**
+ * Allocate a transport, for the socket implementations to fill in.
+ */
+xmms_ipc_transport_t *
+xmms_ipc_transport_new (void)
+{
+	xmms_ipc_transport_priv_t *priv;
+
+	priv = x_new0 (xmms_ipc_transport_priv_t, 1);
+	if (!priv) {
+		return NULL;
+	}
+
+	return &priv->ipct;
+}
 
 void
 xmms_ipc_transport_destroy (xmms_ipc_transport_t *ipct)
 {
+	xmms_ipc_transport_priv_t *priv = XMMS_IPC_TRANSPORT_PRIV (ipct);
+
 	x_return_if_fail (ipct);
 
 	ipct->destroy_func (ipct);
 
-	free (ipct);
+	free (priv->rbuf);
+	free (priv);
 }
 
+/**
+ * Read from the transport. Small reads are served from a read ahead
+ * buffer, so that a burst of messages costs one syscall instead of
+ * two per message. Callers must keep reading until the read would
+ * block, as buffered data does not make the socket poll readable.
+ */
 int
 xmms_ipc_transport_read (xmms_ipc_transport_t *ipct, char *buffer, int len)
 {
-	return ipct->read_func (ipct, buffer, len);
+	xmms_ipc_transport_priv_t *priv = XMMS_IPC_TRANSPORT_PRIV (ipct);
+	int ret;
+
+	if (priv->rbuf_pos == priv->rbuf_len) {
+		if (len >= XMMS_IPC_TRANSPORT_RBUF_SIZE) {
+			return ipct->read_func (ipct, buffer, len);
+		}
+
+		if (!priv->rbuf) {
+			priv->rbuf = malloc (XMMS_IPC_TRANSPORT_RBUF_SIZE);
+			if (!priv->rbuf) {
+				x_oom ();
+				return ipct->read_func (ipct, buffer, len);
+			}
+		}
+
+		ret = ipct->read_func (ipct, priv->rbuf,
+		                       XMMS_IPC_TRANSPORT_RBUF_SIZE);
+		if (ret <= 0) {
+			return ret;
+		}
+
+		priv->rbuf_len = ret;
+		priv->rbuf_pos = 0;
+	}
+
+	ret = priv->rbuf_len - priv->rbuf_pos;
+	if (ret > len) {
+		ret = len;
+	}
+
+	memcpy (buffer, priv->rbuf + priv->rbuf_pos, ret);
+	priv->rbuf_pos += ret;
+
+	return ret;
+}
+
+/**
+ * @returns the number of bytes already read ahead from the socket.
+ */
+int
+xmms_ipc_transport_pending (xmms_ipc_transport_t *ipct)
+{
+	xmms_ipc_transport_priv_t *priv = XMMS_IPC_TRANSPORT_PRIV (ipct);
+
+	x_return_val_if_fail (ipct, 0);
+	return priv->rbuf_len - priv->rbuf_pos;
 }
 
 int
@@ -26,6 +26,26 @@
 #include "xmmspriv/xmms_list.h"
 
 
+/* The ids of an idlist are stored in a counted B+tree, so that inserting,
+ * removing or moving an id in the middle of a huge playlist does not have
+ * to shift the whole tail of the list.  Each inner node knows the number
+ * of ids below it, which is used to find an id by its position. */
+#define XMMSV_COLL_IDTREE_LEAF_MAX 256
+#define XMMSV_COLL_IDTREE_INNER_MAX 64
+#define XMMSV_COLL_IDTREE_MAX_DEPTH 32
+
+typedef struct xmmsv_coll_idtree_St xmmsv_coll_idtree_t;
+
+struct xmmsv_coll_idtree_St {
+	int leaf;
+	int n;    /* number of ids in a leaf, of children in an inner node */
+	int size; /* number of ids in the subtree */
+	union {
+		int32_t ids[XMMSV_COLL_IDTREE_LEAF_MAX];
+		xmmsv_coll_idtree_t *children[XMMSV_COLL_IDTREE_INNER_MAX];
+	} u;
+};
+
 struct xmmsv_coll_St {
 
 	/* refcounting */
@@ -34,7 +54,13 @@ struct xmmsv_coll_St {
 	xmmsv_coll_type_t type;
 	xmmsv_t *operands;
 	xmmsv_t *attributes;
+
+	xmmsv_coll_idtree_t *idtree;
+
+	/* list view of the idtree for xmmsv_coll_idlist_get, only built
+	 * when that is called and rebuilt on demand when stale */
 	xmmsv_t *idlist;
+	int idlist_stale;
 
 	int32_t *legacy_idlist;
 };
@@ -42,6 +68,14 @@ struct xmmsv_coll_St {
 
 static void xmmsv_coll_free (xmmsv_coll_t *coll);
 
+static xmmsv_coll_idtree_t *xmmsv_coll_idtree_new (int leaf);
+static void xmmsv_coll_idtree_free (xmmsv_coll_idtree_t *node);
+static int xmmsv_coll_idtree_insert (xmmsv_coll_t *coll, int pos, int32_t id);
+static void xmmsv_coll_idtree_remove (xmmsv_coll_t *coll, int pos);
+static int32_t *xmmsv_coll_idtree_lookup (xmmsv_coll_idtree_t *node, int pos);
+static int32_t *xmmsv_coll_idtree_flatten (xmmsv_coll_idtree_t *node, int32_t *dst);
+static int xmmsv_coll_idlist_validate_pos (xmmsv_coll_t *coll, int *pos, int allow_append);
+
 
 /**
  * @defgroup CollectionStructure CollectionStructure
@@ -90,8 +124,14 @@ xmmsv_coll_new (xmmsv_coll_type_t type)
 	coll->ref  = 0;
 	coll->type = type;
 
-	coll->idlist = xmmsv_new_list ();
-	xmmsv_list_restrict_type (coll->idlist, XMMSV_TYPE_INT32);
+	coll->idtree = xmmsv_coll_idtree_new (1);
+	if (!coll->idtree) {
+		free (coll);
+		return NULL;
+	}
+
+	coll->idlist = NULL;
+	coll->idlist_stale = 1;
 
 	coll->operands = xmmsv_new_list ();
 	xmmsv_list_restrict_type (coll->operands, XMMSV_TYPE_COLL);
@@ -121,7 +161,10 @@ xmmsv_coll_free (xmmsv_coll_t *coll)
 	/* Unref all the operands and attributes */
 	xmmsv_unref (coll->operands);
 	xmmsv_unref (coll->attributes);
-	xmmsv_unref (coll->idlist);
+	if (coll->idlist) {
+		xmmsv_unref (coll->idlist);
+	}
+	xmmsv_coll_idtree_free (coll->idtree);
 	if (coll->legacy_idlist) {
 		free (coll->legacy_idlist);
 	}
@@ -162,9 +205,9 @@ xmmsv_coll_set_idlist (xmmsv_coll_t *coll, int ids[])
 {
 	unsigned int i;
 
-	xmmsv_list_clear (coll->idlist);
+	xmmsv_coll_idlist_clear (coll);
 	for (i = 0; ids[i]; i++) {
-		xmmsv_list_append_int (coll->idlist, ids[i]);
+		xmmsv_coll_idlist_append (coll, ids[i]);
 	}
 }
 
@@ -245,7 +288,7 @@ xmmsv_coll_remove_operand (xmmsv_coll_t *coll, xmmsv_coll_t *op)
 /**
  * Append a value to the idlist.
  * @param coll  The collection to update.
- * @param id    The id to append to the idlist.
+ * @param id    The id to append to the idlist.
  * @return  TRUE on success, false otherwise.
  */
 int
@@ -253,14 +296,14 @@ xmmsv_coll_idlist_append (xmmsv_coll_t *coll, int id)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_append_int (coll->idlist, id);
+	return xmmsv_coll_idtree_insert (coll, coll->idtree->size, id);
 }
 
 /**
  * Insert a value at a given position in the idlist.
  * @param coll  The collection to update.
- * @param id    The id to insert in the idlist.
- * @param index The position at which to insert the value.
+ * @param id    The id to insert in the idlist.
+ * @param index The position at which to insert the value.
  * @return  TRUE on success, false otherwise.
  */
 int
@@ -268,7 +311,11 @@ xmmsv_coll_idlist_insert (xmmsv_coll_t *coll, int index, int id)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_insert_int (coll->idlist, index, id);
+	if (!xmmsv_coll_idlist_validate_pos (coll, &index, 1)) {
+		return 0;
+	}
+
+	return xmmsv_coll_idtree_insert (coll, index, id);
 }
 
 /**
@@ -281,9 +328,19 @@ xmmsv_coll_idlist_insert (xmmsv_coll_t *coll, int index, int id)
 int
 xmmsv_coll_idlist_move (xmmsv_coll_t *coll, int index, int newindex)
 {
+	int32_t id;
+
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_move (coll->idlist, index, newindex);
+	if (!xmmsv_coll_idlist_validate_pos (coll, &index, 0) ||
+	    !xmmsv_coll_idlist_validate_pos (coll, &newindex, 0)) {
+		return 0;
+	}
+
+	id = *xmmsv_coll_idtree_lookup (coll->idtree, index);
+	xmmsv_coll_idtree_remove (coll, index);
+
+	return xmmsv_coll_idtree_insert (coll, newindex, id);
 }
 
 /**
@@ -297,7 +354,13 @@ xmmsv_coll_idlist_remove (xmmsv_coll_t *coll, int index)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_remove (coll->idlist, index);
+	if (!xmmsv_coll_idlist_validate_pos (coll, &index, 0)) {
+		return 0;
+	}
+
+	xmmsv_coll_idtree_remove (coll, index);
+
+	return 1;
 }
 
 /**
@@ -308,9 +371,18 @@ xmmsv_coll_idlist_remove (xmmsv_coll_t *coll, int index)
 int
 xmmsv_coll_idlist_clear (xmmsv_coll_t *coll)
 {
+	xmmsv_coll_idtree_t *empty;
+
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_clear (coll->idlist);
+	empty = xmmsv_coll_idtree_new (1);
+	x_return_val_if_fail (empty, 0);
+
+	xmmsv_coll_idtree_free (coll->idtree);
+	coll->idtree = empty;
+	coll->idlist_stale = 1;
+
+	return 1;
 }
 
 /**
@@ -325,7 +397,13 @@ xmmsv_coll_idlist_get_index (xmmsv_coll_t *coll, int index, int32_t *val)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_get_int (coll->idlist, index, val);
+	if (!xmmsv_coll_idlist_validate_pos (coll, &index, 0)) {
+		return 0;
+	}
+
+	*val = *xmmsv_coll_idtree_lookup (coll->idtree, index);
+
+	return 1;
 }
 
 /**
@@ -340,7 +418,14 @@ xmmsv_coll_idlist_set_index (xmmsv_coll_t *coll, int index, int32_t val)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_set_int (coll->idlist, index, val);
+	if (!xmmsv_coll_idlist_validate_pos (coll, &index, 0)) {
+		return 0;
+	}
+
+	*xmmsv_coll_idtree_lookup (coll->idtree, index) = val;
+	coll->idlist_stale = 1;
+
+	return 1;
 }
 
 /**
@@ -353,7 +438,7 @@ xmmsv_coll_idlist_get_size (xmmsv_coll_t *coll)
 {
 	x_return_val_if_fail (coll, 0);
 
-	return xmmsv_list_get_size (coll->idlist);
+	return coll->idtree->size;
 }
 
 
@@ -389,10 +474,6 @@ xmmsv_coll_get_type (xmmsv_coll_t *coll)
 const int32_t*
 xmmsv_coll_get_idlist (xmmsv_coll_t *coll)
 {
-	xmmsv_list_iter_t *it;
-	unsigned int i;
-	int32_t entry;
-
 	x_return_null_if_fail (coll);
 
 	/* free and allocate a new legacy list */
@@ -402,18 +483,62 @@ xmmsv_coll_get_idlist (xmmsv_coll_t *coll)
 	coll->legacy_idlist = calloc (xmmsv_coll_idlist_get_size (coll) + 1,
 	                              sizeof (int32_t));
 
-	/* copy contents to legacy list */
-	for (xmmsv_get_list_iter (coll->idlist, &it), i = 0;
-	     xmmsv_list_iter_valid (it);
-	     xmmsv_list_iter_next (it), i++) {
-		xmmsv_list_iter_entry_int (it, &entry);
-		coll->legacy_idlist[i] = entry;
-	}
-	coll->legacy_idlist[i] = 0;
+	/* copy contents to legacy list, the calloc provides the terminator */
+	xmmsv_coll_idtree_flatten (coll->idtree, coll->legacy_idlist);
 
 	return coll->legacy_idlist;
 }
 
+/* Append the ids of the collection to list. */
+static int
+xmmsv_coll_idlist_fill (xmmsv_coll_t *coll, xmmsv_t *list)
+{
+	int32_t *ids;
+	int i;
+
+	ids = x_new (int32_t, coll->idtree->size + 1);
+	x_return_val_if_fail (ids, 0);
+
+	xmmsv_coll_idtree_flatten (coll->idtree, ids);
+
+	for (i = 0; i < coll->idtree->size; i++) {
+		xmmsv_list_append_int (list, ids[i]);
+	}
+	free (ids);
+
+	return 1;
+}
+
+/**
+ * Return a new list holding the ids stored in the collection.
+ * The caller owns the reference to the list, changes to it do not affect
+ * the collection. Unlike #xmmsv_coll_idlist_get this does not modify the
+ * collection, so it may be called by several readers at once.
+ *
+ * Note that this must not be confused with the content of the collection,
+ * which must be queried using xmmsc_coll_query_ids!
+ *
+ * @param coll  The collection to consider.
+ * @return A new list of the ids.
+ */
+xmmsv_t *
+xmmsv_coll_idlist_copy (xmmsv_coll_t *coll)
+{
+	xmmsv_t *list;
+
+	x_return_null_if_fail (coll);
+
+	list = xmmsv_new_list ();
+	xmmsv_list_restrict_type (list, XMMSV_TYPE_INT32);
+
+	if (!xmmsv_coll_idlist_fill (coll, list)) {
+		xmmsv_unref (list);
+		return NULL;
+	}
+
+	return list;
+}
+
 /**
  * Return the list of ids stored in the collection.
  * This function does not increase the refcount of the list, the reference is
@@ -422,14 +547,34 @@ xmmsv_coll_get_idlist (xmmsv_coll_t *coll)
  * Note that this must not be confused with the content of the collection,
  * which must be queried using xmmsc_coll_query_ids!
  *
+ * The list is a read-only view of the idlist, built by this function and
+ * rebuilt when the idlist changed since the last call, so it must not be
+ * called on the same collection from several threads. Use
+ * #xmmsv_coll_idlist_copy for that, and the xmmsv_coll_idlist_*
+ * functions to modify the idlist.
+ *
  * @param coll  The collection to consider.
- * @return The 0-terminated list of ids.
+ * @return The list of ids.
  */
 xmmsv_t *
 xmmsv_coll_idlist_get (xmmsv_coll_t *coll)
 {
 	x_return_null_if_fail (coll);
 
+	if (!coll->idlist) {
+		coll->idlist = xmmsv_new_list ();
+		xmmsv_list_restrict_type (coll->idlist, XMMSV_TYPE_INT32);
+	}
+
+	if (coll->idlist_stale) {
+		xmmsv_list_clear (coll->idlist);
+		if (!xmmsv_coll_idlist_fill (coll, coll->idlist)) {
+			return NULL;
+		}
+
+		coll->idlist_stale = 0;
+	}
+
 	return coll->idlist;
 }
 
@@ -562,3 +707,341 @@ xmmsv_coll_universe ()
 }
 
 /** @} */
+
+
+static xmmsv_coll_idtree_t *
+xmmsv_coll_idtree_new (int leaf)
+{
+	xmmsv_coll_idtree_t *node;
+
+	node = x_new0 (xmmsv_coll_idtree_t, 1);
+	if (!node) {
+		x_oom ();
+		return NULL;
+	}
+
+	node->leaf = leaf;
+
+	return node;
+}
+
+static void
+xmmsv_coll_idtree_free (xmmsv_coll_idtree_t *node)
+{
+	int i;
+
+	if (!node->leaf) {
+		for (i = 0; i < node->n; i++) {
+			xmmsv_coll_idtree_free (node->u.children[i]);
+		}
+	}
+
+	free (node);
+}
+
+static int
+xmmsv_coll_idtree_is_full (xmmsv_coll_idtree_t *node)
+{
+	if (node->leaf) {
+		return node->n == XMMSV_COLL_IDTREE_LEAF_MAX;
+	}
+	return node->n == XMMSV_COLL_IDTREE_INNER_MAX;
+}
+
+static int
+xmmsv_coll_idtree_is_sparse (xmmsv_coll_idtree_t *node)
+{
+	if (node->leaf) {
+		return node->n < XMMSV_COLL_IDTREE_LEAF_MAX / 4;
+	}
+	return node->n < XMMSV_COLL_IDTREE_INNER_MAX / 4;
+}
+
+/**
+ * Find the child of an inner node containing the given position, and
+ * make the position relative to that child.  When inserting, a position
+ * right after the last id of a child belongs to that child.
+ */
+static int
+xmmsv_coll_idtree_find_child (xmmsv_coll_idtree_t *node, int *pos,
+                              int inserting)
+{
+	int i, size;
+
+	for (i = 0; i < node->n - 1; i++) {
+		size = node->u.children[i]->size;
+		if (*pos < size || (inserting && *pos == size)) {
+			break;
+		}
+		*pos -= size;
+	}
+
+	return i;
+}
+
+/**
+ * Move items between two neighbouring nodes on the same level. A positive
+ * count moves the first items of right to the end of left, a negative
+ * count moves the last items of left to the front of right.
+ */
+static void
+xmmsv_coll_idtree_shift (xmmsv_coll_idtree_t *left,
+                         xmmsv_coll_idtree_t *right, int count)
+{
+	int i, moved = 0;
+
+	if (left->leaf) {
+		if (count > 0) {
+			memcpy (left->u.ids + left->n, right->u.ids,
+			        count * sizeof (int32_t));
+			memmove (right->u.ids, right->u.ids + count,
+			         (right->n - count) * sizeof (int32_t));
+		} else {
+			memmove (right->u.ids - count, right->u.ids,
+			         right->n * sizeof (int32_t));
+			memcpy (right->u.ids, left->u.ids + left->n + count,
+			        -count * sizeof (int32_t));
+		}
+		moved = count;
+	} else {
+		if (count > 0) {
+			for (i = 0; i < count; i++) {
+				moved += right->u.children[i]->size;
+			}
+			memcpy (left->u.children + left->n, right->u.children,
+			        count * sizeof (xmmsv_coll_idtree_t *));
+			memmove (right->u.children, right->u.children + count,
+			         (right->n - count) * sizeof (xmmsv_coll_idtree_t *));
+		} else {
+			for (i = left->n + count; i < left->n; i++) {
+				moved -= left->u.children[i]->size;
+			}
+			memmove (right->u.children - count, right->u.children,
+			         right->n * sizeof (xmmsv_coll_idtree_t *));
+			memcpy (right->u.children, left->u.children + left->n + count,
+			        -count * sizeof (xmmsv_coll_idtree_t *));
+		}
+	}
+
+	left->n += count;
+	right->n -= count;
+	left->size += moved;
+	right->size -= moved;
+}
+
+/**
+ * Split the full child at the given index of an inner node in two halves.
+ */
+static int
+xmmsv_coll_idtree_split_child (xmmsv_coll_idtree_t *node, int index)
+{
+	xmmsv_coll_idtree_t *child, *right;
+
+	child = node->u.children[index];
+
+	right = xmmsv_coll_idtree_new (child->leaf);
+	if (!right) {
+		return 0;
+	}
+
+	xmmsv_coll_idtree_shift (child, right, -(child->n / 2));
+
+	memmove (node->u.children + index + 2, node->u.children + index + 1,
+	         (node->n - index - 1) * sizeof (xmmsv_coll_idtree_t *));
+	node->u.children[index + 1] = right;
+	node->n++;
+
+	return 1;
+}
+
+/**
+ * Merge the child at the given index of an inner node with a neighbour,
+ * or even out their sizes if both do not fit in a single node.
+ */
+static void
+xmmsv_coll_idtree_rebalance_child (xmmsv_coll_idtree_t *node, int index)
+{
+	xmmsv_coll_idtree_t *left, *right;
+	int max;
+
+	if (node->n < 2) {
+		return;
+	}
+
+	if (index == node->n - 1) {
+		index--;
+	}
+
+	left = node->u.children[index];
+	right = node->u.children[index + 1];
+
+	max = left->leaf ? XMMSV_COLL_IDTREE_LEAF_MAX : XMMSV_COLL_IDTREE_INNER_MAX;
+
+	if (left->n + right->n <= max) {
+		xmmsv_coll_idtree_shift (left, right, right->n);
+		free (right);
+
+		memmove (node->u.children + index + 1, node->u.children + index + 2,
+		         (node->n - index - 2) * sizeof (xmmsv_coll_idtree_t *));
+		node->n--;
+	} else {
+		xmmsv_coll_idtree_shift (left, right,
+		                         (left->n + right->n) / 2 - left->n);
+	}
+}
+
+/**
+ * Insert an id at the given (valid) position of the idlist. Full nodes are
+ * split on the way down so that there is always room for a new child.
+ */
+static int
+xmmsv_coll_idtree_insert (xmmsv_coll_t *coll, int pos, int32_t id)
+{
+	xmmsv_coll_idtree_t *path[XMMSV_COLL_IDTREE_MAX_DEPTH];
+	xmmsv_coll_idtree_t *node, *root;
+	int depth = 0, i;
+
+	if (xmmsv_coll_idtree_is_full (coll->idtree)) {
+		root = xmmsv_coll_idtree_new (0);
+		x_return_val_if_fail (root, 0);
+
+		root->n = 1;
+		root->size = coll->idtree->size;
+		root->u.children[0] = coll->idtree;
+		coll->idtree = root;
+	}
+
+	node = coll->idtree;
+	while (!node->leaf) {
+		path[depth++] = node;
+
+		i = xmmsv_coll_idtree_find_child (node, &pos, 1);
+		if (xmmsv_coll_idtree_is_full (node->u.children[i])) {
+			x_return_val_if_fail (xmmsv_coll_idtree_split_child (node, i), 0);
+			if (pos > node->u.children[i]->size) {
+				pos -= node->u.children[i]->size;
+				i++;
+			}
+		}
+
+		node = node->u.children[i];
+	}
+
+	memmove (node->u.ids + pos + 1, node->u.ids + pos,
+	         (node->n - pos) * sizeof (int32_t));
+	node->u.ids[pos] = id;
+	node->n++;
+	node->size++;
+
+	/* only account for the id once it has been stored */
+	while (depth > 0) {
+		path[--depth]->size++;
+	}
+
+	coll->idlist_stale = 1;
+
+	return 1;
+}
+
+static void
+xmmsv_coll_idtree_remove_recurs (xmmsv_coll_idtree_t *node, int pos)
+{
+	int i;
+
+	node->size--;
+
+	if (node->leaf) {
+		memmove (node->u.ids + pos, node->u.ids + pos + 1,
+		         (node->n - pos - 1) * sizeof (int32_t));
+		node->n--;
+		return;
+	}
+
+	i = xmmsv_coll_idtree_find_child (node, &pos, 0);
+	xmmsv_coll_idtree_remove_recurs (node->u.children[i], pos);
+
+	if (xmmsv_coll_idtree_is_sparse (node->u.children[i])) {
+		xmmsv_coll_idtree_rebalance_child (node, i);
+	}
+}
+
+/**
+ * Remove the id at the given (valid) position of the idlist.
+ */
+static void
+xmmsv_coll_idtree_remove (xmmsv_coll_t *coll, int pos)
+{
+	xmmsv_coll_idtree_t *root;
+
+	xmmsv_coll_idtree_remove_recurs (coll->idtree, pos);
+
+	/* drop inner roots with a single child */
+	root = coll->idtree;
+	while (!root->leaf && root->n == 1) {
+		coll->idtree = root->u.children[0];
+		free (root);
+		root = coll->idtree;
+	}
+
+	coll->idlist_stale = 1;
+}
+
+/**
+ * Return a pointer to the id stored at the given (valid) position.
+ */
+static int32_t *
+xmmsv_coll_idtree_lookup (xmmsv_coll_idtree_t *node, int pos)
+{
+	int i;
+
+	while (!node->leaf) {
+		i = xmmsv_coll_idtree_find_child (node, &pos, 0);
+		node = node->u.children[i];
+	}
+
+	return node->u.ids + pos;
+}
+
+/**
+ * Copy all the ids of the subtree to dst, and return the end of the copy.
+ */
+static int32_t *
+xmmsv_coll_idtree_flatten (xmmsv_coll_idtree_t *node, int32_t *dst)
+{
+	int i;
+
+	if (node->leaf) {
+		memcpy (dst, node->u.ids, node->n * sizeof (int32_t));
+		return dst + node->n;
+	}
+
+	for (i = 0; i < node->n; i++) {
+		dst = xmmsv_coll_idtree_flatten (node->u.children[i], dst);
+	}
+
+	return dst;
+}
+
+/**
+ * Turn a negative position into a position counted from the end of the
+ * idlist, and check that it is in range (or right after the last id if
+ * allow_append is set), in the same way as positions in lists.
+ */
+static int
+xmmsv_coll_idlist_validate_pos (xmmsv_coll_t *coll, int *pos, int allow_append)
+{
+	int size = coll->idtree->size;
+
+	if (*pos < 0) {
+		if (-*pos > size) {
+			return 0;
+		}
+		*pos = size + *pos;
+	}
+
+	if (*pos > size || (!allow_append && *pos == size)) {
+		return 0;
+	}
+
+	return 1;
+}
@@ -126,7 +126,7 @@ static bool
 _internal_put_on_bb_collection (xmmsv_t *bb, xmmsv_coll_t *coll)
 {
 	xmmsv_list_iter_t *it;
-	xmmsv_t *v, *attrs;
+	xmmsv_t *v, *attrs, *ids;
 	int n;
 	uint32_t ret;
 	int32_t entry;
@@ -156,7 +156,8 @@ _internal_put_on_bb_collection (xmmsv_t *bb, xmmsv_coll_t *coll)
 	/* idlist counter and content */
 	xmmsv_bitbuffer_put_bits (bb, 32, xmmsv_coll_idlist_get_size (coll));
 
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &it);
+	ids = xmmsv_coll_idlist_copy (coll);
+	xmmsv_get_list_iter (ids, &it);
 	for (xmmsv_list_iter_first (it);
 	     xmmsv_list_iter_valid (it);
 	     xmmsv_list_iter_next (it)) {
@@ -167,6 +168,7 @@ _internal_put_on_bb_collection (xmmsv_t *bb, xmmsv_coll_t *coll)
 		xmmsv_bitbuffer_put_bits (bb, 32, entry);
 	}
 	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (ids);
 
 	/* operands counter and objects */
 	n = 0;
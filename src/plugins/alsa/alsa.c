@@ -32,9 +32,17 @@
  * Type definitions
  */
 typedef struct xmms_alsa_data_St {
+	xmms_output_t *output;
 	snd_pcm_t *pcm;
 	snd_mixer_t *mixer;
 	snd_mixer_elem_t *mixer_elem;
+
+	guint buffer_time;
+	guint period_time;
+
+	gint rate;
+	snd_pcm_uframes_t buffer_size;
+	gint xruns;
 } xmms_alsa_data_t;
 
 static const struct {
@@ -78,6 +86,7 @@ static void xmms_alsa_close (xmms_output_t *output);
 static void xmms_alsa_write (xmms_output_t *output, gpointer buffer, gint len,
                              xmms_error_t *err);
 static void xmms_alsa_xrun_recover (xmms_alsa_data_t *output, gint err);
+static void xmms_alsa_stats_update (xmms_alsa_data_t *data);
 static guint xmms_alsa_buffer_bytes_get (xmms_output_t *output);
 static gboolean xmms_alsa_open (xmms_output_t *output);
 static gboolean xmms_alsa_new (xmms_output_t *output);
@@ -150,6 +159,14 @@ xmms_alsa_plugin_setup (xmms_output_plugin_t *plugin)
 	xmms_output_plugin_config_property_register (plugin, "mixer_index", "0",
 	                                             NULL, NULL);
 
+	/* in microseconds, 0 lets the driver decide */
+	xmms_output_plugin_config_property_register (plugin, "buffer_time",
+	                                             G_STRINGIFY (BUFFER_TIME),
+	                                             NULL, NULL);
+
+	xmms_output_plugin_config_property_register (plugin, "period_time", "0",
+	                                             NULL, NULL);
+
 	return TRUE;
 }
 
@@ -179,6 +196,8 @@ xmms_alsa_new (xmms_output_t *output)
 	data = g_new0 (xmms_alsa_data_t, 1);
 	g_return_val_if_fail (data, FALSE);
 
+	data->output = output;
+
 	if (!xmms_alsa_probe_modes (output, data)) {
 		g_free (data);
 		return FALSE;
@@ -354,6 +373,12 @@ xmms_alsa_open (xmms_output_t *output)
 
 	snd_pcm_nonblock (data->pcm, 0);
 
+	cv = xmms_output_config_lookup (output, "buffer_time");
+	data->buffer_time = MAX (xmms_config_property_get_int (cv), 0);
+
+	cv = xmms_output_config_lookup (output, "period_time");
+	data->period_time = MAX (xmms_config_property_get_int (cv), 0);
+
 	return TRUE;
 }
 
@@ -396,7 +421,9 @@ xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
 {
 	snd_pcm_format_t alsa_format = SND_PCM_FORMAT_UNKNOWN;
 	gint err, tmp, i, fmt;
-	guint requested_buffer_time = BUFFER_TIME;
+	guint requested_buffer_time = data->buffer_time;
+	guint requested_period_time = data->period_time;
+	snd_pcm_uframes_t period_size;
 	snd_pcm_hw_params_t *hwparams;
 
 	g_return_val_if_fail (data, FALSE);
@@ -459,18 +486,37 @@ xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
 		                tmp, snd_strerror (err));
 		return FALSE;
 	}
+	data->rate = tmp;
 
-	tmp = requested_buffer_time;
-	err = snd_pcm_hw_params_set_buffer_time_near (data->pcm, hwparams,
-	                                              &requested_buffer_time, NULL);
-	if (err < 0) {
-		xmms_log_error ("Unable to set buffer time %i for playback: %s", tmp,
-		                snd_strerror (err));
-		return FALSE;
+	if (requested_buffer_time) {
+		tmp = requested_buffer_time;
+		err = snd_pcm_hw_params_set_buffer_time_near (data->pcm, hwparams,
+		                                              &requested_buffer_time,
+		                                              NULL);
+		if (err < 0) {
+			xmms_log_error ("Unable to set buffer time %i for playback: %s",
+			                tmp, snd_strerror (err));
+			return FALSE;
+		}
+
+		XMMS_DBG ("Buffer time requested: %dms, got: %dms",
+		          tmp / 1000, requested_buffer_time / 1000);
 	}
 
-	XMMS_DBG ("Buffer time requested: %dms, got: %dms",
-	          tmp / 1000, requested_buffer_time / 1000);
+	if (requested_period_time) {
+		tmp = requested_period_time;
+		err = snd_pcm_hw_params_set_period_time_near (data->pcm, hwparams,
+		                                              &requested_period_time,
+		                                              NULL);
+		if (err < 0) {
+			xmms_log_error ("Unable to set period time %i for playback: %s",
+			                tmp, snd_strerror (err));
+			return FALSE;
+		}
+
+		XMMS_DBG ("Period time requested: %dus, got: %dus",
+		          tmp, requested_period_time);
+	}
 
 	/* Put the hardware parameters into good use */
 	err = snd_pcm_hw_params (data->pcm, hwparams);
@@ -480,6 +526,13 @@ xmms_alsa_set_hwparams (xmms_alsa_data_t *data,
 		return FALSE;
 	}
 
+	snd_pcm_hw_params_get_buffer_size (hwparams, &data->buffer_size);
+	snd_pcm_hw_params_get_period_size (hwparams, &period_size, NULL);
+
+	xmms_output_stats_set (data->output, "alsa.buffer_frames",
+	                       data->buffer_size);
+	xmms_output_stats_set (data->output, "alsa.period_frames", period_size);
+
 	return TRUE;
 }
 
@@ -776,6 +829,9 @@ xmms_alsa_xrun_recover (xmms_alsa_data_t *data, gint err)
 {
 	g_return_if_fail (data);
 
+	data->xruns++;
+	xmms_output_stats_set (data->output, "alsa.xruns", data->xruns);
+
 	if (err == -EPIPE) {
 		err = snd_pcm_prepare (data->pcm);
 		if (err < 0) {
@@ -837,6 +893,29 @@ xmms_alsa_write (xmms_output_t *output, gpointer buffer, gint len,
 			xmms_log_fatal ("ALSA's doing some funky shit.. please report (%s)", snd_strerror (written));
 		}
 	}
+
+	xmms_alsa_stats_update (data);
+}
+
+/**
+ * Publish the current latency and fill level of the device buffer.
+ */
+static void
+xmms_alsa_stats_update (xmms_alsa_data_t *data)
+{
+	snd_pcm_sframes_t avail, delay;
+
+	if (!data->rate || !data->buffer_size ||
+	    snd_pcm_delay (data->pcm, &delay) < 0 ||
+	    (avail = snd_pcm_avail_update (data->pcm)) < 0) {
+		return;
+	}
+
+	xmms_output_stats_set (data->output, "alsa.delay_us",
+	                       (gint64) MAX (delay, 0) * 1000000 / data->rate);
+	xmms_output_stats_set (data->output, "alsa.fill_percent",
+	                       (data->buffer_size - MIN ((snd_pcm_uframes_t) avail, data->buffer_size))
+	                       * 100 / data->buffer_size);
 }
 
 static snd_mixer_elem_t *
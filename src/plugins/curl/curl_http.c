@@ -17,6 +17,7 @@
 #include "xmms/xmms_xformplugin.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_medialib.h"
+#include "curl_pool.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,7 +35,10 @@
 
 typedef struct {
 	CURL *curl_easy;
-	CURLM *curl_multi;
+
+	/* protects everything below, the callbacks run in the pool thread */
+	GMutex *mutex;
+	GCond *cond;
 
 	guint meta_offset;
 
@@ -45,24 +49,39 @@ typedef struct {
 	struct curl_slist *http_200_aliases;
 	struct curl_slist *http_req_headers;
 
-	gchar *buffer;
-	guint bufferpos, bufferlen;
+	/* ring buffer filled ahead of the reader */
+	guchar *buffer;
+	guint bufferpos, bufferlen, buffersize;
 
-	gint curl_code;
+	/* stream offset of the byte at bufferpos */
+	gint64 position;
+	/* offset the current request started at */
+	gint64 request_offset;
 
-	gboolean done;
+	gint64 length;
+	gboolean accept_ranges;
+	/* validators of the response, -1 and NULL if the server sent none */
+	gint64 lmod;
+	gchar *etag;
+	gchar *icy_name;
+	gchar *icy_genre;
 
-	xmms_error_t status;
+	gboolean paused;
+	gboolean done;
+	CURLcode result;
 
 	gboolean broken_version;
 } xmms_curl_data_t;
 
-typedef void (*handler_func_t) (xmms_xform_t *xform, gchar *header);
+typedef void (*handler_func_t) (xmms_curl_data_t *data, gchar *header);
 
-static void header_handler_contentlength (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_metaint (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_name (xmms_xform_t *xform, gchar *header);
-static void header_handler_icy_genre (xmms_xform_t *xform, gchar *header);
+static void header_handler_contentlength (xmms_curl_data_t *data, gchar *header);
+static void header_handler_acceptranges (xmms_curl_data_t *data, gchar *header);
+static void header_handler_lastmodified (xmms_curl_data_t *data, gchar *header);
+static void header_handler_etag (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_metaint (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_name (xmms_curl_data_t *data, gchar *header);
+static void header_handler_icy_genre (xmms_curl_data_t *data, gchar *header);
 static handler_func_t header_handler_find (gchar *header);
 
 typedef struct {
@@ -72,6 +91,9 @@ typedef struct {
 
 handler_t handlers[] = {
 	{ "content-length", header_handler_contentlength },
+	{ "accept-ranges", header_handler_acceptranges },
+	{ "last-modified", header_handler_lastmodified },
+	{ "etag", header_handler_etag },
 	{ "icy-metaint", header_handler_icy_metaint },
 	{ "icy-name", header_handler_icy_name },
 	{ "icy-genre", header_handler_icy_genre },
@@ -86,9 +108,11 @@ handler_t handlers[] = {
 static gboolean xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin);
 static gboolean xmms_curl_init (xmms_xform_t *xform);
 static void xmms_curl_destroy (xmms_xform_t *xform);
-static gint fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error);
+static gint fill_buffer (xmms_curl_data_t *data, xmms_error_t *error);
 static gint xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len, xmms_error_t *error);
-/* static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error); */
+static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error);
+static void xmms_curl_request (xmms_curl_data_t *data, gint64 offset);
+static void xmms_curl_done (CURLcode result, gpointer udata);
 static size_t xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream);
 static size_t xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream);
 
@@ -112,9 +136,7 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.init = xmms_curl_init;
 	methods.destroy = xmms_curl_destroy;
 	methods.read = xmms_curl_read;
-	/*
 	methods.seek = xmms_curl_seek;
-	*/
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -133,6 +155,12 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	/* TODO is this timeout of 10 seconds really appropriate? */
 	xmms_xform_plugin_config_property_register (xform_plugin, "readtimeout",
 	                                            "10", NULL, NULL);
+	/* bytes fetched ahead of the decoder */
+	xmms_xform_plugin_config_property_register (xform_plugin, "readahead",
+	                                            "262144", NULL, NULL);
+	/* idle keep-alive connections kept open, only read on first use */
+	xmms_xform_plugin_config_property_register (xform_plugin, "maxconnections",
+	                                            "8", NULL, NULL);
 	xmms_xform_plugin_config_property_register (xform_plugin, "useproxy",
 	                                            "0", NULL, NULL);
 	xmms_xform_plugin_config_property_register (xform_plugin, "proxyaddress",
@@ -172,6 +200,7 @@ xmms_curl_init (xmms_xform_t *xform)
 	xmms_config_property_t *val;
 	xmms_error_t error;
 	gint metaint, verbose, connecttimeout, useproxy, authproxy;
+	gint readahead, maxconnections;
 	const gchar *proxyaddress, *proxyuser, *proxypass;
 	gchar proxyuserpass[90];
 	const gchar *url;
@@ -181,8 +210,17 @@ xmms_curl_init (xmms_xform_t *xform)
 
 	g_return_val_if_fail (xform, FALSE);
 
+	val = xmms_xform_config_lookup (xform, "maxconnections");
+	maxconnections = xmms_config_property_get_int (val);
+
+	if (!xmms_curl_pool_start (maxconnections)) {
+		return FALSE;
+	}
+
 	data = g_new0 (xmms_curl_data_t, 1);
 	data->broken_version = FALSE;
+	data->length = -1;
+	data->lmod = -1;
 
 	val = xmms_xform_config_lookup (xform, "connecttimeout");
 	connecttimeout = xmms_config_property_get_int (val);
@@ -190,6 +228,9 @@ xmms_curl_init (xmms_xform_t *xform)
 	val = xmms_xform_config_lookup (xform, "readtimeout");
 	data->read_timeout = xmms_config_property_get_int (val);
 
+	val = xmms_xform_config_lookup (xform, "readahead");
+	readahead = xmms_config_property_get_int (val);
+
 	val = xmms_xform_config_lookup (xform, "shoutcastinfo");
 	metaint = xmms_config_property_get_int (val);
 
@@ -214,9 +255,16 @@ xmms_curl_init (xmms_xform_t *xform)
 	g_snprintf (proxyuserpass, sizeof (proxyuserpass), "%s:%s", proxyuser,
 	            proxypass);
 
-	data->buffer = g_malloc (CURL_MAX_WRITE_SIZE);
+	/* a paused transfer hands over up to CURL_MAX_WRITE_SIZE bytes at
+	 * once when it's resumed, there must always be room for that
+	 */
+	data->buffersize = MAX (readahead, 2 * CURL_MAX_WRITE_SIZE);
+	data->buffer = g_malloc (data->buffersize);
 	data->url = g_strdup (url);
 
+	data->mutex = g_mutex_new ();
+	data->cond = g_cond_new ();
+
 	/* check for broken version of curl here */
 	version = curl_version_info (CURLVERSION_NOW);
 	XMMS_DBG ("Using version %s of libcurl", version->version);
@@ -246,8 +294,8 @@ xmms_curl_init (xmms_xform_t *xform)
 	curl_easy_setopt (data->curl_easy, CURLOPT_NOPROGRESS, 1);
 	curl_easy_setopt (data->curl_easy, CURLOPT_USERAGENT,
 	                  "XMMS2/" XMMS_VERSION);
-	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEHEADER, xform);
-	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEDATA, xform);
+	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEHEADER, data);
+	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEDATA, data);
 	curl_easy_setopt (data->curl_easy, CURLOPT_WRITEFUNCTION,
 	                  xmms_curl_callback_write);
 	curl_easy_setopt (data->curl_easy, CURLOPT_HEADERFUNCTION,
@@ -281,21 +329,49 @@ xmms_curl_init (xmms_xform_t *xform)
 		                  data->http_req_headers);
 	}
 
-	data->curl_multi = curl_multi_init ();
-	data->curl_code = CURLM_CALL_MULTI_PERFORM;
-
-	curl_multi_add_handle (data->curl_multi, data->curl_easy);
-
 	xmms_xform_private_data_set (xform, data);
 
-	/* perform initial fill to see if it contains shoutcast metadata or not */
-	if (fill_buffer (xform, data, &error) <= 0) {
+	xmms_curl_request (data, 0);
+
+	/* wait for the first data to see if it contains shoutcast metadata
+	 * or not, the headers have all been seen by then
+	 */
+	xmms_error_reset (&error);
+	if (fill_buffer (data, &error) <= 0) {
 		/* something went wrong */
+		xmms_curl_pool_remove (data->curl_easy);
 		xmms_xform_private_data_set (xform, NULL);
 		xmms_curl_free_data (data);
 		return FALSE;
 	}
 
+	g_mutex_lock (data->mutex);
+
+	if (data->length >= 0) {
+		xmms_xform_metadata_set_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
+		                             data->length);
+	}
+	if (data->lmod >= 0 && data->lmod <= G_MAXINT32) {
+		xmms_xform_metadata_set_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD,
+		                             data->lmod);
+	}
+	if (data->etag) {
+		xmms_xform_metadata_set_str (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_ETAG,
+		                             data->etag);
+	}
+	if (data->icy_name) {
+		xmms_xform_metadata_set_str (xform,
+		                             XMMS_MEDIALIB_ENTRY_PROPERTY_CHANNEL,
+		                             data->icy_name);
+	}
+	if (data->icy_genre) {
+		xmms_xform_metadata_set_str (xform,
+		                             XMMS_MEDIALIB_ENTRY_PROPERTY_GENRE,
+		                             data->icy_genre);
+	}
+
+	g_mutex_unlock (data->mutex);
+
 	if (data->meta_offset > 0) {
 		XMMS_DBG ("icy-metadata detected");
 		xmms_xform_auxdata_set_int (xform, "meta_offset", data->meta_offset);
@@ -314,120 +390,192 @@ xmms_curl_init (xmms_xform_t *xform)
 	return TRUE;
 }
 
+/* (re)start the transfer at offset, the handle must not be in the pool */
+static void
+xmms_curl_request (xmms_curl_data_t *data, gint64 offset)
+{
+	g_mutex_lock (data->mutex);
+	data->bufferpos = 0;
+	data->bufferlen = 0;
+	data->position = offset;
+	data->request_offset = offset;
+	data->paused = FALSE;
+	data->done = FALSE;
+	data->result = CURLE_OK;
+	g_mutex_unlock (data->mutex);
+
+	/* turns into a "Range: bytes=offset-" request, curl fails the
+	 * transfer if the server answers with anything but 206
+	 */
+	curl_easy_setopt (data->curl_easy, CURLOPT_RESUME_FROM_LARGE,
+	                  (curl_off_t) offset);
+
+	xmms_curl_pool_add (data->curl_easy, xmms_curl_done, data);
+}
+
+/*
+ * Wait until the buffer has data or the transfer has ended.
+ * Returns 1 if there is data, 0 on end of stream and -1 on error.
+ */
 static gint
-fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error)
+fill_buffer (xmms_curl_data_t *data, xmms_error_t *error)
 {
-	gint handles;
+	GTimeVal deadline;
+	gint ret = 1;
 
-	g_return_val_if_fail (xform, -1);
 	g_return_val_if_fail (data, -1);
 	g_return_val_if_fail (error, -1);
 
-	while (TRUE) {
-		if (data->curl_code == CURLM_OK) {
-			fd_set fdread, fdwrite, fdexcp;
-			struct timeval timeout;
-			gint ret, maxfd;
+	g_get_current_time (&deadline);
+	g_time_val_add (&deadline, (glong) data->read_timeout * G_USEC_PER_SEC);
 
-			timeout.tv_sec = data->read_timeout;
-			timeout.tv_usec = 0;
+	g_mutex_lock (data->mutex);
 
-			FD_ZERO (&fdread);
-			FD_ZERO (&fdwrite);
-			FD_ZERO (&fdexcp);
+	while (!data->bufferlen && !data->done) {
+		if (!g_cond_timed_wait (data->cond, data->mutex, &deadline)) {
+			break;
+		}
+	}
 
-			curl_multi_fdset (data->curl_multi, &fdread, &fdwrite, &fdexcp,
-			                  &maxfd);
+	if (data->bufferlen) {
+		ret = 1;
+	} else if (!data->done) {
+		xmms_error_set (error, XMMS_ERROR_GENERIC, "Read timeout");
+		ret = -1;
+	} else if (data->result != CURLE_OK) {
+		xmms_log_error ("Curl fill_buffer returned error: (%d) %s",
+		                data->result, curl_easy_strerror (data->result));
+		xmms_error_set (error, XMMS_ERROR_GENERIC,
+		                curl_easy_strerror (data->result));
+		ret = -1;
+	} else {
+		ret = 0;
+	}
 
-			ret = select (maxfd + 1, &fdread, &fdwrite, &fdexcp, &timeout);
+	g_mutex_unlock (data->mutex);
 
-			if (ret == -1) {
-				xmms_error_set (error, XMMS_ERROR_GENERIC, "Error select");
-				return -1;
-			} else if (ret == 0) {
-				xmms_error_set (error, XMMS_ERROR_GENERIC, "Read timeout");
-				return -1;
-			}
+	return ret;
+}
 
-		}
+/* drop len bytes from the front of the buffer, called with the lock held */
+static void
+xmms_curl_consume (xmms_curl_data_t *data, guint len)
+{
+	data->bufferpos = (data->bufferpos + len) % data->buffersize;
+	data->bufferlen -= len;
+	data->position += len;
+
+	if (data->paused &&
+	    data->buffersize - data->bufferlen >= CURL_MAX_WRITE_SIZE) {
+		data->paused = FALSE;
+		xmms_curl_pool_unpause (data->curl_easy);
+	}
+}
 
-		data->curl_code = curl_multi_perform (data->curl_multi, &handles);
+static gint
+xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
+                xmms_error_t *error)
+{
+	xmms_curl_data_t *data;
+	guint chunk;
+	gint ret;
 
-		if (data->curl_code != CURLM_CALL_MULTI_PERFORM &&
-		    data->curl_code != CURLM_OK) {
+	g_return_val_if_fail (xform, -1);
+	g_return_val_if_fail (buffer, -1);
+	g_return_val_if_fail (error, -1);
 
-			xmms_error_set (error, XMMS_ERROR_GENERIC,
-			                curl_multi_strerror (data->curl_code));
-			return -1;
-		}
+	data = xmms_xform_private_data_get (xform);
+	g_return_val_if_fail (data, -1);
 
-		/* done */
-		if (handles == 0) {
-			CURLMsg *curlmsg;
-			gint messages;
+	ret = fill_buffer (data, error);
+	if (ret <= 0) {
+		return ret;
+	}
 
-			do {
-				curlmsg = curl_multi_info_read (data->curl_multi, &messages);
+	g_mutex_lock (data->mutex);
 
-				if (curlmsg == NULL)
-					break;
+	/* if we have data available, just pick it up (even if there's
+	   less bytes available than was requested) */
+	len = MIN (len, data->bufferlen);
+	chunk = MIN (len, data->buffersize - data->bufferpos);
 
-				if (curlmsg->msg == CURLMSG_DONE && curlmsg->data.result != CURLE_OK) {
-					xmms_log_error ("Curl fill_buffer returned error: (%d) %s",
-					                curlmsg->data.result,
-					                curl_easy_strerror (curlmsg->data.result));
-				} else {
-					XMMS_DBG ("Curl fill_buffer returned unknown message (%d)", curlmsg->msg);
-				}
-			} while (messages > 0);
+	memcpy (buffer, data->buffer + data->bufferpos, chunk);
+	memcpy ((guchar *) buffer + chunk, data->buffer, len - chunk);
 
-			data->done = TRUE;
-			return 0;
-		}
+	xmms_curl_consume (data, len);
 
-		if (data->bufferlen > 0) {
-			return 1;
-		}
-	}
+	g_mutex_unlock (data->mutex);
+
+	return len;
 }
 
-static gint
-xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
-                xmms_error_t *error)
+static gint64
+xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
+                xmms_xform_seek_mode_t whence, xmms_error_t *error)
 {
 	xmms_curl_data_t *data;
-	gint ret;
+	gboolean seekable;
+	gint64 length;
 
 	g_return_val_if_fail (xform, -1);
-	g_return_val_if_fail (buffer, -1);
 	g_return_val_if_fail (error, -1);
 
 	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, -1);
 
-	if (data->done)
-		return 0;
+	g_mutex_lock (data->mutex);
 
-	while (TRUE) {
-
-		/* if we have data available, just pick it up (even if there's
-		   less bytes available than was requested) */
-		if (data->bufferlen) {
-			len = MIN (len, data->bufferlen);
-			memcpy (buffer, data->buffer, len);
-			data->bufferlen -= len;
-			if (data->bufferlen) {
-				memmove (data->buffer, data->buffer + len, data->bufferlen);
-			}
-			return len;
+	if (whence == XMMS_XFORM_SEEK_CUR) {
+		offset += data->position;
+	} else if (whence == XMMS_XFORM_SEEK_END) {
+		if (data->length < 0) {
+			g_mutex_unlock (data->mutex);
+			xmms_error_set (error, XMMS_ERROR_INVAL, "Unknown length");
+			return -1;
 		}
+		offset += data->length;
+	}
 
-		ret = fill_buffer (xform, data, error);
+	if (offset < 0 || (data->length >= 0 && offset > data->length)) {
+		g_mutex_unlock (data->mutex);
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Seek out of range");
+		return -1;
+	}
 
-		if (ret == 0 || ret == -1) {
-			return ret;
-		}
+	/* short forward seeks are served from the read-ahead buffer */
+	if (offset >= data->position &&
+	    offset <= data->position + data->bufferlen) {
+		xmms_curl_consume (data, offset - data->position);
+		g_mutex_unlock (data->mutex);
+		return offset;
+	}
+
+	/* icy streams interleave metadata, offsets don't map onto them */
+	seekable = data->accept_ranges && data->length >= 0 && !data->meta_offset;
+	length = data->length;
+
+	g_mutex_unlock (data->mutex);
+
+	if (!seekable) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
+		return -1;
 	}
+
+	xmms_curl_pool_remove (data->curl_easy);
+
+	if (offset == length) {
+		/* a range starting at the end can't be satisfied */
+		g_mutex_lock (data->mutex);
+		data->bufferlen = 0;
+		data->position = offset;
+		data->done = TRUE;
+		data->result = CURLE_OK;
+		g_mutex_unlock (data->mutex);
+	} else {
+		xmms_curl_request (data, offset);
+	}
+
+	return offset;
 }
 
 static void
@@ -440,31 +588,54 @@ xmms_curl_destroy (xmms_xform_t *xform)
 	data = xmms_xform_private_data_get (xform);
 	g_return_if_fail (data);
 
+	xmms_curl_pool_remove (data->curl_easy);
 	xmms_curl_free_data (data);
 }
 
 /*
- * CURL callback functions
+ * CURL callback functions, called from the pool thread
  */
 
+static void
+xmms_curl_done (CURLcode result, gpointer udata)
+{
+	xmms_curl_data_t *data = (xmms_curl_data_t *) udata;
+
+	g_mutex_lock (data->mutex);
+	data->done = TRUE;
+	data->result = result;
+	g_cond_signal (data->cond);
+	g_mutex_unlock (data->mutex);
+}
+
 static size_t
 xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream)
 {
-	xmms_curl_data_t *data;
-	xmms_xform_t *xform = (xmms_xform_t *) stream;
-	gint len;
-
-	g_return_val_if_fail (xform, 0);
+	xmms_curl_data_t *data = (xmms_curl_data_t *) stream;
+	guint len, tail, chunk;
 
-	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, 0);
 
 	len = size * nmemb;
 
-	g_return_val_if_fail ((data->bufferlen + len) <= CURL_MAX_WRITE_SIZE, 0);
+	g_mutex_lock (data->mutex);
+
+	/* curl hands the same data again once the transfer is resumed */
+	if (data->buffersize - data->bufferlen < len) {
+		data->paused = TRUE;
+		g_mutex_unlock (data->mutex);
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	tail = (data->bufferpos + data->bufferlen) % data->buffersize;
+	chunk = MIN (len, data->buffersize - tail);
+
+	memcpy (data->buffer + tail, ptr, chunk);
+	memcpy (data->buffer, (guchar *) ptr + chunk, len - chunk);
+	data->bufferlen += len;
 
-	memcpy (data->buffer + data->bufferlen, ptr, len);
-	data->bufferlen = data->bufferlen + len;
+	g_cond_signal (data->cond);
+	g_mutex_unlock (data->mutex);
 
 	return len;
 }
@@ -483,17 +654,38 @@ strlen_no_crlf (char *ptr, int len) {
 static size_t
 xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream)
 {
-	xmms_xform_t *xform = (xmms_xform_t *) stream;
+	xmms_curl_data_t *data = (xmms_curl_data_t *) stream;
 	handler_func_t func;
 	gchar *header;
 
 	XMMS_DBG ("%.*s", strlen_no_crlf ((char*)ptr, size * nmemb), (char*)ptr);
 
-	g_return_val_if_fail (xform, 0);
+	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (ptr, 0);
 
 	header = g_strndup ((gchar*)ptr, size * nmemb);
 
+	g_mutex_lock (data->mutex);
+
+	/* a new response starts, forget about redirects before it. A
+	 * range response keeps what the first one said, and is itself
+	 * proof that ranges work even without Accept-Ranges.
+	 */
+	if (g_ascii_strncasecmp (header, "HTTP/", 5) == 0) {
+		if (!data->request_offset) {
+			data->accept_ranges = FALSE;
+			data->length = -1;
+			data->lmod = -1;
+			g_free (data->etag);
+			data->etag = NULL;
+		} else {
+			gchar *status = strchr (header, ' ');
+			if (status && atoi (status) == 206) {
+				data->accept_ranges = TRUE;
+			}
+		}
+	}
+
 	func = header_handler_find (header);
 	if (func != NULL) {
 		gchar *val = strchr (header, ':');
@@ -502,9 +694,11 @@ xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream)
 		} else {
 			val = header;
 		}
-		func (xform, val);
+		func (data, val);
 	}
 
+	g_mutex_unlock (data->mutex);
+
 	g_free (header);
 	return size * nmemb;
 }
@@ -528,46 +722,63 @@ header_handler_find (gchar *header)
 }
 
 static void
-header_handler_contentlength (xmms_xform_t *xform,
+header_handler_contentlength (xmms_curl_data_t *data,
                               gchar *header)
 {
-	xmms_curl_data_t *data;
-	int length;
-	const gchar *metakey;
+	/* a range response only has the length of the remainder */
+	if (!data->request_offset) {
+		data->length = g_ascii_strtoll (header, NULL, 10);
+	}
+}
 
-	data = xmms_xform_private_data_get (xform);
+static void
+header_handler_acceptranges (xmms_curl_data_t *data,
+                             gchar *header)
+{
+	data->accept_ranges = g_ascii_strcasecmp (header, "bytes") == 0;
+}
 
-	length = strtoul (header, NULL, 10);
+static void
+header_handler_lastmodified (xmms_curl_data_t *data,
+                             gchar *header)
+{
+	if (!data->request_offset) {
+		data->lmod = curl_getdate (header, NULL);
+	}
+}
 
-	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
-	xmms_xform_metadata_set_int (xform, metakey, length);
+static void
+header_handler_etag (xmms_curl_data_t *data,
+                     gchar *header)
+{
+	/* a weak tag doesn't promise identical bytes */
+	if (!data->request_offset && g_ascii_strncasecmp (header, "W/", 2) != 0) {
+		g_free (data->etag);
+		data->etag = g_strdup (header);
+	}
 }
 
 static void
-header_handler_icy_metaint (xmms_xform_t *xform,
+header_handler_icy_metaint (xmms_curl_data_t *data,
                             gchar *header)
 {
-	xmms_curl_data_t *data;
-
-	data = xmms_xform_private_data_get (xform);
-
 	data->meta_offset = strtoul (header, NULL, 10);
 }
 
 static void
-header_handler_icy_name (xmms_xform_t *xform,
+header_handler_icy_name (xmms_curl_data_t *data,
                          gchar *header)
 {
-	const gchar *metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_CHANNEL;
-	xmms_xform_metadata_set_str (xform, metakey, header);
+	g_free (data->icy_name);
+	data->icy_name = g_strdup (header);
 }
 
 static void
-header_handler_icy_genre (xmms_xform_t *xform,
+header_handler_icy_genre (xmms_curl_data_t *data,
                           gchar *header)
 {
-	const gchar *metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_GENRE;
-	xmms_xform_metadata_set_str (xform, metakey, header);
+	g_free (data->icy_genre);
+	data->icy_genre = g_strdup (header);
 }
 
 static void
@@ -575,23 +786,19 @@ xmms_curl_free_data (xmms_curl_data_t *data)
 {
 	g_return_if_fail (data);
 
-	curl_multi_cleanup (data->curl_multi);
 	curl_easy_cleanup (data->curl_easy);
 
 	curl_slist_free_all (data->http_200_aliases);
 	curl_slist_free_all (data->http_req_headers);
 
+	g_mutex_free (data->mutex);
+	g_cond_free (data->cond);
+
 	g_free (data->buffer);
 
+	g_free (data->etag);
+	g_free (data->icy_name);
+	g_free (data->icy_genre);
 	g_free (data->url);
 	g_free (data);
 }
-
-/*
-static gint64
-xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
-                xmms_xform_seek_mode_t whence, xmms_error_t *error) {
-	xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
-	return -1;
-}
-*/
@@ -0,0 +1,336 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * All transfers of the plugin run on one curl multi handle, driven by
+ * a single thread. Connections that are left open by a finished
+ * transfer stay in the connection cache of the multi handle, so the
+ * next track from the same host doesn't have to connect again.
+ *
+ * The multi handle is only touched by the pool thread, other threads
+ * queue operations and wake it up through a pipe.
+ */
+
+#include "xmms/xmms_log.h"
+#include "curl_pool.h"
+
+#include <gmodule.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+typedef enum {
+	POOL_OP_ADD,
+	POOL_OP_REMOVE,
+	POOL_OP_UNPAUSE
+} xmms_curl_pool_op_type_t;
+
+typedef struct {
+	xmms_curl_pool_op_type_t type;
+	CURL *easy;
+	xmms_curl_pool_done_func_t func;
+	gpointer udata;
+	gboolean finished;
+} xmms_curl_pool_op_t;
+
+static struct {
+	GThread *thread;
+	GMutex *mutex;
+	GCond *cond;
+	GQueue *ops;
+	gboolean quit;
+	gint wake_pipe[2];
+
+	/* only used by the pool thread */
+	CURLM *multi;
+	GHashTable *transfers;
+} pool;
+
+static GStaticMutex pool_start_mutex = G_STATIC_MUTEX_INIT;
+
+static void
+xmms_curl_pool_wake (void)
+{
+	/* a full pipe wakes the thread just as well */
+	while (write (pool.wake_pipe[1], "X", 1) < 0) {
+		if (errno != EINTR) {
+			if (errno != EAGAIN) {
+				xmms_log_error ("Couldn't wake the transfer thread: %s",
+				                strerror (errno));
+			}
+			break;
+		}
+	}
+}
+
+static void
+xmms_curl_pool_push (xmms_curl_pool_op_t *op)
+{
+	g_mutex_lock (pool.mutex);
+	g_queue_push_tail (pool.ops, op);
+	xmms_curl_pool_wake ();
+	g_mutex_unlock (pool.mutex);
+}
+
+static void
+xmms_curl_pool_run_op (xmms_curl_pool_op_t *op)
+{
+	xmms_curl_pool_op_t *transfer;
+
+	transfer = g_hash_table_lookup (pool.transfers, op->easy);
+
+	switch (op->type) {
+		case POOL_OP_ADD:
+			g_hash_table_insert (pool.transfers, op->easy, op);
+			curl_multi_add_handle (pool.multi, op->easy);
+			break;
+		case POOL_OP_UNPAUSE:
+			if (transfer) {
+				curl_easy_pause (op->easy, CURLPAUSE_CONT);
+			}
+			g_free (op);
+			break;
+		case POOL_OP_REMOVE:
+			if (transfer) {
+				curl_multi_remove_handle (pool.multi, op->easy);
+				g_hash_table_remove (pool.transfers, op->easy);
+				g_free (transfer);
+			}
+
+			g_mutex_lock (pool.mutex);
+			op->finished = TRUE;
+			g_cond_broadcast (pool.cond);
+			g_mutex_unlock (pool.mutex);
+			break;
+	}
+}
+
+static void
+xmms_curl_pool_dispatch (void)
+{
+	xmms_curl_pool_op_t *transfer;
+	CURLMsg *msg;
+	CURLcode result;
+	CURL *easy;
+	gint left;
+
+	while ((msg = curl_multi_info_read (pool.multi, &left))) {
+		if (msg->msg != CURLMSG_DONE) {
+			continue;
+		}
+
+		/* msg is invalid once the handle is removed */
+		easy = msg->easy_handle;
+		result = msg->data.result;
+
+		transfer = g_hash_table_lookup (pool.transfers, easy);
+		curl_multi_remove_handle (pool.multi, easy);
+		g_hash_table_remove (pool.transfers, easy);
+
+		if (transfer) {
+			transfer->func (result, transfer->udata);
+			g_free (transfer);
+		}
+	}
+}
+
+static void
+xmms_curl_pool_wait (void)
+{
+	fd_set fdread, fdwrite, fdexcp;
+	struct timeval timeout, *tv = NULL;
+	gchar buf[64];
+	gint maxfd = -1;
+	long ms = -1;
+
+	FD_ZERO (&fdread);
+	FD_ZERO (&fdwrite);
+	FD_ZERO (&fdexcp);
+
+	curl_multi_fdset (pool.multi, &fdread, &fdwrite, &fdexcp, &maxfd);
+
+	if (g_hash_table_size (pool.transfers)) {
+		curl_multi_timeout (pool.multi, &ms);
+		if (ms < 0 || ms > 1000) {
+			ms = 1000;
+		}
+		/* curl has a socket it can't hand out yet, poll */
+		if (maxfd == -1) {
+			ms = MIN (ms, 100);
+		}
+		timeout.tv_sec = ms / 1000;
+		timeout.tv_usec = (ms % 1000) * 1000;
+		tv = &timeout;
+	}
+
+	FD_SET (pool.wake_pipe[0], &fdread);
+	maxfd = MAX (maxfd, pool.wake_pipe[0]);
+
+	if (select (maxfd + 1, &fdread, &fdwrite, &fdexcp, tv) > 0 &&
+	    FD_ISSET (pool.wake_pipe[0], &fdread)) {
+		while (read (pool.wake_pipe[0], buf, sizeof (buf)) > 0);
+	}
+}
+
+static gpointer
+xmms_curl_pool_thread (gpointer udata)
+{
+	xmms_curl_pool_op_t *op;
+	gint running;
+
+	while (TRUE) {
+		g_mutex_lock (pool.mutex);
+		while (!pool.quit && (op = g_queue_pop_head (pool.ops))) {
+			g_mutex_unlock (pool.mutex);
+			xmms_curl_pool_run_op (op);
+			g_mutex_lock (pool.mutex);
+		}
+		if (pool.quit) {
+			g_mutex_unlock (pool.mutex);
+			break;
+		}
+		g_mutex_unlock (pool.mutex);
+
+		while (curl_multi_perform (pool.multi, &running) == CURLM_CALL_MULTI_PERFORM);
+
+		xmms_curl_pool_dispatch ();
+		xmms_curl_pool_wait ();
+	}
+
+	return NULL;
+}
+
+/**
+ * Start the pool thread unless it's already running.
+ *
+ * @param maxconnects number of idle connections kept open
+ */
+gboolean
+xmms_curl_pool_start (gint maxconnects)
+{
+	gboolean ret = TRUE;
+
+	g_static_mutex_lock (&pool_start_mutex);
+
+	if (pool.thread) {
+		goto out;
+	}
+
+	if (pipe (pool.wake_pipe) < 0) {
+		xmms_log_error ("Couldn't create wakeup pipe for curl");
+		ret = FALSE;
+		goto out;
+	}
+	fcntl (pool.wake_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl (pool.wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+	pool.multi = curl_multi_init ();
+	curl_multi_setopt (pool.multi, CURLMOPT_MAXCONNECTS, (long) maxconnects);
+
+	pool.transfers = g_hash_table_new (NULL, NULL);
+	pool.ops = g_queue_new ();
+	pool.mutex = g_mutex_new ();
+	pool.cond = g_cond_new ();
+	pool.quit = FALSE;
+
+	pool.thread = g_thread_create (xmms_curl_pool_thread, NULL, TRUE, NULL);
+
+out:
+	g_static_mutex_unlock (&pool_start_mutex);
+
+	return ret;
+}
+
+/**
+ * Start a transfer. func is called from the pool thread when it ends,
+ * unless it is removed before that.
+ */
+void
+xmms_curl_pool_add (CURL *easy, xmms_curl_pool_done_func_t func,
+                    gpointer udata)
+{
+	xmms_curl_pool_op_t *op;
+
+	op = g_new0 (xmms_curl_pool_op_t, 1);
+	op->type = POOL_OP_ADD;
+	op->easy = easy;
+	op->func = func;
+	op->udata = udata;
+
+	xmms_curl_pool_push (op);
+}
+
+/**
+ * Stop a transfer. No callbacks are invoked for the handle after this
+ * returns, so the caller must not hold locks taken in its callbacks.
+ */
+void
+xmms_curl_pool_remove (CURL *easy)
+{
+	xmms_curl_pool_op_t op = { POOL_OP_REMOVE, easy, NULL, NULL, FALSE };
+
+	g_mutex_lock (pool.mutex);
+	g_queue_push_tail (pool.ops, &op);
+	xmms_curl_pool_wake ();
+	while (!op.finished) {
+		g_cond_wait (pool.cond, pool.mutex);
+	}
+	g_mutex_unlock (pool.mutex);
+}
+
+/** Resume a transfer whose write callback returned CURL_WRITEFUNC_PAUSE. */
+void
+xmms_curl_pool_unpause (CURL *easy)
+{
+	xmms_curl_pool_op_t *op;
+
+	op = g_new0 (xmms_curl_pool_op_t, 1);
+	op->type = POOL_OP_UNPAUSE;
+	op->easy = easy;
+
+	xmms_curl_pool_push (op);
+}
+
+/* Called by GModule before the plugin is unloaded, the thread must not
+ * outlive the code it runs.
+ */
+G_MODULE_EXPORT void
+g_module_unload (GModule *module)
+{
+	if (!pool.thread) {
+		return;
+	}
+
+	g_mutex_lock (pool.mutex);
+	pool.quit = TRUE;
+	xmms_curl_pool_wake ();
+	g_mutex_unlock (pool.mutex);
+
+	g_thread_join (pool.thread);
+	pool.thread = NULL;
+
+	curl_multi_cleanup (pool.multi);
+	g_hash_table_destroy (pool.transfers);
+	g_queue_free (pool.ops);
+	g_cond_free (pool.cond);
+	g_mutex_free (pool.mutex);
+
+	close (pool.wake_pipe[0]);
+	close (pool.wake_pipe[1]);
+}
@@ -0,0 +1,31 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __CURL_POOL_H__
+#define __CURL_POOL_H__
+
+#include <glib.h>
+#include <curl/curl.h>
+
+/** Called from the pool thread when a transfer has finished. */
+typedef void (*xmms_curl_pool_done_func_t) (CURLcode result, gpointer udata);
+
+gboolean xmms_curl_pool_start (gint maxconnects);
+void xmms_curl_pool_add (CURL *easy, xmms_curl_pool_done_func_t func, gpointer udata);
+void xmms_curl_pool_remove (CURL *easy);
+void xmms_curl_pool_unpause (CURL *easy);
+
+#endif
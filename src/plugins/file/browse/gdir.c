@@ -30,6 +30,7 @@ xmms_file_browse (xmms_xform_t *xform,
 	GError *err = NULL;
 	const gchar *d, *tmp;
 	struct stat st;
+	gchar *stat_str;
 
 	tmp = url + 7;
 
@@ -64,6 +65,14 @@ xmms_file_browse (xmms_xform_t *xform,
 		if (!S_ISDIR (st.st_mode)) {
 			xmms_xform_browse_add_entry_property_int (xform, "size",
 			                                          st.st_size);
+			stat_str = g_strdup_printf (XMMS_MEDIALIB_BROWSE_STAT_FORMAT,
+			                            (gint64) st.st_mtime,
+			                            (gint64) st.st_size,
+			                            (guint64) st.st_ino);
+			xmms_xform_browse_add_entry_property_str (xform,
+			                                          XMMS_MEDIALIB_BROWSE_PROPERTY_STAT,
+			                                          stat_str);
+			g_free (stat_str);
 		}
 	}
 
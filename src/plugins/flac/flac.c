@@ -279,9 +279,9 @@ flac_callback_metadata (const FLAC__StreamDecoder *flacdecoder,
 		case FLAC__METADATA_TYPE_PICTURE: {
 			gchar hash[33];
 			if (metadata->data.picture.type == FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER &&
-			    xmms_bindata_plugin_add (metadata->data.picture.data,
-			                             metadata->data.picture.data_length,
-			                             hash)) {
+			    xmms_bindata_plugin_add_lazy (metadata->data.picture.data,
+			                                  metadata->data.picture.data_length,
+			                                  NULL, -1, hash)) {
 				const gchar *metakey;
 				
 				metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_PICTURE_FRONT;
@@ -0,0 +1,1193 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/*
+ * Serves the output to HTTP listeners directly, without an icecast
+ * server in between.
+ *
+ * Every configured stream (mount point, format and bitrate) is encoded
+ * once, in the output thread, into a ring shared by all listeners of
+ * that stream. A single server thread accepts connections and writes
+ * to every listener from its own cursor into the ring. Listeners that
+ * fall more than a ring behind are dropped. Listeners asking for it
+ * get icy metadata blocks with the current title.
+ */
+
+#include "xmms/xmms_outputplugin.h"
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_medialib.h"
+
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include "../ices/encode.h"
+
+#define HTTPSTREAM_REQUEST_MAX 4096
+#define HTTPSTREAM_RING_MIN (64 * 1024)
+
+/* how far ahead of real time the encoded data may run, in seconds */
+#define HTTPSTREAM_LEAD 0.5
+
+typedef enum {
+	HTTPSTREAM_VORBIS,
+	HTTPSTREAM_WAV
+} xmms_httpstream_format_t;
+
+typedef struct xmms_httpstream_stream_St {
+	gchar *mount;
+	xmms_httpstream_format_t format;
+	gint bitrate;
+	encoder_state *encoder;
+
+	/* encoded data, shared by all listeners of the stream */
+	guchar *ring;
+	gsize ringsize;
+	guint64 head;
+
+	/* what a listener needs before it can start at head */
+	GString *headers;
+
+	/* wav headers can't change mid-stream, listeners that joined
+	 * before the last change are dropped once they reach it */
+	guint format_serial;
+	guint64 format_start;
+} xmms_httpstream_stream_t;
+
+typedef struct xmms_httpstream_listener_St {
+	gint fd;
+	GString *request;
+	/* dropped if the request isn't in and answered by then */
+	GTimeVal deadline;
+	xmms_httpstream_stream_t *stream;
+
+	/* response headers and icy blocks */
+	GString *pending;
+	gsize pending_pos;
+	gboolean close_when_sent;
+
+	/* stream headers, they count as audio data for icy */
+	GString *prefix;
+	gsize prefix_pos;
+
+	guint64 cursor;
+	guint format_serial;
+
+	gint metaint;
+	gint metaleft;
+	guint title_serial;
+} xmms_httpstream_listener_t;
+
+typedef struct xmms_httpstream_data_St {
+	GThread *thread;
+	gint listen_fd;
+	gint wake_pipe[2];
+
+	/* protects the rings, the title and quit */
+	GMutex *mutex;
+	gboolean quit;
+
+	GList *streams;
+	gchar *title;
+	guint title_serial;
+
+	/* only used by the server thread */
+	GList *listeners;
+	gint nlisteners;
+	gint maxlisteners;
+	gint request_timeout;
+	gint metaint;
+	gchar *name;
+
+	/* only used by the output thread */
+	vorbis_comment vc;
+	gboolean comment_changed;
+	gint rate;
+	gint channels;
+	GTimer *timer;
+	guint64 frames;
+} xmms_httpstream_data_t;
+
+/*
+ * Function prototypes
+ */
+static gboolean xmms_httpstream_plugin_setup (xmms_output_plugin_t *plugin);
+static gboolean xmms_httpstream_new (xmms_output_t *output);
+static void xmms_httpstream_destroy (xmms_output_t *output);
+static gboolean xmms_httpstream_open (xmms_output_t *output);
+static void xmms_httpstream_close (xmms_output_t *output);
+static void xmms_httpstream_flush (xmms_output_t *output);
+static gboolean xmms_httpstream_format_set (xmms_output_t *output,
+                                            const xmms_stream_type_t *format);
+static void xmms_httpstream_write (xmms_output_t *output, gpointer buffer,
+                                   gint len, xmms_error_t *err);
+static gpointer xmms_httpstream_thread (gpointer udata);
+static void on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg,
+                                       gpointer udata);
+
+/*
+ * Plugin header
+ */
+XMMS_OUTPUT_PLUGIN ("httpstream",
+                    "HTTP Stream Output",
+                    XMMS_VERSION,
+                    "Streams to HTTP listeners without an icecast server",
+                    xmms_httpstream_plugin_setup);
+
+static gboolean
+xmms_httpstream_plugin_setup (xmms_output_plugin_t *plugin)
+{
+	xmms_output_methods_t methods;
+	static const struct {
+		const char *name;
+		const char *val;
+	} *pptr, httpstream_properties[] = {
+		{ "bindaddress", "0.0.0.0" },
+		{ "port", "8000" },
+		/* comma separated mount=format[:bitrate], format is vorbis or wav */
+		{ "streams", "/stream.ogg=vorbis:128000" },
+		{ "maxlisteners", "256" },
+		/* seconds a client may take to send its request */
+		{ "requesttimeout", "10" },
+		/* per stream, in KiB */
+		{ "backlog", "512" },
+		{ "metaint", "16000" },
+		{ "streamname", "XMMS2" },
+		{ NULL, NULL },
+	};
+
+	XMMS_OUTPUT_METHODS_INIT (methods);
+	methods.new = xmms_httpstream_new;
+	methods.destroy = xmms_httpstream_destroy;
+
+	methods.open = xmms_httpstream_open;
+	methods.close = xmms_httpstream_close;
+
+	methods.flush = xmms_httpstream_flush;
+	methods.format_set = xmms_httpstream_format_set;
+	methods.write = xmms_httpstream_write;
+
+	xmms_output_plugin_methods_set (plugin, &methods);
+
+	for (pptr = httpstream_properties; pptr->name != NULL; pptr++)
+		xmms_output_plugin_config_property_register (plugin, pptr->name,
+		                                             pptr->val,
+		                                             NULL, NULL);
+
+	return TRUE;
+}
+
+/*
+ * Streams
+ */
+
+static void
+xmms_httpstream_stream_free (xmms_httpstream_stream_t *stream)
+{
+	if (stream->encoder)
+		xmms_ices_encoder_fini (stream->encoder);
+
+	g_string_free (stream->headers, TRUE);
+	g_free (stream->ring);
+	g_free (stream->mount);
+	g_free (stream);
+}
+
+static GList *
+xmms_httpstream_streams_parse (const gchar *spec, gsize ringsize)
+{
+	xmms_httpstream_stream_t *stream;
+	GList *streams = NULL;
+	gchar **items, **parts, *fmt;
+	gint i;
+
+	items = g_strsplit (spec, ",", 0);
+
+	for (i = 0; items[i]; i++) {
+		parts = g_strsplit (g_strstrip (items[i]), "=", 2);
+
+		if (!parts[0] || !parts[1] || parts[0][0] != '/') {
+			xmms_log_error ("Ignoring bad stream '%s'", items[i]);
+			g_strfreev (parts);
+			continue;
+		}
+
+		stream = g_new0 (xmms_httpstream_stream_t, 1);
+		stream->mount = g_strdup (parts[0]);
+		stream->ringsize = MAX (ringsize, HTTPSTREAM_RING_MIN);
+		stream->ring = g_malloc (stream->ringsize);
+		stream->headers = g_string_new (NULL);
+
+		fmt = strchr (parts[1], ':');
+		if (fmt) {
+			*fmt++ = '\0';
+			stream->bitrate = strtol (fmt, NULL, 10);
+		}
+
+		if (!g_ascii_strcasecmp (parts[1], "wav")) {
+			stream->format = HTTPSTREAM_WAV;
+		} else if (!g_ascii_strcasecmp (parts[1], "vorbis") &&
+		           (stream->encoder = xmms_ices_encoder_init (-1, stream->bitrate, -1))) {
+			stream->format = HTTPSTREAM_VORBIS;
+		} else {
+			xmms_log_error ("Ignoring stream '%s', bad format", stream->mount);
+			xmms_httpstream_stream_free (stream);
+			g_strfreev (parts);
+			continue;
+		}
+
+		streams = g_list_append (streams, stream);
+		g_strfreev (parts);
+	}
+
+	g_strfreev (items);
+
+	return streams;
+}
+
+/* called with the mutex held */
+static void
+xmms_httpstream_stream_append (xmms_httpstream_stream_t *stream,
+                               const guchar *buf, gsize len)
+{
+	gsize off, chunk;
+
+	while (len > 0) {
+		off = stream->head % stream->ringsize;
+		chunk = MIN (len, stream->ringsize - off);
+		memcpy (stream->ring + off, buf, chunk);
+		stream->head += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+}
+
+static void
+xmms_httpstream_wake (xmms_httpstream_data_t *data)
+{
+	/* a full pipe wakes the thread just as well */
+	while (write (data->wake_pipe[1], "X", 1) < 0) {
+		if (errno != EINTR) {
+			if (errno != EAGAIN) {
+				xmms_log_error ("Couldn't wake the server thread: %s",
+				                strerror (errno));
+			}
+			break;
+		}
+	}
+}
+
+/* hand the pages the encoder has ready over to the listeners */
+static void
+xmms_httpstream_vorbis_output (xmms_httpstream_data_t *data,
+                               xmms_httpstream_stream_t *stream)
+{
+	GString *out;
+	ogg_page og;
+
+	out = g_string_new (NULL);
+
+	g_mutex_lock (data->mutex);
+
+	while (xmms_ices_encoder_output (stream->encoder, &og)) {
+		/* header pages start a new logical stream, a listener joining
+		 * later needs them before any audio page
+		 */
+		if (ogg_page_bos (&og)) {
+			g_string_truncate (stream->headers, 0);
+		}
+		if (ogg_page_granulepos (&og) == 0) {
+			g_string_append_len (stream->headers, (gchar *) og.header, og.header_len);
+			g_string_append_len (stream->headers, (gchar *) og.body, og.body_len);
+		}
+
+		g_string_append_len (out, (gchar *) og.header, og.header_len);
+		g_string_append_len (out, (gchar *) og.body, og.body_len);
+	}
+
+	xmms_httpstream_stream_append (stream, (guchar *) out->str, out->len);
+
+	g_mutex_unlock (data->mutex);
+
+	g_string_free (out, TRUE);
+}
+
+static void
+xmms_httpstream_vorbis_restart (xmms_httpstream_data_t *data,
+                                xmms_httpstream_stream_t *stream)
+{
+	if (stream->encoder && stream->headers->len) {
+		xmms_ices_encoder_finish (stream->encoder);
+		xmms_httpstream_vorbis_output (data, stream);
+	}
+
+	xmms_ices_encoder_stream_change (stream->encoder, data->rate,
+	                                 data->channels, &data->vc);
+	xmms_httpstream_vorbis_output (data, stream);
+}
+
+static void
+xmms_httpstream_put_le (GString *str, guint32 val, gint bytes)
+{
+	while (bytes--) {
+		g_string_append_c (str, val & 0xff);
+		val >>= 8;
+	}
+}
+
+/* a wav header for a stream of unknown length */
+static void
+xmms_httpstream_wav_header (xmms_httpstream_data_t *data,
+                            xmms_httpstream_stream_t *stream)
+{
+	GString *h;
+
+	h = g_string_new ("RIFF");
+	xmms_httpstream_put_le (h, 0xffffffff, 4);
+	g_string_append (h, "WAVEfmt ");
+	xmms_httpstream_put_le (h, 16, 4);
+	xmms_httpstream_put_le (h, 1, 2);
+	xmms_httpstream_put_le (h, data->channels, 2);
+	xmms_httpstream_put_le (h, data->rate, 4);
+	xmms_httpstream_put_le (h, data->rate * data->channels * 2, 4);
+	xmms_httpstream_put_le (h, data->channels * 2, 2);
+	xmms_httpstream_put_le (h, 16, 2);
+	g_string_append (h, "data");
+	xmms_httpstream_put_le (h, 0xffffffff, 4);
+
+	g_mutex_lock (data->mutex);
+
+	if (stream->headers->len && !g_string_equal (stream->headers, h)) {
+		stream->format_serial++;
+		stream->format_start = stream->head;
+	}
+
+	g_string_free (stream->headers, TRUE);
+	stream->headers = h;
+
+	g_mutex_unlock (data->mutex);
+}
+
+static void
+xmms_httpstream_wav_input (xmms_httpstream_data_t *data,
+                           xmms_httpstream_stream_t *stream,
+                           const xmms_samplefloat_t *buf, gint samples)
+{
+	gint16 *out;
+	gfloat v;
+	gint i;
+
+	out = g_new (gint16, samples);
+
+	for (i = 0; i < samples; i++) {
+		v = CLAMP (buf[i], -1.0, 1.0) * 32767.0;
+		out[i] = GINT16_TO_LE ((gint16) v);
+	}
+
+	g_mutex_lock (data->mutex);
+	xmms_httpstream_stream_append (stream, (guchar *) out, samples * 2);
+	g_mutex_unlock (data->mutex);
+
+	g_free (out);
+}
+
+/*
+ * Output methods
+ */
+
+static gboolean
+xmms_httpstream_listen (xmms_httpstream_data_t *data, const gchar *address,
+                        const gchar *port)
+{
+	struct addrinfo hints, *res, *ai;
+	gint fd = -1, one = 1;
+
+	memset (&hints, 0, sizeof (hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+
+	if (getaddrinfo (address, port, &hints, &res) != 0) {
+		xmms_log_error ("Couldn't resolve %s", address);
+		return FALSE;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd == -1)
+			continue;
+
+		setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+
+		if (bind (fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+		    listen (fd, 64) == 0)
+			break;
+
+		close (fd);
+		fd = -1;
+	}
+
+	freeaddrinfo (res);
+
+	if (fd == -1) {
+		xmms_log_error ("Couldn't listen on %s:%s", address, port);
+		return FALSE;
+	}
+
+	fcntl (fd, F_SETFL, O_NONBLOCK);
+	data->listen_fd = fd;
+
+	return TRUE;
+}
+
+static gboolean
+xmms_httpstream_new (xmms_output_t *output)
+{
+	xmms_httpstream_data_t *data;
+	xmms_config_property_t *val;
+	const gchar *address;
+	gchar port[16];
+	gint backlog;
+
+	data = g_new0 (xmms_httpstream_data_t, 1);
+	data->listen_fd = -1;
+
+	val = xmms_output_config_lookup (output, "backlog");
+	backlog = xmms_config_property_get_int (val);
+
+	val = xmms_output_config_lookup (output, "streams");
+	data->streams = xmms_httpstream_streams_parse (xmms_config_property_get_string (val),
+	                                               (gsize) backlog * 1024);
+	if (!data->streams) {
+		xmms_log_error ("No usable streams configured");
+		g_free (data);
+		return FALSE;
+	}
+
+	val = xmms_output_config_lookup (output, "maxlisteners");
+	data->maxlisteners = xmms_config_property_get_int (val);
+
+	val = xmms_output_config_lookup (output, "requesttimeout");
+	data->request_timeout = MAX (1, xmms_config_property_get_int (val));
+
+	val = xmms_output_config_lookup (output, "metaint");
+	data->metaint = CLAMP (xmms_config_property_get_int (val), 0, 65536);
+
+	val = xmms_output_config_lookup (output, "streamname");
+	data->name = g_strdup (xmms_config_property_get_string (val));
+
+	val = xmms_output_config_lookup (output, "bindaddress");
+	address = xmms_config_property_get_string (val);
+
+	val = xmms_output_config_lookup (output, "port");
+	g_snprintf (port, sizeof (port), "%d", xmms_config_property_get_int (val));
+
+	if (!xmms_httpstream_listen (data, address, port) ||
+	    pipe (data->wake_pipe) < 0) {
+		if (data->listen_fd != -1)
+			close (data->listen_fd);
+		g_list_foreach (data->streams, (GFunc) xmms_httpstream_stream_free, NULL);
+		g_list_free (data->streams);
+		g_free (data->name);
+		g_free (data);
+		return FALSE;
+	}
+	fcntl (data->wake_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl (data->wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+	vorbis_comment_init (&data->vc);
+	data->timer = g_timer_new ();
+	data->mutex = g_mutex_new ();
+
+	xmms_output_private_data_set (output, data);
+	xmms_output_format_add (output, XMMS_SAMPLE_FORMAT_FLOAT, 2, 44100);
+
+	xmms_object_connect (XMMS_OBJECT (output),
+	                     XMMS_IPC_SIGNAL_PLAYBACK_CURRENTID,
+	                     on_playlist_entry_changed,
+	                     data);
+
+	data->thread = g_thread_create (xmms_httpstream_thread, data, TRUE, NULL);
+
+	xmms_log_info ("Streaming on %s:%s", address, port);
+
+	return TRUE;
+}
+
+static void
+xmms_httpstream_destroy (xmms_output_t *output)
+{
+	xmms_httpstream_data_t *data;
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	xmms_object_disconnect (XMMS_OBJECT (output),
+	                        XMMS_IPC_SIGNAL_PLAYBACK_CURRENTID,
+	                        on_playlist_entry_changed,
+	                        data);
+
+	g_mutex_lock (data->mutex);
+	data->quit = TRUE;
+	xmms_httpstream_wake (data);
+	g_mutex_unlock (data->mutex);
+
+	g_thread_join (data->thread);
+
+	close (data->listen_fd);
+	close (data->wake_pipe[0]);
+	close (data->wake_pipe[1]);
+
+	g_list_foreach (data->streams, (GFunc) xmms_httpstream_stream_free, NULL);
+	g_list_free (data->streams);
+
+	vorbis_comment_clear (&data->vc);
+	g_timer_destroy (data->timer);
+	g_mutex_free (data->mutex);
+
+	g_free (data->title);
+	g_free (data->name);
+	g_free (data);
+}
+
+static gboolean
+xmms_httpstream_open (xmms_output_t *output)
+{
+	xmms_httpstream_data_t *data;
+	g_return_val_if_fail (output, FALSE);
+	data = xmms_output_private_data_get (output);
+	g_return_val_if_fail (data, FALSE);
+
+	g_timer_start (data->timer);
+	data->frames = 0;
+
+	return TRUE;
+}
+
+static void
+xmms_httpstream_close (xmms_output_t *output)
+{
+	xmms_httpstream_data_t *data;
+	xmms_httpstream_stream_t *stream;
+	GList *n;
+
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	/* end the logical streams, the next open starts new ones */
+	for (n = data->streams; n; n = g_list_next (n)) {
+		stream = n->data;
+		if (stream->format == HTTPSTREAM_VORBIS && stream->headers->len) {
+			xmms_ices_encoder_finish (stream->encoder);
+			xmms_httpstream_vorbis_output (data, stream);
+			g_mutex_lock (data->mutex);
+			g_string_truncate (stream->headers, 0);
+			g_mutex_unlock (data->mutex);
+		}
+	}
+
+	xmms_httpstream_wake (data);
+}
+
+static void
+xmms_httpstream_flush (xmms_output_t *output)
+{
+	xmms_httpstream_data_t *data;
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	/* what was sent is out of reach, just don't make up for the gap */
+	g_timer_start (data->timer);
+	data->frames = 0;
+}
+
+static gboolean
+xmms_httpstream_format_set (xmms_output_t *output,
+                            const xmms_stream_type_t *format)
+{
+	xmms_httpstream_data_t *data;
+	xmms_httpstream_stream_t *stream;
+	GList *n;
+
+	g_return_val_if_fail (output, FALSE);
+	data = xmms_output_private_data_get (output);
+	g_return_val_if_fail (data, FALSE);
+
+	data->rate = xmms_stream_type_get_int (format,
+	                                       XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	data->channels = xmms_stream_type_get_int (format,
+	                                           XMMS_STREAM_TYPE_FMT_CHANNELS);
+
+	XMMS_DBG ("Setting format to rate: %i, channels: %i",
+	          data->rate, data->channels);
+
+	for (n = data->streams; n; n = g_list_next (n)) {
+		stream = n->data;
+		if (stream->format == HTTPSTREAM_VORBIS) {
+			xmms_httpstream_vorbis_restart (data, stream);
+		} else {
+			xmms_httpstream_wav_header (data, stream);
+		}
+	}
+
+	data->comment_changed = FALSE;
+	xmms_httpstream_wake (data);
+
+	return TRUE;
+}
+
+/* don't run ahead of real time, listeners would get everything at once */
+static void
+xmms_httpstream_pace (xmms_httpstream_data_t *data, gint frames)
+{
+	gdouble elapsed, ahead;
+
+	data->frames += frames;
+
+	elapsed = g_timer_elapsed (data->timer, NULL);
+	ahead = (gdouble) data->frames / data->rate - elapsed;
+
+	if (ahead > HTTPSTREAM_LEAD) {
+		g_usleep ((ahead - HTTPSTREAM_LEAD) * G_USEC_PER_SEC);
+	} else if (ahead < -1.0) {
+		/* starved for a while, don't burst to catch up */
+		g_timer_start (data->timer);
+		data->frames = 0;
+	}
+}
+
+static void
+xmms_httpstream_write (xmms_output_t *output, gpointer buffer,
+                       gint len, xmms_error_t *err)
+{
+	xmms_httpstream_data_t *data;
+	xmms_httpstream_stream_t *stream;
+	gint samples;
+	GList *n;
+
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	if (!data->rate) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "format is not set");
+		return;
+	}
+
+	samples = len / sizeof (xmms_samplefloat_t);
+
+	for (n = data->streams; n; n = g_list_next (n)) {
+		stream = n->data;
+		if (stream->format == HTTPSTREAM_VORBIS) {
+			if (data->comment_changed || !stream->headers->len) {
+				xmms_httpstream_vorbis_restart (data, stream);
+			}
+			xmms_ices_encoder_input (stream->encoder, buffer, len);
+			xmms_httpstream_vorbis_output (data, stream);
+		} else {
+			xmms_httpstream_wav_input (data, stream, buffer, samples);
+		}
+	}
+
+	data->comment_changed = FALSE;
+	xmms_httpstream_wake (data);
+
+	xmms_httpstream_pace (data, samples / data->channels);
+}
+
+static void
+on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg, gpointer udata)
+{
+	xmms_httpstream_data_t *data = udata;
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry;
+	gchar *artist, *title, *album;
+
+	if (!xmmsv_get_int (arg, &entry))
+		return;
+
+	session = xmms_medialib_begin ();
+	artist = xmms_medialib_entry_property_get_str (session, entry,
+	                                               XMMS_MEDIALIB_ENTRY_PROPERTY_ARTIST);
+	title = xmms_medialib_entry_property_get_str (session, entry,
+	                                              XMMS_MEDIALIB_ENTRY_PROPERTY_TITLE);
+	album = xmms_medialib_entry_property_get_str (session, entry,
+	                                              XMMS_MEDIALIB_ENTRY_PROPERTY_ALBUM);
+	xmms_medialib_end (session);
+
+	/* picked up by the output thread with the next write */
+	vorbis_comment_clear (&data->vc);
+	vorbis_comment_init (&data->vc);
+	if (title)
+		vorbis_comment_add_tag (&data->vc, "title", title);
+	if (artist)
+		vorbis_comment_add_tag (&data->vc, "artist", artist);
+	if (album)
+		vorbis_comment_add_tag (&data->vc, "album", album);
+	data->comment_changed = TRUE;
+
+	g_mutex_lock (data->mutex);
+	g_free (data->title);
+	if (artist && title) {
+		data->title = g_strdup_printf ("%s - %s", artist, title);
+	} else {
+		data->title = g_strdup (title ? title : "");
+	}
+	data->title_serial++;
+	g_mutex_unlock (data->mutex);
+
+	g_free (artist);
+	g_free (title);
+	g_free (album);
+}
+
+/*
+ * Listeners, only touched by the server thread
+ */
+
+static void
+xmms_httpstream_listener_free (xmms_httpstream_data_t *data,
+                               xmms_httpstream_listener_t *l)
+{
+	close (l->fd);
+
+	g_string_free (l->request, TRUE);
+	g_string_free (l->pending, TRUE);
+	if (l->prefix)
+		g_string_free (l->prefix, TRUE);
+	g_free (l);
+
+	data->nlisteners--;
+}
+
+static void
+xmms_httpstream_accept (xmms_httpstream_data_t *data)
+{
+	xmms_httpstream_listener_t *l;
+	gint fd;
+
+	while ((fd = accept (data->listen_fd, NULL, NULL)) != -1) {
+		fcntl (fd, F_SETFL, O_NONBLOCK);
+
+		l = g_new0 (xmms_httpstream_listener_t, 1);
+		l->fd = fd;
+		l->request = g_string_new (NULL);
+		l->pending = g_string_new (NULL);
+
+		g_get_current_time (&l->deadline);
+		l->deadline.tv_sec += data->request_timeout;
+
+		data->listeners = g_list_prepend (data->listeners, l);
+		data->nlisteners++;
+	}
+}
+
+static void
+xmms_httpstream_reply_error (xmms_httpstream_listener_t *l, const gchar *status)
+{
+	g_string_append_printf (l->pending,
+	                        "HTTP/1.0 %s\r\n"
+	                        "Content-Type: text/plain\r\n"
+	                        "Connection: close\r\n"
+	                        "\r\n"
+	                        "%s\n", status, status);
+	l->close_when_sent = TRUE;
+}
+
+/* called with the mutex held once the whole request is in */
+static void
+xmms_httpstream_request (xmms_httpstream_data_t *data,
+                         xmms_httpstream_listener_t *l)
+{
+	xmms_httpstream_stream_t *stream = NULL;
+	gchar **lines, **words, *query;
+	gboolean icy = FALSE;
+	GList *n;
+	gint i;
+
+	lines = g_strsplit (l->request->str, "\r\n", 0);
+	words = g_strsplit (lines[0], " ", 3);
+
+	if (!words[0] || !words[1] || strcmp (words[0], "GET")) {
+		xmms_httpstream_reply_error (l, "400 Bad Request");
+		goto out;
+	}
+
+	query = strchr (words[1], '?');
+	if (query)
+		*query = '\0';
+
+	for (n = data->streams; n; n = g_list_next (n)) {
+		if (!strcmp (((xmms_httpstream_stream_t *) n->data)->mount, words[1])) {
+			stream = n->data;
+			break;
+		}
+	}
+
+	if (!stream) {
+		xmms_httpstream_reply_error (l, "404 Not Found");
+		goto out;
+	}
+
+	if (data->nlisteners > data->maxlisteners) {
+		xmms_httpstream_reply_error (l, "503 Service Unavailable");
+		goto out;
+	}
+
+	for (i = 1; lines[i]; i++) {
+		if (!g_ascii_strncasecmp (lines[i], "icy-metadata:", 13) &&
+		    atoi (lines[i] + 13) == 1) {
+			icy = TRUE;
+		}
+	}
+
+	g_string_append_printf (l->pending,
+	                        "HTTP/1.0 200 OK\r\n"
+	                        "Content-Type: %s\r\n"
+	                        "Cache-Control: no-cache\r\n"
+	                        "Server: XMMS2/" XMMS_VERSION "\r\n"
+	                        "icy-name: %s\r\n",
+	                        stream->format == HTTPSTREAM_VORBIS ?
+	                        "application/ogg" : "audio/x-wav",
+	                        data->name);
+	if (stream->bitrate > 0) {
+		g_string_append_printf (l->pending, "icy-br: %d\r\n",
+		                        stream->bitrate / 1000);
+	}
+	if (icy && data->metaint) {
+		g_string_append_printf (l->pending, "icy-metaint: %d\r\n",
+		                        data->metaint);
+		l->metaint = l->metaleft = data->metaint;
+		/* the first block carries the title */
+		l->title_serial = data->title_serial - 1;
+	}
+	g_string_append (l->pending, "\r\n");
+
+	l->stream = stream;
+	l->prefix = g_string_new_len (stream->headers->str, stream->headers->len);
+	l->cursor = stream->head;
+	l->format_serial = stream->format_serial;
+
+	XMMS_DBG ("New listener on %s (%d listeners)", stream->mount,
+	          data->nlisteners);
+
+out:
+	g_strfreev (words);
+	g_strfreev (lines);
+}
+
+static gboolean
+xmms_httpstream_read_request (xmms_httpstream_data_t *data,
+                              xmms_httpstream_listener_t *l)
+{
+	gchar buf[1024];
+	gint ret;
+
+	ret = recv (l->fd, buf, sizeof (buf), 0);
+	if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR)) {
+		return FALSE;
+	}
+	if (ret < 0 || l->stream || l->close_when_sent) {
+		/* listeners don't talk after the request */
+		return TRUE;
+	}
+
+	g_string_append_len (l->request, buf, ret);
+
+	if (strstr (l->request->str, "\r\n\r\n")) {
+		g_mutex_lock (data->mutex);
+		xmms_httpstream_request (data, l);
+		g_mutex_unlock (data->mutex);
+	} else if (l->request->len > HTTPSTREAM_REQUEST_MAX) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* called with the mutex held */
+static void
+xmms_httpstream_icy_block (xmms_httpstream_data_t *data,
+                           xmms_httpstream_listener_t *l)
+{
+	gchar *text;
+	gint len, blocks;
+
+	l->metaleft = l->metaint;
+
+	if (l->title_serial == data->title_serial || !data->title) {
+		g_string_append_c (l->pending, '\0');
+		return;
+	}
+	l->title_serial = data->title_serial;
+
+	text = g_strdup_printf ("StreamTitle='%s';", data->title);
+	len = MIN (strlen (text), 255 * 16);
+	blocks = (len + 15) / 16;
+
+	g_string_append_c (l->pending, blocks);
+	g_string_append_len (l->pending, text, len);
+	while (len++ < blocks * 16)
+		g_string_append_c (l->pending, '\0');
+
+	g_free (text);
+}
+
+/* called with the mutex held */
+static gboolean
+xmms_httpstream_has_output (xmms_httpstream_listener_t *l)
+{
+	return l->pending_pos < l->pending->len ||
+	       (l->stream && (l->prefix_pos < l->prefix->len ||
+	                      l->cursor < l->stream->head));
+}
+
+/*
+ * Send as much as the socket takes. Called with the mutex held.
+ * Returns FALSE if the listener is to be dropped.
+ */
+static gboolean
+xmms_httpstream_send (xmms_httpstream_data_t *data,
+                      xmms_httpstream_listener_t *l)
+{
+	xmms_httpstream_stream_t *stream = l->stream;
+	enum { PENDING, PREFIX, RING } what;
+	const gchar *ptr;
+	gsize len, off;
+	gint ret;
+
+	while (TRUE) {
+		if (l->pending_pos < l->pending->len) {
+			what = PENDING;
+			ptr = l->pending->str + l->pending_pos;
+			len = l->pending->len - l->pending_pos;
+		} else if (l->close_when_sent) {
+			return FALSE;
+		} else if (!stream) {
+			return TRUE;
+		} else if (l->metaint && !l->metaleft) {
+			xmms_httpstream_icy_block (data, l);
+			continue;
+		} else if (stream->format == HTTPSTREAM_WAV && !l->prefix->len &&
+		           stream->headers->len) {
+			/* joined before the format was known, nothing sent yet */
+			g_string_append_len (l->prefix, stream->headers->str,
+			                     stream->headers->len);
+			l->format_serial = stream->format_serial;
+			continue;
+		} else if (l->prefix_pos < l->prefix->len) {
+			what = PREFIX;
+			ptr = l->prefix->str + l->prefix_pos;
+			len = l->prefix->len - l->prefix_pos;
+		} else if (l->cursor < stream->head) {
+			if (stream->head - l->cursor > stream->ringsize) {
+				XMMS_DBG ("Dropping listener on %s, too far behind",
+				          stream->mount);
+				return FALSE;
+			}
+			if (l->format_serial != stream->format_serial &&
+			    (stream->format_serial - l->format_serial > 1 ||
+			     l->cursor >= stream->format_start)) {
+				XMMS_DBG ("Dropping listener on %s, format changed",
+				          stream->mount);
+				return FALSE;
+			}
+			what = RING;
+			off = l->cursor % stream->ringsize;
+			ptr = (gchar *) stream->ring + off;
+			len = MIN (stream->head - l->cursor, stream->ringsize - off);
+			if (l->format_serial != stream->format_serial) {
+				len = MIN (len, stream->format_start - l->cursor);
+			}
+		} else {
+			return TRUE;
+		}
+
+		if (what != PENDING && l->metaint) {
+			len = MIN (len, l->metaleft);
+		}
+
+		ret = send (l->fd, ptr, len, 0);
+		if (ret < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+
+		if (what == PENDING) {
+			l->pending_pos += ret;
+			if (l->pending_pos == l->pending->len) {
+				g_string_truncate (l->pending, 0);
+				l->pending_pos = 0;
+			}
+		} else {
+			if (what == PREFIX) {
+				l->prefix_pos += ret;
+			} else {
+				l->cursor += ret;
+			}
+			if (l->metaint) {
+				l->metaleft -= ret;
+			}
+		}
+
+		if (ret < len) {
+			return TRUE;
+		}
+	}
+}
+
+/* milliseconds until the request deadline of the client */
+static glong
+xmms_httpstream_time_left (xmms_httpstream_listener_t *l, const GTimeVal *now)
+{
+	glong left;
+
+	left = (l->deadline.tv_sec - now->tv_sec) * 1000 +
+	       (l->deadline.tv_usec - now->tv_usec) / 1000;
+
+	return MAX (0, left);
+}
+
+/* Milliseconds until the first client that hasn't been served a
+ * stream times out, -1 if there is none.
+ */
+static gint
+xmms_httpstream_next_timeout (xmms_httpstream_data_t *data,
+                              const GTimeVal *now)
+{
+	xmms_httpstream_listener_t *l;
+	glong left, timeout = -1;
+	GList *n;
+
+	for (n = data->listeners; n; n = g_list_next (n)) {
+		l = n->data;
+		if (l->stream) {
+			continue;
+		}
+
+		left = xmms_httpstream_time_left (l, now);
+		if (timeout < 0 || left < timeout) {
+			timeout = left;
+		}
+	}
+
+	return timeout;
+}
+
+static gpointer
+xmms_httpstream_thread (gpointer udata)
+{
+	xmms_httpstream_data_t *data = udata;
+	xmms_httpstream_listener_t *l;
+	struct pollfd *fds = NULL;
+	gchar buf[64];
+	GTimeVal now;
+	GList *n, *next;
+	gint nfds, timeout, i;
+
+	g_mutex_lock (data->mutex);
+
+	while (!data->quit) {
+		fds = g_renew (struct pollfd, fds, data->nlisteners + 2);
+
+		fds[0].fd = data->listen_fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = data->wake_pipe[0];
+		fds[1].events = POLLIN;
+
+		for (i = 2, n = data->listeners; n; n = g_list_next (n), i++) {
+			l = n->data;
+			fds[i].fd = l->fd;
+			fds[i].events = POLLIN;
+			if (xmms_httpstream_has_output (l))
+				fds[i].events |= POLLOUT;
+		}
+		nfds = i;
+
+		g_get_current_time (&now);
+		timeout = xmms_httpstream_next_timeout (data, &now);
+
+		g_mutex_unlock (data->mutex);
+
+		if (poll (fds, nfds, timeout) < 0 && errno != EINTR) {
+			xmms_log_error ("poll failed: %s", strerror (errno));
+			g_mutex_lock (data->mutex);
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+			while (read (data->wake_pipe[0], buf, sizeof (buf)) > 0);
+
+		g_get_current_time (&now);
+
+		/* listeners go first, the list is in the order of fds */
+		for (i = 2, n = data->listeners; i < nfds; n = next, i++) {
+			gboolean keep = TRUE;
+
+			next = g_list_next (n);
+			l = n->data;
+
+			if (fds[i].revents & (POLLERR | POLLNVAL)) {
+				keep = FALSE;
+			} else if (fds[i].revents & (POLLIN | POLLHUP)) {
+				keep = xmms_httpstream_read_request (data, l);
+			}
+
+			if (keep) {
+				g_mutex_lock (data->mutex);
+				if (xmms_httpstream_has_output (l))
+					keep = xmms_httpstream_send (data, l);
+				g_mutex_unlock (data->mutex);
+			}
+
+			/* don't let idle connections use up maxlisteners */
+			if (keep && !l->stream &&
+			    xmms_httpstream_time_left (l, &now) == 0) {
+				keep = FALSE;
+			}
+
+			if (!keep) {
+				data->listeners = g_list_delete_link (data->listeners, n);
+				xmms_httpstream_listener_free (data, l);
+			}
+		}
+
+		if (fds[0].revents & POLLIN)
+			xmms_httpstream_accept (data);
+
+		g_mutex_lock (data->mutex);
+	}
+
+	g_mutex_unlock (data->mutex);
+
+	while (data->listeners) {
+		xmms_httpstream_listener_free (data, data->listeners->data);
+		data->listeners = g_list_delete_link (data->listeners,
+		                                      data->listeners);
+	}
+
+	g_free (fds);
+
+	return NULL;
+}
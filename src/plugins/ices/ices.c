@@ -29,14 +29,65 @@
 
 #include "encode.h"
 
-typedef struct xmms_ices_data_St {
+/* jobs are shared by the queues of all variants */
+typedef enum {
+	ICES_JOB_DATA,
+	ICES_JOB_FORMAT,
+	ICES_JOB_COMMENT,
+	ICES_JOB_CLOSE
+} xmms_ices_job_type_t;
+
+typedef struct xmms_ices_job_St {
+	gint refs;
+	xmms_ices_job_type_t type;
+
+	/* ICES_JOB_DATA */
+	gpointer buffer;
+	gint len;
+
+	/* ICES_JOB_FORMAT */
+	gint rate;
+	gint channels;
+
+	/* ICES_JOB_FORMAT and ICES_JOB_COMMENT, key/value pairs */
+	gchar **tags;
+} xmms_ices_job_t;
+
+/* One mount on the icecast server, encoded by its own thread. */
+typedef struct xmms_ices_variant_St {
 	shout_t *shout;
-	vorbis_comment vc;
+	gint minbr;
+	gint nombr;
+	gint maxbr;
+
+	GThread *thread;
+	GQueue *jobs;
+	gsize queued;
+	gboolean busy;
+	gboolean failed;
+
+	/* only used by the variant's thread */
 	encoder_state *encoder;
+	vorbis_comment vc;
 	gint rate;
 	gint channels;
+} xmms_ices_variant_t;
+
+typedef struct xmms_ices_data_St {
+	GList *variants;
+
+	/* protects the variant queues */
+	GMutex *mutex;
+	GCond *cond;
+	gsize queuesize;
+	gboolean quit;
 } xmms_ices_data_t;
 
+typedef struct xmms_ices_worker_St {
+	xmms_ices_data_t *data;
+	xmms_ices_variant_t *variant;
+} xmms_ices_worker_t;
+
 /*
  * Forward definitions.
  */
@@ -50,42 +101,213 @@ static gboolean xmms_ices_format_set (xmms_output_t *output,
                                       const xmms_stream_type_t *format);
 static void xmms_ices_write (xmms_output_t *output, gpointer buffer,
                              gint len, xmms_error_t *err);
-static void xmms_ices_update_comment (xmms_medialib_entry_t entry,
-                                      vorbis_comment *vc);
+static gchar **xmms_ices_get_tags (xmms_medialib_entry_t entry);
 static void on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg,
                                        gpointer udata);
 
 /*
  * Internal helper functions.
  */
-static void
-xmms_ices_send_shout (xmms_ices_data_t *data, xmms_error_t *err)
+static gboolean
+xmms_ices_send_shout (xmms_ices_variant_t *variant)
 {
 	ogg_page og;
 
-	while (xmms_ices_encoder_output (data->encoder, &og) == TRUE) {
-		if (shout_send (data->shout, og.header, og.header_len) < 0) {
-			if (err)
-				xmms_error_set (err, XMMS_ERROR_GENERIC,
-				                "Disconnected or something.");
-			return;
-		} else if (shout_send (data->shout, og.body, og.body_len) < 0) {
-			if (err)
-				xmms_error_set (err, XMMS_ERROR_GENERIC,
-				                "Error when sending data to icecast server");
-			return;
+	while (xmms_ices_encoder_output (variant->encoder, &og) == TRUE) {
+		if (shout_send (variant->shout, og.header, og.header_len) < 0 ||
+		    shout_send (variant->shout, og.body, og.body_len) < 0) {
+			xmms_log_error ("Error when sending data to %s: %s",
+			                shout_get_mount (variant->shout),
+			                shout_get_error (variant->shout));
+			return FALSE;
 		}
 
-		shout_sync (data->shout);
+		shout_sync (variant->shout);
 	}
+
+	return TRUE;
 }
 
 static void
-xmms_ices_flush_internal (xmms_ices_data_t *data)
+xmms_ices_flush_internal (xmms_ices_variant_t *variant)
 {
-	xmms_ices_encoder_finish (data->encoder);
+	xmms_ices_encoder_finish (variant->encoder);
 
-	xmms_ices_send_shout (data, NULL);
+	xmms_ices_send_shout (variant);
+}
+
+static void
+xmms_ices_set_comment (xmms_ices_variant_t *variant, gchar **tags)
+{
+	vorbis_comment_clear (&variant->vc);
+	vorbis_comment_init (&variant->vc);
+
+	for (; tags && tags[0]; tags += 2) {
+		vorbis_comment_add_tag (&variant->vc, tags[0], tags[1]);
+	}
+}
+
+static xmms_ices_job_t *
+xmms_ices_job_new (xmms_ices_job_type_t type)
+{
+	xmms_ices_job_t *job;
+
+	job = g_new0 (xmms_ices_job_t, 1);
+	job->refs = 1;
+	job->type = type;
+
+	return job;
+}
+
+static void
+xmms_ices_job_unref (xmms_ices_job_t *job)
+{
+	if (g_atomic_int_dec_and_test (&job->refs)) {
+		g_strfreev (job->tags);
+		g_free (job->buffer);
+		g_free (job);
+	}
+}
+
+static void
+xmms_ices_run_job (xmms_ices_variant_t *variant, xmms_ices_job_t *job)
+{
+	switch (job->type) {
+		case ICES_JOB_DATA:
+			if (!variant->encoder || variant->failed)
+				break;
+
+			xmms_ices_encoder_input (variant->encoder, job->buffer, job->len);
+			if (!xmms_ices_send_shout (variant))
+				variant->failed = TRUE;
+			break;
+		case ICES_JOB_FORMAT:
+			if (variant->encoder) {
+				xmms_ices_flush_internal (variant);
+			} else {
+				variant->encoder = xmms_ices_encoder_init (variant->minbr,
+				                                           variant->nombr,
+				                                           variant->maxbr);
+				if (!variant->encoder)
+					break;
+			}
+
+			variant->rate = job->rate;
+			variant->channels = job->channels;
+			xmms_ices_set_comment (variant, job->tags);
+			xmms_ices_encoder_stream_change (variant->encoder, variant->rate,
+			                                 variant->channels, &variant->vc);
+			break;
+		case ICES_JOB_COMMENT:
+			if (!variant->encoder)
+				break;
+
+			xmms_ices_flush_internal (variant);
+			xmms_ices_set_comment (variant, job->tags);
+			xmms_ices_encoder_stream_change (variant->encoder, variant->rate,
+			                                 variant->channels, &variant->vc);
+			break;
+		case ICES_JOB_CLOSE:
+			if (variant->encoder) {
+				xmms_ices_flush_internal (variant);
+				xmms_ices_encoder_fini (variant->encoder);
+				variant->encoder = NULL;
+			}
+
+			shout_close (variant->shout);
+			variant->failed = FALSE;
+			break;
+	}
+}
+
+static gpointer
+xmms_ices_worker (gpointer udata)
+{
+	xmms_ices_worker_t *worker = udata;
+	xmms_ices_data_t *data = worker->data;
+	xmms_ices_variant_t *variant = worker->variant;
+	xmms_ices_job_t *job;
+
+	g_free (worker);
+
+	g_mutex_lock (data->mutex);
+
+	while (TRUE) {
+		while (!data->quit && g_queue_is_empty (variant->jobs))
+			g_cond_wait (data->cond, data->mutex);
+
+		job = g_queue_pop_head (variant->jobs);
+		if (!job)
+			break;
+
+		variant->busy = TRUE;
+		g_mutex_unlock (data->mutex);
+
+		xmms_ices_run_job (variant, job);
+
+		g_mutex_lock (data->mutex);
+		variant->queued -= job->len;
+		variant->busy = FALSE;
+		g_cond_broadcast (data->cond);
+
+		xmms_ices_job_unref (job);
+	}
+
+	g_mutex_unlock (data->mutex);
+
+	return NULL;
+}
+
+/* Hand a job to every variant. Blocks while the queue of one of them
+ * is full, that is what paces the output.
+ */
+static void
+xmms_ices_push (xmms_ices_data_t *data, xmms_ices_job_t *job)
+{
+	xmms_ices_variant_t *variant;
+	GList *n;
+
+	g_mutex_lock (data->mutex);
+
+	for (n = data->variants; n; n = g_list_next (n)) {
+		variant = n->data;
+		while (variant->queued > 0 &&
+		       variant->queued + job->len > data->queuesize &&
+		       !variant->failed) {
+			g_cond_wait (data->cond, data->mutex);
+		}
+	}
+
+	for (n = data->variants; n; n = g_list_next (n)) {
+		variant = n->data;
+		g_atomic_int_inc (&job->refs);
+		g_queue_push_tail (variant->jobs, job);
+		variant->queued += job->len;
+	}
+
+	g_cond_broadcast (data->cond);
+	g_mutex_unlock (data->mutex);
+
+	xmms_ices_job_unref (job);
+}
+
+/* Wait until every variant has run all of its jobs. */
+static void
+xmms_ices_sync (xmms_ices_data_t *data)
+{
+	xmms_ices_variant_t *variant;
+	GList *n;
+
+	g_mutex_lock (data->mutex);
+
+	for (n = data->variants; n; n = g_list_next (n)) {
+		variant = n->data;
+		while (!g_queue_is_empty (variant->jobs) || variant->busy) {
+			g_cond_wait (data->cond, data->mutex);
+		}
+	}
+
+	g_mutex_unlock (data->mutex);
 }
 
 /*
@@ -120,6 +342,10 @@ xmms_ices_plugin_setup (xmms_output_plugin_t *plugin)
 		{ "streamdescription", "" },
 		{ "streamgenre", "" },
 		{ "streamurl", "" },
+		/* extra mounts, comma separated mount=nominal bitrate */
+		{ "variants", "" },
+		/* per mount, in KiB of input */
+		{ "queuesize", "1024" },
 		{ NULL, NULL },
 	};
 
@@ -144,51 +370,136 @@ xmms_ices_plugin_setup (xmms_output_plugin_t *plugin)
 	return TRUE;
 }
 
-static gboolean
-xmms_ices_new (xmms_output_t *output)
+static shout_t *
+xmms_ices_shout_new (xmms_output_t *output, const gchar *mount)
 {
-	xmms_ices_data_t *data;
 	xmms_config_property_t *val;
+	shout_t *shout;
 
-	shout_init ();
-
-	data = g_new0 (xmms_ices_data_t, 1);
-	data->shout = shout_new ();
+	shout = shout_new ();
 
-	shout_set_format (data->shout, SHOUT_FORMAT_VORBIS);
-	shout_set_protocol (data->shout, SHOUT_PROTOCOL_HTTP);
+	shout_set_format (shout, SHOUT_FORMAT_VORBIS);
+	shout_set_protocol (shout, SHOUT_PROTOCOL_HTTP);
 
 	val = xmms_output_config_lookup (output, "host");
-	shout_set_host (data->shout, xmms_config_property_get_string (val));
+	shout_set_host (shout, xmms_config_property_get_string (val));
 
 	val = xmms_output_config_lookup (output, "port");
-	shout_set_port (data->shout, xmms_config_property_get_int (val));
+	shout_set_port (shout, xmms_config_property_get_int (val));
 
 	val = xmms_output_config_lookup (output, "password");
-	shout_set_password (data->shout, xmms_config_property_get_string (val));
+	shout_set_password (shout, xmms_config_property_get_string (val));
 
 	val = xmms_output_config_lookup (output, "user");
-	shout_set_user (data->shout, xmms_config_property_get_string (val));
+	shout_set_user (shout, xmms_config_property_get_string (val));
 
-	shout_set_agent (data->shout, "XMMS/" XMMS_VERSION);
+	shout_set_agent (shout, "XMMS/" XMMS_VERSION);
 
-	val = xmms_output_config_lookup (output, "mount");
-	shout_set_mount (data->shout, xmms_config_property_get_string (val));
+	shout_set_mount (shout, mount);
 
 	val = xmms_output_config_lookup (output, "public");
-	shout_set_public (data->shout, xmms_config_property_get_int (val));
+	shout_set_public (shout, xmms_config_property_get_int (val));
 
 	val = xmms_output_config_lookup (output, "streamname");
-	shout_set_name (data->shout, xmms_config_property_get_string (val));
+	shout_set_name (shout, xmms_config_property_get_string (val));
 
 	val = xmms_output_config_lookup (output, "streamdescription");
-	shout_set_description (data->shout, xmms_config_property_get_string (val));
+	shout_set_description (shout, xmms_config_property_get_string (val));
 
 	val = xmms_output_config_lookup (output, "streamgenre");
-	shout_set_genre (data->shout, xmms_config_property_get_string (val));
+	shout_set_genre (shout, xmms_config_property_get_string (val));
 
 	val = xmms_output_config_lookup (output, "streamurl");
-	shout_set_url (data->shout, xmms_config_property_get_string (val));
+	shout_set_url (shout, xmms_config_property_get_string (val));
+
+	return shout;
+}
+
+static void
+xmms_ices_variant_add (xmms_output_t *output, xmms_ices_data_t *data,
+                       const gchar *mount, gint minbr, gint nombr, gint maxbr)
+{
+	xmms_ices_variant_t *variant;
+	xmms_ices_worker_t *worker;
+
+	if (nombr <= 0) {
+		xmms_log_error ("Ignoring %s, no bitrate", mount);
+		return;
+	}
+
+	variant = g_new0 (xmms_ices_variant_t, 1);
+	variant->shout = xmms_ices_shout_new (output, mount);
+	variant->minbr = minbr;
+	variant->nombr = nombr;
+	variant->maxbr = maxbr;
+	variant->jobs = g_queue_new ();
+	vorbis_comment_init (&variant->vc);
+
+	worker = g_new0 (xmms_ices_worker_t, 1);
+	worker->data = data;
+	worker->variant = variant;
+	variant->thread = g_thread_create (xmms_ices_worker, worker, TRUE, NULL);
+
+	data->variants = g_list_append (data->variants, variant);
+}
+
+static void
+xmms_ices_variant_free (xmms_ices_variant_t *variant)
+{
+	if (variant->encoder)
+		xmms_ices_encoder_fini (variant->encoder);
+
+	vorbis_comment_clear (&variant->vc);
+
+	shout_close (variant->shout);
+	shout_free (variant->shout);
+
+	g_queue_free (variant->jobs);
+	g_free (variant);
+}
+
+static gboolean
+xmms_ices_new (xmms_output_t *output)
+{
+	xmms_ices_data_t *data;
+	xmms_config_property_t *val;
+	gint minbr, nombr, maxbr;
+	gchar **items, **parts;
+	gint i;
+
+	shout_init ();
+
+	data = g_new0 (xmms_ices_data_t, 1);
+	data->mutex = g_mutex_new ();
+	data->cond = g_cond_new ();
+
+	val = xmms_output_config_lookup (output, "queuesize");
+	data->queuesize = MAX (xmms_config_property_get_int (val), 64) * 1024;
+
+	val = xmms_output_config_lookup (output, "encodingnombr");
+	nombr = xmms_config_property_get_int (val);
+	val = xmms_output_config_lookup (output, "encodingminbr");
+	minbr = xmms_config_property_get_int (val);
+	val = xmms_output_config_lookup (output, "encodingmaxbr");
+	maxbr = xmms_config_property_get_int (val);
+
+	val = xmms_output_config_lookup (output, "mount");
+	xmms_ices_variant_add (output, data, xmms_config_property_get_string (val),
+	                       minbr, nombr, maxbr);
+
+	val = xmms_output_config_lookup (output, "variants");
+	items = g_strsplit (xmms_config_property_get_string (val), ",", 0);
+	for (i = 0; items[i]; i++) {
+		parts = g_strsplit (g_strstrip (items[i]), "=", 2);
+		if (parts[0] && parts[1]) {
+			xmms_ices_variant_add (output, data, parts[0], -1,
+			                       strtol (parts[1], NULL, 10), -1);
+		} else if (*items[i]) {
+			xmms_log_error ("Ignoring bad variant '%s'", items[i]);
+		}
+		g_strfreev (parts);
+	}
+	g_strfreev (items);
 
 	xmms_output_private_data_set (output, data);
 	xmms_output_format_add (output, XMMS_SAMPLE_FORMAT_FLOAT, 2, 44100);
@@ -205,6 +516,8 @@ static void
 xmms_ices_destroy (xmms_output_t *output)
 {
 	xmms_ices_data_t *data;
+	GList *n;
+
 	g_return_if_fail (output);
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
@@ -214,13 +527,20 @@ xmms_ices_destroy (xmms_output_t *output)
 	                        on_playlist_entry_changed,
 	                        data);
 
-	if (data->encoder)
-		xmms_ices_encoder_fini (data->encoder);
+	g_mutex_lock (data->mutex);
+	data->quit = TRUE;
+	g_cond_broadcast (data->cond);
+	g_mutex_unlock (data->mutex);
 
-	vorbis_comment_clear (&data->vc);
+	for (n = data->variants; n; n = g_list_next (n)) {
+		xmms_ices_variant_t *variant = n->data;
+		g_thread_join (variant->thread);
+		xmms_ices_variant_free (variant);
+	}
+	g_list_free (data->variants);
 
-	shout_close (data->shout);
-	shout_free (data->shout);
+	g_cond_free (data->cond);
+	g_mutex_free (data->mutex);
 
 	g_free (data);
 
@@ -231,16 +551,39 @@ static gboolean
 xmms_ices_open (xmms_output_t *output)
 {
 	xmms_ices_data_t *data;
+	xmms_ices_variant_t *variant;
+	gint connected = 0;
+	GList *n;
+
 	g_return_val_if_fail (output, FALSE);
 	data = xmms_output_private_data_get (output);
 	g_return_val_if_fail (data, FALSE);
 
-	if (shout_open (data->shout) == SHOUTERR_SUCCESS) {
-		XMMS_DBG ("Connected to http://%s:%d/%s",
-		          shout_get_host (data->shout),
-		          shout_get_port (data->shout),
-		          shout_get_mount (data->shout));
-	} else {
+	/* the workers are idle, close waited for them. A mount that can't
+	 * be reached is left out until the next open, the others go on.
+	 */
+	g_mutex_lock (data->mutex);
+	for (n = data->variants; n; n = g_list_next (n)) {
+		variant = n->data;
+
+		if (shout_open (variant->shout) == SHOUTERR_SUCCESS) {
+			XMMS_DBG ("Connected to http://%s:%d/%s",
+			          shout_get_host (variant->shout),
+			          shout_get_port (variant->shout),
+			          shout_get_mount (variant->shout));
+			connected++;
+		} else {
+			xmms_log_error ("Couldn't connect to http://%s:%d/%s: %s",
+			                shout_get_host (variant->shout),
+			                shout_get_port (variant->shout),
+			                shout_get_mount (variant->shout),
+			                shout_get_error (variant->shout));
+			variant->failed = TRUE;
+		}
+	}
+	g_mutex_unlock (data->mutex);
+
+	if (!connected) {
 		xmms_log_error ("Couldn't connect to icecast server!");
 		return FALSE;
 	}
@@ -256,17 +599,8 @@ xmms_ices_close (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	if (!data->encoder) {
-		shout_close (data->shout);
-		return;
-	}
-
-	xmms_ices_flush_internal (data);
-
-	shout_close (data->shout);
-
-	xmms_ices_encoder_fini (data->encoder);
-	data->encoder = NULL;
+	xmms_ices_push (data, xmms_ices_job_new (ICES_JOB_CLOSE));
+	xmms_ices_sync (data);
 }
 
 static void
@@ -278,52 +612,25 @@ static gboolean
 xmms_ices_format_set (xmms_output_t *output, const xmms_stream_type_t *format)
 {
 	xmms_ices_data_t *data;
-	xmms_config_property_t *val;
-	xmms_medialib_entry_t entry;
+	xmms_ices_job_t *job;
 
 	g_return_val_if_fail (output, FALSE);
 	data = xmms_output_private_data_get (output);
 	g_return_val_if_fail (data, FALSE);
 
-	if (data->encoder)
-		xmms_ices_flush_internal (data);
-
-	/* Set the Vorbis comment to the current track metadata. */
-	vorbis_comment_clear (&data->vc);
-	vorbis_comment_init (&data->vc);
-
-	entry = xmms_output_current_id (output);
-	xmms_ices_update_comment (entry, &data->vc);
-
-
-	/* If there is no encoder around, we need to build one. */
-	if (!data->encoder) {
-		int minbr, nombr, maxbr;
-
-		val = xmms_output_config_lookup (output, "encodingnombr");
-		nombr = xmms_config_property_get_int (val);
-		val = xmms_output_config_lookup (output, "encodingminbr");
-		minbr = xmms_config_property_get_int (val);
-		val = xmms_output_config_lookup (output, "encodingmaxbr");
-		maxbr = xmms_config_property_get_int (val);
-
-		data->encoder = xmms_ices_encoder_init (minbr, nombr, maxbr);
-		if (!data->encoder)
-			return FALSE;
-	}
-
-	/* Get this stream's data and fire up the encoder. */
-	data->rate = xmms_stream_type_get_int (format,
-	                                       XMMS_STREAM_TYPE_FMT_SAMPLERATE);
-	data->channels = xmms_stream_type_get_int (format,
-	                                           XMMS_STREAM_TYPE_FMT_CHANNELS);
+	/* Get this stream's data and have the encoders fired up. */
+	job = xmms_ices_job_new (ICES_JOB_FORMAT);
+	job->rate = xmms_stream_type_get_int (format,
+	                                      XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	job->channels = xmms_stream_type_get_int (format,
+	                                          XMMS_STREAM_TYPE_FMT_CHANNELS);
+	job->tags = xmms_ices_get_tags (xmms_output_current_id (output));
 
 	XMMS_DBG ("Setting format to rate: %i, channels: %i",
-	          data->rate,
-	          data->channels);
+	          job->rate,
+	          job->channels);
 
-	xmms_ices_encoder_stream_change (data->encoder, data->rate, data->channels,
-	                                 &data->vc);
+	xmms_ices_push (data, job);
 
 	return TRUE;
 }
@@ -333,24 +640,40 @@ xmms_ices_write (xmms_output_t *output, gpointer buffer,
                  gint len, xmms_error_t *err)
 {
 	xmms_ices_data_t *data;
+	xmms_ices_job_t *job;
+	gboolean failed = TRUE;
+	GList *n;
+
 	g_return_if_fail (output);
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
-	if (!data->encoder) {
-		xmms_error_set (err, XMMS_ERROR_GENERIC, "encoding is not initialized");
+	g_mutex_lock (data->mutex);
+	for (n = data->variants; n; n = g_list_next (n)) {
+		failed = failed && ((xmms_ices_variant_t *) n->data)->failed;
+	}
+	g_mutex_unlock (data->mutex);
+
+	/* keep going as long as one of the mounts still works */
+	if (failed) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC,
+		                "Error when sending data to icecast server");
 		return;
 	}
 
-	xmms_ices_encoder_input (data->encoder, buffer, len);
+	job = xmms_ices_job_new (ICES_JOB_DATA);
+	job->buffer = g_memdup (buffer, len);
+	job->len = len;
 
-	xmms_ices_send_shout (data, err);
+	xmms_ices_push (data, job);
 }
 
-static void
-xmms_ices_update_comment (xmms_medialib_entry_t entry, vorbis_comment *vc)
+/* Returns the vorbis comment tags of the entry as key/value pairs. */
+static gchar **
+xmms_ices_get_tags (xmms_medialib_entry_t entry)
 {
 	xmms_medialib_session_t *session;
+	GPtrArray *tags;
 
 	static const struct {
 		const gchar *prop;
@@ -362,22 +685,25 @@ xmms_ices_update_comment (xmms_medialib_entry_t entry, vorbis_comment *vc)
 		{NULL, NULL}
 	};
 
-	vorbis_comment_clear (vc);
-	vorbis_comment_init (vc);
+	tags = g_ptr_array_new ();
 
 	session = xmms_medialib_begin ();
 
 	for (pptr = props; pptr && pptr->prop; pptr++) {
-		const gchar *tmp;
+		gchar *tmp;
 
 		tmp = xmms_medialib_entry_property_get_str (session, entry, pptr->prop);
 		if (tmp) {
-			vorbis_comment_add_tag (vc, pptr->key, (gchar *) tmp);
+			g_ptr_array_add (tags, g_strdup (pptr->key));
+			g_ptr_array_add (tags, tmp);
 		}
 	}
 
 	xmms_medialib_end (session);
 
+	g_ptr_array_add (tags, NULL);
+
+	return (gchar **) g_ptr_array_free (tags, FALSE);
 }
 
 static void
@@ -385,21 +711,15 @@ on_playlist_entry_changed (xmms_object_t *object, xmmsv_t *arg, gpointer udata)
 {
 	xmms_ices_data_t * data = udata;
 	xmms_medialib_entry_t entry;
+	xmms_ices_job_t *job;
 
 	if (!xmmsv_get_int (arg, &entry))
 		return;
 
-	if (data->encoder)
-		xmms_ices_flush_internal (data);
-
-	vorbis_comment_clear (&data->vc);
-	vorbis_comment_init (&data->vc);
-
-	xmms_ices_update_comment (entry, &data->vc);
-
 	XMMS_DBG ("Updating comment");
 
-	xmms_ices_encoder_stream_change (data->encoder, data->rate, data->channels,
-	                                 &data->vc);
+	job = xmms_ices_job_new (ICES_JOB_COMMENT);
+	job->tags = xmms_ices_get_tags (entry);
 
+	xmms_ices_push (data, job);
 }
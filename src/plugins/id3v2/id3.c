@@ -379,6 +379,7 @@ handle_id3v2_apic (xmms_xform_t *xform, xmms_id3v2_header_t *head,
 {
 	const gchar *enc, *typ, *desc, *data, *mime;
 	gchar hash[33];
+	gint64 offset;
 
 	enc = binary_to_enc (buf[0]);
 	buf++;
@@ -397,7 +398,17 @@ handle_id3v2_apic (xmms_xform_t *xform, xmms_id3v2_header_t *head,
 	/* XXX desc might be UCS2 and find_nul will not do what we want */
 	data = find_nul (desc, &len);
 
-	if (data && xmms_bindata_plugin_add ((const guchar *)data, len, hash)) {
+	if (!data)
+		return;
+
+	offset = -1;
+	if (head->offset >= 0) {
+		offset = head->offset + ((const guchar *) data - head->buf);
+	}
+
+	if (xmms_bindata_plugin_add_lazy ((const guchar *) data, len,
+	                                  xmms_xform_get_url (xform),
+	                                  offset, hash)) {
 		const gchar *metakey;
 
 		metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_PICTURE_FRONT;
@@ -563,6 +574,8 @@ xmms_id3v2_is_header (guchar *buf, xmms_id3v2_header_t *header)
 	header->ver = id3head->ver;
 	header->rev = id3head->rev;
 	header->flags = id3head->flags;
+	header->offset = -1;
+	header->buf = NULL;
 
 	header->len = id3head->size[0] << 21 | id3head->size[1] << 14 |
 	              id3head->size[2] << 7 | id3head->size[3];
@@ -594,8 +607,14 @@ xmms_id3v2_parse (xmms_xform_t *xform,
 		return FALSE;
 	}
 
+	head->buf = buf;
+
 	if (head->flags & ID3v2_HEADER_FLAGS_UNSYNC) {
 		int i, j;
+
+		/* the data no longer matches the file */
+		head->offset = -1;
+
 		XMMS_DBG ("Removing false syncronisations from id3v2 tag");
 		for (i = 0, j = 0; i < len; i++, j++) {
 			buf[i] = buf[j];
@@ -17,6 +17,9 @@ typedef struct xmms_id3v2_header_St {
 	guint8 rev;
 	guint32 flags;
 	guint32 len;
+	/* where the tag data starts in the file, -1 if unknown */
+	gint64 offset;
+	const guchar *buf;
 } xmms_id3v2_header_t;
 
 gboolean xmms_id3v2_is_header (guchar *, xmms_id3v2_header_t *);
@@ -128,6 +128,10 @@ xmms_id3v2_init (xmms_xform_t *xform)
 	/* Total data length is the length of header data plus header bytes */
 	data->len = head.len + 10;
 
+	/* the magic only matches a tag at the start of the stream, which
+	 * is the start of the file unless something is in front of us */
+	head.offset = 10;
+
 	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE;
 	if (xmms_xform_metadata_get_int (xform, metakey, &filesize)) {
 		metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE;
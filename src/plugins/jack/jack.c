@@ -19,6 +19,7 @@
 
 #include <glib.h>
 #include <jack/jack.h>
+#include <jack/ringbuffer.h>
 
 
 /*
@@ -28,6 +29,16 @@
 /* this isn't really what we want... */
 #define CHANNELS 2
 
+#define FRAME_SIZE (CHANNELS * sizeof (xmms_samplefloat_t))
+
+/* States of a flush of the ring. The feeder stops writing before the
+ * process callback empties it, so nothing read from the output before
+ * the flush can end up behind it.
+ */
+#define FLUSH_NONE 0
+#define FLUSH_REQUESTED 1
+#define FLUSH_FEEDER_STOPPED 2
+
 
 /*
  * Type definitions
@@ -43,6 +54,21 @@ typedef struct xmms_jack_data_St {
 	guint underruns;
 	guint volume[2];
 	gfloat volume_actual[2];
+
+	/* With the feeder, the process callback never touches the output.
+	 * The feeder thread moves data from the output into the ring and
+	 * the callback takes it from there without locking.
+	 */
+	gboolean use_feeder;
+	GThread *feeder;
+	GMutex *feeder_mutex;
+	GCond *feeder_cond;
+	gboolean feeder_quit;
+	jack_ringbuffer_t *ring;
+	gint ring_periods;
+	gint flush;
+	gint late_callbacks;
+	jack_time_t last_callback;
 } xmms_jack_data_t;
 
 
@@ -58,6 +84,8 @@ static void xmms_jack_flush (xmms_output_t *output);
 static gboolean xmms_jack_volume_set (xmms_output_t *output, const gchar *channel, guint volume);
 static gboolean xmms_jack_volume_get (xmms_output_t *output, const gchar **names, guint *values, guint *num_channels);
 static int xmms_jack_process (jack_nframes_t frames, void *arg);
+static int xmms_jack_process_ring (jack_nframes_t frames, void *arg);
+static gpointer xmms_jack_feeder (gpointer arg);
 static void xmms_jack_shutdown (void *arg);
 static void xmms_jack_error (const gchar *desc);
 
@@ -95,6 +123,14 @@ xmms_jack_plugin_setup (xmms_output_plugin_t *plugin)
 	xmms_output_plugin_config_property_register (plugin, "volume.right", "100",
 	                                             NULL, NULL);
 
+	/* feed the process callback from a ring instead of the output */
+	xmms_output_plugin_config_property_register (plugin, "feeder", "1",
+	                                             NULL, NULL);
+
+	/* size of the ring, in jack periods */
+	xmms_output_plugin_config_property_register (plugin, "ringperiods", "4",
+	                                             NULL, NULL);
+
 	jack_set_error_function (xmms_jack_error);
 
 	return TRUE;
@@ -121,7 +157,9 @@ xmms_jack_connect (xmms_output_t *output, xmms_jack_data_t *data)
 		return FALSE;
 	}
 
-	jack_set_process_callback (data->jack, xmms_jack_process, output);
+	jack_set_process_callback (data->jack, data->use_feeder ?
+	                           xmms_jack_process_ring : xmms_jack_process,
+	                           output);
 	jack_on_shutdown (data->jack, xmms_jack_shutdown, output);
 
 
@@ -136,6 +174,14 @@ xmms_jack_connect (xmms_output_t *output, xmms_jack_data_t *data)
 
 	data->chunksiz = jack_get_buffer_size (data->jack);
 
+	/* the feeder may be using the ring already when reconnecting */
+	if (data->use_feeder && !data->ring) {
+		data->ring = jack_ringbuffer_create (data->ring_periods *
+		                                     data->chunksiz * FRAME_SIZE);
+		jack_ringbuffer_mlock (data->ring);
+		data->last_callback = 0;
+	}
+
 	if (jack_activate (data->jack)) {
 		/* jadda jadda */
 		return FALSE;
@@ -169,12 +215,24 @@ xmms_jack_new (xmms_output_t *output)
 	data->volume_actual[1] = (gfloat)(data->volume[1] / 100.0);
 	data->volume_actual[1] *= data->volume_actual[1];
 
+	cv = xmms_output_config_lookup (output, "feeder");
+	data->use_feeder = !!xmms_config_property_get_int (cv);
+
+	cv = xmms_output_config_lookup (output, "ringperiods");
+	data->ring_periods = MAX (xmms_config_property_get_int (cv), 2);
+
 	xmms_output_private_data_set (output, data);
 
 	if (!xmms_jack_connect (output, data)) {
 		return FALSE;
 	}
 
+	if (data->use_feeder) {
+		data->feeder_mutex = g_mutex_new ();
+		data->feeder_cond = g_cond_new ();
+		data->feeder = g_thread_create (xmms_jack_feeder, output, TRUE, NULL);
+	}
+
 	xmms_output_format_add (output, XMMS_SAMPLE_FORMAT_FLOAT, CHANNELS,
 	                        jack_get_sample_rate (data->jack));
 
@@ -194,11 +252,29 @@ xmms_jack_destroy (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
+	if (data->feeder) {
+		g_mutex_lock (data->feeder_mutex);
+		data->feeder_quit = TRUE;
+		g_cond_signal (data->feeder_cond);
+		g_mutex_unlock (data->feeder_mutex);
+
+		g_thread_join (data->feeder);
+	}
+
 	if (data->jack) {
 		jack_deactivate (data->jack);
 		jack_client_close (data->jack);
 	}
 
+	if (data->feeder) {
+		g_mutex_free (data->feeder_mutex);
+		g_cond_free (data->feeder_cond);
+	}
+
+	if (data->ring) {
+		jack_ringbuffer_free (data->ring);
+	}
+
 	g_free (data);
 }
 
@@ -262,6 +338,12 @@ xmms_jack_status (xmms_output_t *output, xmms_playback_status_t status)
 		data->running = FALSE;
 	}
 
+	if (data->feeder) {
+		g_mutex_lock (data->feeder_mutex);
+		g_cond_signal (data->feeder_cond);
+		g_mutex_unlock (data->feeder_mutex);
+	}
+
 	return TRUE;
 }
 
@@ -269,7 +351,159 @@ xmms_jack_status (xmms_output_t *output, xmms_playback_status_t status)
 static void
 xmms_jack_flush (xmms_output_t *output)
 {
-	/* do nothing... */
+	xmms_jack_data_t *data;
+
+	g_return_if_fail (output);
+	data = xmms_output_private_data_get (output);
+	g_return_if_fail (data);
+
+	/* only the reading side may empty the ring, leave it to the
+	 * process callback
+	 */
+	if (data->ring) {
+		g_atomic_int_compare_and_exchange (&data->flush, FLUSH_NONE,
+		                                   FLUSH_REQUESTED);
+	}
+}
+
+
+/**
+ * Move what the output has into the ring, publish the counters of the
+ * process callback, and sleep until the callback has made room.
+ */
+static gpointer
+xmms_jack_feeder (gpointer arg)
+{
+	xmms_output_t *output = (xmms_output_t *) arg;
+	xmms_jack_data_t *data;
+	gchar buf[CHANNELS * 4096 * sizeof (xmms_samplefloat_t)];
+	GTimeVal timeout;
+	gint len, res;
+
+	data = xmms_output_private_data_get (output);
+
+	g_mutex_lock (data->feeder_mutex);
+
+	while (!data->feeder_quit) {
+		g_mutex_unlock (data->feeder_mutex);
+
+		xmms_output_stats_set (output, "jack.underruns",
+		                       g_atomic_int_get ((gint *) &data->underruns));
+		xmms_output_stats_set (output, "jack.late_callbacks",
+		                       g_atomic_int_get (&data->late_callbacks));
+
+		/* whatever we wrote before this point is still ahead of the
+		 * read pointer, the callback empties the ring after this */
+		g_atomic_int_compare_and_exchange (&data->flush, FLUSH_REQUESTED,
+		                                   FLUSH_FEEDER_STOPPED);
+
+		len = 0;
+		if (data->running && !g_atomic_int_get (&data->flush)) {
+			/* only ask for what is there, so we never block on the output */
+			len = MIN (jack_ringbuffer_write_space (data->ring),
+			           xmms_output_bytes_available (output));
+			len = MIN (len, sizeof (buf));
+			len -= len % FRAME_SIZE;
+		}
+
+		if (len > 0) {
+			res = xmms_output_read (output, buf, len);
+
+			/* flushed while we were reading, the data is stale. If the
+			 * flush comes in after this check, the write is still
+			 * ahead of the callback emptying the ring */
+			if (res > 0 && !g_atomic_int_get (&data->flush)) {
+				jack_ringbuffer_write (data->ring, buf, res);
+			}
+		}
+
+		g_mutex_lock (data->feeder_mutex);
+
+		if (len <= 0 && !data->feeder_quit) {
+			/* woken up by the process callback after each period */
+			g_get_current_time (&timeout);
+			g_time_val_add (&timeout, 20000);
+			g_cond_timed_wait (data->feeder_cond, data->feeder_mutex, &timeout);
+		}
+	}
+
+	g_mutex_unlock (data->feeder_mutex);
+
+	return NULL;
+}
+
+
+/**
+ * Process callback used with the feeder. It doesn't lock, allocate or
+ * wait, at worst it plays silence.
+ */
+static int
+xmms_jack_process_ring (jack_nframes_t frames, void *arg)
+{
+	xmms_output_t *output = (xmms_output_t*) arg;
+	xmms_jack_data_t *data;
+	xmms_samplefloat_t *buf[CHANNELS];
+	xmms_samplefloat_t *src;
+	jack_ringbuffer_data_t vec[2];
+	jack_time_t now, period;
+	gint i, j, k, n, done = 0;
+
+	data = xmms_output_private_data_get (output);
+
+	for (i = 0; i < CHANNELS; i++) {
+		buf[i] = jack_port_get_buffer (data->ports[i], frames);
+	}
+
+	/* count cycles that started well after the previous one */
+	now = jack_get_time ();
+	period = (jack_time_t) frames * 1000000 / jack_get_sample_rate (data->jack);
+	if (data->last_callback && now - data->last_callback > period + period / 2) {
+		g_atomic_int_inc (&data->late_callbacks);
+	}
+	data->last_callback = now;
+
+	if (g_atomic_int_get (&data->flush) == FLUSH_FEEDER_STOPPED) {
+		jack_ringbuffer_read_advance (data->ring,
+		                              jack_ringbuffer_read_space (data->ring));
+		g_atomic_int_compare_and_exchange (&data->flush, FLUSH_FEEDER_STOPPED,
+		                                   FLUSH_NONE);
+	}
+
+	if (data->running) {
+		jack_ringbuffer_get_read_vector (data->ring, vec);
+
+		for (k = 0; k < 2 && done < frames; k++) {
+			src = (xmms_samplefloat_t *) vec[k].buf;
+			n = MIN (vec[k].len / FRAME_SIZE, frames - done);
+
+			for (i = 0; i < n; i++) {
+				for (j = 0; j < CHANNELS; j++) {
+					buf[j][done + i] = src[i * CHANNELS + j] * data->volume_actual[j];
+				}
+			}
+			done += n;
+		}
+
+		jack_ringbuffer_read_advance (data->ring, done * FRAME_SIZE);
+
+		if (done < frames) {
+			g_atomic_int_inc ((gint *) &data->underruns);
+		}
+
+		/* never block here, the feeder wakes up on its own too */
+		if (g_mutex_trylock (data->feeder_mutex)) {
+			g_cond_signal (data->feeder_cond);
+			g_mutex_unlock (data->feeder_mutex);
+		}
+	}
+
+	for (i = done; i < frames; i++) {
+		for (j = 0; j < CHANNELS; j++) {
+			buf[j][i] = 0.0;
+		}
+	}
+
+	return 0;
 }
 
 
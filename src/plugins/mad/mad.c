@@ -39,6 +39,11 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+/* how far before the target a seek through the index starts decoding,
+ * the first frames after a seek lack their bit reservoir
+ */
+#define XMMS_MAD_PRESEEK_SAMPLES (3 * 1152)
+
 /*
  * Type definitions
  */
@@ -60,6 +65,14 @@ typedef struct xmms_mad_data_St {
 	gint64 samples_to_play;
 	gint frames_to_skip;
 
+	/* input offset of buffer[0] */
+	gint64 stream_pos;
+	/* samples in the frames before the next one, -1 if unknown */
+	gint64 frame_sample;
+	/* frame samples before the first output sample */
+	gint64 skip_base;
+	gint64 samples_total;
+
 	xmms_xing_t *xing;
 } xmms_mad_data_t;
 
@@ -145,18 +158,58 @@ xmms_mad_destroy (xmms_xform_t *xform)
 
 }
 
+static void
+xmms_mad_buffer_reset (xmms_mad_data_t *data, gint64 pos)
+{
+	data->buffer_length = 0;
+	data->stream_pos = pos;
+	data->synthpos = 0x7fffffff;
+
+	mad_stream_buffer (&data->stream, data->buffer, 0);
+	mad_frame_mute (&data->frame);
+	mad_synth_mute (&data->synth);
+}
+
 static gint64
 xmms_mad_seek (xmms_xform_t *xform, gint64 samples, xmms_xform_seek_mode_t whence, xmms_error_t *err)
 {
 	xmms_mad_data_t *data;
 	guint bytes;
-	gint64 res;
+	gint64 res, target, found, offset;
 
 	g_return_val_if_fail (whence == XMMS_XFORM_SEEK_SET, -1);
 	g_return_val_if_fail (xform, -1);
 
 	data = xmms_xform_private_data_get (xform);
 
+	/* if this part of the file has been decoded before we know
+	 * where its frames are and can seek with sample accuracy
+	 */
+	target = samples + data->skip_base;
+	if (xmms_xform_seek_index_lookup (xform,
+	                                  MAX (target - XMMS_MAD_PRESEEK_SAMPLES, 0),
+	                                  &found, &offset)) {
+		XMMS_DBG ("Seek %" G_GINT64_FORMAT " samples -> %" G_GINT64_FORMAT
+		          " bytes (indexed)", samples, offset);
+
+		res = xmms_xform_seek (xform, offset, XMMS_XFORM_SEEK_SET, err);
+		if (res == -1) {
+			return -1;
+		}
+
+		xmms_mad_buffer_reset (data, res);
+		data->frame_sample = found;
+		data->frames_to_skip = 0;
+		data->samples_to_skip = target - found;
+		if (data->samples_total >= 0) {
+			data->samples_to_play = MAX (data->samples_total - samples, 0);
+		} else {
+			data->samples_to_play = -1;
+		}
+
+		return samples;
+	}
+
 	if (data->xing &&
 	    xmms_xing_has_flag (data->xing, XMMS_XING_FRAMES) &&
 	    xmms_xing_has_flag (data->xing, XMMS_XING_TOC)) {
@@ -176,8 +229,11 @@ xmms_mad_seek (xmms_xform_t *xform, gint64 samples, xmms_xform_seek_mode_t whenc
 		return -1;
 	}
 
+	xmms_mad_buffer_reset (data, res);
+
 	/* we don't have sample accuracy when seeking,
 	   so there is no use trying */
+	data->frame_sample = -1;
 	data->samples_to_skip = 0;
 	data->samples_to_play = -1;
 
@@ -237,6 +293,7 @@ xmms_mad_init (xmms_xform_t *xform)
 	}
 
 	data->samples_to_play = -1;
+	data->samples_total = -1;
 
 	data->xing = xmms_xing_parse (stream.anc_ptr);
 	if (data->xing) {
@@ -276,6 +333,8 @@ xmms_mad_init (xmms_xform_t *xform)
 			data->samples_to_skip = lame->start_delay;
 			data->samples_to_play = ((guint64) xmms_xing_get_frames (data->xing) * 1152ULL) -
 			                        lame->start_delay - lame->end_padding;
+			data->samples_total = data->samples_to_play;
+			data->skip_base = 32 * MAD_NSBSAMPLES (&frame.header) + lame->start_delay;
 			XMMS_DBG ("Samples to skip in the beginning: %d, total: %" G_GINT64_FORMAT,
 			          data->samples_to_skip, data->samples_to_play);
 			/*
@@ -383,6 +442,13 @@ xmms_mad_read (xmms_xform_t *xform, gpointer buf, gint len, xmms_error_t *err)
 		/* then try to decode another frame */
 		if (mad_frame_decode (&data->frame, &data->stream) != -1) {
 
+			if (data->frame_sample >= 0) {
+				xmms_xform_seek_index_add (xform, data->frame_sample,
+				                           data->stream_pos +
+				                           (data->stream.this_frame - data->buffer));
+				data->frame_sample += 32 * MAD_NSBSAMPLES (&data->frame.header);
+			}
+
 			/* mad_synthpop_frame - go Depeche! */
 			mad_synth_frame (&data->synth, &data->frame);
 
@@ -411,11 +477,24 @@ xmms_mad_read (xmms_xform_t *xform, gpointer buf, gint len, xmms_error_t *err)
 			continue;
 		}
 
+		/* right after a seek frames can lack their bit reservoir,
+		 * they still take up their samples in the stream
+		 */
+		if (data->stream.error == MAD_ERROR_BADDATAPTR) {
+			gint n = 32 * MAD_NSBSAMPLES (&data->frame.header);
+
+			if (data->frame_sample >= 0) {
+				data->frame_sample += n;
+			}
+			data->samples_to_skip = MAX (data->samples_to_skip - n, 0);
+			continue;
+		}
 
 		/* if there is no frame to decode stream more data */
 		if (data->stream.next_frame) {
 			guchar *buffer = data->buffer;
 			const guchar *nf = data->stream.next_frame;
+			data->stream_pos += nf - buffer;
 			memmove (data->buffer, data->stream.next_frame,
 			         data->buffer_length = (&buffer[data->buffer_length] - nf));
 		}
@@ -341,7 +341,10 @@ xmms_mp4_get_mediainfo (xmms_xform_t *xform)
 	if ((temp = mp4ff_meta_get_coverart (data->mp4ff, &metabuf))) {
 		gchar hash[33];
 
-		if (xmms_bindata_plugin_add ((guchar *) metabuf, temp, hash)) {
+		if (xmms_bindata_plugin_add_lazy ((guchar *) metabuf, temp,
+		                                  xmms_xform_get_url (xform),
+		                                  mp4ff_meta_get_coverart_offset (data->mp4ff),
+		                                  hash)) {
 			metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_PICTURE_FRONT;
 			xmms_xform_metadata_set_str (xform, metakey, hash);
 
@@ -112,6 +112,7 @@ int mp4ff_meta_get_totaldiscs(const mp4ff_t *f, char **value);
 int mp4ff_meta_get_compilation(const mp4ff_t *f, char **value);
 int mp4ff_meta_get_tempo(const mp4ff_t *f, char **value);
 int32_t mp4ff_meta_get_coverart(const mp4ff_t *f, char **value);
+int64_t mp4ff_meta_get_coverart_offset(const mp4ff_t *f);
 
 /* metadata tag structure */
 typedef struct
@@ -119,6 +120,7 @@ typedef struct
     char *item;
     char *value;
     uint32_t value_length;
+    int64_t value_offset; /* position in the stream, -1 if unknown */
 } mp4ff_tag_t;
 
 /* metadata list structure */
@@ -155,6 +155,7 @@ typedef struct
     char *item;
     char *value;
     uint32_t value_length;
+    int64_t value_offset; /* position in the stream, -1 if unknown */
 } mp4ff_tag_t;
 
 /* metadata list structure */
@@ -311,6 +312,7 @@ int32_t mp4ff_meta_get_disc(const mp4ff_t *f, char **value);
 int32_t mp4ff_meta_get_compilation(const mp4ff_t *f, char **value);
 int32_t mp4ff_meta_get_tempo(const mp4ff_t *f, char **value);
 int32_t mp4ff_meta_get_coverart(const mp4ff_t *f, char **value);
+int64_t mp4ff_meta_get_coverart_offset(const mp4ff_t *f);
 #endif
 
 /* mp4ff.c */
@@ -57,6 +57,7 @@ int32_t mp4ff_tag_add_field_len(mp4ff_metadata_t *tags, const char *item, const
         tags->tags[tags->count].value[valuelen] = '\0';
 
         tags->tags[tags->count].value_length = valuelen;
+        tags->tags[tags->count].value_offset = -1;
 
         if (!tags->tags[tags->count].item || !tags->tags[tags->count].value)
         {
@@ -239,6 +240,7 @@ int32_t mp4ff_parse_tag(mp4ff_t *f, const uint8_t parent_atom_type, const int32_
     char * name = NULL;
 	char * data = NULL;
 	uint32_t datalen = 0;
+	int64_t dataoffset = -1;
 	uint32_t done = 0;
 
 
@@ -308,6 +310,7 @@ int32_t mp4ff_parse_tag(mp4ff_t *f, const uint8_t parent_atom_type, const int32_
 				} else
 				{
 					if (data) {free(data);data = NULL;}
+					dataoffset = mp4ff_position(f);
 					data = mp4ff_read_string(f,(uint32_t)(subsize-(header_size+8)));
 					datalen = (uint32_t)(subsize-(header_size+8));
 				}
@@ -330,7 +333,8 @@ int32_t mp4ff_parse_tag(mp4ff_t *f, const uint8_t parent_atom_type, const int32_
 		if (!done)
 		{
 			if (name == NULL) mp4ff_set_metadata_name(f, parent_atom_type, &name);
-			if (name) mp4ff_tag_add_field_len(&(f->tags), name, data, datalen);
+			if (name && mp4ff_tag_add_field_len(&(f->tags), name, data, datalen))
+				f->tags.tags[f->tags.count-1].value_offset = dataoffset;
 		}
 
 		free(data);
@@ -478,4 +482,18 @@ int32_t mp4ff_meta_get_coverart(const mp4ff_t *f, char **value)
     return mp4ff_meta_find_by_name(f, "cover", value);
 }
 
+/* where the cover art is stored in the stream, -1 if unknown */
+int64_t mp4ff_meta_get_coverart_offset(const mp4ff_t *f)
+{
+    uint32_t i;
+
+    for (i = 0; i < f->tags.count; i++)
+    {
+        if (!stricmp(f->tags.tags[i].item, "cover"))
+            return f->tags.tags[i].value_offset;
+    }
+
+    return -1;
+}
+
 #endif
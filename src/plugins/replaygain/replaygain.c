@@ -22,6 +22,7 @@
 #include "xmms/xmms_xformplugin.h"
 #include "xmms/xmms_config.h"
 #include "xmms/xmms_log.h"
+#include "xmms/xmms_medialib.h"
 
 #include <math.h>
 #include <glib.h>
@@ -64,6 +65,7 @@ static const xmms_sample_format_t formats[] = {
 static gboolean xmms_replaygain_plugin_setup (xmms_xform_plugin_t *xform_plugin);
 static gboolean xmms_replaygain_init (xmms_xform_t *xform);
 static void xmms_replaygain_destroy (xmms_xform_t *xform);
+static gboolean xmms_replaygain_reinit (xmms_xform_t *xform);
 static gint xmms_replaygain_read (xmms_xform_t *xform, xmms_sample_t *buf,
                                   gint len, xmms_error_t *error);
 static gint64 xmms_replaygain_seek (xmms_xform_t *xform, gint64 samples,
@@ -71,6 +73,7 @@ static gint64 xmms_replaygain_seek (xmms_xform_t *xform, gint64 samples,
                                     xmms_error_t *error);
 static void xmms_replaygain_config_changed (xmms_object_t *obj, xmmsv_t *_val, gpointer udata);
 
+static gboolean get_value (xmms_xform_t *xform, const gchar *key, gfloat *value);
 static void compute_gain (xmms_xform_t *xform, xmms_replaygain_data_t *data);
 static xmms_replaygain_mode_t parse_mode (const char *s);
 
@@ -105,6 +108,7 @@ xmms_replaygain_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.destroy = xmms_replaygain_destroy;
 	methods.read = xmms_replaygain_read;
 	methods.seek = xmms_replaygain_seek;
+	methods.reinit = xmms_replaygain_reinit;
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -241,6 +245,22 @@ xmms_replaygain_destroy (xmms_xform_t *xform)
 	                                      xmms_replaygain_config_changed, xform);
 }
 
+/* the gain is per entry */
+static gboolean
+xmms_replaygain_reinit (xmms_xform_t *xform)
+{
+	xmms_replaygain_data_t *data;
+
+	g_return_val_if_fail (xform, FALSE);
+
+	data = xmms_xform_private_data_get (xform);
+	g_return_val_if_fail (data, FALSE);
+
+	compute_gain (xform, data);
+
+	return TRUE;
+}
+
 static gint
 xmms_replaygain_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
                       xmms_error_t *error)
@@ -310,31 +330,56 @@ xmms_replaygain_config_changed (xmms_object_t *obj, xmmsv_t *_val, gpointer udat
 	}
 }
 
-static void
-compute_gain (xmms_xform_t *xform, xmms_replaygain_data_t *data)
+/* The medialib has what the server measured, and otherwise what was
+ * read from the tags the last time. The metadata of this chain covers
+ * entries that were never in the medialib.
+ */
+static gboolean
+get_value (xmms_xform_t *xform, const gchar *key, gfloat *value)
 {
-	gfloat s, p;
-	const gchar *key_s, *key_p, *tmp;
-
-	if (data->mode == XMMS_REPLAYGAIN_MODE_TRACK) {
-		key_s = XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_TRACK;
-		key_p = XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_TRACK;
-	} else {
-		key_s = XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_ALBUM;
-		key_p = XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_ALBUM;
+	xmms_medialib_session_t *session;
+	const gchar *tmp;
+	gchar *str;
+
+	session = xmms_medialib_begin ();
+	str = xmms_medialib_entry_property_get_str (session,
+	                                            xmms_xform_entry_get (xform),
+	                                            key);
+	xmms_medialib_end (session);
+
+	if (str) {
+		*value = atof (str);
+		g_free (str);
+		return TRUE;
 	}
 
-	/** @todo should this be ints instead? */
-	if (xmms_xform_metadata_get_str (xform, key_s, &tmp)) {
-		s = atof (tmp);
-	} else {
-		s = 1.0;
+	if (xmms_xform_metadata_get_str (xform, key, &tmp)) {
+		*value = atof (tmp);
+		return TRUE;
 	}
 
-	if (xmms_xform_metadata_get_str (xform, key_p, &tmp)) {
-		p = atof (tmp);
+	return FALSE;
+}
+
+static void
+compute_gain (xmms_xform_t *xform, xmms_replaygain_data_t *data)
+{
+	gfloat s, p;
+
+	/* tracks that are not on an album only have track gain */
+	if (data->mode == XMMS_REPLAYGAIN_MODE_ALBUM &&
+	    get_value (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_ALBUM, &s)) {
+		if (!get_value (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_ALBUM, &p)) {
+			p = 1.0;
+		}
 	} else {
-		p = 1.0;
+		/** @todo should this be ints instead? */
+		if (!get_value (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_TRACK, &s)) {
+			s = 1.0;
+		}
+		if (!get_value (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_TRACK, &p)) {
+			p = 1.0;
+		}
 	}
 
 	s *= data->preamp;
@@ -319,7 +319,8 @@ handle_image_comment (xmms_xform_t *xform, const gchar *encoded_value)
 		goto finish;
 	}
 
-	if (xmms_bindata_plugin_add (img_data, img_len, hash)) {
+	/* base64 encoded in the comment, so it can't be read back */
+	if (xmms_bindata_plugin_add_lazy (img_data, img_len, NULL, -1, hash)) {
 		const gchar *metakey;
 
 		metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_PICTURE_FRONT;
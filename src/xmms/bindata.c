@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <errno.h>
 
 #include "xmmsc/xmmsc_idnumbers.h"
@@ -35,11 +36,69 @@
 #include "xmmspriv/xmms_playlist.h"
 #include "xmmspriv/xmms_config.h"
 #include "xmmspriv/xmms_bindata.h"
+#include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_utils.h"
 
+/** Largest share of the cache a single file may take */
+#define XMMS_BINDATA_CACHE_MAX_SHARE 4
+
+/** Bytes hashed at the start, middle and end of a picture */
+#define XMMS_BINDATA_SAMPLE_SIZE 4096
+
+/** Other files remembered for a picture that is not extracted yet */
+#define XMMS_BINDATA_MAX_FALLBACKS 4
+
+typedef struct xmms_bindata_blob_St {
+	gchar *hash;
+	guchar *data;
+	gsize len;
+} xmms_bindata_blob_t;
+
+typedef struct xmms_bindata_location_St {
+	gchar *url;
+	gint64 offset;
+} xmms_bindata_location_t;
+
+/* A picture embedded in a media file. While url is set the picture
+ * has not been written to the bindir yet, and is read from offset in
+ * that file when a client asks for it. Other files found to embed it
+ * are kept in fallbacks, in case the first one goes away.
+ */
+typedef struct xmms_bindata_picture_St {
+	gchar *fingerprint;
+	gchar hash[33];
+	gchar *url;
+	gint64 offset;
+	gsize len;
+	GSList *fallbacks;
+} xmms_bindata_picture_t;
+
 struct xmms_bindata_St {
 	xmms_object_t obj;
 	const gchar *bindir;
+
+	/** Protects the index and the cache */
+	GMutex *mutex;
+
+	/** Size and fast hash -> md5 of the data added since startup */
+	GHashTable *index;
+
+	/** Fingerprint -> embedded picture, kept in picturefile */
+	GHashTable *pictures;
+	/** md5 -> embedded picture not extracted yet */
+	GHashTable *pending;
+	gchar *picturefile;
+	/** Lines in picturefile, overridden ones included */
+	guint picture_lines;
+
+	/** md5 -> link in the lru queue */
+	GHashTable *cache;
+	/** Cached files, most recently used first */
+	GQueue *lru;
+	gsize cache_used;
+	gsize cache_size;
+	/** Bumped by every removal, so reads racing one don't cache */
+	guint removals;
 };
 
 static xmms_bindata_t *global_bindata;
@@ -62,9 +121,13 @@ static void md5_append (md5_state_t *pms, const md5_byte_t *data, int nbytes);
 static void md5_finish (md5_state_t *pms, md5_byte_t digest[16]);
 
 static gchar *xmms_bindata_build_path (xmms_bindata_t *bindata, const gchar *hash);
+static void xmms_bindata_picture_free (xmms_bindata_picture_t *picture);
+static void xmms_bindata_pictures_load (xmms_bindata_t *bindata);
+static void xmms_bindata_pictures_save (xmms_bindata_t *bindata);
 
 static gchar *xmms_bindata_client_add (xmms_bindata_t *bindata, GString *data, xmms_error_t *err);
 static xmmsv_t *xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash, xmms_error_t *err);
+static xmmsv_t *xmms_bindata_client_retrieve_range (xmms_bindata_t *bindata, const gchar *hash, gint32 offset, gint32 length, xmms_error_t *err);
 static void xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash, xmms_error_t *);
 static GList *xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err);
 static gboolean _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar hash[33], xmms_error_t *err);
@@ -88,21 +151,276 @@ xmms_bindata_init ()
 
 	obj->bindir = xmms_config_property_get_string (cv);
 
+	cv = xmms_config_property_register ("bindata.cache_size", "8388608",
+	                                    NULL, NULL);
+	obj->cache_size = MAX (0, xmms_config_property_get_int (cv));
+
+	obj->mutex = g_mutex_new ();
+	obj->index = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                    g_free, g_free);
+	obj->cache = g_hash_table_new (g_str_hash, g_str_equal);
+	obj->lru = g_queue_new ();
+	obj->pictures = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                                       (GDestroyNotify) xmms_bindata_picture_free);
+	obj->pending = g_hash_table_new (g_str_hash, g_str_equal);
+
 	if (!g_file_test (obj->bindir, G_FILE_TEST_IS_DIR)) {
 		if (g_mkdir_with_parents (obj->bindir, 0755) == -1) {
 			xmms_log_error ("Couldn't create bindir %s", obj->bindir);
 		}
 	}
 
+	/* not a valid hash, so it can't clash with the stored files */
+	obj->picturefile = g_build_filename (obj->bindir, ".pictures", NULL);
+	xmms_bindata_pictures_load (obj);
+
 	global_bindata = obj;
 
 	return obj;
 }
 
+static void
+xmms_bindata_blob_free (xmms_bindata_blob_t *blob)
+{
+	g_free (blob->hash);
+	g_free (blob->data);
+	g_free (blob);
+}
+
+static xmms_bindata_location_t *
+xmms_bindata_location_new (const gchar *url, gint64 offset)
+{
+	xmms_bindata_location_t *location;
+
+	location = g_new0 (xmms_bindata_location_t, 1);
+	location->url = g_strdup (url);
+	location->offset = offset;
+
+	return location;
+}
+
+static void
+xmms_bindata_location_free (xmms_bindata_location_t *location)
+{
+	g_free (location->url);
+	g_free (location);
+}
+
+static void
+xmms_bindata_picture_clear_fallbacks (xmms_bindata_picture_t *picture)
+{
+	g_slist_foreach (picture->fallbacks, (GFunc) xmms_bindata_location_free, NULL);
+	g_slist_free (picture->fallbacks);
+	picture->fallbacks = NULL;
+}
+
+static void
+xmms_bindata_picture_free (xmms_bindata_picture_t *picture)
+{
+	xmms_bindata_picture_clear_fallbacks (picture);
+	g_free (picture->fingerprint);
+	g_free (picture->url);
+	g_free (picture);
+}
+
+/* Whether url is already known as a place the picture is stored in. */
+static gboolean
+xmms_bindata_picture_has_url (xmms_bindata_picture_t *picture,
+                              const gchar *url)
+{
+	xmms_bindata_location_t *location;
+	GSList *n;
+
+	if (!strcmp (picture->url, url)) {
+		return TRUE;
+	}
+
+	for (n = picture->fallbacks; n; n = g_slist_next (n)) {
+		location = n->data;
+		if (!strcmp (location->url, url)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Whether url should be remembered as a fallback for a pending
+ * picture. Must be called with the mutex held.
+ */
+static gboolean
+xmms_bindata_picture_wants_fallback (xmms_bindata_picture_t *picture,
+                                     const gchar *url)
+{
+	return url && picture->url &&
+	       g_slist_length (picture->fallbacks) < XMMS_BINDATA_MAX_FALLBACKS &&
+	       !xmms_bindata_picture_has_url (picture, url);
+}
+
 static void
 xmms_bindata_destroy (xmms_object_t *obj)
 {
+	xmms_bindata_t *bindata = (xmms_bindata_t *) obj;
+	xmms_bindata_blob_t *blob;
+
 	xmms_bindata_unregister_ipc_commands ();
+
+	while ((blob = g_queue_pop_head (bindata->lru))) {
+		xmms_bindata_blob_free (blob);
+	}
+
+	g_queue_free (bindata->lru);
+	g_hash_table_destroy (bindata->cache);
+	g_hash_table_destroy (bindata->index);
+	g_hash_table_destroy (bindata->pending);
+	g_hash_table_destroy (bindata->pictures);
+	g_free (bindata->picturefile);
+	g_mutex_free (bindata->mutex);
+}
+
+/* MurmurHash64A by Austin Appleby, placed in the public domain. Much
+ * cheaper than md5, used to recognize data that has been added before.
+ */
+static guint64
+xmms_bindata_fast_hash (const guchar *data, gsize len)
+{
+	const guint64 m = G_GUINT64_CONSTANT (0xc6a4a7935bd1e995);
+	const gint r = 47;
+	const guchar *end;
+	guint64 h, k;
+
+	h = G_GUINT64_CONSTANT (0x8445d61a4e774912) ^ (len * m);
+
+	for (end = data + (len & ~7); data != end; data += 8) {
+		memcpy (&k, data, 8);
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (len & 7) {
+		case 7: h ^= (guint64) data[6] << 48;
+		case 6: h ^= (guint64) data[5] << 40;
+		case 5: h ^= (guint64) data[4] << 32;
+		case 4: h ^= (guint64) data[3] << 24;
+		case 3: h ^= (guint64) data[2] << 16;
+		case 2: h ^= (guint64) data[1] << 8;
+		case 1: h ^= (guint64) data[0];
+		        h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+/* Size and fast hash of the start, middle and end of data. Costs the
+ * same for any size, so rescanning a file with a large picture
+ * doesn't have to look at all of it.
+ */
+static gchar *
+xmms_bindata_fingerprint (const guchar *data, gsize len)
+{
+	const gsize n = XMMS_BINDATA_SAMPLE_SIZE;
+	guint64 h;
+
+	if (len <= 3 * n) {
+		h = xmms_bindata_fast_hash (data, len);
+	} else {
+		h = xmms_bindata_fast_hash (data, n);
+		h = h * 31 + xmms_bindata_fast_hash (data + (len - n) / 2, n);
+		h = h * 31 + xmms_bindata_fast_hash (data + len - n, n);
+	}
+
+	return g_strdup_printf ("%" G_GSIZE_FORMAT ":%016" G_GINT64_MODIFIER "x",
+	                        len, h);
+}
+
+/* Look up a cached file and mark it as recently used. Must be called
+ * with the mutex held.
+ */
+static xmms_bindata_blob_t *
+xmms_bindata_cache_lookup (xmms_bindata_t *bindata, const gchar *hash)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (bindata->cache, hash);
+	if (!link) {
+		return NULL;
+	}
+
+	g_queue_unlink (bindata->lru, link);
+	g_queue_push_head_link (bindata->lru, link);
+
+	return link->data;
+}
+
+static void
+xmms_bindata_cache_remove (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_blob_t *blob;
+	GList *link;
+
+	link = g_hash_table_lookup (bindata->cache, hash);
+	if (!link) {
+		return;
+	}
+
+	blob = link->data;
+
+	g_hash_table_remove (bindata->cache, hash);
+	g_queue_delete_link (bindata->lru, link);
+
+	bindata->cache_used -= blob->len;
+	xmms_bindata_blob_free (blob);
+}
+
+/* Add a file to the cache, evicting the least recently used ones to
+ * make room. Takes ownership of the data. Must be called with the
+ * mutex held.
+ */
+static xmms_bindata_blob_t *
+xmms_bindata_cache_insert (xmms_bindata_t *bindata, const gchar *hash,
+                           guchar *data, gsize len)
+{
+	xmms_bindata_blob_t *blob;
+
+	/* someone else got here first */
+	blob = xmms_bindata_cache_lookup (bindata, hash);
+	if (blob) {
+		g_free (data);
+		return blob;
+	}
+
+	while (bindata->cache_used + len > bindata->cache_size &&
+	       !g_queue_is_empty (bindata->lru)) {
+		blob = g_queue_peek_tail (bindata->lru);
+		xmms_bindata_cache_remove (bindata, blob->hash);
+	}
+
+	blob = g_new0 (xmms_bindata_blob_t, 1);
+	blob->hash = g_strdup (hash);
+	blob->data = data;
+	blob->len = len;
+
+	g_queue_push_head (bindata->lru, blob);
+	g_hash_table_insert (bindata->cache, blob->hash, bindata->lru->head);
+
+	bindata->cache_used += len;
+
+	return blob;
+}
+
+static gboolean
+xmms_bindata_hash_valid (const gchar *hash)
+{
+	return *hash && *hash != '.' && !strchr (hash, G_DIR_SEPARATOR);
 }
 
 gchar *
@@ -134,6 +452,38 @@ xmms_bindata_build_path (xmms_bindata_t *bindata, const gchar *hash)
 	return g_build_path (G_DIR_SEPARATOR_S, bindata->bindir, hash, NULL);
 }
 
+/* Store data under its md5 unless it is there already. */
+static gboolean
+xmms_bindata_write (xmms_bindata_t *bindata, const gchar *hash,
+                    const guchar *data, gsize len, xmms_error_t *err)
+{
+	GError *error = NULL;
+	gchar *path;
+
+	path = xmms_bindata_build_path (bindata, hash);
+
+	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+		XMMS_DBG ("file %s is already in bindata dir", hash);
+	} else {
+		XMMS_DBG ("Creating %s", path);
+
+		/* written to a temporary file and renamed, so readers never
+		 * see a partial file */
+		if (!g_file_set_contents (path, (const gchar *) data, len, &error)) {
+			xmms_log_error ("Couldn't create %s: %s", path, error->message);
+			xmms_error_set (err, XMMS_ERROR_GENERIC,
+			                "Couldn't create file on server!");
+			g_error_free (error);
+			g_free (path);
+			return FALSE;
+		}
+	}
+
+	g_free (path);
+
+	return TRUE;
+}
+
 /** Add binary data from a plugin */
 gboolean
 xmms_bindata_plugin_add (const guchar *data, gsize size, gchar hash[33])
@@ -145,59 +495,416 @@ xmms_bindata_plugin_add (const guchar *data, gsize size, gchar hash[33])
 static gboolean
 _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar hash[33], xmms_error_t *err)
 {
-	const guchar *ptr;
-	gsize left;
-	gchar *path;
-	FILE *fp;
+	const gchar *known;
+	gboolean exists = FALSE;
+	gchar *key, *path;
 
-	xmms_bindata_calculate_md5 (data, len, hash);
+	/* The same cover art is usually added once for every track of an
+	 * album, so remember what we have seen to skip the md5.
+	 */
+	key = g_strdup_printf ("%" G_GSIZE_FORMAT ":%016" G_GINT64_MODIFIER "x",
+	                       len, xmms_bindata_fast_hash (data, len));
 
-	path = xmms_bindata_build_path (bindata, hash);
+	g_mutex_lock (bindata->mutex);
+	known = g_hash_table_lookup (bindata->index, key);
+	if (known) {
+		g_strlcpy (hash, known, 33);
+	}
+	g_mutex_unlock (bindata->mutex);
 
-	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
-		XMMS_DBG ("file %s is already in bindata dir", hash);
+	/* the file may have been deleted behind our back */
+	if (known) {
+		path = xmms_bindata_build_path (bindata, hash);
+		exists = g_file_test (path, G_FILE_TEST_IS_REGULAR);
 		g_free (path);
+	}
+
+	if (exists) {
+		g_free (key);
 		return TRUE;
 	}
 
-	XMMS_DBG ("Creating %s", path);
-	fp = fopen (path, "wb");
+	xmms_bindata_calculate_md5 (data, len, hash);
+
+	if (!xmms_bindata_write (bindata, hash, data, len, err)) {
+		g_free (key);
+		return FALSE;
+	}
+
+	g_mutex_lock (bindata->mutex);
+	g_hash_table_replace (bindata->index, key, g_strdup (hash));
+	g_mutex_unlock (bindata->mutex);
+
+	return TRUE;
+}
+
+/* One line per picture, fallbacks appended as offset and url pairs. */
+static void
+xmms_bindata_picture_write (FILE *fp, xmms_bindata_picture_t *picture)
+{
+	xmms_bindata_location_t *location;
+	GSList *n;
+
+	fprintf (fp, "%s\t%s\t%" G_GINT64_FORMAT "\t%" G_GSIZE_FORMAT "\t%s",
+	         picture->fingerprint, picture->hash, picture->offset,
+	         picture->len, picture->url ? picture->url : "");
+
+	for (n = picture->fallbacks; n; n = g_slist_next (n)) {
+		location = n->data;
+		fprintf (fp, "\t%" G_GINT64_FORMAT "\t%s",
+		         location->offset, location->url);
+	}
+
+	fputc ('\n', fp);
+}
+
+static void
+xmms_bindata_picture_insert (xmms_bindata_t *bindata,
+                             xmms_bindata_picture_t *picture)
+{
+	xmms_bindata_picture_t *old;
+
+	old = g_hash_table_lookup (bindata->pictures, picture->fingerprint);
+	if (old && g_hash_table_lookup (bindata->pending, old->hash) == old) {
+		g_hash_table_remove (bindata->pending, old->hash);
+	}
+
+	g_hash_table_replace (bindata->pictures, picture->fingerprint, picture);
+	if (picture->url) {
+		g_hash_table_replace (bindata->pending, picture->hash, picture);
+	}
+}
+
+/* Rewrite the picture file once most of its lines have been
+ * overridden. Must be called with the mutex held.
+ */
+static void
+xmms_bindata_pictures_compact (xmms_bindata_t *bindata)
+{
+	if (bindata->picture_lines > 2 * g_hash_table_size (bindata->pictures) + 1024) {
+		xmms_bindata_pictures_save (bindata);
+	}
+}
+
+/* Append a picture to the picture file, later lines override earlier
+ * ones. Must be called with the mutex held.
+ */
+static void
+xmms_bindata_picture_save (xmms_bindata_t *bindata,
+                           xmms_bindata_picture_t *picture)
+{
+	FILE *fp;
+
+	fp = fopen (bindata->picturefile, "a");
+	if (!fp) {
+		xmms_log_error ("Couldn't write %s", bindata->picturefile);
+		return;
+	}
+
+	xmms_bindata_picture_write (fp, picture);
+	fclose (fp);
+
+	bindata->picture_lines++;
+	xmms_bindata_pictures_compact (bindata);
+}
+
+/* Rewrite the picture file with only the current pictures. Must be
+ * called with the mutex held.
+ */
+static void
+xmms_bindata_pictures_save (xmms_bindata_t *bindata)
+{
+	xmms_bindata_picture_t *picture;
+	GHashTableIter iter;
+	gchar *tmp;
+	FILE *fp;
+
+	tmp = g_strconcat (bindata->picturefile, ".tmp", NULL);
+
+	fp = fopen (tmp, "w");
 	if (!fp) {
-		xmms_log_error ("Couldn't create %s", path);
-		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't create file on server!");
+		xmms_log_error ("Couldn't write %s", tmp);
+		g_free (tmp);
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, bindata->pictures);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &picture)) {
+		xmms_bindata_picture_write (fp, picture);
+	}
+
+	if (fclose (fp) != 0 || rename (tmp, bindata->picturefile) == -1) {
+		xmms_log_error ("Couldn't write %s", bindata->picturefile);
+		unlink (tmp);
+	} else {
+		bindata->picture_lines = g_hash_table_size (bindata->pictures);
+	}
+
+	g_free (tmp);
+}
+
+static void
+xmms_bindata_pictures_load (xmms_bindata_t *bindata)
+{
+	xmms_bindata_picture_t *picture;
+	xmms_bindata_location_t *location;
+	gchar *contents, **lines, **fields;
+	guint i, j, n;
+
+	if (!g_file_get_contents (bindata->picturefile, &contents, NULL, NULL)) {
+		return;
+	}
+
+	lines = g_strsplit (contents, "\n", 0);
+	g_free (contents);
+
+	for (i = 0; lines[i]; i++) {
+		fields = g_strsplit (lines[i], "\t", 0);
+		n = g_strv_length (fields);
+
+		if (n >= 5 && n % 2 == 1 && strlen (fields[1]) == 32) {
+			picture = g_new0 (xmms_bindata_picture_t, 1);
+			picture->fingerprint = g_strdup (fields[0]);
+			g_strlcpy (picture->hash, fields[1], sizeof (picture->hash));
+			picture->offset = g_ascii_strtoll (fields[2], NULL, 10);
+			picture->len = g_ascii_strtoull (fields[3], NULL, 10);
+			if (*fields[4]) {
+				picture->url = g_strdup (fields[4]);
+			}
+			for (j = 5; picture->url && j < n; j += 2) {
+				location = xmms_bindata_location_new (fields[j + 1],
+				                                      g_ascii_strtoll (fields[j], NULL, 10));
+				picture->fallbacks = g_slist_append (picture->fallbacks, location);
+			}
+
+			xmms_bindata_picture_insert (bindata, picture);
+			bindata->picture_lines++;
+		}
+
+		g_strfreev (fields);
+	}
+
+	g_strfreev (lines);
+
+	xmms_bindata_pictures_compact (bindata);
+}
+
+/* Read len bytes at offset from the local file url points to. */
+static gboolean
+xmms_bindata_read_url (const gchar *url, gint64 offset,
+                       guchar *data, gsize len)
+{
+	gboolean ret;
+	gchar *path;
+	FILE *fp;
+
+	if (!url || offset < 0 || g_ascii_strncasecmp (url, "file://", 7) != 0) {
+		return FALSE;
+	}
+
+	path = g_strdup (url + 7);
+	if (!xmms_medialib_decode_url (path)) {
 		g_free (path);
 		return FALSE;
 	}
 
-	/* write the data to the file */
-	ptr = data;
-	left = len;
+	fp = fopen (path, "rb");
+	g_free (path);
 
-	while (left > 0) {
-		size_t w;
+	if (!fp) {
+		return FALSE;
+	}
 
-		w = fwrite (ptr, 1, left, fp);
-		if (!w && ferror (fp)) {
-			fclose (fp);
-			unlink (path);
+	ret = fseeko (fp, offset, SEEK_SET) == 0 &&
+	      fread (data, 1, len, fp) == len;
 
-			xmms_log_error ("Couldn't write data");
-			xmms_error_set (err, XMMS_ERROR_GENERIC,
-			                "Couldn't write data!");
-			g_free (path);
-			return FALSE;
+	fclose (fp);
+
+	return ret;
+}
+
+/* Check that the ends of data really are at offset in url, so
+ * plugins may guess where a picture is stored.
+ */
+static gboolean
+xmms_bindata_location_valid (const gchar *url, gint64 offset,
+                             const guchar *data, gsize len)
+{
+	guchar buf[XMMS_BINDATA_SAMPLE_SIZE];
+	gsize n;
+
+	n = MIN (len, sizeof (buf));
+
+	return xmms_bindata_read_url (url, offset, buf, n) &&
+	       memcmp (buf, data, n) == 0 &&
+	       xmms_bindata_read_url (url, offset + len - n, buf, n) &&
+	       memcmp (buf, data + len - n, n) == 0;
+}
+
+/**
+ * Add a picture embedded in a media file from a plugin.
+ *
+ * Pictures are recognized by a fingerprint of their size and a few
+ * samples, so when a file is scanned again a known picture costs
+ * neither an md5 nor a write. New pictures are only written to the
+ * bindir once a client retrieves them, read again from url at offset
+ * where they must be stored verbatim. Pass NULL and -1 when they are
+ * not, and the picture is stored right away. A few more files a
+ * pending picture is found in are remembered, to extract it from when
+ * the first one is gone.
+ */
+gboolean
+xmms_bindata_plugin_add_lazy (const guchar *data, gsize size,
+                              const gchar *url, gint64 offset,
+                              gchar hash[33])
+{
+	xmms_bindata_t *bindata = global_bindata;
+	xmms_bindata_picture_t *picture;
+	xmms_bindata_location_t *location;
+	xmms_error_t err;
+	gchar *fingerprint, *path;
+	gboolean fallback = FALSE;
+
+	fingerprint = xmms_bindata_fingerprint (data, size);
+
+	g_mutex_lock (bindata->mutex);
+	picture = g_hash_table_lookup (bindata->pictures, fingerprint);
+	if (picture) {
+		g_strlcpy (hash, picture->hash, 33);
+		fallback = xmms_bindata_picture_wants_fallback (picture, url);
+	}
+	g_mutex_unlock (bindata->mutex);
+
+	/* checked without the mutex, the picture is looked up again after */
+	if (fallback && xmms_bindata_location_valid (url, offset, data, size)) {
+		g_mutex_lock (bindata->mutex);
+		picture = g_hash_table_lookup (bindata->pictures, fingerprint);
+		if (picture && xmms_bindata_picture_wants_fallback (picture, url)) {
+			location = xmms_bindata_location_new (url, offset);
+			picture->fallbacks = g_slist_append (picture->fallbacks, location);
+			xmms_bindata_picture_save (bindata, picture);
 		}
+		g_mutex_unlock (bindata->mutex);
+	}
 
-		left -= w;
-		ptr += w;
+	if (picture) {
+		g_free (fingerprint);
+		return TRUE;
 	}
 
-	fclose (fp);
-	g_free (path);
+	xmms_bindata_calculate_md5 (data, size, hash);
+
+	picture = g_new0 (xmms_bindata_picture_t, 1);
+	picture->fingerprint = fingerprint;
+	g_strlcpy (picture->hash, hash, sizeof (picture->hash));
+	picture->offset = -1;
+	picture->len = size;
+
+	if (xmms_bindata_location_valid (url, offset, data, size)) {
+		path = xmms_bindata_build_path (bindata, hash);
+
+		if (!g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+			picture->url = g_strdup (url);
+			picture->offset = offset;
+		}
+
+		g_free (path);
+	}
+
+	if (!picture->url &&
+	    !xmms_bindata_write (bindata, hash, data, size, &err)) {
+		xmms_bindata_picture_free (picture);
+		return FALSE;
+	}
+
+	g_mutex_lock (bindata->mutex);
+	if (!g_hash_table_lookup (bindata->pictures, picture->fingerprint)) {
+		xmms_bindata_picture_insert (bindata, picture);
+		xmms_bindata_picture_save (bindata, picture);
+		picture = NULL;
+	}
+	g_mutex_unlock (bindata->mutex);
+
+	if (picture) {
+		xmms_bindata_picture_free (picture);
+	}
 
 	return TRUE;
 }
 
+/* Write a pending picture to the bindir, reading it from the first
+ * file or one of the fallbacks that still holds it. When none does the
+ * picture is forgotten, so the next rehash finds it anew.
+ */
+static gboolean
+xmms_bindata_extract (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_picture_t *picture;
+	xmms_bindata_location_t *location;
+	GSList *locations, *n;
+	gboolean ret = FALSE;
+	guchar *data;
+	gchar md5[33];
+	gsize len;
+
+	g_mutex_lock (bindata->mutex);
+	picture = g_hash_table_lookup (bindata->pending, hash);
+	if (!picture) {
+		g_mutex_unlock (bindata->mutex);
+		return FALSE;
+	}
+	locations = g_slist_prepend (NULL, xmms_bindata_location_new (picture->url,
+	                                                               picture->offset));
+	for (n = picture->fallbacks; n; n = g_slist_next (n)) {
+		location = n->data;
+		locations = g_slist_prepend (locations,
+		                             xmms_bindata_location_new (location->url,
+		                                                        location->offset));
+	}
+	locations = g_slist_reverse (locations);
+	len = picture->len;
+	g_mutex_unlock (bindata->mutex);
+
+	data = g_malloc (len);
+
+	for (n = locations; n && !ret; n = g_slist_next (n)) {
+		location = n->data;
+
+		XMMS_DBG ("Extracting %s from %s", hash, location->url);
+
+		if (xmms_bindata_read_url (location->url, location->offset, data, len) &&
+		    !strcmp (xmms_bindata_calculate_md5 (data, len, md5), hash)) {
+			xmms_error_t err;
+			ret = xmms_bindata_write (bindata, hash, data, len, &err);
+		} else {
+			xmms_log_error ("Picture %s is gone from %s", hash, location->url);
+		}
+	}
+
+	g_free (data);
+	g_slist_foreach (locations, (GFunc) xmms_bindata_location_free, NULL);
+	g_slist_free (locations);
+
+	g_mutex_lock (bindata->mutex);
+	picture = g_hash_table_lookup (bindata->pending, hash);
+	if (picture) {
+		g_hash_table_remove (bindata->pending, hash);
+		if (ret) {
+			g_free (picture->url);
+			picture->url = NULL;
+			picture->offset = -1;
+			xmms_bindata_picture_clear_fallbacks (picture);
+			xmms_bindata_picture_save (bindata, picture);
+		} else {
+			g_hash_table_remove (bindata->pictures, picture->fingerprint);
+			xmms_bindata_pictures_save (bindata);
+		}
+	}
+	g_mutex_unlock (bindata->mutex);
+
+	return ret;
+}
+
 char *
 xmms_bindata_client_add (xmms_bindata_t *bindata, GString *data, xmms_error_t *err)
 {
@@ -208,17 +915,57 @@ xmms_bindata_client_add (xmms_bindata_t *bindata, GString *data, xmms_error_t *e
 }
 
 static xmmsv_t *
-xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash,
-                              xmms_error_t *err)
+xmms_bindata_slice (const guchar *data, gsize len, gsize offset, gssize length)
+{
+	offset = MIN (offset, len);
+
+	if (length < 0 || (gsize) length > len - offset) {
+		length = len - offset;
+	}
+
+	return xmmsv_new_bin (data + offset, length);
+}
+
+/* Read length bytes at offset from a file, or all of it if length is
+ * negative. Files small enough to be cached are read completely and
+ * kept around, so retrieving them in chunks only reads them once.
+ */
+static xmmsv_t *
+xmms_bindata_read (xmms_bindata_t *bindata, const gchar *hash,
+                   gsize offset, gssize length, xmms_error_t *err)
 {
+	xmms_bindata_blob_t *blob;
+	gsize size, start, want;
 	xmmsv_t *res;
+	struct stat st;
+	guchar *data;
+	gboolean cache;
+	guint removals;
 	gchar *path;
-	GString *str;
 	FILE *fp;
 
+	if (!xmms_bindata_hash_valid (hash)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Invalid hash!");
+		return NULL;
+	}
+
+	g_mutex_lock (bindata->mutex);
+	blob = xmms_bindata_cache_lookup (bindata, hash);
+	if (blob) {
+		res = xmms_bindata_slice (blob->data, blob->len, offset, length);
+		g_mutex_unlock (bindata->mutex);
+		return res;
+	}
+	removals = bindata->removals;
+	g_mutex_unlock (bindata->mutex);
+
 	path = xmms_bindata_build_path (bindata, hash);
 
 	fp = fopen (path, "rb");
+	if (!fp && xmms_bindata_extract (bindata, hash)) {
+		fp = fopen (path, "rb");
+	}
+
 	if (!fp) {
 		xmms_log_error ("Requesting '%s' which is not on the server", hash);
 		xmms_error_set (err, XMMS_ERROR_NOENT, "File not found!");
@@ -228,38 +975,126 @@ xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash,
 
 	g_free (path);
 
-	str = g_string_new (NULL);
-	while (!feof (fp)) {
-		gchar buf[1024];
-		gint l;
-
-		l = fread (buf, 1, 1024, fp);
-		if (ferror (fp)) {
-			g_string_free (str, TRUE);
-			xmms_log_error ("Error reading bindata '%s'", hash);
-			xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
-			fclose (fp);
-			return NULL;
+	if (fstat (fileno (fp), &st) == -1) {
+		xmms_log_error ("Error reading bindata '%s'", hash);
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
+		fclose (fp);
+		return NULL;
+	}
+
+	size = st.st_size;
+	cache = size <= bindata->cache_size / XMMS_BINDATA_CACHE_MAX_SHARE;
+
+	if (cache) {
+		start = 0;
+		want = size;
+	} else {
+		start = MIN (offset, size);
+		want = size - start;
+		if (length >= 0 && (gsize) length < want) {
+			want = length;
 		}
-		g_string_append_len (str, buf, l);
+	}
+
+	data = g_malloc (want);
+
+	if (fseek (fp, start, SEEK_SET) == -1 ||
+	    fread (data, 1, want, fp) != want) {
+		xmms_log_error ("Error reading bindata '%s'", hash);
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
+		g_free (data);
+		fclose (fp);
+		return NULL;
 	}
 
 	fclose (fp);
 
-	res = xmmsv_new_bin ((unsigned char *)str->str, str->len);
+	if (!cache) {
+		res = xmmsv_new_bin (data, want);
+		g_free (data);
+		return res;
+	}
 
-	g_string_free (str, TRUE);
+	g_mutex_lock (bindata->mutex);
+	if (bindata->removals != removals) {
+		/* the file may have been removed while we read it, don't
+		 * bring it back into the cache */
+		g_mutex_unlock (bindata->mutex);
+		res = xmms_bindata_slice (data, want, offset, length);
+		g_free (data);
+		return res;
+	}
+	blob = xmms_bindata_cache_insert (bindata, hash, data, want);
+	res = xmms_bindata_slice (blob->data, blob->len, offset, length);
+	g_mutex_unlock (bindata->mutex);
 
 	return res;
 }
 
+static xmmsv_t *
+xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash,
+                              xmms_error_t *err)
+{
+	return xmms_bindata_read (bindata, hash, 0, -1, err);
+}
+
+static xmmsv_t *
+xmms_bindata_client_retrieve_range (xmms_bindata_t *bindata,
+                                    const gchar *hash, gint32 offset,
+                                    gint32 length, xmms_error_t *err)
+{
+	if (offset < 0 || length <= 0) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Invalid range!");
+		return NULL;
+	}
+
+	return xmms_bindata_read (bindata, hash, offset, length, err);
+}
+
+static gboolean
+xmms_bindata_index_match (gpointer key, gpointer value, gpointer udata)
+{
+	return !strcmp (value, udata);
+}
+
+static gboolean
+xmms_bindata_picture_match (gpointer key, gpointer value, gpointer udata)
+{
+	xmms_bindata_picture_t *picture = value;
+	return !strcmp (picture->hash, udata);
+}
+
 static void
 xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash,
                             xmms_error_t *err)
 {
+	gboolean pending, removed;
 	gchar *path;
+
+	if (!xmms_bindata_hash_valid (hash)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "Invalid hash!");
+		return;
+	}
+
 	path = xmms_bindata_build_path (bindata, hash);
-	if (unlink (path) == -1) {
+
+	/* unlinked with the mutex held, so a read either caches the file
+	 * before it is dropped here or notices the removal */
+	g_mutex_lock (bindata->mutex);
+	bindata->removals++;
+	removed = unlink (path) == 0;
+	xmms_bindata_cache_remove (bindata, hash);
+	g_hash_table_foreach_remove (bindata->index, xmms_bindata_index_match,
+	                             (gpointer) hash);
+	pending = g_hash_table_remove (bindata->pending, hash);
+	if (g_hash_table_foreach_remove (bindata->pictures,
+	                                 xmms_bindata_picture_match,
+	                                 (gpointer) hash)) {
+		xmms_bindata_pictures_save (bindata);
+	}
+	g_mutex_unlock (bindata->mutex);
+
+	if (!removed && !pending) {
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't remove file");
 	}
 	g_free (path);
@@ -269,8 +1104,10 @@ xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash,
 static GList *
 xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
 {
+	GHashTable *listed;
+	GHashTableIter iter;
 	GList *entries = NULL;
-	gchar *path;
+	gchar *path, *hash;
 	const gchar *file;
 	GDir *dir;
 
@@ -284,12 +1121,30 @@ xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
 		return NULL;
 	}
 
+	listed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
 	while ((file = g_dir_read_name (dir))) {
+		if (*file == '.') {
+			continue;
+		}
 		entries = g_list_prepend (entries, xmmsv_new_string (file));
+		g_hash_table_insert (listed, g_strdup (file), NULL);
 	}
 
 	g_dir_close (dir);
 
+	/* embedded pictures not extracted yet can be retrieved too */
+	g_mutex_lock (bindata->mutex);
+	g_hash_table_iter_init (&iter, bindata->pending);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &hash, NULL)) {
+		if (!g_hash_table_lookup_extended (listed, hash, NULL, NULL)) {
+			entries = g_list_prepend (entries, xmmsv_new_string (hash));
+		}
+	}
+	g_mutex_unlock (bindata->mutex);
+
+	g_hash_table_destroy (listed);
+
 	return entries;
 }
 
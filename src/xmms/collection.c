@@ -31,6 +31,7 @@
 #include "xmmspriv/xmms_collquery.h"
 #include "xmmspriv/xmms_collserial.h"
 #include "xmmspriv/xmms_collsync.h"
+#include "xmmspriv/xmms_colljournal.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_streamtype.h"
 #include "xmms/xmms_ipc.h"
@@ -45,12 +46,14 @@ typedef struct {
 	const gchar *namespace;
 	xmmsv_coll_t *oldtarget;
 	xmmsv_coll_t *newtarget;
+	gboolean modified;
 } coll_rebind_infos_t;
 
 typedef struct {
 	const gchar* oldname;
 	const gchar* newname;
 	const gchar* namespace;
+	gboolean modified;
 } coll_rename_infos_t;
 
 typedef struct {
@@ -101,6 +104,7 @@ static void prepend_key_string (gpointer key, gpointer value, gpointer udata);
 static gboolean value_match_save_key (gpointer key, gpointer val, gpointer udata);
 
 static void rebind_references (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *parent, void *udata);
+static void xmms_collection_update_references (xmms_coll_dag_t *dag, FuncApplyToColl f, void *udata, gboolean *modified);
 static void rename_references (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *parent, void *udata);
 static void strip_references (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *parent, void *udata);
 static void check_for_reference (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *parent, void *udata);
@@ -198,11 +202,153 @@ struct xmms_coll_dag_St {
 
 	GMutex *mutex;
 
+	/* Labels changed since the last sync, protected by dirty_mutex as
+	 * they are marked from signal handlers that may hold the mutex above */
+	GHashTable *dirty[XMMS_COLLECTION_NUM_NAMESPACES];
+	GMutex *dirty_mutex;
+
+	/* Labels not written to the journal yet, and the idle source that
+	 * will, also protected by dirty_mutex */
+	GHashTable *unjournaled[XMMS_COLLECTION_NUM_NAMESPACES];
+	guint journal_source;
+
 };
 
+static gboolean xmms_collection_journal_flush (gpointer udata);
+
+static void
+xmms_collection_mark_dirty (xmms_coll_dag_t *dag, guint nsid,
+                            const gchar *name)
+{
+	if (nsid >= XMMS_COLLECTION_NUM_NAMESPACES || name == NULL) {
+		return;
+	}
+
+	g_mutex_lock (dag->dirty_mutex);
+	g_hash_table_insert (dag->dirty[nsid], g_strdup (name), NULL);
+	g_hash_table_insert (dag->unjournaled[nsid], g_strdup (name), NULL);
+	if (dag->journal_source == 0) {
+		dag->journal_source = g_idle_add (xmms_collection_journal_flush, dag);
+	}
+	g_mutex_unlock (dag->dirty_mutex);
+}
+
+/* Write the labels changed since the last call to the journal, the
+ * active playlist last as it refers to another label. */
+static gboolean
+xmms_collection_journal_flush (gpointer udata)
+{
+	xmms_coll_dag_t *dag = udata;
+	GHashTable *labels[XMMS_COLLECTION_NUM_NAMESPACES];
+	GHashTableIter it;
+	xmmsv_coll_t *coll;
+	gboolean active = FALSE;
+	gchar *label;
+	gint i;
+
+	g_mutex_lock (dag->mutex);
+
+	g_mutex_lock (dag->dirty_mutex);
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		labels[i] = dag->unjournaled[i];
+		dag->unjournaled[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                             g_free, NULL);
+	}
+	dag->journal_source = 0;
+	g_mutex_unlock (dag->dirty_mutex);
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_iter_init (&it, labels[i]);
+		while (g_hash_table_iter_next (&it, (gpointer *) &label, NULL)) {
+			if (i == XMMS_COLLECTION_NSID_PLAYLISTS &&
+			    strcmp (label, XMMS_ACTIVE_PLAYLIST) == 0) {
+				active = TRUE;
+				continue;
+			}
+
+			coll = xmms_collection_get_pointer (dag, label, i);
+			xmms_coll_journal_append (i, label, coll, NULL);
+		}
+		g_hash_table_destroy (labels[i]);
+	}
+
+	if (active) {
+		i = XMMS_COLLECTION_NSID_PLAYLISTS;
+		coll = xmms_collection_get_pointer (dag, XMMS_ACTIVE_PLAYLIST, i);
+		xmms_coll_journal_append (i, XMMS_ACTIVE_PLAYLIST, coll,
+		                          coll == NULL ? NULL :
+		                          xmms_collection_find_alias (dag, i, coll,
+		                                                      XMMS_ACTIVE_PLAYLIST));
+	}
+
+	xmms_coll_journal_flush ();
+
+	g_mutex_unlock (dag->mutex);
+
+	return FALSE;
+}
+
+/* Apply a journaled label change the way saving or removing the
+ * collection through a client would, without signalling it. */
+static void
+xmms_collection_journal_replay (guint nsid, const gchar *name,
+                                xmmsv_coll_t *coll, const gchar *alias,
+                                gpointer udata)
+{
+	xmms_coll_dag_t *dag = udata;
+	xmmsv_coll_t *existing, *target;
+	const gchar *namespace, *other;
+
+	existing = xmms_collection_get_pointer (dag, name, nsid);
+
+	if (alias != NULL) {
+		target = xmms_collection_get_pointer (dag, alias, nsid);
+		if (target != NULL) {
+			xmms_collection_update_pointer (dag, name, nsid, target);
+		}
+	} else if (coll == NULL) {
+		g_hash_table_remove (dag->collrefs[nsid], name);
+	} else if (existing == NULL) {
+		xmms_collection_apply_to_collection (dag, coll, bind_all_references,
+		                                     NULL);
+		xmms_collection_update_pointer (dag, name, nsid, coll);
+	} else {
+		namespace = xmms_collection_get_namespace_string (nsid);
+		coll_rebind_infos_t infos = { name, namespace, existing, coll, FALSE };
+		xmms_collection_apply_to_all_collections (dag, rebind_references,
+		                                          &infos);
+		xmms_collection_apply_to_collection (dag, coll, bind_all_references,
+		                                     NULL);
+
+		while ((other = xmms_collection_find_alias (dag, nsid, existing,
+		                                            NULL)) != NULL) {
+			xmms_collection_update_pointer (dag, other, nsid, coll);
+		}
+	}
+}
+
 static void
 coll_sync_cb (xmms_object_t *object, xmmsv_t *val, gpointer udata)
 {
+	xmms_coll_dag_t *dag = udata;
+	const gchar *name, *namespace;
+	guint nsid = XMMS_COLLECTION_NSID_PLAYLISTS;
+
+	/* Loading a playlist moves the _active label, other signals carry
+	 * the changed name (and namespace, new name for collections) */
+	if (xmmsv_get_string (val, &name)) {
+		xmms_collection_mark_dirty (dag, nsid, XMMS_ACTIVE_PLAYLIST);
+	} else if (xmmsv_dict_entry_get_string (val, "name", &name)) {
+		if (xmmsv_dict_entry_get_string (val, "namespace", &namespace)) {
+			nsid = xmms_collection_get_namespace_id (namespace);
+		}
+		xmms_collection_mark_dirty (dag, nsid, name);
+
+		if (xmmsv_dict_entry_get_string (val, "newname", &name)) {
+			xmms_collection_mark_dirty (dag, nsid, name);
+		}
+	}
+
 	xmms_coll_sync_schedule_sync ();
 }
 
@@ -219,15 +365,20 @@ xmms_collection_init (xmms_playlist_t *playlist)
 
 	ret = xmms_object_new (xmms_coll_dag_t, xmms_collection_destroy);
 	ret->mutex = g_mutex_new ();
+	ret->dirty_mutex = g_mutex_new ();
 	ret->playlist = playlist;
 
-	xmms_coll_sync_init (ret);
-
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		ret->collrefs[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
 		                                          g_free, coll_unref);
+		ret->dirty[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                       g_free, NULL);
+		ret->unjournaled[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                             g_free, NULL);
 	}
 
+	xmms_coll_sync_init (ret);
+
 	xmms_collection_register_ipc_commands (XMMS_OBJECT (ret));
 
 	/* Connection coll_sync_cb to some signals */
@@ -251,6 +402,13 @@ xmms_collection_init (xmms_playlist_t *playlist)
 
 	xmms_collection_dag_restore (ret);
 
+	/* Bring back the changes a crash kept from the database */
+	if (xmms_coll_journal_replay (xmms_collection_journal_replay, ret) > 0) {
+		xmms_log_info ("Replayed collection changes from the journal");
+		xmms_collection_dag_save (ret);
+	}
+	xmms_coll_journal_open ();
+
 	f = _xmms_stream_type_new (NULL,
 	                           XMMS_STREAM_TYPE_MIMETYPE,
 	                           "application/x-xmms2-playlist-entries",
@@ -444,7 +602,7 @@ xmms_collection_client_save (xmms_coll_dag_t *dag, const gchar *name, const gcha
 	existing = xmms_collection_get_pointer (dag, name, nsid);
 	if (existing != NULL) {
 		/* Rebind reference pointers to the new collection */
-		coll_rebind_infos_t infos = { name, namespace, existing, coll };
+		coll_rebind_infos_t infos = { name, namespace, existing, coll, FALSE };
 		xmms_collection_apply_to_all_collections (dag, rebind_references, &infos);
 	}
 
@@ -530,6 +688,9 @@ xmms_collection_client_get (xmms_coll_dag_t *dag, const gchar *name,
 
 
 /** Synchronize collection data to the database (i.e. to disk).
+ *
+ * Only the collections that changed since the last synchronization
+ * are written.
  *
  * @param dag  The collection DAG.
  * @param err  If an error occurs, a message is stored in it.
@@ -538,13 +699,31 @@ xmms_collection_client_get (xmms_coll_dag_t *dag, const gchar *name,
 void
 xmms_collection_sync (xmms_coll_dag_t *dag)
 {
+	GHashTable *dirty[XMMS_COLLECTION_NUM_NAMESPACES];
+	gint i;
+
 	g_return_if_fail (dag);
 
 	g_mutex_lock (dag->mutex);
 
-	xmms_collection_dag_save (dag);
+	/* Take over the changed labels, new changes go to fresh sets */
+	g_mutex_lock (dag->dirty_mutex);
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		dirty[i] = dag->dirty[i];
+		dag->dirty[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                       g_free, NULL);
+	}
+	g_mutex_unlock (dag->dirty_mutex);
+
+	xmms_coll_journal_rotate ();
+	xmms_collection_dag_save_delta (dag, dirty);
+	xmms_coll_journal_discard ();
 
 	g_mutex_unlock (dag->mutex);
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_destroy (dirty[i]);
+	}
 }
 
 
@@ -700,8 +879,9 @@ xmms_collection_client_rename (xmms_coll_dag_t *dag, const gchar *from_name,
 		g_hash_table_remove (dag->collrefs[nsid], from_name);
 
 		/* update name in all reference operators */
-		coll_rename_infos_t infos = { from_name, to_name, namespace };
-		xmms_collection_apply_to_all_collections (dag, rename_references, &infos);
+		coll_rename_infos_t infos = { from_name, to_name, namespace, FALSE };
+		xmms_collection_update_references (dag, rename_references, &infos,
+		                                   &infos.modified);
 
 		/* Send _RENAME signal */
 		dict = xmms_collection_changed_msg_new (XMMS_COLLECTION_CHANGED_RENAME,
@@ -741,7 +921,7 @@ xmms_collection_query_ids (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
 	idval = xmmsv_new_string ("id");
 	xmmsv_list_append (fetch, idval);
 
-	res = xmms_collection_client_query_infos (dag, coll, lim_start, lim_len, order, fetch, group, err);
+	res = xmms_collection_query_infos (dag, coll, lim_start, lim_len, order, fetch, group, err);
 
 	/* FIXME: get an uint list directly ! (we're getting ints here actually) */
 	for (n = res; n; n = n->next) {
@@ -783,9 +963,9 @@ xmms_collection_client_query_ids (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
  * @return A list of property dicts for each entry.
  */
 GList *
-xmms_collection_client_query_infos (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
-                                    gint32 lim_start, gint32 lim_len, xmmsv_t *order,
-                                    xmmsv_t *fetch, xmmsv_t *group, xmms_error_t *err)
+xmms_collection_query_infos (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
+                             gint32 lim_start, gint32 lim_len, xmmsv_t *order,
+                             xmmsv_t *fetch, xmmsv_t *group, xmms_error_t *err)
 {
 	GList *res = NULL;
 	GString *query;
@@ -837,6 +1017,15 @@ xmms_collection_client_query_infos (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
 	return res;
 }
 
+GList *
+xmms_collection_client_query_infos (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
+                                    gint32 lim_start, gint32 lim_len, xmmsv_t *order,
+                                    xmmsv_t *fetch, xmmsv_t *group, xmms_error_t *err)
+{
+	return xmms_collection_query_infos (dag, coll, lim_start, lim_len, order,
+	                                    fetch, group, err);
+}
+
 /**
  * Update a reference to point to a new collection.
  *
@@ -1017,12 +1206,21 @@ xmms_collection_destroy (xmms_object_t *object)
 	g_return_if_fail (dag);
 
 	xmms_coll_sync_shutdown ();
+
+	if (dag->journal_source != 0) {
+		g_source_remove (dag->journal_source);
+	}
+
 	xmms_collection_dag_save (dag);
+	xmms_coll_journal_close ();
 
 	g_mutex_free (dag->mutex);
+	g_mutex_free (dag->dirty_mutex);
 
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		g_hash_table_destroy (dag->collrefs[i]);  /* dag is freed here */
+		g_hash_table_destroy (dag->dirty[i]);
+		g_hash_table_destroy (dag->unjournaled[i]);
 	}
 
 	xmms_collection_unregister_ipc_commands ();
@@ -1263,13 +1461,14 @@ xmms_collection_unreference (xmms_coll_dag_t *dag, const gchar *name, guint nsid
 	if (existing != NULL && existing != active_pl) {
 		const gchar *matchkey;
 		const gchar *nsname = xmms_collection_get_namespace_string (nsid);
-		coll_rebind_infos_t infos = { name, nsname, existing, NULL };
+		coll_rebind_infos_t infos = { name, nsname, existing, NULL, FALSE };
 
 		/* FIXME: if reference pointed to by a label, we should update
 		 * the label to point to the ref'd operator instead ! */
 
 		/* Strip all references to the deleted coll, bind operator directly */
-		xmms_collection_apply_to_all_collections (dag, strip_references, &infos);
+		xmms_collection_update_references (dag, strip_references, &infos,
+		                                   &infos.modified);
 
 		/* Remove all pairs pointing to that collection */
 		while ((matchkey = xmms_collection_find_alias (dag, nsid,
@@ -1401,6 +1600,30 @@ xmms_collection_apply_to_all_collections (xmms_coll_dag_t *dag,
 	}
 }
 
+/* Apply a function that rewrites reference operators to all
+ * collections, and mark the labels of those it changed (as told by
+ * modified) dirty so they are synced too.
+ */
+static void
+xmms_collection_update_references (xmms_coll_dag_t *dag, FuncApplyToColl f,
+                                   void *udata, gboolean *modified)
+{
+	GHashTableIter iter;
+	gpointer name, coll;
+	gint i;
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_iter_init (&iter, dag->collrefs[i]);
+		while (g_hash_table_iter_next (&iter, &name, &coll)) {
+			*modified = FALSE;
+			xmms_collection_apply_to_collection (dag, coll, f, udata);
+			if (*modified) {
+				xmms_collection_mark_dirty (dag, i, name);
+			}
+		}
+	}
+}
+
 /** Apply a function of type #FuncApplyToColl to the given collection.
  *
  * @param dag  The collection DAG.
@@ -1579,6 +1802,7 @@ rename_references (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *paren
 		if (strcmp (infos->oldname, target_name) == 0 &&
 		    strcmp (infos->namespace, target_namespace) == 0) {
 			xmmsv_coll_attribute_set (coll, "reference", infos->newname);
+			infos->modified = TRUE;
 		}
 	}
 }
@@ -1628,6 +1852,8 @@ strip_references (xmms_coll_dag_t *dag, xmmsv_coll_t *coll, xmmsv_coll_t *parent
 		tmp = xmmsv_new_coll (infos->oldtarget);
 		xmmsv_list_iter_insert (iter, tmp);
 		xmmsv_unref (tmp);
+
+		infos->modified = TRUE;
 	}
 	xmmsv_list_iter_explicit_destroy (iter);
 }
@@ -1733,6 +1959,7 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 	xmmsv_t *val;
 	xmms_medialib_entry_t entry, id;
 	xmmsv_list_iter_t *iter;
+	gint i, size;
 
 	switch (xmmsv_coll_get_type (coll)) {
 	case XMMS_COLLECTION_TYPE_REFERENCE:
@@ -1822,18 +2049,11 @@ xmms_collection_media_match (xmms_coll_dag_t *dag, GHashTable *mediainfo,
 		if (val != NULL) {
 			xmmsv_get_int (val, &id);
 
-			xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &iter);
-			for (xmmsv_list_iter_first (iter);
-			     xmmsv_list_iter_valid (iter);
-			     xmmsv_list_iter_next (iter)) {
-
-				xmmsv_list_iter_entry_int (iter, &entry);
-				if (entry == id) {
-					match = TRUE;
-					break;
-				}
+			size = xmmsv_coll_idlist_get_size (coll);
+			for (i = 0; i < size && !match; i++) {
+				xmmsv_coll_idlist_get_index (coll, i, &entry);
+				match = (entry == id);
 			}
-			xmmsv_list_iter_explicit_destroy (iter);
 		}
 		break;
 
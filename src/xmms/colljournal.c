@@ -0,0 +1,265 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+/** @file
+ *  Write-ahead journal of collection changes.
+ *
+ *  The changed labels are appended to a journal next to the database
+ *  as soon as the main loop is idle, before the delayed sync writes
+ *  them to the database. The journal is rotated when a sync starts
+ *  and the rotated part is dropped once the sync is done, so after a
+ *  crash replaying both parts on top of the database gives back the
+ *  last state. All functions but replay are called with the
+ *  collection DAG locked.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "xmmspriv/xmms_colljournal.h"
+#include "xmmspriv/xmms_collection.h"
+#include "xmms/xmms_config.h"
+#include "xmms/xmms_log.h"
+#include "xmmsc/xmmsv.h"
+
+static FILE *journal;
+static gchar *journal_path;
+static gchar *rotated_path;
+
+static void
+journal_paths (void)
+{
+	xmms_config_property_t *cv;
+
+	if (journal_path != NULL) {
+		return;
+	}
+
+	cv = xmms_config_lookup ("medialib.path");
+	journal_path = g_strconcat (xmms_config_property_get_string (cv),
+	                            "-colljournal", NULL);
+	rotated_path = g_strconcat (journal_path, ".old", NULL);
+}
+
+/* Every record is a 32-bit big endian length followed by a serialized
+ * dict. A truncated record at the end was cut off by the crash and
+ * ends the replay. */
+static gint
+replay_file (const gchar *path, xmms_coll_journal_replay_func_t func,
+             gpointer udata)
+{
+	gchar *contents;
+	gsize len, pos = 0;
+	gint count = 0;
+
+	if (!g_file_get_contents (path, &contents, &len, NULL)) {
+		return 0;
+	}
+
+	while (len - pos >= 4) {
+		xmmsv_t *bb, *rec;
+		xmmsv_coll_t *coll = NULL;
+		const gchar *name, *alias = NULL;
+		guint32 size;
+		gint nsid;
+
+		memcpy (&size, contents + pos, 4);
+		size = GUINT32_FROM_BE (size);
+		pos += 4;
+
+		if (len - pos < size) {
+			break;
+		}
+
+		bb = xmmsv_bitbuffer_new_ro ((const guchar *) contents + pos, size);
+		pos += size;
+
+		if (!xmmsv_bitbuffer_deserialize_value (bb, &rec)) {
+			xmmsv_unref (bb);
+			break;
+		}
+		xmmsv_unref (bb);
+
+		if (xmmsv_dict_entry_get_int (rec, "namespace", &nsid) &&
+		    xmmsv_dict_entry_get_string (rec, "name", &name) &&
+		    nsid >= 0 && nsid < XMMS_COLLECTION_NUM_NAMESPACES) {
+			xmmsv_dict_entry_get_coll (rec, "collection", &coll);
+			xmmsv_dict_entry_get_string (rec, "alias", &alias);
+			func (nsid, name, coll, alias, udata);
+			count++;
+		}
+
+		xmmsv_unref (rec);
+	}
+
+	if (pos != len) {
+		xmms_log_info ("Ignoring incomplete record at the end of %s", path);
+	}
+
+	g_free (contents);
+
+	return count;
+}
+
+/**
+ * Replay the journal left by a previous run, oldest change first.
+ *
+ * @returns The number of changes replayed.
+ */
+gint
+xmms_coll_journal_replay (xmms_coll_journal_replay_func_t func,
+                          gpointer udata)
+{
+	journal_paths ();
+
+	return replay_file (rotated_path, func, udata) +
+	       replay_file (journal_path, func, udata);
+}
+
+/**
+ * Start an empty journal. The changes from a previous run must have been
+ * replayed and saved to the database before.
+ */
+void
+xmms_coll_journal_open (void)
+{
+	journal_paths ();
+
+	g_unlink (rotated_path);
+
+	journal = g_fopen (journal_path, "wb");
+	if (journal == NULL) {
+		xmms_log_error ("Couldn't create %s: %s", journal_path,
+		                strerror (errno));
+	}
+}
+
+/**
+ * Close and remove the journal, everything has been saved to the database.
+ */
+void
+xmms_coll_journal_close (void)
+{
+	if (journal != NULL) {
+		fclose (journal);
+		journal = NULL;
+	}
+
+	g_unlink (journal_path);
+	g_unlink (rotated_path);
+
+	g_free (journal_path);
+	g_free (rotated_path);
+	journal_path = rotated_path = NULL;
+}
+
+/**
+ * Append the new state of a label to the journal.
+ *
+ * @param nsid  The namespace of the label.
+ * @param name  The label.
+ * @param coll  The collection it points to, or NULL.
+ * @param alias  The label it is an alias of, or NULL.
+ */
+void
+xmms_coll_journal_append (guint nsid, const gchar *name, xmmsv_coll_t *coll,
+                          const gchar *alias)
+{
+	xmmsv_t *rec, *bb;
+	guint32 size;
+
+	if (journal == NULL) {
+		return;
+	}
+
+	rec = xmmsv_new_dict ();
+	xmmsv_dict_set_int (rec, "namespace", nsid);
+	xmmsv_dict_set_string (rec, "name", name);
+	if (alias != NULL) {
+		xmmsv_dict_set_string (rec, "alias", alias);
+	} else if (coll != NULL) {
+		xmmsv_t *val = xmmsv_new_coll (coll);
+		xmmsv_dict_set (rec, "collection", val);
+		xmmsv_unref (val);
+	}
+
+	bb = xmmsv_bitbuffer_new ();
+	if (xmmsv_bitbuffer_serialize_value (bb, rec)) {
+		size = GUINT32_TO_BE (xmmsv_bitbuffer_len (bb) / 8);
+
+		if (fwrite (&size, 4, 1, journal) != 1 ||
+		    fwrite (xmmsv_bitbuffer_buffer (bb), xmmsv_bitbuffer_len (bb) / 8,
+		            1, journal) != 1) {
+			xmms_log_error ("Couldn't write to %s", journal_path);
+		}
+	}
+
+	xmmsv_unref (bb);
+	xmmsv_unref (rec);
+}
+
+/**
+ * Hand the appended changes to the operating system, so that they
+ * survive a crash of the server.
+ */
+void
+xmms_coll_journal_flush (void)
+{
+	if (journal != NULL && fflush (journal) != 0) {
+		xmms_log_error ("Couldn't write to %s: %s", journal_path,
+		                strerror (errno));
+	}
+}
+
+/**
+ * Set the current journal aside before its changes are synced to the
+ * database, new changes go to a fresh journal.
+ */
+void
+xmms_coll_journal_rotate (void)
+{
+	if (journal == NULL) {
+		return;
+	}
+
+	fclose (journal);
+
+	if (g_rename (journal_path, rotated_path) == -1) {
+		xmms_log_error ("Couldn't move %s to %s", journal_path, rotated_path);
+	}
+
+	journal = g_fopen (journal_path, "wb");
+	if (journal == NULL) {
+		xmms_log_error ("Couldn't create %s: %s", journal_path,
+		                strerror (errno));
+	}
+}
+
+/**
+ * Drop the journal set aside by the last rotation, its changes are in
+ * the database now.
+ */
+void
+xmms_coll_journal_discard (void)
+{
+	if (rotated_path != NULL) {
+		g_unlink (rotated_path);
+	}
+}
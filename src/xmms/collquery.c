@@ -235,7 +235,7 @@ xmms_collection_append_to_query (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
 	gchar *attr1, *attr2, *attr3;
 	gboolean case_sens;
 	xmmsv_list_iter_t *iter;
-	xmmsv_t *tmp;
+	xmmsv_t *tmp, *ids;
 	gboolean first;
 
 	xmmsv_coll_type_t type = xmmsv_coll_get_type (coll);
@@ -304,7 +304,8 @@ xmms_collection_append_to_query (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
 		first = TRUE;
 		query_append_string (query, "m0.id IN (");
 
-		xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &iter);
+		ids = xmmsv_coll_idlist_copy (coll);
+		xmmsv_get_list_iter (ids, &iter);
 		for (xmmsv_list_iter_first (iter);
 		     xmmsv_list_iter_valid (iter);
 		     xmmsv_list_iter_next (iter)) {
@@ -319,6 +320,7 @@ xmms_collection_append_to_query (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
 			query_append_int (query, entry);
 		}
 		xmmsv_list_iter_explicit_destroy (iter);
+		xmmsv_unref (ids);
 
 		query_append_string (query, ")");
 		break;
@@ -32,13 +32,21 @@ typedef struct {
 	xmms_collection_namespace_id_t nsid;
 } coll_dbwrite_t;
 
+typedef struct {
+	xmmsv_coll_t *coll;
+	GHashTable *labels;
+} coll_alias_search_t;
+
 
 static xmmsv_coll_t *xmms_collection_dbread_operator (xmms_medialib_session_t *session, gint id, xmmsv_coll_type_t type);
 static guint xmms_collection_dbwrite_operator (xmms_medialib_session_t *session, guint collid, xmmsv_coll_t *coll);
+static void xmms_collection_dbdelete_operator (xmms_medialib_session_t *session, gint id);
+static gint xmms_collection_dbread_label (xmms_medialib_session_t *session, guint nsid, const gchar *label);
 
 static void dbwrite_operator (void *key, void *value, void *udata);
 static void dbwrite_coll_attributes (const char *key, xmmsv_t *value, void *udata);
 static void dbwrite_strip_tmpprops (void *key, void *value, void *udata);
+static void collect_aliases (void *key, void *value, void *udata);
 
 static gint value_get_dict_int (xmmsv_t *val, const gchar *key);
 static const gchar *value_get_dict_string (xmmsv_t *val, const gchar *key);
@@ -77,6 +85,141 @@ xmms_collection_dag_save (xmms_coll_dag_t *dag)
 	xmms_medialib_end (session);
 }
 
+/** Save only the given labels of the collection DAG in the database.
+ *
+ * The operators previously saved under those labels are removed if no
+ * other label refers to them anymore, and the current collections are
+ * appended under fresh ids.  Labels aliasing the same collection are
+ * rewritten along, so that they keep pointing to a single operator.
+ *
+ * @param dag  The collection DAG to save.
+ * @param dirty  For each namespace, a set of the labels that changed.
+ */
+void
+xmms_collection_dag_save_delta (xmms_coll_dag_t *dag, GHashTable **dirty)
+{
+	gint i;
+	GHashTable *labels[XMMS_COLLECTION_NUM_NAMESPACES];
+	GHashTableIter it;
+	xmms_medialib_session_t *session;
+	gchar *label;
+	xmmsv_coll_t *coll;
+	GList *orphans = NULL;
+	GList *res;
+	gint collid;
+
+	/* Extend the changed labels with all aliases of their collections */
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		labels[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                   g_free, NULL);
+	}
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_iter_init (&it, dirty[i]);
+		while (g_hash_table_iter_next (&it, (gpointer *) &label, NULL)) {
+			coll_alias_search_t search;
+			gint j;
+
+			g_hash_table_insert (labels[i], g_strdup (label), NULL);
+
+			coll = xmms_collection_get_pointer (dag, label, i);
+			if (coll == NULL) {
+				continue;
+			}
+
+			search.coll = coll;
+			for (j = 0; j < XMMS_COLLECTION_NUM_NAMESPACES; ++j) {
+				search.labels = labels[j];
+				xmms_collection_foreach_in_namespace (dag, j, collect_aliases,
+				                                      &search);
+			}
+		}
+	}
+
+	session = xmms_medialib_begin_write ();
+
+	/* Drop the old labels, remember which operators they pointed to */
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_iter_init (&it, labels[i]);
+		while (g_hash_table_iter_next (&it, (gpointer *) &label, NULL)) {
+			gchar *query, *esc_label;
+
+			collid = xmms_collection_dbread_label (session, i, label);
+			if (collid > 0) {
+				orphans = g_list_prepend (orphans, GINT_TO_POINTER (collid));
+			}
+
+			esc_label = sqlite_prepare_string (label);
+			query = g_strdup_printf ("DELETE FROM CollectionLabels "
+			                         "WHERE namespace=%d AND name=%s",
+			                         i, esc_label);
+			xmms_medialib_select (session, query, NULL);
+
+			g_free (query);
+			g_free (esc_label);
+		}
+	}
+
+	/* Remove the operators no longer pointed to by any label */
+	while (orphans) {
+		gchar query[128];
+		gint count = 0;
+
+		collid = GPOINTER_TO_INT (orphans->data);
+		g_snprintf (query, sizeof (query),
+		            "SELECT COUNT(*) AS count FROM CollectionLabels "
+		            "WHERE collid=%d", collid);
+
+		res = xmms_medialib_select (session, query, NULL);
+		if (res != NULL) {
+			count = value_get_dict_int (res->data, "count");
+			xmmsv_unref (res->data);
+			g_list_free (res);
+		}
+
+		if (count == 0) {
+			xmms_collection_dbdelete_operator (session, collid);
+		}
+
+		orphans = g_list_delete_link (orphans, orphans);
+	}
+
+	/* Append the current collections after the last used id */
+	coll_dbwrite_t dbinfos = { session, 1, 0 };
+	res = xmms_medialib_select (session,
+	                            "SELECT IFNULL(MAX(id), 0) + 1 AS id "
+	                            "FROM CollectionOperators", NULL);
+	if (res != NULL) {
+		dbinfos.collid = value_get_dict_int (res->data, "id");
+		xmmsv_unref (res->data);
+		g_list_free (res);
+	}
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		dbinfos.nsid = i;
+		g_hash_table_iter_init (&it, labels[i]);
+		while (g_hash_table_iter_next (&it, (gpointer *) &label, NULL)) {
+			coll = xmms_collection_get_pointer (dag, label, i);
+			if (coll != NULL) {
+				dbwrite_operator (label, coll, &dbinfos);
+			}
+		}
+	}
+
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
+		g_hash_table_iter_init (&it, labels[i]);
+		while (g_hash_table_iter_next (&it, (gpointer *) &label, NULL)) {
+			coll = xmms_collection_get_pointer (dag, label, i);
+			if (coll != NULL) {
+				dbwrite_strip_tmpprops (label, coll, NULL);
+			}
+		}
+		g_hash_table_destroy (labels[i]);
+	}
+
+	xmms_medialib_end (session);
+}
+
 /** Restore the collection DAG from the database.
  *
  * @param dag  The collection DAG to restore to.
@@ -235,7 +378,7 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
 	xmmsv_list_iter_t *it;
 	gint i;
 	xmmsv_coll_t *op;
-	xmmsv_t *attrs;
+	xmmsv_t *attrs, *ids;
 	gint newid, nextid;
 	coll_dbwrite_t dbwrite_infos = { session, collid, 0 };
 
@@ -252,7 +395,8 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
 	attrs = NULL; /* no unref needed. */
 
 	/* Write idlist */
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &it);
+	ids = xmmsv_coll_idlist_copy (coll);
+	xmmsv_get_list_iter (ids, &it);
 	for (xmmsv_list_iter_first (it), i = 0;
 	     xmmsv_list_iter_valid (it);
 	     xmmsv_list_iter_next (it), i++) {
@@ -265,6 +409,7 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
 		xmms_medialib_select (session, query, NULL);
 	}
 	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (ids);
 
 	/* Save operands and connections (don't recurse in ref operand) */
 	newid = collid + 1;
@@ -295,6 +440,80 @@ xmms_collection_dbwrite_operator (xmms_medialib_session_t *session,
 	return newid;
 }
 
+/** Remove the given operator and all its operands from the database.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param id  The id of the operator to remove.
+ */
+static void
+xmms_collection_dbdelete_operator (xmms_medialib_session_t *session, gint id)
+{
+	gchar query[128];
+	GList *res;
+
+	/* Remove the operands first */
+	g_snprintf (query, sizeof (query),
+	            "SELECT from_id AS id FROM CollectionConnections "
+	            "WHERE to_id=%d", id);
+
+	res = xmms_medialib_select (session, query, NULL);
+	while (res) {
+		xmms_collection_dbdelete_operator (session,
+		                                   value_get_dict_int (res->data, "id"));
+		xmmsv_unref (res->data);
+		res = g_list_delete_link (res, res);
+	}
+
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionConnections WHERE to_id=%d", id);
+	xmms_medialib_select (session, query, NULL);
+
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionAttributes WHERE collid=%d", id);
+	xmms_medialib_select (session, query, NULL);
+
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionIdlists WHERE collid=%d", id);
+	xmms_medialib_select (session, query, NULL);
+
+	g_snprintf (query, sizeof (query),
+	            "DELETE FROM CollectionOperators WHERE id=%d", id);
+	xmms_medialib_select (session, query, NULL);
+}
+
+/** Find the id of the operator saved under the given label.
+ *
+ * @param session  The medialib session connected to the DB.
+ * @param nsid  The namespace of the label.
+ * @param label  The name of the label.
+ * @return  The id of the operator, or -1 if the label was not saved.
+ */
+static gint
+xmms_collection_dbread_label (xmms_medialib_session_t *session, guint nsid,
+                              const gchar *label)
+{
+	gchar *query, *esc_label;
+	GList *res;
+	gint collid = -1;
+
+	esc_label = sqlite_prepare_string (label);
+	query = g_strdup_printf ("SELECT collid FROM CollectionLabels "
+	                         "WHERE namespace=%d AND name=%s",
+	                         nsid, esc_label);
+
+	res = xmms_medialib_select (session, query, NULL);
+	while (res) {
+		collid = value_get_dict_int (res->data, "collid");
+		xmmsv_unref (res->data);
+		res = g_list_delete_link (res, res);
+	}
+
+	g_free (query);
+	g_free (esc_label);
+
+	return collid;
+}
+
 /* For all label-operator pairs, write the operator and all its
  * operands to the DB recursively. */
 static void
@@ -357,6 +576,17 @@ dbwrite_strip_tmpprops (void *key, void *value, void *udata)
 	xmmsv_coll_attribute_remove (coll, XMMS_COLLSERIAL_ATTR_ID);
 }
 
+/* Add the labels pointing to the searched collection to the label set. */
+static void
+collect_aliases (void *key, void *value, void *udata)
+{
+	coll_alias_search_t *search = udata;
+
+	if (value == search->coll) {
+		g_hash_table_insert (search->labels, g_strdup (key), NULL);
+	}
+}
+
 
 /* Extract the int value out of a xmmsv_t object. */
 static gint
@@ -16,8 +16,9 @@
 
 
 /** @file
- *  Manages the synchronization of collections to the database at 10 seconds
- *  after the last collections-change.
+ *  Manages the synchronization of collections to the database at 2 seconds
+ *  after the last collections-change, or at most 10 seconds after the first
+ *  pending change.
  */
 
 #include "xmmspriv/xmms_collsync.h"
@@ -25,21 +26,33 @@
 #include "xmms/xmms_log.h"
 #include <glib.h>
 
+#define XMMS_COLL_SYNC_QUIET_DELAY 2000000
+#define XMMS_COLL_SYNC_MAX_DELAY 10000000
+
 static GThread *thread;
 static GMutex *mutex;
 static GCond *cond;
 static gboolean want_sync = FALSE;
 static gboolean keep_running = TRUE;
 
+static gboolean
+time_val_before (GTimeVal *a, GTimeVal *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_usec < b->tv_usec);
+}
+
 /**
- * Wait until no collections have changed for 10 seconds, then sync.
+ * Wait until no collections have changed for 2 seconds, then sync. Only the
+ * changed collections are written, so under a steady stream of changes we
+ * sync at least every 10 seconds rather than waiting for a quiet period.
  * @internal
  */
 static gpointer
 do_loop (gpointer udata)
 {
 	xmms_coll_dag_t *dag = udata;
-	GTimeVal time;
+	GTimeVal time, deadline;
 
 	xmms_set_thread_name ("x2 coll sync");
 
@@ -50,12 +63,20 @@ do_loop (gpointer udata)
 			g_cond_wait (cond, mutex);
 		}
 
-		/* Wait until no requests have been filed for 10 seconds. */
+		g_get_current_time (&deadline);
+		g_time_val_add (&deadline, XMMS_COLL_SYNC_MAX_DELAY);
+
+		/* Wait until no requests have been filed for 2 seconds. */
 		while (keep_running && want_sync) {
 			want_sync = FALSE;
 
 			g_get_current_time (&time);
-			g_time_val_add (&time, 10000000);
+			g_time_val_add (&time, XMMS_COLL_SYNC_QUIET_DELAY);
+
+			if (!time_val_before (&time, &deadline)) {
+				g_cond_timed_wait (cond, mutex, &deadline);
+				break;
+			}
 
 			g_cond_timed_wait (cond, mutex, &time);
 		}
@@ -107,7 +128,7 @@ xmms_coll_sync_shutdown ()
 }
 
 /**
- * Schedule a collection-to-database-synchronization in 10 seconds.
+ * Schedule a collection-to-database-synchronization in 2 seconds.
  */
 void
 xmms_coll_sync_schedule_sync ()
@@ -0,0 +1,46 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xmms/xmms_config.h"
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_object.h"
+#include "xmmspriv/xmms_watcher.h"
+
+struct xmms_watcher_St {
+	xmms_object_t object;
+};
+
+static void
+xmms_watcher_destroy (xmms_object_t *object)
+{
+}
+
+xmms_watcher_t *
+xmms_watcher_start (xmms_medialib_t *medialib)
+{
+	xmms_config_property_t *cv;
+	const gchar *dir;
+
+	cv = xmms_config_property_register ("medialib.watch_dir", "", NULL, NULL);
+	dir = xmms_config_property_get_string (cv);
+
+	if (dir && *dir) {
+		xmms_log_info ("Watching directories is not supported "
+		               "on this platform");
+	}
+
+	return xmms_object_new (xmms_watcher_t, xmms_watcher_destroy);
+}
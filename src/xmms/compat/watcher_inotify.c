@@ -0,0 +1,845 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Watches the library directory with inotify and keeps the medialib
+ * up to date with the changes.
+ *
+ * Events are collected until the directory has been quiet for
+ * medialib.watch_delay milliseconds. Repeated events for the same
+ * file are coalesced and renames are paired into moves, then the
+ * whole batch is handed to the medialib at once.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "xmms/xmms_config.h"
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_object.h"
+#include "xmmspriv/xmms_watcher.h"
+#include "xmmspriv/xmms_thread_name.h"
+
+/** Flush even if events keep coming in after this many delays */
+#define XMMS_WATCHER_MAX_DELAYS 10
+
+#define XMMS_WATCHER_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | \
+                           IN_MOVED_FROM | IN_MOVED_TO | \
+                           IN_ONLYDIR | IN_DONT_FOLLOW)
+
+typedef enum {
+	XMMS_WATCHER_NONE,
+	XMMS_WATCHER_ADDED,
+	XMMS_WATCHER_REMOVED,
+	XMMS_WATCHER_MOVED
+} xmms_watcher_action_t;
+
+typedef struct xmms_watcher_event_St {
+	xmms_watcher_action_t action;
+	gboolean isdir;
+	/** TRUE if the file was created since the last flush */
+	gboolean created;
+	gchar *path;
+	/** Where the file was moved to */
+	gchar *dest;
+} xmms_watcher_event_t;
+
+struct xmms_watcher_St {
+	xmms_object_t object;
+	xmms_medialib_t *medialib;
+
+	GThread *thread;
+	GMainContext *context;
+	GMainLoop *ml;
+
+	/** Protects new_root */
+	GMutex *mutex;
+	/** Directory to switch to, set when the config changes */
+	gchar *new_root;
+
+	gint fd;
+	GSource *source;
+	gchar *root;
+
+	/** Watch descriptor -> directory */
+	GHashTable *wds;
+	/** Directory -> watch descriptor */
+	GHashTable *dirs;
+
+	/** Pending events, in the order they came in */
+	GQueue *events;
+	/** Path -> pending added or removed event */
+	GHashTable *pending;
+	/** Move cookie -> pending move */
+	GHashTable *moves;
+	/** The kernel dropped events, rescan everything */
+	gboolean rescan;
+
+	GSource *timer;
+	gint delays;
+
+	guint received;
+	guint coalesced;
+};
+
+static void xmms_watcher_add_dir (xmms_watcher_t *watcher, const gchar *path);
+
+static gboolean
+path_below (const gchar *dir, const gchar *path)
+{
+	gint len = strlen (dir);
+
+	return !strncmp (dir, path, len) && (!path[len] || path[len] == '/');
+}
+
+static gchar *
+xmms_watcher_url (const gchar *path)
+{
+	gchar *enc, *url;
+
+	enc = xmms_medialib_url_encode (path);
+	url = g_strconcat ("file://", enc, NULL);
+	g_free (enc);
+
+	return url;
+}
+
+static xmms_watcher_event_t *
+xmms_watcher_event_new (xmms_watcher_t *watcher, xmms_watcher_action_t action,
+                        const gchar *path, gboolean isdir)
+{
+	xmms_watcher_event_t *ev;
+
+	ev = g_new0 (xmms_watcher_event_t, 1);
+	ev->action = action;
+	ev->isdir = isdir;
+	ev->path = g_strdup (path);
+
+	g_queue_push_tail (watcher->events, ev);
+
+	return ev;
+}
+
+static void
+xmms_watcher_event_free (xmms_watcher_event_t *ev)
+{
+	g_free (ev->path);
+	g_free (ev->dest);
+	g_free (ev);
+}
+
+static void
+xmms_watcher_events_clear (xmms_watcher_t *watcher)
+{
+	xmms_watcher_event_t *ev;
+
+	g_hash_table_remove_all (watcher->pending);
+	g_hash_table_remove_all (watcher->moves);
+
+	while ((ev = g_queue_pop_head (watcher->events))) {
+		xmms_watcher_event_free (ev);
+	}
+
+	if (watcher->timer) {
+		g_source_destroy (watcher->timer);
+		watcher->timer = NULL;
+	}
+
+	watcher->delays = 0;
+	watcher->rescan = FALSE;
+}
+
+/* Stop watching the directory and everything below it. */
+static void
+xmms_watcher_remove_dir (xmms_watcher_t *watcher, const gchar *path)
+{
+	GHashTableIter it;
+	gpointer key, value;
+
+	g_hash_table_iter_init (&it, watcher->dirs);
+	while (g_hash_table_iter_next (&it, &key, &value)) {
+		if (path_below (path, key)) {
+			inotify_rm_watch (watcher->fd, GPOINTER_TO_INT (value));
+			g_hash_table_remove (watcher->wds, value);
+			g_hash_table_iter_remove (&it);
+		}
+	}
+}
+
+/* Update the watched directories after the directory has been moved. */
+static void
+xmms_watcher_rename_dir (xmms_watcher_t *watcher, const gchar *from,
+                         const gchar *to)
+{
+	GHashTableIter it;
+	GList *moved = NULL, *n;
+	gpointer key, value;
+	gint len;
+
+	len = strlen (from);
+
+	g_hash_table_iter_init (&it, watcher->dirs);
+	while (g_hash_table_iter_next (&it, &key, &value)) {
+		if (path_below (from, key)) {
+			moved = g_list_prepend (moved, value);
+			g_hash_table_iter_remove (&it);
+		}
+	}
+
+	for (n = moved; n; n = g_list_next (n)) {
+		const gchar *old;
+		gchar *path;
+
+		old = g_hash_table_lookup (watcher->wds, n->data);
+		path = g_strconcat (to, old + len, NULL);
+
+		g_hash_table_insert (watcher->dirs, g_strdup (path), n->data);
+		g_hash_table_insert (watcher->wds, n->data, path);
+	}
+
+	g_list_free (moved);
+}
+
+static void
+xmms_watcher_add_dir (xmms_watcher_t *watcher, const gchar *path)
+{
+	const gchar *name;
+	GDir *dir;
+	gint wd;
+
+	wd = inotify_add_watch (watcher->fd, path, XMMS_WATCHER_MASK);
+	if (wd < 0) {
+		if (errno == ENOSPC) {
+			xmms_log_error ("Unable to watch '%s', increase "
+			                "fs.inotify.max_user_watches", path);
+		} else {
+			xmms_log_error ("Unable to watch '%s': %s", path,
+			                strerror (errno));
+		}
+		return;
+	}
+
+	/* already watched through another path, don't loop */
+	if (g_hash_table_lookup (watcher->wds, GINT_TO_POINTER (wd))) {
+		return;
+	}
+
+	g_hash_table_insert (watcher->wds, GINT_TO_POINTER (wd), g_strdup (path));
+	g_hash_table_insert (watcher->dirs, g_strdup (path), GINT_TO_POINTER (wd));
+
+	dir = g_dir_open (path, 0, NULL);
+	if (!dir) {
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir))) {
+		struct stat st;
+		gchar *child;
+
+		child = g_build_filename (path, name, NULL);
+		if (!lstat (child, &st) && S_ISDIR (st.st_mode)) {
+			xmms_watcher_add_dir (watcher, child);
+		}
+		g_free (child);
+	}
+
+	g_dir_close (dir);
+}
+
+static void
+xmms_watcher_added (xmms_watcher_t *watcher, const gchar *path,
+                    gboolean isdir, gboolean created)
+{
+	xmms_watcher_event_t *ev;
+
+	ev = g_hash_table_lookup (watcher->pending, path);
+	if (ev) {
+		/* removed and added again, treat it as changed */
+		ev->action = XMMS_WATCHER_ADDED;
+		ev->isdir = isdir;
+		watcher->coalesced++;
+		return;
+	}
+
+	ev = xmms_watcher_event_new (watcher, XMMS_WATCHER_ADDED, path, isdir);
+	ev->created = created;
+
+	g_hash_table_insert (watcher->pending, ev->path, ev);
+}
+
+static void
+xmms_watcher_removed (xmms_watcher_t *watcher, const gchar *path,
+                      gboolean isdir)
+{
+	xmms_watcher_event_t *ev;
+
+	ev = g_hash_table_lookup (watcher->pending, path);
+	if (ev) {
+		if (ev->action == XMMS_WATCHER_ADDED && ev->created) {
+			/* came and went before we got to it */
+			ev->action = XMMS_WATCHER_NONE;
+			g_hash_table_remove (watcher->pending, path);
+		} else {
+			ev->action = XMMS_WATCHER_REMOVED;
+			ev->isdir = isdir;
+		}
+		watcher->coalesced++;
+		return;
+	}
+
+	ev = xmms_watcher_event_new (watcher, XMMS_WATCHER_REMOVED, path, isdir);
+
+	g_hash_table_insert (watcher->pending, ev->path, ev);
+}
+
+static void
+xmms_watcher_moved_from (xmms_watcher_t *watcher, const gchar *path,
+                         gboolean isdir, guint32 cookie)
+{
+	xmms_watcher_event_t *ev, *prev;
+
+	/* if the other half of the move never shows up, the file has
+	 * been moved out of the watched directory */
+	ev = xmms_watcher_event_new (watcher, XMMS_WATCHER_REMOVED, path, isdir);
+
+	/* written to a temporary file and renamed, there's nothing in
+	 * the medialib to move yet */
+	prev = g_hash_table_lookup (watcher->pending, path);
+	if (prev && prev->action == XMMS_WATCHER_ADDED && prev->created) {
+		prev->action = XMMS_WATCHER_NONE;
+		g_hash_table_remove (watcher->pending, path);
+		ev->created = TRUE;
+		watcher->coalesced++;
+	}
+
+	g_hash_table_insert (watcher->moves, GUINT_TO_POINTER (cookie), ev);
+}
+
+static void
+xmms_watcher_moved_to (xmms_watcher_t *watcher, const gchar *path,
+                       gboolean isdir, guint32 cookie)
+{
+	xmms_watcher_event_t *ev;
+
+	ev = g_hash_table_lookup (watcher->moves, GUINT_TO_POINTER (cookie));
+	if (!ev) {
+		/* moved in from outside the watched directory */
+		if (isdir) {
+			xmms_watcher_add_dir (watcher, path);
+		}
+		xmms_watcher_added (watcher, path, isdir, FALSE);
+		return;
+	}
+
+	g_hash_table_remove (watcher->moves, GUINT_TO_POINTER (cookie));
+
+	if (isdir) {
+		xmms_watcher_rename_dir (watcher, ev->path, path);
+	}
+
+	if (ev->created) {
+		ev->action = XMMS_WATCHER_NONE;
+		xmms_watcher_added (watcher, path, isdir, FALSE);
+	} else {
+		ev->action = XMMS_WATCHER_MOVED;
+		ev->dest = g_strdup (path);
+	}
+
+	watcher->coalesced++;
+}
+
+static void
+xmms_watcher_handle (xmms_watcher_t *watcher, struct inotify_event *iev)
+{
+	const gchar *dir;
+	gboolean isdir;
+	gchar *path;
+
+	if (iev->mask & IN_Q_OVERFLOW) {
+		watcher->rescan = TRUE;
+		return;
+	}
+
+	dir = g_hash_table_lookup (watcher->wds, GINT_TO_POINTER (iev->wd));
+	if (!dir) {
+		return;
+	}
+
+	if (iev->mask & IN_IGNORED) {
+		g_hash_table_remove (watcher->dirs, dir);
+		g_hash_table_remove (watcher->wds, GINT_TO_POINTER (iev->wd));
+		return;
+	}
+
+	if (!iev->len) {
+		return;
+	}
+
+	watcher->received++;
+
+	path = g_build_filename (dir, iev->name, NULL);
+	isdir = !!(iev->mask & IN_ISDIR);
+
+	if (iev->mask & IN_CREATE) {
+		if (isdir) {
+			xmms_watcher_add_dir (watcher, path);
+		}
+		xmms_watcher_added (watcher, path, isdir, TRUE);
+	} else if (iev->mask & IN_CLOSE_WRITE) {
+		xmms_watcher_added (watcher, path, FALSE, FALSE);
+	} else if (iev->mask & IN_DELETE) {
+		xmms_watcher_removed (watcher, path, isdir);
+	} else if (iev->mask & IN_MOVED_FROM) {
+		xmms_watcher_moved_from (watcher, path, isdir, iev->cookie);
+	} else if (iev->mask & IN_MOVED_TO) {
+		xmms_watcher_moved_to (watcher, path, isdir, iev->cookie);
+	}
+
+	g_free (path);
+}
+
+/* Add a file the way xmms_xform_browse would have listed it. */
+static GList *
+xmms_watcher_file_add (GList *files, const gchar *path)
+{
+	struct stat st;
+	xmmsv_t *val;
+	gchar *url, *stat_str;
+
+	if (stat (path, &st) || !S_ISREG (st.st_mode)) {
+		return files;
+	}
+
+	url = xmms_watcher_url (path);
+
+	val = xmmsv_new_dict ();
+	xmmsv_dict_set_string (val, "path", url);
+	xmmsv_dict_set_int (val, "isdir", 0);
+	xmmsv_dict_set_int (val, "size", st.st_size);
+
+	stat_str = g_strdup_printf (XMMS_MEDIALIB_BROWSE_STAT_FORMAT,
+	                            (gint64) st.st_mtime, (gint64) st.st_size,
+	                            (guint64) st.st_ino);
+	xmmsv_dict_set_string (val, XMMS_MEDIALIB_BROWSE_PROPERTY_STAT, stat_str);
+
+	g_free (stat_str);
+	g_free (url);
+
+	return g_list_prepend (files, val);
+}
+
+static GList *
+xmms_watcher_files_import (xmms_watcher_t *watcher, GList *files)
+{
+	xmms_error_t err;
+
+	if (files) {
+		xmms_error_reset (&err);
+		xmms_medialib_import_files (watcher->medialib,
+		                            g_list_reverse (files), &err);
+	}
+
+	return NULL;
+}
+
+static void
+xmms_watcher_dir_import (xmms_watcher_t *watcher, const gchar *path)
+{
+	xmms_error_t err;
+	gchar *url;
+
+	url = xmms_watcher_url (path);
+
+	xmms_error_reset (&err);
+	xmms_medialib_add_recursive (watcher->medialib, NULL, url, &err);
+
+	g_free (url);
+}
+
+/* Watch the whole tree below root again and bring the medialib up to
+ * date with it, for when changes may have gone unnoticed.
+ */
+static void
+xmms_watcher_resync (xmms_watcher_t *watcher)
+{
+	GHashTableIter it;
+	gpointer key;
+	gchar *url;
+
+	g_hash_table_iter_init (&it, watcher->wds);
+	while (g_hash_table_iter_next (&it, &key, NULL)) {
+		inotify_rm_watch (watcher->fd, GPOINTER_TO_INT (key));
+	}
+	g_hash_table_remove_all (watcher->wds);
+	g_hash_table_remove_all (watcher->dirs);
+
+	xmms_watcher_add_dir (watcher, watcher->root);
+	xmms_log_info ("Watching %u directories below '%s'",
+	               g_hash_table_size (watcher->wds), watcher->root);
+
+	url = xmms_watcher_url (watcher->root);
+	xmms_medialib_remove_vanished (watcher->medialib, url);
+	g_free (url);
+
+	xmms_watcher_dir_import (watcher, watcher->root);
+}
+
+static void
+xmms_watcher_process (xmms_watcher_t *watcher, xmms_watcher_event_t *ev,
+                      GList **files)
+{
+	gchar *url, *dest;
+	struct stat st;
+
+	switch (ev->action) {
+		case XMMS_WATCHER_ADDED:
+			if (ev->isdir) {
+				*files = xmms_watcher_files_import (watcher, *files);
+				xmms_watcher_dir_import (watcher, ev->path);
+			} else {
+				*files = xmms_watcher_file_add (*files, ev->path);
+			}
+			break;
+		case XMMS_WATCHER_REMOVED:
+			*files = xmms_watcher_files_import (watcher, *files);
+
+			/* moved out, the kernel keeps watching it */
+			if (ev->isdir && (lstat (ev->path, &st) || !S_ISDIR (st.st_mode))) {
+				xmms_watcher_remove_dir (watcher, ev->path);
+			}
+
+			url = xmms_watcher_url (ev->path);
+			xmms_medialib_remove_recursive (watcher->medialib, url);
+			g_free (url);
+			break;
+		case XMMS_WATCHER_MOVED:
+			*files = xmms_watcher_files_import (watcher, *files);
+
+			url = xmms_watcher_url (ev->path);
+			dest = xmms_watcher_url (ev->dest);
+
+			/* a file moved over another one, as when saved through
+			 * a temporary file, takes its place and keeps its id */
+			if (ev->isdir) {
+				xmms_medialib_move_recursive (watcher->medialib, url, dest);
+			} else {
+				xmms_medialib_replace (watcher->medialib, url, dest);
+			}
+
+			g_free (url);
+			g_free (dest);
+
+			/* pick up whatever changed before the move */
+			if (ev->isdir) {
+				xmms_watcher_dir_import (watcher, ev->dest);
+			} else {
+				*files = xmms_watcher_file_add (*files, ev->dest);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static gboolean
+xmms_watcher_flush (gpointer udata)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) udata;
+	xmms_watcher_event_t *ev;
+	GList *files = NULL;
+	guint count;
+
+	watcher->timer = NULL;
+
+	if (watcher->rescan) {
+		xmms_log_info ("Missed changes below '%s', rescanning", watcher->root);
+		xmms_watcher_events_clear (watcher);
+		xmms_watcher_resync (watcher);
+		return FALSE;
+	}
+
+	g_hash_table_remove_all (watcher->pending);
+	g_hash_table_remove_all (watcher->moves);
+
+	count = g_queue_get_length (watcher->events);
+
+	while ((ev = g_queue_pop_head (watcher->events))) {
+		xmms_watcher_process (watcher, ev, &files);
+		xmms_watcher_event_free (ev);
+	}
+
+	xmms_watcher_files_import (watcher, files);
+
+	XMMS_DBG ("Flushed %u changes from %u events (%u coalesced), "
+	          "watching %u directories", count, watcher->received,
+	          watcher->coalesced, g_hash_table_size (watcher->wds));
+
+	watcher->received = 0;
+	watcher->coalesced = 0;
+	watcher->delays = 0;
+
+	return FALSE;
+}
+
+/* (Re)start the timer so the events are flushed once things calm
+ * down, but don't put it off forever.
+ */
+static void
+xmms_watcher_schedule (xmms_watcher_t *watcher)
+{
+	xmms_config_property_t *cv;
+	gint delay;
+
+	if (g_queue_is_empty (watcher->events) && !watcher->rescan) {
+		return;
+	}
+
+	if (watcher->timer) {
+		if (watcher->delays >= XMMS_WATCHER_MAX_DELAYS) {
+			return;
+		}
+		g_source_destroy (watcher->timer);
+		watcher->delays++;
+	}
+
+	cv = xmms_config_lookup ("medialib.watch_delay");
+	delay = MAX (0, xmms_config_property_get_int (cv));
+
+	watcher->timer = g_timeout_source_new (delay);
+	g_source_set_callback (watcher->timer, xmms_watcher_flush, watcher, NULL);
+	g_source_attach (watcher->timer, watcher->context);
+	g_source_unref (watcher->timer);
+}
+
+static gboolean
+xmms_watcher_read (GIOChannel *chan, GIOCondition cond, gpointer udata)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) udata;
+	guint32 buf[4096];
+	gchar *p;
+	gssize len;
+
+	len = read (watcher->fd, buf, sizeof (buf));
+	if (len < 0) {
+		if (errno == EAGAIN || errno == EINTR) {
+			return TRUE;
+		}
+		xmms_log_error ("Error reading inotify events: %s", strerror (errno));
+		return FALSE;
+	}
+
+	for (p = (gchar *) buf; p < (gchar *) buf + len; ) {
+		struct inotify_event *iev = (struct inotify_event *) p;
+
+		xmms_watcher_handle (watcher, iev);
+		p += sizeof (struct inotify_event) + iev->len;
+	}
+
+	xmms_watcher_schedule (watcher);
+
+	return TRUE;
+}
+
+static gboolean
+xmms_watcher_switch (gpointer udata)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) udata;
+	GHashTableIter it;
+	gpointer key;
+	gchar *root;
+	gint len;
+
+	g_mutex_lock (watcher->mutex);
+	root = watcher->new_root;
+	watcher->new_root = NULL;
+	g_mutex_unlock (watcher->mutex);
+
+	if (!root) {
+		return FALSE;
+	}
+
+	xmms_watcher_events_clear (watcher);
+
+	g_hash_table_iter_init (&it, watcher->wds);
+	while (g_hash_table_iter_next (&it, &key, NULL)) {
+		inotify_rm_watch (watcher->fd, GPOINTER_TO_INT (key));
+	}
+	g_hash_table_remove_all (watcher->wds);
+	g_hash_table_remove_all (watcher->dirs);
+
+	g_free (watcher->root);
+	watcher->root = NULL;
+
+	len = strlen (root);
+	while (len > 1 && root[len - 1] == '/') {
+		root[--len] = '\0';
+	}
+
+	if (!*root) {
+		g_free (root);
+		return FALSE;
+	}
+
+	watcher->root = root;
+
+	/* catch up with what changed while we weren't looking */
+	xmms_watcher_resync (watcher);
+
+	return FALSE;
+}
+
+static void
+xmms_watcher_root_changed (xmms_object_t *object, xmmsv_t *data,
+                           gpointer udata)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) udata;
+	xmms_config_property_t *cv = (xmms_config_property_t *) object;
+	GSource *source;
+
+	g_mutex_lock (watcher->mutex);
+	g_free (watcher->new_root);
+	watcher->new_root = g_strdup (xmms_config_property_get_string (cv));
+	g_mutex_unlock (watcher->mutex);
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, xmms_watcher_switch, watcher, NULL);
+	g_source_attach (source, watcher->context);
+	g_source_unref (source);
+}
+
+static gboolean
+xmms_watcher_quit (gpointer udata)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) udata;
+
+	g_main_loop_quit (watcher->ml);
+
+	return FALSE;
+}
+
+static gpointer
+xmms_watcher_thread (gpointer data)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) data;
+
+	xmms_set_thread_name ("x2 watcher");
+
+	xmms_watcher_switch (watcher);
+
+	g_main_loop_run (watcher->ml);
+
+	return NULL;
+}
+
+static void
+xmms_watcher_destroy (xmms_object_t *object)
+{
+	xmms_watcher_t *watcher = (xmms_watcher_t *) object;
+	xmms_config_property_t *cv;
+	GSource *source;
+
+	cv = xmms_config_lookup ("medialib.watch_dir");
+	xmms_config_property_callback_remove (cv, xmms_watcher_root_changed,
+	                                      watcher);
+
+	if (watcher->thread) {
+		source = g_idle_source_new ();
+		g_source_set_callback (source, xmms_watcher_quit, watcher, NULL);
+		g_source_attach (source, watcher->context);
+		g_source_unref (source);
+
+		g_thread_join (watcher->thread);
+	}
+
+	xmms_watcher_events_clear (watcher);
+
+	if (watcher->source) {
+		g_source_destroy (watcher->source);
+	}
+	if (watcher->fd >= 0) {
+		close (watcher->fd);
+	}
+
+	g_hash_table_destroy (watcher->wds);
+	g_hash_table_destroy (watcher->dirs);
+	g_hash_table_destroy (watcher->pending);
+	g_hash_table_destroy (watcher->moves);
+	g_queue_free (watcher->events);
+
+	g_main_loop_unref (watcher->ml);
+	g_main_context_unref (watcher->context);
+
+	g_mutex_free (watcher->mutex);
+	g_free (watcher->new_root);
+	g_free (watcher->root);
+}
+
+/**
+ * Start watching the directory configured in medialib.watch_dir for
+ * changes.
+ */
+xmms_watcher_t *
+xmms_watcher_start (xmms_medialib_t *medialib)
+{
+	xmms_watcher_t *watcher;
+	xmms_config_property_t *cv;
+	GIOChannel *chan;
+
+	watcher = xmms_object_new (xmms_watcher_t, xmms_watcher_destroy);
+	watcher->medialib = medialib;
+
+	watcher->mutex = g_mutex_new ();
+	watcher->context = g_main_context_new ();
+	watcher->ml = g_main_loop_new (watcher->context, FALSE);
+
+	watcher->wds = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+	                                      NULL, g_free);
+	watcher->dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                       g_free, NULL);
+	watcher->pending = g_hash_table_new (g_str_hash, g_str_equal);
+	watcher->moves = g_hash_table_new (g_direct_hash, g_direct_equal);
+	watcher->events = g_queue_new ();
+
+	xmms_config_property_register ("medialib.watch_delay", "1000", NULL, NULL);
+	cv = xmms_config_property_register ("medialib.watch_dir", "",
+	                                    xmms_watcher_root_changed, watcher);
+
+	watcher->new_root = g_strdup (xmms_config_property_get_string (cv));
+
+	watcher->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+	if (watcher->fd < 0) {
+		xmms_log_error ("Unable to initialize inotify: %s", strerror (errno));
+		return watcher;
+	}
+
+	chan = g_io_channel_unix_new (watcher->fd);
+	watcher->source = g_io_create_watch (chan, G_IO_IN);
+	g_source_set_callback (watcher->source, (GSourceFunc) xmms_watcher_read,
+	                       watcher, NULL);
+	g_source_attach (watcher->source, watcher->context);
+	g_source_unref (watcher->source);
+	g_io_channel_unref (chan);
+
+	watcher->thread = g_thread_create (xmms_watcher_thread, watcher, TRUE, NULL);
+
+	return watcher;
+}
@@ -132,6 +132,12 @@ xmms_converter_plugin_seek (xmms_xform_t *xform, gint64 samples, xmms_xform_seek
 	return scaled_samples;
 }
 
+static gboolean
+xmms_converter_plugin_reinit (xmms_xform_t *xform)
+{
+	return TRUE;
+}
+
 static gboolean
 xmms_converter_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 {
@@ -142,6 +148,7 @@ xmms_converter_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.destroy = xmms_converter_plugin_destroy;
 	methods.read = xmms_converter_plugin_read;
 	methods.seek = xmms_converter_plugin_seek;
+	methods.reinit = xmms_converter_plugin_reinit;
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -0,0 +1,456 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Decoder benchmark.
+ *
+ * Sets up the xform chain of every file given, the way the daemon does
+ * for playback but without the effects, and reads it to the end as
+ * fast as it goes, with nothing behind it. Prints one JSON object per
+ * file and line with the decoder chain, throughput, realtime factor,
+ * glib allocations per second and read latencies.
+ *
+ * The medialib and configuration live in a temporary directory that
+ * is removed afterwards. Config values can be set with -D, for
+ * instance -D mpg123.priority.audio/mpeg=0 to bench mad on mp3 files.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_medialib.h"
+#include "xmms/xmms_sample.h"
+#include "xmmspriv/xmms_bindata.h"
+#include "xmmspriv/xmms_config.h"
+#include "xmmspriv/xmms_ipc.h"
+#include "xmmspriv/xmms_log.h"
+#include "xmmspriv/xmms_medialib.h"
+#include "xmmspriv/xmms_plugin.h"
+#include "xmmspriv/xmms_streamtype.h"
+#include "xmmspriv/xmms_utils.h"
+#include "xmmspriv/xmms_xform.h"
+
+/** Same as the output filler */
+#define XMMS_BENCH_READ_SIZE 4096
+
+typedef struct xmms_bench_result_St {
+	gchar *chain;
+	guint64 input_bytes;
+	guint64 pcm_bytes;
+	gdouble audio_seconds;
+	gdouble setup_seconds;
+	/** Of the fastest round */
+	gdouble seconds;
+	/** Over all rounds */
+	gdouble total_seconds;
+	gint allocs;
+	GArray *latencies;
+} xmms_bench_result_t;
+
+static gint allocs;
+
+/** The log goes to stdout too */
+static FILE *output;
+
+static gpointer
+count_malloc (gsize n)
+{
+	g_atomic_int_inc (&allocs);
+	return malloc (n);
+}
+
+static gpointer
+count_realloc (gpointer mem, gsize n)
+{
+	g_atomic_int_inc (&allocs);
+	return realloc (mem, n);
+}
+
+static gpointer
+count_calloc (gsize n, gsize size)
+{
+	g_atomic_int_inc (&allocs);
+	return calloc (n, size);
+}
+
+static GMemVTable count_vtable = {
+	count_malloc, count_realloc, free, count_calloc, NULL, NULL
+};
+
+static void
+remove_tree (const gchar *path)
+{
+	const gchar *name;
+	gchar *child;
+	GDir *dir;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name (dir))) {
+			child = g_build_filename (path, name, NULL);
+			remove_tree (child);
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+
+	g_remove (path);
+}
+
+static void
+json_string (GString *out, const gchar *key, const gchar *str)
+{
+	g_string_append_printf (out, ", \"%s\": \"", key);
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\') {
+			g_string_append_printf (out, "\\%c", *str);
+		} else if ((guchar) *str < 0x20) {
+			g_string_append_printf (out, "\\u%04x", *str);
+		} else {
+			g_string_append_c (out, *str);
+		}
+	}
+
+	g_string_append_c (out, '"');
+}
+
+static gint
+cmp_double (gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static gdouble
+percentile (GArray *values, gint p)
+{
+	if (!values->len) {
+		return 0.0;
+	}
+
+	return g_array_index (values, gdouble, (values->len - 1) * p / 100);
+}
+
+/* one pass over the chain, returns FALSE on errors */
+static gboolean
+bench_round (xmms_medialib_entry_t entry, const gchar *url, GList *goal,
+             xmms_bench_result_t *res, xmms_error_t *err)
+{
+	xmms_xform_t *xform;
+	xmms_sample_format_t fmt;
+	gchar buf[XMMS_BENCH_READ_SIZE];
+	GTimer *timer;
+	gdouble start, now, seconds;
+	guint64 bytes = 0;
+	gint ret, rate, channels, before;
+
+	timer = g_timer_new ();
+
+	xform = xmms_xform_chain_setup_url (entry, url, goal, TRUE);
+	res->setup_seconds = MIN (res->setup_seconds, g_timer_elapsed (timer, NULL));
+
+	if (!xform) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "no chain for this file");
+		g_timer_destroy (timer);
+		return FALSE;
+	}
+
+	rate = xmms_xform_outtype_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	channels = xmms_xform_outtype_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	fmt = xmms_xform_outtype_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
+
+	before = g_atomic_int_get (&allocs);
+	start = now = g_timer_elapsed (timer, NULL);
+
+	do {
+		ret = xmms_xform_this_read (xform, buf, sizeof (buf), err);
+		seconds = g_timer_elapsed (timer, NULL) - now;
+		now += seconds;
+
+		if (ret > 0) {
+			bytes += ret;
+			g_array_append_val (res->latencies, seconds);
+		}
+	} while (ret > 0);
+
+	/* empty files should not divide by zero */
+	seconds = MAX (now - start, 1e-9);
+	res->allocs += g_atomic_int_get (&allocs) - before;
+	res->total_seconds += seconds;
+	res->seconds = MIN (res->seconds, seconds);
+	res->pcm_bytes = bytes;
+
+	if (rate > 0 && channels > 0) {
+		res->audio_seconds = (gdouble) bytes /
+		                     (rate * channels * xmms_sample_size_get (fmt));
+	}
+
+	xmms_object_unref (xform);
+	g_timer_destroy (timer);
+
+	return ret == 0;
+}
+
+static void
+bench_file (const gchar *path, GList *goal, gint rounds)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry;
+	xmms_bench_result_t res;
+	xmms_error_t err;
+	struct stat st;
+	GString *out;
+	gchar *abspath, *url;
+	gint i;
+
+	memset (&res, 0, sizeof (res));
+	res.seconds = res.setup_seconds = G_MAXDOUBLE;
+	res.latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	xmms_error_reset (&err);
+
+	out = g_string_new ("{");
+	g_string_append_printf (out, "\"rounds\": %d", rounds);
+	json_string (out, "file", path);
+
+	if (g_path_is_absolute (path)) {
+		abspath = g_strdup (path);
+	} else {
+		gchar *cwd = g_get_current_dir ();
+		abspath = g_build_filename (cwd, path, NULL);
+		g_free (cwd);
+	}
+	url = g_strconcat ("file://", abspath, NULL);
+	g_free (abspath);
+
+	if (g_stat (path, &st) == 0) {
+		res.input_bytes = st.st_size;
+	}
+
+	session = xmms_medialib_begin_write ();
+	entry = xmms_medialib_entry_new (session, url, &err);
+	xmms_medialib_end (session);
+	g_free (url);
+
+	if (!entry) {
+		if (!xmms_error_iserror (&err)) {
+			xmms_error_set (&err, XMMS_ERROR_GENERIC,
+			                "could not add the file to the medialib");
+		}
+		goto out;
+	}
+
+	/* the chain setup wants the encoded url, as stored in the medialib */
+	session = xmms_medialib_begin ();
+	url = xmms_medialib_entry_property_get_str (session, entry,
+	                                            XMMS_MEDIALIB_ENTRY_PROPERTY_URL);
+	xmms_medialib_end (session);
+
+	for (i = 0; i < rounds; i++) {
+		if (!bench_round (entry, url, goal, &res, &err)) {
+			break;
+		}
+	}
+	g_free (url);
+
+	session = xmms_medialib_begin ();
+	res.chain = xmms_medialib_entry_property_get_str (session, entry,
+	                                                  XMMS_MEDIALIB_ENTRY_PROPERTY_CHAIN);
+	xmms_medialib_end (session);
+
+out:
+	if (res.chain) {
+		json_string (out, "chain", res.chain);
+	}
+
+	if (xmms_error_iserror (&err)) {
+		json_string (out, "error", xmms_error_message_get (&err));
+	} else {
+		g_array_sort (res.latencies, cmp_double);
+
+		/* the fastest round for throughput, all of them for the rest */
+		g_string_append_printf (out,
+		                        ", \"input_bytes\": %" G_GUINT64_FORMAT
+		                        ", \"pcm_bytes\": %" G_GUINT64_FORMAT
+		                        ", \"audio_seconds\": %.3f"
+		                        ", \"setup_ms\": %.3f"
+		                        ", \"seconds\": %.6f"
+		                        ", \"input_mb_per_s\": %.3f"
+		                        ", \"pcm_mb_per_s\": %.3f"
+		                        ", \"realtime\": %.1f"
+		                        ", \"allocs_per_s\": %.0f"
+		                        ", \"reads\": %u"
+		                        ", \"read_p50_us\": %.1f"
+		                        ", \"read_p99_us\": %.1f"
+		                        ", \"read_max_us\": %.1f",
+		                        res.input_bytes, res.pcm_bytes,
+		                        res.audio_seconds,
+		                        res.setup_seconds * 1000,
+		                        res.seconds,
+		                        res.input_bytes / res.seconds / 1e6,
+		                        res.pcm_bytes / res.seconds / 1e6,
+		                        res.audio_seconds / res.seconds,
+		                        res.allocs / res.total_seconds,
+		                        res.latencies->len / rounds,
+		                        percentile (res.latencies, 50) * 1e6,
+		                        percentile (res.latencies, 99) * 1e6,
+		                        percentile (res.latencies, 100) * 1e6);
+	}
+
+	g_string_append (out, "}");
+	fprintf (output, "%s\n", out->str);
+	fflush (output);
+
+	g_string_free (out, TRUE);
+	g_array_free (res.latencies, TRUE);
+	g_free (res.chain);
+}
+
+static void
+set_config (gchar **defines)
+{
+	xmms_config_property_t *cv;
+	gchar **kv;
+
+	for (; defines && *defines; defines++) {
+		kv = g_strsplit (*defines, "=", 2);
+		if (!kv[0] || !kv[1]) {
+			g_printerr ("Bad config value '%s', use key=value\n", *defines);
+			exit (EXIT_FAILURE);
+		}
+
+		cv = xmms_config_lookup (kv[0]);
+		if (!cv) {
+			g_printerr ("No config value named '%s'\n", kv[0]);
+			exit (EXIT_FAILURE);
+		}
+		xmms_config_property_set_data (cv, kv[1]);
+
+		g_strfreev (kv);
+	}
+}
+
+int
+main (int argc, char **argv)
+{
+	xmms_stream_type_t *f;
+	GOptionContext *context;
+	GError *error = NULL;
+	GList *goal;
+	gchar *ppath = NULL, *outname = NULL, **defines = NULL;
+	gchar *tmpdir, *conffile, *confdir;
+	gboolean verbose = FALSE;
+	gint i, rounds = 3;
+
+	GOptionEntry opts[] = {
+		{"plugindir", 'p', 0, G_OPTION_ARG_FILENAME, &ppath, "Search for plugins in directory 'foo'", "<foo>"},
+		{"rounds", 'r', 0, G_OPTION_ARG_INT, &rounds, "Decode every file 'n' times", "<n>"},
+		{"output", 'o', 0, G_OPTION_ARG_FILENAME, &outname, "Write the results to 'file' instead of stdout", "<file>"},
+		{"define", 'D', 0, G_OPTION_ARG_STRING_ARRAY, &defines, "Set a config value", "<key=value>"},
+		{"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Log what the daemon would", NULL},
+		{NULL}
+	};
+
+	/* count every glib allocation, before the first */
+	setenv ("G_SLICE", "always-malloc", 1);
+	g_mem_set_vtable (&count_vtable);
+
+	g_thread_init (NULL);
+
+	context = g_option_context_new ("file... - benchmark the decoders");
+	g_option_context_add_main_entries (context, opts, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error) || error) {
+		g_printerr ("Error parsing options: %s\n", error->message);
+		exit (EXIT_FAILURE);
+	}
+	g_option_context_free (context);
+
+	if (argc < 2 || rounds < 1) {
+		g_printerr ("Usage: %s [-p plugindir] [-r rounds] [-o file] [-D key=value] file...\n",
+		            argv[0]);
+		exit (EXIT_FAILURE);
+	}
+
+	output = outname ? fopen (outname, "w") : stdout;
+	if (!output) {
+		g_printerr ("Could not open %s\n", outname);
+		exit (EXIT_FAILURE);
+	}
+
+	tmpdir = g_build_filename (g_get_tmp_dir (), "xmms2-bench-XXXXXX", NULL);
+	if (!mkdtemp (tmpdir)) {
+		g_printerr ("Could not create %s\n", tmpdir);
+		exit (EXIT_FAILURE);
+	}
+	g_setenv ("XDG_CONFIG_HOME", tmpdir, TRUE);
+
+	xmms_log_init (verbose ? 2 : 0);
+	xmms_ipc_init ();
+
+	conffile = XMMS_BUILD_PATH ("xmms2.conf");
+	confdir = g_path_get_dirname (conffile);
+	g_mkdir_with_parents (confdir, 0755);
+	xmms_config_init (conffile);
+
+	if (!xmms_plugin_init (ppath)) {
+		exit (EXIT_FAILURE);
+	}
+
+	/* no playlist, so no mediainfo reader either */
+	xmms_medialib_init (NULL);
+	xmms_xform_object_init ();
+
+	/* tag readers store embedded pictures */
+	xmms_bindata_init ();
+
+	set_config (defines);
+
+	/* what the decoders give, as the output would take it */
+	f = _xmms_stream_type_new (NULL,
+	                           XMMS_STREAM_TYPE_MIMETYPE,
+	                           "audio/pcm",
+	                           XMMS_STREAM_TYPE_END);
+	goal = g_list_prepend (NULL, f);
+
+	for (i = 1; i < argc; i++) {
+		bench_file (argv[i], goal, rounds);
+	}
+
+	xmms_object_unref (f);
+	g_list_free (goal);
+
+	remove_tree (tmpdir);
+
+	if (output != stdout) {
+		fclose (output);
+	}
+
+	g_free (confdir);
+	g_free (conffile);
+	g_free (tmpdir);
+	g_strfreev (defines);
+	g_free (outname);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,526 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Loudness analysis of medialib entries.
+ *
+ * Queued entries are decoded to float samples by a pool of worker
+ * threads, through the same xform chain as for playback but without
+ * the effects, and measured as fast as the decoders go. The gain that
+ * brings a track to the ReplayGain reference level of -18 LUFS and its
+ * true peak are stored in the medialib as gain_track and peak_track,
+ * under their own source that is preferred over the tags.
+ * The other tracks of the album of a queued entry are queued along with
+ * it, and the album is measured as a whole once the last of them is
+ * done, for gain_album and peak_album.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_medialib.h"
+#include "xmms/xmms_sample.h"
+#include "xmmspriv/xmms_config.h"
+#include "xmmspriv/xmms_gainscan.h"
+#include "xmmspriv/xmms_loudness.h"
+#include "xmmspriv/xmms_medialib.h"
+#include "xmmspriv/xmms_streamtype.h"
+#include "xmmspriv/xmms_xform.h"
+#include "xmmsc/xmmsc_idnumbers.h"
+
+/** Loudness the gains bring tracks to, in LUFS */
+#define XMMS_GAINSCAN_REFERENCE -18.0
+
+/** Kept apart from the server source, so a rehash doesn't clear the
+ * measured values and still drops those read from removed tags. */
+#define XMMS_GAINSCAN_SOURCE "server/gainscan"
+
+typedef struct xmms_gainscan_album_St {
+	/** Tracks not measured yet */
+	gint pending;
+	GList *tracks;
+} xmms_gainscan_album_t;
+
+typedef struct xmms_gainscan_track_St {
+	xmms_medialib_entry_t entry;
+	xmms_gainscan_album_t *album;
+	/** NULL if the entry could not be measured */
+	xmms_loudness_t *meter;
+} xmms_gainscan_track_t;
+
+static struct {
+	xmms_object_t *medialib;
+	GList *goal;
+	GThreadPool *pool;
+	gboolean stopping;
+
+	/** Protects everything below */
+	GMutex *mutex;
+
+	/** Entries queued or being measured */
+	GHashTable *queued;
+
+	/** Progress since the pool was last idle */
+	gint total;
+	gint done;
+	gint failed;
+} gainscan;
+
+static void xmms_gainscan_worker (gpointer data, gpointer udata);
+
+void
+xmms_gainscan_init (xmms_object_t *medialib)
+{
+	xmms_config_property_t *cv;
+	xmms_stream_type_t *f;
+	gint threads;
+
+	cv = xmms_config_property_register ("medialib.gainscan_threads",
+	                                    "4", NULL, NULL);
+	threads = MAX (1, xmms_config_property_get_int (cv));
+
+	f = _xmms_stream_type_new (NULL,
+	                           XMMS_STREAM_TYPE_MIMETYPE,
+	                           "audio/pcm",
+	                           XMMS_STREAM_TYPE_FMT_FORMAT,
+	                           XMMS_SAMPLE_FORMAT_FLOAT,
+	                           XMMS_STREAM_TYPE_END);
+
+	gainscan.medialib = medialib;
+	gainscan.goal = g_list_prepend (NULL, f);
+	gainscan.mutex = g_mutex_new ();
+	gainscan.queued = g_hash_table_new (g_direct_hash, g_direct_equal);
+	gainscan.pool = g_thread_pool_new (xmms_gainscan_worker, NULL,
+	                                   threads, FALSE, NULL);
+}
+
+/**
+ * Stop measuring, the entries still queued are dropped.
+ */
+void
+xmms_gainscan_shutdown (void)
+{
+	gainscan.stopping = TRUE;
+
+	/* the workers make short work of what is left */
+	g_thread_pool_free (gainscan.pool, FALSE, TRUE);
+
+	g_hash_table_destroy (gainscan.queued);
+	g_mutex_free (gainscan.mutex);
+
+	xmms_object_unref (gainscan.goal->data);
+	g_list_free (gainscan.goal);
+}
+
+/* album and album artist, or NULL for tracks that are not on an album */
+static gchar *
+xmms_gainscan_album_key (xmms_medialib_session_t *session,
+                         xmms_medialib_entry_t entry)
+{
+	gchar *album, *artist, *key;
+
+	album = xmms_medialib_entry_property_get_str (session, entry,
+	                                              XMMS_MEDIALIB_ENTRY_PROPERTY_ALBUM);
+	if (!album) {
+		return NULL;
+	}
+
+	artist = xmms_medialib_entry_property_get_str (session, entry,
+	                                               XMMS_MEDIALIB_ENTRY_PROPERTY_ALBUM_ARTIST);
+	if (!artist &&
+	    xmms_medialib_entry_property_get_int (session, entry,
+	                                          XMMS_MEDIALIB_ENTRY_PROPERTY_COMPILATION) != 1) {
+		artist = xmms_medialib_entry_property_get_str (session, entry,
+		                                               XMMS_MEDIALIB_ENTRY_PROPERTY_ARTIST);
+	}
+
+	key = g_strconcat (album, "\n", artist ? artist : "", NULL);
+
+	g_free (album);
+	g_free (artist);
+
+	return key;
+}
+
+/* Mark the entry as queued, FALSE if it already is. */
+static gboolean
+xmms_gainscan_claim (gpointer entry)
+{
+	gboolean ret = FALSE;
+
+	g_mutex_lock (gainscan.mutex);
+	if (!g_hash_table_lookup (gainscan.queued, entry)) {
+		g_hash_table_insert (gainscan.queued, entry, entry);
+		ret = TRUE;
+	}
+	g_mutex_unlock (gainscan.mutex);
+
+	return ret;
+}
+
+static xmms_gainscan_track_t *
+xmms_gainscan_track_new (xmms_medialib_entry_t entry,
+                         xmms_gainscan_album_t *album)
+{
+	xmms_gainscan_track_t *track;
+
+	track = g_new0 (xmms_gainscan_track_t, 1);
+	track->entry = entry;
+
+	if (album) {
+		album->tracks = g_list_prepend (album->tracks, track);
+		album->pending++;
+		track->album = album;
+	}
+
+	return track;
+}
+
+/* Add the tracks of the album that were not queued themselves, the
+ * album gain must cover all of it. Tracks queued by an earlier call
+ * are already part of an album of their own.
+ */
+static GList *
+xmms_gainscan_album_fill (xmms_medialib_session_t *session,
+                          xmms_gainscan_album_t *album, const gchar *key,
+                          GList *tracks, gint *count)
+{
+	xmms_gainscan_track_t *first = album->tracks->data;
+	GList *res, *n;
+	gchar *name, *esc, *query, *other;
+	gint32 id;
+
+	name = xmms_medialib_entry_property_get_str (session, first->entry,
+	                                             XMMS_MEDIALIB_ENTRY_PROPERTY_ALBUM);
+	if (!name) {
+		return tracks;
+	}
+
+	esc = sqlite_prepare_string (name);
+	query = g_strdup_printf ("SELECT DISTINCT id FROM Media "
+	                         "WHERE key='%s' AND value=%s",
+	                         XMMS_MEDIALIB_ENTRY_PROPERTY_ALBUM, esc);
+	res = xmms_medialib_select (session, query, NULL);
+	g_free (query);
+	g_free (esc);
+	g_free (name);
+
+	for (n = res; n; n = g_list_next (n)) {
+		if (xmmsv_dict_entry_get_int (n->data, "id", &id)) {
+			other = xmms_gainscan_album_key (session, id);
+			if (other && !strcmp (other, key) &&
+			    xmms_gainscan_claim (GINT_TO_POINTER (id))) {
+				tracks = g_list_prepend (tracks,
+				                         xmms_gainscan_track_new (id, album));
+				(*count)++;
+			}
+			g_free (other);
+		}
+		xmmsv_unref (n->data);
+	}
+
+	g_list_free (res);
+
+	return tracks;
+}
+
+/**
+ * Queue entries for measuring, entries already queued are skipped.
+ * The other tracks of their albums are queued as well.
+ *
+ * @param entries A list of medialib entries, as GINT_TO_POINTER
+ * @returns the number of entries queued.
+ */
+gint
+xmms_gainscan_queue (GList *entries)
+{
+	xmms_medialib_session_t *session;
+	xmms_gainscan_album_t *album;
+	xmms_gainscan_track_t *track;
+	GHashTable *albums;
+	GHashTableIter it;
+	GList *n, *tracks = NULL;
+	gpointer entry, value;
+	gchar *key;
+	gint count = 0;
+
+	albums = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	session = xmms_medialib_begin ();
+
+	for (n = entries; n; n = g_list_next (n)) {
+		entry = n->data;
+
+		if (!xmms_gainscan_claim (entry)) {
+			continue;
+		}
+
+		album = NULL;
+
+		key = xmms_gainscan_album_key (session, GPOINTER_TO_INT (entry));
+		if (key) {
+			album = g_hash_table_lookup (albums, key);
+			if (!album) {
+				album = g_new0 (xmms_gainscan_album_t, 1);
+				g_hash_table_insert (albums, key, album);
+			} else {
+				g_free (key);
+			}
+		}
+
+		track = xmms_gainscan_track_new (GPOINTER_TO_INT (entry), album);
+		tracks = g_list_prepend (tracks, track);
+		count++;
+	}
+
+	g_hash_table_iter_init (&it, albums);
+	while (g_hash_table_iter_next (&it, &entry, &value)) {
+		tracks = xmms_gainscan_album_fill (session, value, entry,
+		                                   tracks, &count);
+	}
+
+	xmms_medialib_end (session);
+
+	g_hash_table_destroy (albums);
+
+	g_mutex_lock (gainscan.mutex);
+	gainscan.total += count;
+	g_mutex_unlock (gainscan.mutex);
+
+	/* only now, the albums must be complete before any track is done */
+	tracks = g_list_reverse (tracks);
+	for (n = tracks; n; n = g_list_next (n)) {
+		g_thread_pool_push (gainscan.pool, n->data, NULL);
+	}
+	g_list_free (tracks);
+
+	return count;
+}
+
+static xmms_loudness_t *
+xmms_gainscan_measure (xmms_medialib_entry_t entry)
+{
+	xmms_loudness_t *meter;
+	xmms_xform_t *xform;
+	xmms_error_t err;
+	gfloat buf[4096];
+	gchar *data = (gchar *) buf;
+	gint channels, rate, framesize, frames, fill = 0, ret;
+
+	xform = xmms_xform_chain_setup_decoder (entry, gainscan.goal);
+	if (!xform) {
+		return NULL;
+	}
+
+	channels = xmms_xform_outtype_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	rate = xmms_xform_outtype_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	framesize = channels * sizeof (gfloat);
+
+	if (channels <= 0 || rate <= 0 || framesize > (gint) sizeof (buf)) {
+		xmms_log_error ("Can't measure entry %d with %d channels at %dHz",
+		                entry, channels, rate);
+		xmms_object_unref (xform);
+		return NULL;
+	}
+
+	meter = xmms_loudness_new (channels, rate);
+	xmms_error_reset (&err);
+
+	do {
+		ret = xmms_xform_this_read (xform, data + fill,
+		                            sizeof (buf) - fill, &err);
+		if (ret > 0) {
+			fill += ret;
+			frames = fill / framesize;
+			xmms_loudness_add_frames (meter, buf, frames);
+
+			fill -= frames * framesize;
+			memmove (data, data + frames * framesize, fill);
+		}
+	} while (ret > 0 && !gainscan.stopping);
+
+	xmms_object_unref (xform);
+
+	if (ret < 0 || gainscan.stopping) {
+		xmms_loudness_free (meter);
+		return NULL;
+	}
+
+	return meter;
+}
+
+static void
+xmms_gainscan_store (xmms_medialib_session_t *session,
+                     xmms_medialib_entry_t entry, const gchar *gain_key,
+                     const gchar *peak_key, gdouble loudness, gdouble peak)
+{
+	guint32 source;
+	gchar buf[32];
+
+	source = xmms_medialib_source_to_id (session, XMMS_GAINSCAN_SOURCE);
+
+	/* stored linear, like the tag readers do */
+	g_snprintf (buf, sizeof (buf), "%f",
+	            pow (10.0, (XMMS_GAINSCAN_REFERENCE - loudness) / 20.0));
+	xmms_medialib_entry_property_set_str_source (session, entry, gain_key,
+	                                             buf, source);
+
+	g_snprintf (buf, sizeof (buf), "%f", peak);
+	xmms_medialib_entry_property_set_str_source (session, entry, peak_key,
+	                                             buf, source);
+}
+
+static void
+xmms_gainscan_album_store (xmms_gainscan_album_t *album)
+{
+	xmms_medialib_session_t *session;
+	xmms_gainscan_track_t *track;
+	xmms_loudness_t **meters;
+	gdouble loudness, peak = 0.0;
+	GList *n, *measured = NULL;
+	gint count = 0;
+
+	meters = g_new (xmms_loudness_t *, g_list_length (album->tracks));
+
+	for (n = album->tracks; n; n = g_list_next (n)) {
+		track = n->data;
+		if (track->meter) {
+			meters[count++] = track->meter;
+			peak = MAX (peak, xmms_loudness_true_peak (track->meter));
+		}
+	}
+
+	if (count && !gainscan.stopping) {
+		loudness = xmms_loudness_integrated (meters, count);
+
+		session = xmms_medialib_begin_write ();
+		for (n = album->tracks; n; n = g_list_next (n)) {
+			track = n->data;
+			if (track->meter) {
+				xmms_gainscan_store (session, track->entry,
+				                     XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_ALBUM,
+				                     XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_ALBUM,
+				                     loudness, peak);
+				measured = g_list_prepend (measured,
+				                           GINT_TO_POINTER (track->entry));
+			}
+		}
+		xmms_medialib_end (session);
+
+		for (n = measured; n; n = g_list_next (n)) {
+			xmms_medialib_entry_send_update (GPOINTER_TO_INT (n->data));
+		}
+		g_list_free (measured);
+	}
+
+	for (n = album->tracks; n; n = g_list_next (n)) {
+		track = n->data;
+		if (track->meter) {
+			xmms_loudness_free (track->meter);
+		}
+		g_free (track);
+	}
+
+	g_free (meters);
+	g_list_free (album->tracks);
+	g_free (album);
+}
+
+static void
+xmms_gainscan_worker (gpointer data, gpointer udata)
+{
+	xmms_gainscan_track_t *track = data;
+	xmms_gainscan_album_t *album = track->album;
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry = track->entry;
+	gboolean album_done = FALSE;
+	gdouble loudness = XMMS_LOUDNESS_SILENCE;
+	xmmsv_t *progress;
+
+	if (!gainscan.stopping) {
+		track->meter = xmms_gainscan_measure (entry);
+	}
+
+	/* silent or too short to be gated, there is no gain to give */
+	if (track->meter) {
+		loudness = xmms_loudness_integrated (&track->meter, 1);
+		if (loudness <= XMMS_LOUDNESS_SILENCE) {
+			xmms_log_info ("Entry %d is too short or silent to measure",
+			               entry);
+			xmms_loudness_free (track->meter);
+			track->meter = NULL;
+		}
+	}
+
+	if (track->meter) {
+		session = xmms_medialib_begin_write ();
+		xmms_gainscan_store (session, entry,
+		                     XMMS_MEDIALIB_ENTRY_PROPERTY_GAIN_TRACK,
+		                     XMMS_MEDIALIB_ENTRY_PROPERTY_PEAK_TRACK,
+		                     loudness, xmms_loudness_true_peak (track->meter));
+		xmms_medialib_end (session);
+
+		if (!album) {
+			xmms_medialib_entry_send_update (entry);
+		}
+	}
+
+	g_mutex_lock (gainscan.mutex);
+
+	g_hash_table_remove (gainscan.queued, GINT_TO_POINTER (entry));
+
+	if (track->meter) {
+		gainscan.done++;
+	} else {
+		gainscan.failed++;
+	}
+
+	progress = xmmsv_build_dict (XMMSV_DICT_ENTRY_INT ("id", entry),
+	                             XMMSV_DICT_ENTRY_INT ("total", gainscan.total),
+	                             XMMSV_DICT_ENTRY_INT ("done", gainscan.done),
+	                             XMMSV_DICT_ENTRY_INT ("failed", gainscan.failed),
+	                             XMMSV_DICT_END);
+
+	if (gainscan.done + gainscan.failed == gainscan.total) {
+		gainscan.total = gainscan.done = gainscan.failed = 0;
+	}
+
+	if (album) {
+		album_done = --album->pending == 0;
+	}
+
+	g_mutex_unlock (gainscan.mutex);
+
+	/* the last track of an album is the only one left touching it */
+	if (album_done) {
+		xmms_gainscan_album_store (album);
+	} else if (!album) {
+		if (track->meter) {
+			xmms_loudness_free (track->meter);
+		}
+		g_free (track);
+	}
+
+	if (!gainscan.stopping) {
+		xmms_object_emit (gainscan.medialib,
+		                  XMMS_IPC_SIGNAL_MEDIALIB_GAIN_SCAN_PROGRESS,
+		                  progress);
+	}
+	xmmsv_unref (progress);
+}
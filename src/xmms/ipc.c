@@ -31,7 +31,22 @@
   * @{
   */
 
+/* Maximum number of queued replies handed to a single write */
+#define XMMS_IPC_WRITE_MAX_MSGS 64
 
+/* Length of the out queue above which a client is counted as congested */
+#define XMMS_IPC_OUT_HIGH_WATER 1024
+
+/* Upper bound of the coalescing interval a client may ask for, in ms */
+#define XMMS_IPC_COALESCE_MAX 10000
+
+/** How values of a signal are merged when delivery is coalesced */
+typedef enum {
+	XMMS_IPC_COALESCE_NONE,   /* every value matters, never coalesced */
+	XMMS_IPC_COALESCE_LATEST, /* only the latest value is delivered */
+	XMMS_IPC_COALESCE_DICT,   /* dicts are merged, later keys win */
+	XMMS_IPC_COALESCE_IDS,    /* medialib ids are gathered into a list */
+} xmms_ipc_coalesce_kind_t;
 
 /**
  * The IPC object list
@@ -78,8 +93,33 @@ typedef struct xmms_ipc_client_St {
 
 	guint pendingsignals[XMMS_IPC_SIGNAL_END];
 	GList *broadcasts[XMMS_IPC_SIGNAL_END];
+
+	/** Coalescing interval asked for with the pending signals, in ms */
+	guint signalintervals[XMMS_IPC_SIGNAL_END];
+	struct xmms_ipc_coalesce_St *delayedsignals[XMMS_IPC_SIGNAL_END];
+
+	/** Out queue accounting, reported through the stats */
+	guint out_max;
+	guint out_congested;
+	guint coalesced;
 } xmms_ipc_client_t;
 
+/**
+ * A signal or broadcast registration of a client. Values are merged
+ * into value and written when the timer fires if the client asked
+ * for coalesced delivery, and written right away otherwise.
+ */
+typedef struct xmms_ipc_coalesce_St {
+	xmms_ipc_client_t *client;
+	guint signalid;
+	guint32 cookie;
+	guint interval;
+
+	xmmsv_t *value;
+	GHashTable *ids;
+	GSource *timer;
+} xmms_ipc_coalesce_t;
+
 static GMutex *ipc_servers_lock;
 static GList *ipc_servers = NULL;
 
@@ -91,6 +131,7 @@ static void xmms_ipc_client_destroy (xmms_ipc_client_t *client);
 static void xmms_ipc_register_signal (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg, xmmsv_t *arguments);
 static void xmms_ipc_register_broadcast (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg, xmmsv_t *arguments);
 static gboolean xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg);
+static void xmms_ipc_coalesce_free (xmms_ipc_coalesce_t *co);
 
 static void
 xmms_ipc_handle_cmd_value (xmms_ipc_msg_t *msg, xmmsv_t *val)
@@ -100,6 +141,213 @@ xmms_ipc_handle_cmd_value (xmms_ipc_msg_t *msg, xmmsv_t *val)
 	}
 }
 
+static xmms_ipc_coalesce_kind_t
+xmms_ipc_coalesce_kind (guint signalid)
+{
+	switch (signalid) {
+		case XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED:
+		case XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_UPDATE:
+		case XMMS_IPC_SIGNAL_MEDIALIB_ENTRIES_UPDATE:
+			return XMMS_IPC_COALESCE_IDS;
+		case XMMS_IPC_SIGNAL_CONFIGVALUE_CHANGED:
+			return XMMS_IPC_COALESCE_DICT;
+		case XMMS_IPC_SIGNAL_PLAYBACK_STATUS:
+		case XMMS_IPC_SIGNAL_PLAYBACK_VOLUME_CHANGED:
+		case XMMS_IPC_SIGNAL_PLAYBACK_PLAYTIME:
+		case XMMS_IPC_SIGNAL_PLAYBACK_CURRENTID:
+		case XMMS_IPC_SIGNAL_PLAYLIST_CURRENT_POS:
+		case XMMS_IPC_SIGNAL_PLAYLIST_LOADED:
+		case XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS:
+		case XMMS_IPC_SIGNAL_MEDIAINFO_READER_UNINDEXED:
+			return XMMS_IPC_COALESCE_LATEST;
+		default:
+			return XMMS_IPC_COALESCE_NONE;
+	}
+}
+
+/**
+ * Extract the optional coalescing interval following the signal id
+ * in the arguments of a signal or broadcast request.
+ */
+static guint
+xmms_ipc_coalesce_interval (guint signalid, xmmsv_t *arguments)
+{
+	gint32 interval;
+
+	if (xmms_ipc_coalesce_kind (signalid) == XMMS_IPC_COALESCE_NONE) {
+		return 0;
+	}
+
+	if (!xmmsv_list_get_int (arguments, 1, &interval) || interval <= 0) {
+		return 0;
+	}
+
+	return MIN (interval, XMMS_IPC_COALESCE_MAX);
+}
+
+static void
+xmms_ipc_coalesce_free (xmms_ipc_coalesce_t *co)
+{
+	if (co->timer) {
+		g_source_destroy (co->timer);
+		g_source_unref (co->timer);
+	}
+	if (co->value) {
+		xmmsv_unref (co->value);
+	}
+	if (co->ids) {
+		g_hash_table_destroy (co->ids);
+	}
+	g_free (co);
+}
+
+/**
+ * Merge a new value into the ones waiting for delivery.
+ * Should hold client->lock.
+ */
+static void
+xmms_ipc_coalesce_merge (xmms_ipc_coalesce_t *co, xmmsv_t *arg)
+{
+	xmmsv_list_iter_t *lit;
+	xmmsv_dict_iter_t *dit;
+	const gchar *key;
+	xmmsv_t *val;
+	gint32 id;
+
+	if (co->value || co->ids) {
+		co->client->coalesced++;
+	}
+
+	switch (xmms_ipc_coalesce_kind (co->signalid)) {
+		case XMMS_IPC_COALESCE_IDS:
+			if (!co->ids) {
+				co->ids = g_hash_table_new (NULL, NULL);
+			}
+			if (xmmsv_get_int (arg, &id)) {
+				g_hash_table_insert (co->ids, GINT_TO_POINTER (id), NULL);
+			} else if (xmmsv_get_list_iter (arg, &lit)) {
+				for (; xmmsv_list_iter_valid (lit); xmmsv_list_iter_next (lit)) {
+					if (xmmsv_list_iter_entry_int (lit, &id)) {
+						g_hash_table_insert (co->ids, GINT_TO_POINTER (id), NULL);
+					}
+				}
+			}
+			break;
+		case XMMS_IPC_COALESCE_DICT:
+			if (!co->value) {
+				co->value = xmmsv_new_dict ();
+			}
+			if (xmmsv_get_dict_iter (arg, &dit)) {
+				for (; xmmsv_dict_iter_valid (dit); xmmsv_dict_iter_next (dit)) {
+					xmmsv_dict_iter_pair (dit, &key, &val);
+					xmmsv_dict_set (co->value, key, val);
+				}
+			}
+			break;
+		default:
+			if (co->value) {
+				xmmsv_unref (co->value);
+			}
+			co->value = xmmsv_ref (arg);
+			break;
+	}
+}
+
+static gint
+xmms_ipc_coalesce_id_compare (gconstpointer a, gconstpointer b)
+{
+	return GPOINTER_TO_INT (a) - GPOINTER_TO_INT (b);
+}
+
+/**
+ * Write the merged value to the client.
+ * Should hold client->lock.
+ */
+static void
+xmms_ipc_coalesce_deliver (xmms_ipc_coalesce_t *co, guint32 cmd)
+{
+	xmms_ipc_msg_t *msg;
+	GList *ids, *n;
+
+	if (co->ids) {
+		ids = g_list_sort (g_hash_table_get_keys (co->ids),
+		                   xmms_ipc_coalesce_id_compare);
+
+		co->value = xmmsv_new_list ();
+		for (n = ids; n; n = g_list_next (n)) {
+			xmmsv_list_append_int (co->value, GPOINTER_TO_INT (n->data));
+		}
+
+		g_list_free (ids);
+		g_hash_table_destroy (co->ids);
+		co->ids = NULL;
+	}
+
+	if (co->value) {
+		msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, cmd);
+		xmms_ipc_msg_set_cookie (msg, co->cookie);
+		xmms_ipc_handle_cmd_value (msg, co->value);
+		xmms_ipc_client_msg_write (co->client, msg);
+
+		xmmsv_unref (co->value);
+		co->value = NULL;
+	}
+}
+
+static gboolean
+xmms_ipc_broadcast_flush (gpointer data)
+{
+	xmms_ipc_coalesce_t *co = data;
+	xmms_ipc_client_t *client = co->client;
+
+	g_mutex_lock (client->lock);
+	g_source_unref (co->timer);
+	co->timer = NULL;
+	xmms_ipc_coalesce_deliver (co, XMMS_IPC_CMD_BROADCAST);
+	g_mutex_unlock (client->lock);
+
+	return FALSE;
+}
+
+static gboolean
+xmms_ipc_signal_flush (gpointer data)
+{
+	xmms_ipc_coalesce_t *co = data;
+	xmms_ipc_client_t *client = co->client;
+
+	g_mutex_lock (client->lock);
+	g_source_unref (co->timer);
+	co->timer = NULL;
+
+	/* the signal is one-shot, the client asks again when it gets it */
+	co->cookie = client->pendingsignals[co->signalid];
+	if (co->cookie) {
+		xmms_ipc_coalesce_deliver (co, XMMS_IPC_CMD_SIGNAL);
+		client->pendingsignals[co->signalid] = 0;
+	}
+	client->delayedsignals[co->signalid] = NULL;
+	xmms_ipc_coalesce_free (co);
+	g_mutex_unlock (client->lock);
+
+	return FALSE;
+}
+
+/**
+ * Start the timer delivering the merged values, unless it runs already.
+ * Should hold client->lock.
+ */
+static void
+xmms_ipc_coalesce_schedule (xmms_ipc_coalesce_t *co, GSourceFunc func)
+{
+	if (co->timer) {
+		return;
+	}
+
+	co->timer = g_timeout_source_new (co->interval);
+	g_source_set_callback (co->timer, func, co, NULL);
+	g_source_attach (co->timer, g_main_loop_get_context (co->client->ml));
+}
+
 static void
 xmms_ipc_register_signal (xmms_ipc_client_t *client,
                           xmms_ipc_msg_t *msg, xmmsv_t *arguments)
@@ -127,6 +375,8 @@ xmms_ipc_register_signal (xmms_ipc_client_t *client,
 
 	g_mutex_lock (client->lock);
 	client->pendingsignals[signalid] = xmms_ipc_msg_get_cookie (msg);
+	client->signalintervals[signalid] = xmms_ipc_coalesce_interval (signalid,
+	                                                                arguments);
 	g_mutex_unlock (client->lock);
 }
 
@@ -134,6 +384,7 @@ static void
 xmms_ipc_register_broadcast (xmms_ipc_client_t *client,
                              xmms_ipc_msg_t *msg, xmmsv_t *arguments)
 {
+	xmms_ipc_coalesce_t *co;
 	xmmsv_t *arg;
 	gint32 broadcastid;
 	int r;
@@ -155,10 +406,15 @@ xmms_ipc_register_broadcast (xmms_ipc_client_t *client,
 		return;
 	}
 
+	co = g_new0 (xmms_ipc_coalesce_t, 1);
+	co->client = client;
+	co->signalid = broadcastid;
+	co->cookie = xmms_ipc_msg_get_cookie (msg);
+	co->interval = xmms_ipc_coalesce_interval (broadcastid, arguments);
+
 	g_mutex_lock (client->lock);
 	client->broadcasts[broadcastid] =
-		g_list_append (client->broadcasts[broadcastid],
-				GUINT_TO_POINTER (xmms_ipc_msg_get_cookie (msg)));
+		g_list_append (client->broadcasts[broadcastid], co);
 
 	g_mutex_unlock (client->lock);
 }
@@ -311,31 +567,42 @@ xmms_ipc_client_write_cb (GIOChannel *iochan,
 	g_return_val_if_fail (client, FALSE);
 
 	while (TRUE) {
-		xmms_ipc_msg_t *msg;
+		xmms_ipc_msg_t *msgs[XMMS_IPC_WRITE_MAX_MSGS];
+		GList *n;
+		gint i, count, written;
 
+		/* hand as many queued replies as possible to one write */
 		g_mutex_lock (client->lock);
-		msg = g_queue_peek_head (client->out_msg);
+		count = 0;
+		for (n = g_queue_peek_head_link (client->out_msg);
+		     n && count < XMMS_IPC_WRITE_MAX_MSGS; n = g_list_next (n)) {
+			msgs[count++] = n->data;
+		}
 		g_mutex_unlock (client->lock);
 
-		if (!msg)
+		if (!count)
 			break;
 
-		if (!xmms_ipc_msg_write_transport (msg,
-		                                   client->transport,
-		                                   &disconnect)) {
-			if (disconnect) {
-				break;
-			} else {
-				/* try sending again later */
-				return TRUE;
-			}
-		}
+		written = xmms_ipc_msg_write_transport_many (msgs, count,
+		                                             client->transport,
+		                                             &disconnect);
 
 		g_mutex_lock (client->lock);
-		g_queue_pop_head (client->out_msg);
+		for (i = 0; i < written; i++) {
+			g_queue_pop_head (client->out_msg);
+		}
 		g_mutex_unlock (client->lock);
 
-		xmms_ipc_msg_destroy (msg);
+		for (i = 0; i < written; i++) {
+			xmms_ipc_msg_destroy (msgs[i]);
+		}
+
+		if (disconnect) {
+			break;
+		} else if (!written) {
+			/* try sending again later */
+			return TRUE;
+		}
 	}
 
 	return FALSE;
@@ -424,7 +691,12 @@ xmms_ipc_client_destroy (xmms_ipc_client_t *client)
 	g_queue_free (client->out_msg);
 
 	for (i = 0; i < XMMS_IPC_SIGNAL_END; i++) {
+		g_list_foreach (client->broadcasts[i],
+		                (GFunc) xmms_ipc_coalesce_free, NULL);
 		g_list_free (client->broadcasts[i]);
+		if (client->delayedsignals[i]) {
+			xmms_ipc_coalesce_free (client->delayedsignals[i]);
+		}
 	}
 
 	g_mutex_unlock (client->lock);
@@ -455,6 +727,7 @@ static gboolean
 xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 {
 	gboolean queue_empty;
+	guint length;
 
 	g_return_val_if_fail (client, FALSE);
 	g_return_val_if_fail (msg, FALSE);
@@ -462,6 +735,14 @@ xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	queue_empty = g_queue_is_empty (client->out_msg);
 	g_queue_push_tail (client->out_msg, msg);
 
+	length = g_queue_get_length (client->out_msg);
+	if (length > client->out_max) {
+		client->out_max = length;
+	}
+	if (length == XMMS_IPC_OUT_HIGH_WATER) {
+		client->out_congested++;
+	}
+
 	/* If there's no write in progress, add a new callback */
 	if (queue_empty) {
 		GMainContext *context = g_main_loop_get_context (client->ml);
@@ -568,6 +849,46 @@ xmms_ipc_has_pending (guint signalid)
 	return FALSE;
 }
 
+/**
+ * Get the out queue accounting of all connected clients.
+ *
+ * @returns a list with a dict per client.
+ */
+xmmsv_t *
+xmms_ipc_client_stats (void)
+{
+	GList *c, *s;
+	xmms_ipc_t *ipc;
+	xmmsv_t *list, *dict;
+
+	list = xmmsv_new_list ();
+
+	g_mutex_lock (ipc_servers_lock);
+
+	for (s = ipc_servers; s; s = g_list_next (s)) {
+		ipc = s->data;
+		g_mutex_lock (ipc->mutex_lock);
+		for (c = ipc->clients; c; c = g_list_next (c)) {
+			xmms_ipc_client_t *cli = c->data;
+			g_mutex_lock (cli->lock);
+			dict = xmmsv_build_dict (
+			        XMMSV_DICT_ENTRY_INT ("queued", g_queue_get_length (cli->out_msg)),
+			        XMMSV_DICT_ENTRY_INT ("queued_max", cli->out_max),
+			        XMMSV_DICT_ENTRY_INT ("congested", cli->out_congested),
+			        XMMSV_DICT_ENTRY_INT ("coalesced", cli->coalesced),
+			        XMMSV_DICT_END);
+			g_mutex_unlock (cli->lock);
+			xmmsv_list_append (list, dict);
+			xmmsv_unref (dict);
+		}
+		g_mutex_unlock (ipc->mutex_lock);
+	}
+
+	g_mutex_unlock (ipc_servers_lock);
+
+	return list;
+}
+
 static void
 xmms_ipc_signal_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 {
@@ -584,7 +905,18 @@ xmms_ipc_signal_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 		for (c = ipc->clients; c; c = g_list_next (c)) {
 			xmms_ipc_client_t *cli = c->data;
 			g_mutex_lock (cli->lock);
-			if (cli->pendingsignals[signalid]) {
+			if (cli->pendingsignals[signalid] && cli->signalintervals[signalid]) {
+				xmms_ipc_coalesce_t *co = cli->delayedsignals[signalid];
+				if (!co) {
+					co = g_new0 (xmms_ipc_coalesce_t, 1);
+					co->client = cli;
+					co->signalid = signalid;
+					co->interval = cli->signalintervals[signalid];
+					cli->delayedsignals[signalid] = co;
+				}
+				xmms_ipc_coalesce_merge (co, arg);
+				xmms_ipc_coalesce_schedule (co, xmms_ipc_signal_flush);
+			} else if (cli->pendingsignals[signalid]) {
 				msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_CMD_SIGNAL);
 				xmms_ipc_msg_set_cookie (msg, cli->pendingsignals[signalid]);
 				xmms_ipc_handle_cmd_value (msg, arg);
@@ -619,8 +951,14 @@ xmms_ipc_broadcast_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 
 			g_mutex_lock (cli->lock);
 			for (l = cli->broadcasts[broadcastid]; l; l = g_list_next (l)) {
+				xmms_ipc_coalesce_t *co = l->data;
+				if (co->interval) {
+					xmms_ipc_coalesce_merge (co, arg);
+					xmms_ipc_coalesce_schedule (co, xmms_ipc_broadcast_flush);
+					continue;
+				}
 				msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_CMD_BROADCAST);
-				xmms_ipc_msg_set_cookie (msg, GPOINTER_TO_UINT (l->data));
+				xmms_ipc_msg_set_cookie (msg, co->cookie);
 				xmms_ipc_handle_cmd_value (msg, arg);
 				xmms_ipc_client_msg_write (cli, msg);
 			}
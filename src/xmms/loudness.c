@@ -0,0 +1,322 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Loudness measurement as in EBU R128 / ITU-R BS.1770.
+ *
+ * The input is K-weighted and the mean square of every 400ms block,
+ * overlapping by 300ms, is kept. The integrated loudness is the mean
+ * of the blocks passing an absolute gate at -70 LUFS and a relative
+ * gate 10 LU below the absolute gated loudness. Gating over the blocks
+ * of several meters gives the loudness of an album.
+ *
+ * The true peak is measured on the input oversampled four times.
+ */
+
+#include <math.h>
+
+#include "xmmspriv/xmms_loudness.h"
+
+/* taps per phase of the oversampling filter */
+#define TP_TAPS 12
+#define TP_PHASES 4
+
+struct xmms_loudness_St {
+	gint channels;
+	gint rate;
+
+	/* K-weighting: a high shelf followed by a high pass */
+	gdouble b[2][3];
+	gdouble a[2][3];
+	gdouble *state;
+	gdouble *weights;
+
+	/* 100ms sub-blocks, four of them make a block */
+	gint sub_len;
+	gint sub_pos;
+	gdouble sub_sum;
+	gdouble prev[3];
+	gint nprev;
+
+	gdouble *blocks;
+	gint nblocks;
+	gint blocks_alloc;
+
+	/* true peak */
+	gdouble coefs[TP_PHASES][TP_TAPS];
+	gfloat *history;
+	gint history_pos;
+	gdouble peak;
+};
+
+static void
+xmms_loudness_filter_setup (xmms_loudness_t *meter)
+{
+	gdouble f0, G, Q, K, Vh, Vb, a0;
+
+	/* coefficients of BS.1770 given for 48kHz, derived for any rate */
+	f0 = 1681.974450955533;
+	G = 3.999843853973347;
+	Q = 0.7071752369554196;
+
+	K = tan (M_PI * f0 / meter->rate);
+	Vh = pow (10.0, G / 20.0);
+	Vb = pow (Vh, 0.4996667741545416);
+	a0 = 1.0 + K / Q + K * K;
+
+	meter->b[0][0] = (Vh + Vb * K / Q + K * K) / a0;
+	meter->b[0][1] = 2.0 * (K * K - Vh) / a0;
+	meter->b[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+	meter->a[0][1] = 2.0 * (K * K - 1.0) / a0;
+	meter->a[0][2] = (1.0 - K / Q + K * K) / a0;
+
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+
+	K = tan (M_PI * f0 / meter->rate);
+	a0 = 1.0 + K / Q + K * K;
+
+	meter->b[1][0] = 1.0;
+	meter->b[1][1] = -2.0;
+	meter->b[1][2] = 1.0;
+	meter->a[1][1] = 2.0 * (K * K - 1.0) / a0;
+	meter->a[1][2] = (1.0 - K / Q + K * K) / a0;
+}
+
+/* windowed sinc, split into phases that each have unity gain */
+static void
+xmms_loudness_oversampler_setup (xmms_loudness_t *meter)
+{
+	gint p, j, n, len = TP_TAPS * TP_PHASES;
+	gdouble t, h, sum;
+
+	for (p = 0; p < TP_PHASES; p++) {
+		sum = 0.0;
+		for (j = 0; j < TP_TAPS; j++) {
+			n = j * TP_PHASES + p;
+			t = (n - (len - 1) / 2.0) / TP_PHASES;
+			h = t == 0.0 ? 1.0 : sin (M_PI * t) / (M_PI * t);
+			h *= 0.5 - 0.5 * cos (2.0 * M_PI * (n + 0.5) / len);
+			meter->coefs[p][j] = h;
+			sum += h;
+		}
+		for (j = 0; j < TP_TAPS; j++) {
+			meter->coefs[p][j] /= sum;
+		}
+	}
+}
+
+/**
+ * Create a meter for interleaved float input.
+ */
+xmms_loudness_t *
+xmms_loudness_new (gint channels, gint rate)
+{
+	xmms_loudness_t *meter;
+	gint i;
+
+	g_return_val_if_fail (channels > 0, NULL);
+	g_return_val_if_fail (rate > 0, NULL);
+
+	meter = g_new0 (xmms_loudness_t, 1);
+	meter->channels = channels;
+	meter->rate = rate;
+	meter->sub_len = MAX (rate / 10, 1);
+
+	meter->state = g_new0 (gdouble, channels * 4);
+	meter->history = g_new0 (gfloat, channels * TP_TAPS);
+
+	/* the surround channels of 5.0 and 5.1 count more, LFE not at all */
+	meter->weights = g_new (gdouble, channels);
+	for (i = 0; i < channels; i++) {
+		meter->weights[i] = 1.0;
+	}
+	if (channels == 5) {
+		meter->weights[3] = meter->weights[4] = 1.41;
+	} else if (channels == 6) {
+		meter->weights[3] = 0.0;
+		meter->weights[4] = meter->weights[5] = 1.41;
+	}
+
+	xmms_loudness_filter_setup (meter);
+	xmms_loudness_oversampler_setup (meter);
+
+	return meter;
+}
+
+void
+xmms_loudness_free (xmms_loudness_t *meter)
+{
+	g_return_if_fail (meter);
+
+	g_free (meter->state);
+	g_free (meter->history);
+	g_free (meter->weights);
+	g_free (meter->blocks);
+	g_free (meter);
+}
+
+static void
+xmms_loudness_sub_block_done (xmms_loudness_t *meter)
+{
+	gdouble sum;
+
+	if (meter->nprev == 3) {
+		sum = meter->prev[0] + meter->prev[1] + meter->prev[2] + meter->sub_sum;
+
+		if (meter->nblocks == meter->blocks_alloc) {
+			meter->blocks_alloc = MAX (meter->blocks_alloc * 2, 64);
+			meter->blocks = g_renew (gdouble, meter->blocks,
+			                         meter->blocks_alloc);
+		}
+		meter->blocks[meter->nblocks++] = sum / (4 * meter->sub_len);
+
+		meter->prev[0] = meter->prev[1];
+		meter->prev[1] = meter->prev[2];
+		meter->prev[2] = meter->sub_sum;
+	} else {
+		meter->prev[meter->nprev++] = meter->sub_sum;
+	}
+
+	meter->sub_sum = 0.0;
+	meter->sub_pos = 0;
+}
+
+static inline gdouble
+xmms_loudness_true_peak_sample (xmms_loudness_t *meter, gfloat *history)
+{
+	gdouble v, max = 0.0;
+	gint p, j, k;
+
+	for (p = 0; p < TP_PHASES; p++) {
+		v = 0.0;
+		k = meter->history_pos;
+		for (j = 0; j < TP_TAPS; j++) {
+			v += history[k] * meter->coefs[p][j];
+			k = k ? k - 1 : TP_TAPS - 1;
+		}
+		max = MAX (max, fabs (v));
+	}
+
+	return max;
+}
+
+/**
+ * Feed interleaved samples to the meter.
+ */
+void
+xmms_loudness_add_frames (xmms_loudness_t *meter, const gfloat *buf,
+                          gint frames)
+{
+	gdouble x, y, *s, sum, peak;
+	gfloat *history;
+	gint i, c;
+
+	peak = meter->peak;
+
+	for (i = 0; i < frames; i++) {
+		sum = 0.0;
+
+		meter->history_pos = (meter->history_pos + 1) % TP_TAPS;
+
+		for (c = 0; c < meter->channels; c++) {
+			x = buf[i * meter->channels + c];
+			s = meter->state + c * 4;
+
+			/* transposed direct form II */
+			y = meter->b[0][0] * x + s[0];
+			s[0] = meter->b[0][1] * x - meter->a[0][1] * y + s[1];
+			s[1] = meter->b[0][2] * x - meter->a[0][2] * y;
+
+			x = y;
+			y = meter->b[1][0] * x + s[2];
+			s[2] = meter->b[1][1] * x - meter->a[1][1] * y + s[3];
+			s[3] = meter->b[1][2] * x - meter->a[1][2] * y;
+
+			sum += meter->weights[c] * y * y;
+
+			history = meter->history + c * TP_TAPS;
+			history[meter->history_pos] = buf[i * meter->channels + c];
+			peak = MAX (peak, xmms_loudness_true_peak_sample (meter, history));
+		}
+
+		meter->sub_sum += sum;
+		if (++meter->sub_pos == meter->sub_len) {
+			xmms_loudness_sub_block_done (meter);
+		}
+	}
+
+	meter->peak = peak;
+}
+
+static gdouble
+xmms_loudness_lufs (gdouble z)
+{
+	return -0.691 + 10.0 * log10 (z);
+}
+
+/**
+ * Integrated loudness in LUFS of everything fed to the meters, gated
+ * as a whole. Returns #XMMS_LOUDNESS_SILENCE if no block passes the
+ * gates.
+ */
+gdouble
+xmms_loudness_integrated (xmms_loudness_t **meters, gint n)
+{
+	gdouble sum = 0.0, gate, l;
+	gint i, j, count = 0;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < meters[i]->nblocks; j++) {
+			if (xmms_loudness_lufs (meters[i]->blocks[j]) > XMMS_LOUDNESS_SILENCE) {
+				sum += meters[i]->blocks[j];
+				count++;
+			}
+		}
+	}
+
+	if (!count) {
+		return XMMS_LOUDNESS_SILENCE;
+	}
+
+	gate = xmms_loudness_lufs (sum / count) - 10.0;
+
+	sum = 0.0;
+	count = 0;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < meters[i]->nblocks; j++) {
+			l = xmms_loudness_lufs (meters[i]->blocks[j]);
+			if (l > XMMS_LOUDNESS_SILENCE && l > gate) {
+				sum += meters[i]->blocks[j];
+				count++;
+			}
+		}
+	}
+
+	return xmms_loudness_lufs (sum / count);
+}
+
+/**
+ * Highest sample value of the oversampled input, 1.0 is full scale.
+ */
+gdouble
+xmms_loudness_true_peak (xmms_loudness_t *meter)
+{
+	g_return_val_if_fail (meter, 0.0);
+
+	return meter->peak;
+}
@@ -25,6 +25,14 @@
 
 static GList *magic_list, *ext_list;
 
+/* for every possible value of the first byte of a stream, the magic
+ * sets that can match it, in the same order as magic_list
+ */
+static GPtrArray *magic_dispatch[256];
+
+/* the longest prefix any of the registered magic sets looks at */
+static guint magic_needed;
+
 #define SWAP16(v, endian) \
 	if (endian == G_LITTLE_ENDIAN) { \
 		v = GUINT16_TO_LE (v); \
@@ -82,6 +90,9 @@ typedef struct xmms_magic_entry_St {
 	guint pre_test_and_op;
 	xmms_magic_entry_operator_t oper;
 
+	/* index of the next sibling once compiled into a set */
+	guint next;
+
 	union {
 		guint8 i8;
 		guint16 i16;
@@ -95,19 +106,35 @@ typedef struct xmms_magic_checker_St {
 	gchar *buf;
 	guint alloc;
 	guint read;
-	guint offset;
 	gint dumpcount;
 } xmms_magic_checker_t;
 
 typedef struct xmms_magic_ext_data_St {
 	gchar *type;
 	gchar *pattern;
+	GPatternSpec *spec;
 } xmms_magic_ext_data_t;
 
+/**
+ * A magic tree flattened into an array in pre-order.
+ *
+ * The children of entries[i] are entries[i + 1] up to (but not
+ * including) entries[entries[i].next], the top level alternatives
+ * are found by following next from entries[0].
+ */
+typedef struct xmms_magic_set_St {
+	gchar *desc;
+	gchar *mime;
+	guint complexity;
+	guint needed;
+	guint8 first[32]; /* bitmask of possible values of the first byte */
+	guint n_entries;
+	xmms_magic_entry_t *entries;
+} xmms_magic_set_t;
+
 static void xmms_magic_tree_free (GNode *tree);
 
 static gchar *xmms_magic_match (xmms_magic_checker_t *c, const gchar *u);
-static guint xmms_magic_complexity (GNode *tree);
 
 static void
 xmms_magic_entry_free (xmms_magic_entry_t *e)
@@ -286,6 +313,7 @@ xmms_magic_tree_free (GNode *tree)
 {
 	g_node_traverse (tree, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
 	                 (GNodeTraverseFunc) free_node, NULL);
+	g_node_destroy (tree);
 }
 
 static GNode *
@@ -343,6 +371,135 @@ xmms_magic_add_node (GNode *tree, const gchar *s, GNode *prev_node)
 	}
 }
 
+static guint
+compile_children (GNode *node, xmms_magic_set_t *set, guint pos)
+{
+	GNode *n;
+
+	for (n = node->children; n; n = n->next) {
+		xmms_magic_entry_t *entry = &set->entries[pos];
+
+		memcpy (entry, n->data, sizeof (xmms_magic_entry_t));
+		set->needed = MAX (set->needed, entry->offset + entry->len);
+
+		pos = compile_children (n, set, pos + 1);
+		entry->next = pos;
+	}
+
+	return pos;
+}
+
+static void
+first_byte_add (xmms_magic_set_t *set, xmms_magic_entry_t *entry)
+{
+	guint8 b;
+	guint i;
+
+	if (entry->offset || entry->oper != XMMS_MAGIC_ENTRY_OPERATOR_EQUAL ||
+	    entry->pre_test_and_op) {
+		goto any;
+	}
+
+	switch (entry->type) {
+		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
+			b = entry->value.i8;
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_INT16:
+			if (entry->endian == G_BIG_ENDIAN) {
+				b = entry->value.i16 >> 8;
+			} else {
+				b = entry->value.i16 & 0xff;
+			}
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_INT32:
+			if (entry->endian == G_BIG_ENDIAN) {
+				b = entry->value.i32 >> 24;
+			} else {
+				b = entry->value.i32 & 0xff;
+			}
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_STRING:
+			if (!entry->len) {
+				goto any;
+			}
+			b = entry->value.s[0];
+			break;
+		case XMMS_MAGIC_ENTRY_TYPE_STRINGC:
+			if (!entry->len) {
+				goto any;
+			}
+			b = g_ascii_tolower (entry->value.s[0]);
+			set->first[b >> 3] |= 1 << (b & 7);
+			b = g_ascii_toupper (entry->value.s[0]);
+			break;
+		default:
+			goto any;
+	}
+
+	set->first[b >> 3] |= 1 << (b & 7);
+	return;
+
+any:
+	for (i = 0; i < sizeof (set->first); i++) {
+		set->first[i] = 0xff;
+	}
+}
+
+/**
+ * Flatten a parsed magic tree into a set that can be matched without
+ * walking the GNode structure. The tree itself is left untouched.
+ */
+static xmms_magic_set_t *
+xmms_magic_compile (GNode *tree)
+{
+	xmms_magic_set_t *set;
+	gpointer *data = tree->data;
+	guint i;
+
+	set = g_new0 (xmms_magic_set_t, 1);
+	set->desc = g_strdup (data[0]);
+	set->mime = g_strdup (data[1]);
+	set->complexity = g_node_n_nodes (tree, G_TRAVERSE_ALL);
+	set->n_entries = set->complexity - 1;
+	set->entries = g_new0 (xmms_magic_entry_t, set->n_entries);
+
+	compile_children (tree, set, 0);
+
+	for (i = 0; i < set->n_entries; i = set->entries[i].next) {
+		first_byte_add (set, &set->entries[i]);
+	}
+
+	return set;
+}
+
+static void
+xmms_magic_dispatch_rebuild (void)
+{
+	const GList *l;
+	guint b;
+
+	magic_needed = 0;
+
+	for (b = 0; b < G_N_ELEMENTS (magic_dispatch); b++) {
+		if (magic_dispatch[b]) {
+			g_ptr_array_free (magic_dispatch[b], TRUE);
+		}
+		magic_dispatch[b] = g_ptr_array_new ();
+	}
+
+	for (l = magic_list; l; l = g_list_next (l)) {
+		xmms_magic_set_t *set = l->data;
+
+		magic_needed = MAX (magic_needed, set->needed);
+
+		for (b = 0; b < G_N_ELEMENTS (magic_dispatch); b++) {
+			if (set->first[b >> 3] & (1 << (b & 7))) {
+				g_ptr_array_add (magic_dispatch[b], set);
+			}
+		}
+	}
+}
+
 static gint
 read_data (xmms_magic_checker_t *c, guint needed)
 {
@@ -359,33 +516,21 @@ read_data (xmms_magic_checker_t *c, guint needed)
 }
 
 static gboolean
-node_match (xmms_magic_checker_t *c, GNode *node)
+node_match (xmms_magic_checker_t *c, xmms_magic_entry_t *entry)
 {
-	xmms_magic_entry_t *entry = node->data;
-	guint needed = c->offset + entry->offset + entry->len;
 	guint8 i8;
 	guint16 i16;
 	guint32 i32;
-	gint tmp;
 	gchar *ptr;
 
-	/* do we have enough data ready for this check?
-	 * if not, read some more
+	/* the whole prefix has been read up front, if it is too short
+	 * for this check the stream is too short for it as well
 	 */
-	if (c->read < needed) {
-		tmp = read_data (c, needed);
-		if (tmp == -1) {
-			return FALSE;
-		}
-
-		c->read = tmp;
-		if (c->read < needed) {
-			/* couldn't read enough data */
-			return FALSE;
-		}
+	if (c->read < entry->offset + entry->len) {
+		return FALSE;
 	}
 
-	ptr = &c->buf[c->offset + entry->offset];
+	ptr = &c->buf[entry->offset];
 
 	switch (entry->type) {
 		case XMMS_MAGIC_ENTRY_TYPE_BYTE:
@@ -408,18 +553,21 @@ node_match (xmms_magic_checker_t *c, GNode *node)
 	}
 }
 
+/* match the siblings in entries[first] .. entries[last - 1] */
 static gboolean
-tree_match (xmms_magic_checker_t *c, GNode *tree)
+range_match (xmms_magic_checker_t *c, xmms_magic_entry_t *entries,
+             guint first, guint last)
 {
-	GNode *n;
+	guint i;
 
 	/* empty subtrees match anything */
-	if (!tree->children) {
+	if (first == last) {
 		return TRUE;
 	}
 
-	for (n = tree->children; n; n = n->next) {
-		if (node_match (c, n) && tree_match (c, n)) {
+	for (i = first; i < last; i = entries[i].next) {
+		if (node_match (c, &entries[i]) &&
+		    range_match (c, entries, i + 1, entries[i].next)) {
 			return TRUE;
 		}
 	}
@@ -427,40 +575,92 @@ tree_match (xmms_magic_checker_t *c, GNode *tree)
 	return FALSE;
 }
 
+static gboolean
+set_match (xmms_magic_checker_t *c, xmms_magic_set_t *set)
+{
+	if (range_match (c, set->entries, 0, set->n_entries)) {
+		XMMS_DBG ("magic plugin detected '%s' (%s)", set->mime, set->desc);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static const gchar *
+extension_match (const gchar *uri)
+{
+	const GList *l;
+	const gchar *ret = NULL;
+	gchar *u;
+	guint len;
+
+	if (!uri || !ext_list) {
+		return NULL;
+	}
+
+	u = g_ascii_strdown (uri, -1);
+	len = strlen (u);
+
+	for (l = ext_list; l; l = g_list_next (l)) {
+		xmms_magic_ext_data_t *e = l->data;
+		if (g_pattern_match (e->spec, len, u, NULL)) {
+			ret = e->type;
+			break;
+		}
+	}
+
+	g_free (u);
+
+	return ret;
+}
+
 static gchar *
 xmms_magic_match (xmms_magic_checker_t *c, const gchar *uri)
 {
 	const GList *l;
+	const gchar *hint;
+	GPtrArray *candidates;
 	gchar *u, *dump;
+	guint n;
 	int i;
 
 	g_return_val_if_fail (c, NULL);
 
-	/* only one of the contained sets has to match */
-	for (l = magic_list; l; l = g_list_next (l)) {
-		GNode *tree = l->data;
+	hint = extension_match (uri);
+
+	if (c->read > 0) {
+		/* try the type suggested by the extension first, in the
+		 * common case that is the only set that has to be checked
+		 */
+		if (hint) {
+			for (l = magic_list; l; l = g_list_next (l)) {
+				xmms_magic_set_t *set = l->data;
 
-		if (tree_match (c, tree)) {
-			gpointer *data = tree->data;
-			XMMS_DBG ("magic plugin detected '%s' (%s)",
-			          (char *)data[1], (char *)data[0]);
-			return (char *) (data[1]);
+				if (!strcmp (set->mime, hint) && set_match (c, set)) {
+					return set->mime;
+				}
+			}
 		}
-	}
 
-	if (!uri)
-		return NULL;
+		/* only one of the sets that can start with this byte has to match */
+		candidates = magic_dispatch[(guint8) c->buf[0]];
+		for (n = 0; candidates && n < candidates->len; n++) {
+			xmms_magic_set_t *set = g_ptr_array_index (candidates, n);
 
-	u = g_ascii_strdown (uri, -1);
-	for (l = ext_list; l; l = g_list_next (l)) {
-		xmms_magic_ext_data_t *e = l->data;
-		if (g_pattern_match_simple (e->pattern, u)) {
-			XMMS_DBG ("magic plugin detected '%s' (by extension '%s')", e->type, e->pattern);
-			g_free (u);
-			return e->type;
+			if (hint && !strcmp (set->mime, hint)) {
+				continue; /* already tried */
+			}
+
+			if (set_match (c, set)) {
+				return set->mime;
+			}
 		}
 	}
-	g_free (u);
+
+	if (hint) {
+		XMMS_DBG ("magic plugin detected '%s' (by extension)", hint);
+		return (gchar *) hint;
+	}
 
 	if (c->dumpcount > 0) {
 		dump = g_malloc ((MIN (c->read, c->dumpcount) * 3) + 1);
@@ -479,23 +679,12 @@ xmms_magic_match (xmms_magic_checker_t *c, const gchar *uri)
 	return NULL;
 }
 
-static guint
-xmms_magic_complexity (GNode *tree)
-{
-	return g_node_n_nodes (tree, G_TRAVERSE_ALL);
-}
-
 static gint
-cb_sort_magic_list (GNode *a, GNode *b)
+cb_sort_magic_list (xmms_magic_set_t *a, xmms_magic_set_t *b)
 {
-	guint n1, n2;
-
-	n1 = xmms_magic_complexity (a);
-	n2 = xmms_magic_complexity (b);
-
-	if (n1 > n2) {
+	if (a->complexity > b->complexity) {
 		return -1;
-	} else if (n1 < n2) {
+	} else if (a->complexity < b->complexity) {
 		return 1;
 	} else {
 		return 0;
@@ -513,6 +702,7 @@ xmms_magic_extension_add (const gchar *mime, const gchar *ext)
 
 	e = g_new0 (xmms_magic_ext_data_t, 1);
 	e->pattern = g_strdup (ext);
+	e->spec = g_pattern_spec_new (ext);
 	e->type = g_strdup (mime);
 
 	ext_list = g_list_prepend (ext_list, e);
@@ -570,12 +760,13 @@ xmms_magic_add (const gchar *desc, const gchar *mime, ...)
 	/* only add this tree to the list if all spec chunks are valid */
 	if (ret) {
 		magic_list =
-			g_list_insert_sorted (magic_list, tree,
+			g_list_insert_sorted (magic_list, xmms_magic_compile (tree),
 			                      (GCompareFunc) cb_sort_magic_list);
-	} else {
-		xmms_magic_tree_free (tree);
+		xmms_magic_dispatch_rebuild ();
 	}
 
+	xmms_magic_tree_free (tree);
+
 	return ret;
 }
 
@@ -588,8 +779,8 @@ xmms_magic_plugin_init (xmms_xform_t *xform)
 	xmms_config_property_t *cv;
 
 	c.xform = xform;
-	c.read = c.offset = 0;
-	c.alloc = 128; /* start with a 128 bytes buffer */
+	c.read = 0;
+	c.alloc = MAX (magic_needed, 1);
 	c.buf = g_malloc (c.alloc);
 
 	cv = xmms_xform_config_lookup (xform, "dumpcount");
@@ -597,6 +788,11 @@ xmms_magic_plugin_init (xmms_xform_t *xform)
 
 	url = xmms_xform_indata_find_str (xform, XMMS_STREAM_TYPE_URL);
 
+	/* a single peek covers every check of every set */
+	if (magic_needed) {
+		c.read = MAX (read_data (&c, magic_needed), 0);
+	}
+
 	res = xmms_magic_match (&c, url);
 	if (res) {
 		xmms_xform_metadata_set_str (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_MIME, res);
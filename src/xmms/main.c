@@ -37,12 +37,14 @@
 #include "xmmspriv/xmms_checkroot.h"
 #include "xmmspriv/xmms_thread_name.h"
 #include "xmmspriv/xmms_medialib.h"
+#include "xmmspriv/xmms_gainscan.h"
 #include "xmmspriv/xmms_output.h"
 #include "xmmspriv/xmms_ipc.h"
 #include "xmmspriv/xmms_log.h"
 #include "xmmspriv/xmms_sqlite.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_bindata.h"
+#include "xmmspriv/xmms_netcache.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmmspriv/xmms_visualization.h"
 
@@ -118,6 +120,12 @@ xmms_main_client_stats (xmms_object_t *object, xmms_error_t *error)
 	               xmmsv_new_string (XMMS_VERSION));
 	g_tree_insert (ret, (gpointer) "uptime",
 	               xmmsv_new_int (time (NULL) - starttime));
+	g_tree_insert (ret, (gpointer) "clients",
+	               xmms_ipc_client_stats ());
+	g_tree_insert (ret, (gpointer) "netcache",
+	               xmms_netcache_stats ());
+	g_tree_insert (ret, (gpointer) "output",
+	               xmms_output_stats (((xmms_main_t*)object)->output));
 
 	return ret;
 }
@@ -283,6 +291,9 @@ xmms_main_destroy (xmms_object_t *object)
 
 	g_usleep (G_USEC_PER_SEC); /* wait for the output thread to end */
 
+	/* the scanner decodes with the plugins */
+	xmms_gainscan_shutdown ();
+
 	xmms_object_unref (mainobj->vis);
 	xmms_object_unref (mainobj->output);
 
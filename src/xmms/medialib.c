@@ -16,6 +16,8 @@
 
 #include "xmms_configuration.h"
 #include "xmmspriv/xmms_medialib.h"
+#include "xmmspriv/xmms_gainscan.h"
+#include "xmmspriv/xmms_seekindex.h"
 #include "xmmspriv/xmms_xform.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmms/xmms_error.h"
@@ -26,6 +28,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <time.h>
@@ -49,8 +53,11 @@ static void xmms_medialib_client_rehash (xmms_medialib_t *medialib, gint32 id, x
 static void xmms_medialib_client_set_property_string (xmms_medialib_t *medialib, gint32 entry, const gchar *source, const gchar *key, const gchar *value, xmms_error_t *error);
 static void xmms_medialib_client_set_property_int (xmms_medialib_t *medialib, gint32 entry, const gchar *source, const gchar *key, gint32 value, xmms_error_t *error);
 static void xmms_medialib_client_remove_property (xmms_medialib_t *medialib, gint32 entry, const gchar *source, const gchar *key, xmms_error_t *error);
+static void xmms_medialib_client_set_properties (xmms_medialib_t *medialib, xmmsv_t *changes, xmms_error_t *error);
+static void xmms_medialib_client_set_collection_properties (xmms_medialib_t *medialib, xmmsv_coll_t *coll, const gchar *source, xmmsv_t *properties, xmms_error_t *error);
 static GTree *xmms_medialib_client_get_info (xmms_medialib_t *medialib, gint32 id, xmms_error_t *err);
 static gint32 xmms_medialib_client_get_id (xmms_medialib_t *medialib, const gchar *url, xmms_error_t *error);
+static gint32 xmms_medialib_client_scan_gain (xmms_medialib_t *medialib, xmmsv_coll_t *coll, xmms_error_t *error);
 
 #include "medialib_ipc.c"
 
@@ -108,7 +115,7 @@ struct xmms_medialib_session_St {
 static xmms_medialib_t *medialib;
 
 static const char source_pref[] =
-	"server:client/*:plugin/playlist:plugin/id3v2:plugin/segment:plugin/*";
+	"server/gainscan:server:client/*:plugin/playlist:plugin/id3v2:plugin/segment:plugin/*";
 
 /**
   * This is only used if we are using a older version of sqlite.
@@ -329,6 +336,8 @@ xmms_medialib_init (xmms_playlist_t *playlist)
 	xmms_config_property_register ("medialib.analyze_on_startup", "0", NULL, NULL);
 	xmms_config_property_register ("medialib.allow_remote_fs",
 	                               "0", NULL, NULL);
+	xmms_config_property_register ("medialib.import_threads",
+	                               "4", NULL, NULL);
 
 	g_free (path);
 
@@ -376,6 +385,8 @@ xmms_medialib_init (xmms_playlist_t *playlist)
 
 	xmms_medialib_end (session);
 
+	xmms_gainscan_init (XMMS_OBJECT (medialib));
+
 	return medialib;
 }
 
@@ -478,6 +489,16 @@ xmms_medialib_value_cb (xmmsv_t **row, gpointer udata)
  * @see xmms_medialib_entry_property_get_str
  */
 
+/* Properties are written to the interned tables directly, rather than
+ * through the triggers of the Media view, which is a lot slower. */
+#define XMMS_MEDIALIB_SET_PROPERTY_SQL \
+	"INSERT OR IGNORE INTO PropertyKeys (key) VALUES (%Q);" \
+	"INSERT OR IGNORE INTO PropertyValues (value) VALUES (%Q);" \
+	"INSERT OR REPLACE INTO MediaProperties " \
+	"(id, key, value, intval, source) VALUES " \
+	"(%d, (SELECT id FROM PropertyKeys WHERE key = %Q), " \
+	"(SELECT id FROM PropertyValues WHERE value = %Q), %s, %d)"
+
 #define XMMS_MEDIALIB_RETRV_PROPERTY_SQL "SELECT IFNULL (intval, value) FROM Media WHERE key=%Q AND id=%d ORDER BY xmms_source_pref(source, %Q) LIMIT 1"
 
 xmmsv_t *
@@ -584,6 +605,7 @@ xmms_medialib_entry_property_set_int_source (xmms_medialib_session_t *session,
                                              const gchar *property, gint value,
                                              guint32 source)
 {
+	gchar strval[32];
 	gboolean ret;
 
 	g_return_val_if_fail (property, FALSE);
@@ -596,11 +618,11 @@ xmms_medialib_entry_property_set_int_source (xmms_medialib_session_t *session,
 		return FALSE;
 	}
 
-	ret = xmms_sqlite_exec (session->sql,
-	                        "INSERT OR REPLACE INTO Media "
-	                        "(id, value, intval, key, source) VALUES "
-	                        "(%d, '%d', %d, %Q, %d)",
-	                        entry, value, value, property, source);
+	g_snprintf (strval, sizeof (strval), "%d", value);
+
+	ret = xmms_sqlite_exec (session->sql, XMMS_MEDIALIB_SET_PROPERTY_SQL,
+	                        property, strval, entry, property, strval,
+	                        strval, source);
 
 	return ret;
 
@@ -651,11 +673,9 @@ xmms_medialib_entry_property_set_str_source (xmms_medialib_session_t *session,
 		return FALSE;
 	}
 
-	ret = xmms_sqlite_exec (session->sql,
-	                        "INSERT OR REPLACE INTO Media "
-	                        "(id, value, intval, key, source) VALUES "
-	                        "(%d, %Q, NULL, %Q, %d)",
-	                        entry, value, property, source);
+	ret = xmms_sqlite_exec (session->sql, XMMS_MEDIALIB_SET_PROPERTY_SQL,
+	                        property, value, entry, property, value,
+	                        "NULL", source);
 
 	return ret;
 
@@ -712,15 +732,64 @@ xmms_medialib_entry_remove (xmms_medialib_entry_t entry)
 	xmms_medialib_session_t *session;
 
 	session = xmms_medialib_begin_write ();
-	xmms_sqlite_exec (session->sql, "DELETE FROM Media WHERE id=%d", entry);
+	xmms_sqlite_exec (session->sql, "DELETE FROM MediaProperties WHERE id=%d",
+	                  entry);
+	xmms_sqlite_exec (session->sql, "DELETE FROM ImportCache WHERE id=%d",
+	                  entry);
 	xmms_medialib_end (session);
 
+	xmms_seek_index_remove (entry);
+
 	/** @todo safe ? */
 	xmms_playlist_remove_by_entry (medialib->playlist, entry);
 }
 
 static xmms_medialib_entry_t xmms_medialib_entry_new_insert (xmms_medialib_session_t *session, guint32 id, const char *url, xmms_error_t *error);
 
+/** Number of imported files handled per write transaction */
+#define XMMS_MEDIALIB_IMPORT_BATCH 1000
+
+/**
+ * State shared by the threads of a directory scan.
+ */
+typedef struct xmms_medialib_scan_St {
+	GMutex *mutex;
+	GCond *cond;
+	GThreadPool *pool;
+	/** Directories queued or being browsed */
+	gint pending;
+	/** Browse results of all files found */
+	GList *files;
+	xmms_error_t *error;
+} xmms_medialib_scan_t;
+
+/**
+ * Stat info of an imported file, as stored in the ImportCache table.
+ */
+typedef struct xmms_medialib_import_stat_St {
+	gint32 id;
+	/** The "stat" browse property, see #XMMS_MEDIALIB_BROWSE_PROPERTY_STAT */
+	gchar *stat;
+} xmms_medialib_import_stat_t;
+
+static void
+process_entry (xmms_medialib_session_t *session,
+               const gchar *playlist,
+               gint32 pos,
+               xmms_medialib_entry_t entry,
+               xmms_error_t *error)
+{
+	if (entry && playlist != NULL) {
+		if (pos >= 0) {
+			xmms_playlist_insert_entry (session->medialib->playlist,
+			                            playlist, pos, entry, error);
+		} else {
+			xmms_playlist_add_entry (session->medialib->playlist,
+			                         playlist, entry, error);
+		}
+	}
+}
+
 static void
 process_file (xmms_medialib_session_t *session,
               const gchar *playlist,
@@ -731,18 +800,171 @@ process_file (xmms_medialib_session_t *session,
 	xmms_medialib_entry_t entry;
 
 	entry = xmms_medialib_entry_new_encoded (session, path, error);
+	process_entry (session, playlist, pos, entry, error);
+}
 
-	if (entry && playlist != NULL) {
-		if (pos >= 0) {
-			xmms_playlist_insert_entry (session->medialib->playlist,
-			                            playlist, pos, entry, error);
-		} else {
-			xmms_playlist_add_entry (session->medialib->playlist,
-			                         playlist, entry, error);
+static gboolean
+import_cache_get (xmmsv_t **row, gpointer udata)
+{
+	xmms_medialib_import_stat_t *st = udata;
+
+	const gchar *stat;
+
+	if (!xmmsv_get_string (row[1], &stat)) {
+		return FALSE;
+	}
+
+	xmmsv_get_int (row[0], &st->id);
+	st->stat = g_strdup (stat);
+
+	return FALSE;
+}
+
+static void
+import_stat_free (gpointer data)
+{
+	xmms_medialib_import_stat_t *st = data;
+
+	g_free (st->stat);
+	g_free (st);
+}
+
+/* Add a file found by process_dir, skipping the medialib lookup if
+ * its stat info matches the one recorded by the previous import. The
+ * stat info is looked up in the cache if given, in the database
+ * otherwise. Returns TRUE if an existing entry has been marked for
+ * rehashing.
+ */
+static gboolean
+process_file_cached (xmms_medialib_session_t *session,
+                     GHashTable *cache,
+                     const gchar *playlist,
+                     gint32 pos,
+                     xmmsv_t *val,
+                     xmms_error_t *error)
+{
+	xmms_medialib_import_stat_t row = { 0, NULL }, *cached = NULL;
+	xmms_medialib_entry_t entry;
+	gboolean rehash = FALSE;
+	const gchar *path, *stat;
+
+	xmmsv_dict_entry_get_string (val, "path", &path);
+
+	/* the transport didn't stat the file, nothing to compare with */
+	if (!xmmsv_dict_entry_get_string (val, XMMS_MEDIALIB_BROWSE_PROPERTY_STAT,
+	                                  &stat)) {
+		process_file (session, playlist, pos, path, error);
+		return FALSE;
+	}
+
+	if (cache) {
+		cached = g_hash_table_lookup (cache, path);
+	} else {
+		xmms_sqlite_query_array (session->sql, import_cache_get, &row,
+		                         "SELECT id, stat "
+		                         "FROM ImportCache WHERE path = %Q", path);
+		if (row.id) {
+			cached = &row;
 		}
 	}
+
+	if (cached && strcmp (cached->stat, stat) == 0) {
+		process_entry (session, playlist, pos, cached->id, error);
+		g_free (row.stat);
+		return FALSE;
+	}
+
+	entry = xmms_medialib_entry_new_encoded (session, path, error);
+	if (!entry) {
+		g_free (row.stat);
+		return FALSE;
+	}
+
+	/* the file changed since it was imported, read it again */
+	if (cached && cached->id == entry) {
+		xmms_medialib_entry_status_set (session, entry,
+		                                XMMS_MEDIALIB_ENTRY_STATUS_REHASH);
+		rehash = TRUE;
+	}
+
+	xmms_sqlite_exec (session->sql,
+	                  "INSERT OR REPLACE INTO ImportCache (path, id, stat) "
+	                  "VALUES (%Q, %d, %Q)",
+	                  path, entry, stat);
+
+	process_entry (session, playlist, pos, entry, error);
+
+	g_free (row.stat);
+
+	return rehash;
 }
 
+static gboolean
+import_cache_add (xmmsv_t **row, gpointer udata)
+{
+	GHashTable *cache = udata;
+	xmms_medialib_import_stat_t *st;
+	const gchar *path, *stat;
+
+	if (!xmmsv_get_string (row[0], &path) ||
+	    !xmmsv_get_string (row[2], &stat)) {
+		return TRUE;
+	}
+
+	st = g_new0 (xmms_medialib_import_stat_t, 1);
+	xmmsv_get_int (row[1], &st->id);
+	st->stat = g_strdup (stat);
+
+	g_hash_table_insert (cache, g_strdup (path), st);
+
+	return TRUE;
+}
+
+/* Load the stat info of all previously imported files below the
+ * given directory into a hash table keyed by url.
+ */
+static GHashTable *
+import_cache_load (xmms_medialib_session_t *session, const gchar *directory)
+{
+	GHashTable *cache;
+	gchar *durl, *lower, *upper;
+	gint len;
+
+	cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                               import_stat_free);
+
+	/* encode the url the same way the browsed paths are encoded */
+	durl = g_strdup (directory);
+	xmms_medialib_decode_url (durl);
+	lower = xmms_medialib_url_encode (durl);
+	g_free (durl);
+
+	len = strlen (lower);
+	if (!len || lower[len - 1] != '/') {
+		durl = lower;
+		lower = g_strconcat (durl, "/", NULL);
+		g_free (durl);
+		len++;
+	}
+
+	/* every path below the directory sorts between "dir/" and "dir0" */
+	upper = g_strdup (lower);
+	upper[len - 1] = '0';
+
+	xmms_sqlite_query_array (session->sql, import_cache_add, cache,
+	                         "SELECT path, id, stat "
+	                         "FROM ImportCache WHERE path >= %Q AND path < %Q",
+	                         lower, upper);
+
+	g_free (lower);
+	g_free (upper);
+
+	return cache;
+}
+
+/* Compare paths component by component, giving the order of a
+ * depth-first walk with sorted directory listings.
+ */
 static gint
 cmp_val (gconstpointer a, gconstpointer b)
 {
@@ -758,24 +980,44 @@ cmp_val (gconstpointer a, gconstpointer b)
 	xmmsv_dict_entry_get_string (v1, "path", &s1);
 	xmmsv_dict_entry_get_string (v2, "path", &s2);
 
-	return strcmp (s1, s2);
+	while (*s1 && *s1 == *s2) {
+		s1++;
+		s2++;
+	}
+
+	if (*s1 == *s2) {
+		return 0;
+	}
+
+	/* a separator sorts before anything but the end of the path */
+	if (*s1 == '/') {
+		return *s2 ? -1 : 1;
+	}
+	if (*s2 == '/') {
+		return *s1 ? 1 : -1;
+	}
+
+	return (guchar) *s1 - (guchar) *s2;
 }
 
-/* code ported over from CLI's "radd" command. */
-/* note that the returned file list is reverse-sorted! */
-static gboolean
-process_dir (const gchar *directory,
-             GList **ret,
-             xmms_error_t *error)
+static void
+process_dir_worker (gpointer data, gpointer udata)
 {
+	xmms_medialib_scan_t *scan = udata;
+	gchar *directory = data;
+	xmms_error_t err;
 	GList *list;
 
-	list = xmms_xform_browse (directory, error);
-	if (!list) {
-		return FALSE;
-	}
+	xmms_error_reset (&err);
 
-	list = g_list_sort (list, cmp_val);
+	list = xmms_xform_browse (directory, &err);
+
+	g_mutex_lock (scan->mutex);
+
+	if (xmms_error_iserror (&err) && xmms_error_isok (scan->error)) {
+		xmms_error_set (scan->error, xmms_error_type_get (&err),
+		                xmms_error_message_get (&err));
+	}
 
 	while (list) {
 		xmmsv_t *val = list->data;
@@ -786,16 +1028,117 @@ process_dir (const gchar *directory,
 		xmmsv_dict_entry_get_int (val, "isdir", &isdir);
 
 		if (isdir == 1) {
-			process_dir (str, ret, error);
+			scan->pending++;
+			g_thread_pool_push (scan->pool, g_strdup (str), NULL);
+			xmmsv_unref (val);
 		} else {
-			*ret = g_list_prepend (*ret, g_strdup (str));
+			scan->files = g_list_prepend (scan->files, val);
 		}
 
-		xmmsv_unref (val);
 		list = g_list_delete_link (list, list);
 	}
 
-	return TRUE;
+	if (--scan->pending == 0) {
+		g_cond_signal (scan->cond);
+	}
+
+	g_mutex_unlock (scan->mutex);
+
+	g_free (directory);
+}
+
+/* Browse the directory tree below the given url, handing the
+ * directories out to a pool of threads. Returns the browse results
+ * of all files found, in depth-first order.
+ */
+static GList *
+process_dir (const gchar *directory,
+             xmms_error_t *error)
+{
+	xmms_medialib_scan_t scan;
+	xmms_config_property_t *cv;
+	gint threads;
+
+	cv = xmms_config_lookup ("medialib.import_threads");
+	threads = MAX (1, xmms_config_property_get_int (cv));
+
+	scan.mutex = g_mutex_new ();
+	scan.cond = g_cond_new ();
+	scan.pending = 1;
+	scan.files = NULL;
+	scan.error = error;
+	scan.pool = g_thread_pool_new (process_dir_worker, &scan,
+	                               threads, FALSE, NULL);
+
+	g_thread_pool_push (scan.pool, g_strdup (directory), NULL);
+
+	g_mutex_lock (scan.mutex);
+	while (scan.pending > 0) {
+		g_cond_wait (scan.cond, scan.mutex);
+	}
+	g_mutex_unlock (scan.mutex);
+
+	/* waits for the workers to return */
+	g_thread_pool_free (scan.pool, FALSE, TRUE);
+
+	g_cond_free (scan.cond);
+	g_mutex_free (scan.mutex);
+
+	return g_list_sort (scan.files, cmp_val);
+}
+
+/* Add the files found by process_dir to the medialib, optionally
+ * inserting them into a playlist. The stat info cache is preloaded for
+ * the directory if given. The list and its values are freed.
+ */
+static void
+import_files (xmms_medialib_t *medialib, const gchar *directory,
+              const gchar *playlist, gint32 pos, GList *list,
+              xmms_error_t *error)
+{
+	xmms_medialib_session_t *session;
+	xmms_mediainfo_reader_t *mr;
+	GHashTable *cache = NULL;
+	gboolean rehash = FALSE;
+	gint count = 0;
+
+	XMMS_DBG ("taking the transaction!");
+	session = xmms_medialib_begin_write ();
+
+	if (directory) {
+		cache = import_cache_load (session, directory);
+	}
+
+	/* Increase pos each time to retain order. The transaction is
+	 * committed every few files so other clients aren't locked out
+	 * of the medialib during large imports.
+	 */
+	while (list) {
+		if (++count % XMMS_MEDIALIB_IMPORT_BATCH == 0) {
+			xmms_medialib_end (session);
+			session = xmms_medialib_begin_write ();
+		}
+
+		rehash |= process_file_cached (session, cache, playlist, pos,
+		                               list->data, error);
+		if (pos >= 0)
+			pos++;
+
+		xmmsv_unref (list->data);
+		list = g_list_delete_link (list, list);
+	}
+
+	XMMS_DBG ("and we are done!");
+	xmms_medialib_end (session);
+
+	if (cache) {
+		g_hash_table_destroy (cache);
+	}
+
+	if (rehash) {
+		mr = xmms_playlist_mediainfo_reader_get (medialib->playlist);
+		xmms_mediainfo_reader_wakeup (mr);
+	}
 }
 
 void
@@ -868,45 +1211,41 @@ xmms_medialib_add_recursive (xmms_medialib_t *medialib, const gchar *playlist,
  * optionally insert them into a playlist at a given position if the
  * playlist argument is not NULL. If the position is negative, entries
  * are appended to the playlist.
+ *
+ * Files whose stat info didn't change since they were last imported
+ * are skipped, changed ones are marked for rehashing.
  */
 void
 xmms_medialib_insert_recursive (xmms_medialib_t *medialib, const gchar *playlist,
                                 gint32 pos, const gchar *path,
                                 xmms_error_t *error)
 {
-	xmms_medialib_session_t *session;
-	GList *first, *list = NULL, *n;
+	GList *list;
 
 	g_return_if_fail (medialib);
 	g_return_if_fail (path);
 
-	/* Allocate our first list node manually here. The following call
-	 * to process_dir() will prepend all other nodes, so afterwards
-	 * "first" will point to the last node of the list... see below.
-	 */
-	first = list = g_list_alloc ();
-
-	process_dir (path, &list, error);
+	list = process_dir (path, error);
 
-	XMMS_DBG ("taking the transaction!");
-	session = xmms_medialib_begin_write ();
-
-	/* We now want to iterate the list in the order in which the nodes
-	 * were added, ie in reverse order. Thankfully we stored a pointer
-	 * to the last node in the list before, which saves us an expensive
-	 * g_list_last() call now. Increase pos each time to retain order.
-	 */
-	for (n = first->prev; n; n = g_list_previous (n)) {
-		process_file (session, playlist, pos, n->data, error);
-		if (pos >= 0)
-			pos++;
-		g_free (n->data);
-	}
+	import_files (medialib, path, playlist, pos, list, error);
+}
 
-	g_list_free (list);
+/**
+ * Add files to the medialib, skipping those which didn't change since
+ * they were last imported.
+ *
+ * @param medialib The medialib
+ * @param files List of browse results for the files, as returned by
+ * #xmms_xform_browse. The list and its values are freed.
+ * @param error If an error occurs, it will be stored in there.
+ */
+void
+xmms_medialib_import_files (xmms_medialib_t *medialib, GList *files,
+                            xmms_error_t *error)
+{
+	g_return_if_fail (medialib);
 
-	XMMS_DBG ("and we are done!");
-	xmms_medialib_end (session);
+	import_files (medialib, NULL, NULL, -1, files, error);
 }
 
 static void
@@ -927,10 +1266,9 @@ xmms_medialib_entry_new_insert (xmms_medialib_session_t *session,
 
 	source = XMMS_MEDIALIB_SOURCE_SERVER_ID;
 
-	if (!xmms_sqlite_exec (session->sql,
-	                       "INSERT INTO Media (id, key, value, source) VALUES "
-	                                         "(%d, '%s', %Q, %d)",
-	                       id, XMMS_MEDIALIB_ENTRY_PROPERTY_URL, url,
+	if (!xmms_sqlite_exec (session->sql, XMMS_MEDIALIB_SET_PROPERTY_SQL,
+	                       XMMS_MEDIALIB_ENTRY_PROPERTY_URL, url, id,
+	                       XMMS_MEDIALIB_ENTRY_PROPERTY_URL, url, "NULL",
 	                       source)) {
 		xmms_error_set (error, XMMS_ERROR_GENERIC,
 		                "Sql error/corruption inserting url");
@@ -973,7 +1311,8 @@ xmms_medialib_entry_new_encoded (xmms_medialib_session_t *session,
 	} else {
 		if (session->next_id <= 0 &&
 		    !xmms_sqlite_query_int (session->sql, &session->next_id,
-		                            "SELECT IFNULL(MAX (id),0)+1 FROM Media")) {
+		                            "SELECT IFNULL(MAX (id),0)+1 "
+		                            "FROM MediaProperties")) {
 			xmms_error_set (error, XMMS_ERROR_GENERIC,
 			                "SQL error/corruption selecting max(id)");
 			return 0;
@@ -1257,6 +1596,60 @@ xmms_medialib_client_add_entry (xmms_medialib_t *medialib, const gchar *url,
 	xmms_medialib_end (session);
 }
 
+static gint
+xmms_medialib_entry_compare (gconstpointer a, gconstpointer b)
+{
+	return GPOINTER_TO_INT (a) - GPOINTER_TO_INT (b);
+}
+
+/**
+ * Tell the clients about many changed entries at once. The entries
+ * are also announced one by one, for clients that only follow
+ * entry_changed.
+ *
+ * @param entries Sorted list of the changed entries, may contain
+ * duplicates.
+ */
+static void
+xmms_medialib_entries_send_update (GList *entries)
+{
+	xmmsv_t *list;
+	gint32 last = 0;
+
+	list = xmmsv_new_list ();
+
+	for (; entries; entries = g_list_next (entries)) {
+		gint32 entry = GPOINTER_TO_INT (entries->data);
+		if (entry != last) {
+			xmmsv_list_append_int (list, entry);
+			xmms_medialib_entry_send_update (entry);
+			last = entry;
+		}
+	}
+
+	if (xmmsv_list_get_size (list) > 0) {
+		xmms_object_emit (XMMS_OBJECT (medialib),
+		                  XMMS_IPC_SIGNAL_MEDIALIB_ENTRIES_UPDATE,
+		                  list);
+	}
+
+	xmmsv_unref (list);
+}
+
+static void
+xmms_medialib_entry_move (xmms_medialib_session_t *session,
+                          xmms_medialib_entry_t entry, const gchar *enc_url)
+{
+	const gchar *key = XMMS_MEDIALIB_ENTRY_PROPERTY_URL;
+	guint32 sourceid = XMMS_MEDIALIB_SOURCE_SERVER_ID;
+
+	xmms_medialib_entry_property_set_str_source (session, entry, key, enc_url,
+	                                             sourceid);
+	xmms_sqlite_exec (session->sql,
+	                  "UPDATE ImportCache SET path=%Q WHERE id=%d",
+	                  enc_url, entry);
+}
+
 /**
  * Changes the URL of an entry in the medialib.
  *
@@ -1269,8 +1662,6 @@ static void
 xmms_medialib_client_move_entry (xmms_medialib_t *medialib, gint32 entry,
                                  const gchar *url, xmms_error_t *error)
 {
-	const gchar *key = XMMS_MEDIALIB_ENTRY_PROPERTY_URL;
-	guint32 sourceid = XMMS_MEDIALIB_SOURCE_SERVER_ID;
 	gchar *enc_url;
 
 	xmms_medialib_session_t *session;
@@ -1278,8 +1669,7 @@ xmms_medialib_client_move_entry (xmms_medialib_t *medialib, gint32 entry,
 	enc_url = xmms_medialib_url_encode (url);
 
 	session = xmms_medialib_begin_write ();
-	xmms_medialib_entry_property_set_str_source (session, entry, key, enc_url,
-	                                             sourceid);
+	xmms_medialib_entry_move (session, entry, enc_url);
 	xmms_medialib_end (session);
 
 	g_free (enc_url);
@@ -1287,6 +1677,235 @@ xmms_medialib_client_move_entry (xmms_medialib_t *medialib, gint32 entry,
 	xmms_medialib_entry_send_update (entry);
 }
 
+static gboolean
+add_to_entry_urls (xmmsv_t **row, gpointer udata)
+{
+	GHashTable *entries = udata;
+	const gchar *url;
+	gint32 id;
+
+	if (xmmsv_get_int (row[0], &id) && xmmsv_get_string (row[1], &url)) {
+		g_hash_table_insert (entries, GINT_TO_POINTER (id), g_strdup (url));
+	}
+
+	return TRUE;
+}
+
+/* Find the entry with the given url and all entries below it if the
+ * url is a directory. Returns a hash table mapping the entries to
+ * their urls.
+ */
+static GHashTable *
+xmms_medialib_entries_below (xmms_medialib_session_t *session,
+                             const gchar *url)
+{
+	GHashTable *entries;
+	gchar *lower, *upper;
+	gint len;
+
+	entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+	                                 NULL, g_free);
+
+	lower = g_strconcat (url, "/", NULL);
+	upper = g_strdup (lower);
+
+	len = strlen (upper);
+	upper[len - 1] = '0';
+
+	xmms_sqlite_query_array (session->sql, add_to_entry_urls, entries,
+	                         "SELECT id, value FROM Media "
+	                         "WHERE key='%s' AND source=%d AND (value=%Q OR "
+	                         "(value >= %Q AND value < %Q))",
+	                         XMMS_MEDIALIB_ENTRY_PROPERTY_URL,
+	                         XMMS_MEDIALIB_SOURCE_SERVER_ID,
+	                         url, lower, upper);
+
+	g_free (lower);
+	g_free (upper);
+
+	return entries;
+}
+
+/**
+ * Change the url of the entry with the given url, or of all entries
+ * below it if it is a directory.
+ *
+ * @param medialib The medialib
+ * @param from Encoded url of the moved file or directory.
+ * @param to Encoded url it has been moved to.
+ */
+void
+xmms_medialib_move_recursive (xmms_medialib_t *medialib, const gchar *from,
+                              const gchar *to)
+{
+	xmms_medialib_session_t *session;
+	GHashTable *entries;
+	GHashTableIter it;
+	GList *changed = NULL;
+	gpointer key, value;
+	gint len;
+
+	g_return_if_fail (medialib);
+	g_return_if_fail (from);
+	g_return_if_fail (to);
+
+	len = strlen (from);
+
+	session = xmms_medialib_begin_write ();
+
+	entries = xmms_medialib_entries_below (session, from);
+
+	g_hash_table_iter_init (&it, entries);
+	while (g_hash_table_iter_next (&it, &key, &value)) {
+		gchar *url = g_strconcat (to, (gchar *) value + len, NULL);
+
+		xmms_medialib_entry_move (session, GPOINTER_TO_INT (key), url);
+		changed = g_list_prepend (changed, key);
+
+		g_free (url);
+	}
+
+	xmms_medialib_end (session);
+
+	g_hash_table_destroy (entries);
+
+	changed = g_list_sort (changed, xmms_medialib_entry_compare);
+	xmms_medialib_entries_send_update (changed);
+	g_list_free (changed);
+}
+
+/**
+ * A file has been moved over another one. The target keeps its entry,
+ * so it stays in the playlists it is in, and the entry of the moved
+ * file goes away. If there is no entry for the target yet, the moved
+ * file's entry is moved there.
+ *
+ * @param medialib The medialib
+ * @param from Encoded url of the moved file.
+ * @param to Encoded url it has replaced.
+ */
+void
+xmms_medialib_replace (xmms_medialib_t *medialib, const gchar *from,
+                       const gchar *to)
+{
+	xmms_medialib_session_t *session;
+	gint32 target = 0;
+
+	g_return_if_fail (medialib);
+	g_return_if_fail (from);
+	g_return_if_fail (to);
+
+	session = xmms_medialib_begin ();
+	xmms_sqlite_query_int (session->sql, &target,
+	                       "SELECT id FROM Media "
+	                       "WHERE key='%s' AND source=%d AND value=%Q",
+	                       XMMS_MEDIALIB_ENTRY_PROPERTY_URL,
+	                       XMMS_MEDIALIB_SOURCE_SERVER_ID, to);
+	xmms_medialib_end (session);
+
+	if (target) {
+		xmms_medialib_remove_recursive (medialib, from);
+	} else {
+		xmms_medialib_move_recursive (medialib, from, to);
+	}
+}
+
+/**
+ * Remove the entry with the given url, or all entries below it if it
+ * is a directory.
+ *
+ * @param medialib The medialib
+ * @param url Encoded url of the removed file or directory.
+ */
+void
+xmms_medialib_remove_recursive (xmms_medialib_t *medialib, const gchar *url)
+{
+	xmms_medialib_session_t *session;
+	GHashTable *entries;
+	GHashTableIter it;
+	gpointer key;
+
+	g_return_if_fail (medialib);
+	g_return_if_fail (url);
+
+	session = xmms_medialib_begin ();
+	entries = xmms_medialib_entries_below (session, url);
+	xmms_medialib_end (session);
+
+	g_hash_table_iter_init (&it, entries);
+	while (g_hash_table_iter_next (&it, &key, NULL)) {
+		xmms_medialib_entry_remove (GPOINTER_TO_INT (key));
+	}
+
+	g_hash_table_destroy (entries);
+}
+
+/**
+ * Remove the entries imported from below the given directory whose
+ * file no longer exists. Nothing is removed if the directory itself
+ * is gone, as it might just not be mounted.
+ *
+ * @param medialib The medialib
+ * @param url Url of the directory, as passed to
+ * #xmms_medialib_add_recursive.
+ */
+void
+xmms_medialib_remove_vanished (xmms_medialib_t *medialib, const gchar *url)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_import_stat_t *st;
+	GHashTable *cache;
+	GHashTableIter it;
+	GList *vanished = NULL, *n;
+	gpointer key, value;
+	struct stat sb;
+	gchar *path;
+
+	g_return_if_fail (medialib);
+	g_return_if_fail (url);
+
+	if (!g_str_has_prefix (url, "file://")) {
+		return;
+	}
+
+	path = g_strdup (url + 7);
+	xmms_medialib_decode_url (path);
+	if (stat (path, &sb) || !S_ISDIR (sb.st_mode)) {
+		g_free (path);
+		return;
+	}
+	g_free (path);
+
+	session = xmms_medialib_begin ();
+	cache = import_cache_load (session, url);
+	xmms_medialib_end (session);
+
+	g_hash_table_iter_init (&it, cache);
+	while (g_hash_table_iter_next (&it, &key, &value)) {
+		st = value;
+
+		path = g_strdup ((gchar *) key + 7);
+		xmms_medialib_decode_url (path);
+		if (stat (path, &sb) && errno == ENOENT) {
+			vanished = g_list_prepend (vanished, GINT_TO_POINTER (st->id));
+		}
+		g_free (path);
+	}
+
+	g_hash_table_destroy (cache);
+
+	for (n = vanished; n; n = g_list_next (n)) {
+		xmms_medialib_entry_remove (GPOINTER_TO_INT (n->data));
+	}
+
+	if (vanished) {
+		XMMS_DBG ("Removed %u vanished entries below '%s'",
+		          g_list_length (vanished), url);
+	}
+
+	g_list_free (vanished);
+}
+
 static void
 xmms_medialib_client_set_property_string (xmms_medialib_t *medialib,
                                           gint32 entry, const gchar *source,
@@ -1367,6 +1986,271 @@ xmms_medialib_client_remove_property (xmms_medialib_t *medialib, gint32 entry,
 	return xmms_medialib_property_remove (medialib, entry, source, key, error);
 }
 
+/**
+ * Set, or remove if value is a none value, a property within an
+ * already opened write session.
+ */
+static gboolean
+xmms_medialib_property_apply (xmms_medialib_session_t *session,
+                              xmms_medialib_entry_t entry, const gchar *key,
+                              xmmsv_t *value, guint32 sourceid)
+{
+	const gchar *strval;
+	gint32 intval;
+
+	if (xmmsv_get_string (value, &strval)) {
+		return xmms_medialib_entry_property_set_str_source (session, entry,
+		                                                    key, strval,
+		                                                    sourceid);
+	} else if (xmmsv_get_int (value, &intval)) {
+		return xmms_medialib_entry_property_set_int_source (session, entry,
+		                                                    key, intval,
+		                                                    sourceid);
+	}
+
+	return xmms_sqlite_exec (session->sql,
+	                         "DELETE FROM Media WHERE source=%d AND key=%Q AND "
+	                                                 "id=%d",
+	                         sourceid, key, entry);
+}
+
+static gboolean
+xmms_medialib_property_value_valid (xmmsv_t *value)
+{
+	switch (xmmsv_get_type (value)) {
+		case XMMSV_TYPE_NONE:
+		case XMMSV_TYPE_INT32:
+		case XMMSV_TYPE_STRING:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+static gboolean
+xmms_medialib_property_source_valid (const gchar *source, xmms_error_t *error)
+{
+	if (g_ascii_strcasecmp (source, "server") == 0) {
+		xmms_error_set (error, XMMS_ERROR_GENERIC,
+		                "Can't write to source server!");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Look up the id of a source, caching the answers for the duration
+ * of a bulk change.
+ */
+static guint32
+xmms_medialib_source_to_id_cached (xmms_medialib_session_t *session,
+                                   GHashTable *cache, const gchar *source)
+{
+	guint32 sourceid;
+
+	sourceid = GPOINTER_TO_UINT (g_hash_table_lookup (cache, source));
+	if (!sourceid) {
+		sourceid = xmms_medialib_source_to_id (session, source);
+		g_hash_table_insert (cache, (gpointer) source,
+		                     GUINT_TO_POINTER (sourceid));
+	}
+
+	return sourceid;
+}
+
+/**
+ * Apply a list of property changes in a single transaction.
+ *
+ * Each change is a dict with the keys "id", "source", "key" and
+ * "value". A missing or none value removes the property. Nothing is
+ * changed if any of the changes is malformed.
+ */
+static void
+xmms_medialib_client_set_properties (xmms_medialib_t *medialib,
+                                     xmmsv_t *changes, xmms_error_t *error)
+{
+	xmms_medialib_session_t *session;
+	xmmsv_list_iter_t *it;
+	xmmsv_t *change, *value;
+	const gchar *source, *key;
+	GHashTable *sources;
+	GList *entries = NULL;
+	guint32 sourceid;
+	gint32 entry;
+
+	if (!xmmsv_get_list_iter (changes, &it)) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "changes must be a list");
+		return;
+	}
+
+	for (; xmmsv_list_iter_valid (it); xmmsv_list_iter_next (it)) {
+		xmmsv_list_iter_entry (it, &change);
+
+		if (!xmmsv_dict_entry_get_int (change, "id", &entry) || entry <= 0 ||
+		    !xmmsv_dict_entry_get_string (change, "source", &source) ||
+		    !xmmsv_dict_entry_get_string (change, "key", &key)) {
+			xmms_error_set (error, XMMS_ERROR_INVAL,
+			                "each change needs an id, a source and a key");
+			return;
+		}
+
+		if (xmmsv_dict_get (change, "value", &value) &&
+		    !xmms_medialib_property_value_valid (value)) {
+			xmms_error_set (error, XMMS_ERROR_INVAL,
+			                "property values must be strings or integers");
+			return;
+		}
+
+		if (!xmms_medialib_property_source_valid (source, error)) {
+			return;
+		}
+	}
+
+	sources = g_hash_table_new (g_str_hash, g_str_equal);
+	value = xmmsv_new_none ();
+
+	session = xmms_medialib_begin_write ();
+
+	for (xmmsv_list_iter_first (it);
+	     xmmsv_list_iter_valid (it);
+	     xmmsv_list_iter_next (it)) {
+		xmmsv_t *v = value;
+
+		xmmsv_list_iter_entry (it, &change);
+		xmmsv_dict_entry_get_int (change, "id", &entry);
+		xmmsv_dict_entry_get_string (change, "source", &source);
+		xmmsv_dict_entry_get_string (change, "key", &key);
+		xmmsv_dict_get (change, "value", &v);
+
+		sourceid = xmms_medialib_source_to_id_cached (session, sources,
+		                                              source);
+		if (xmms_medialib_property_apply (session, entry, key, v, sourceid)) {
+			entries = g_list_prepend (entries, GINT_TO_POINTER (entry));
+		}
+	}
+
+	xmms_medialib_end (session);
+
+	xmmsv_unref (value);
+	g_hash_table_destroy (sources);
+
+	entries = g_list_sort (entries, xmms_medialib_entry_compare);
+	xmms_medialib_entries_send_update (entries);
+	g_list_free (entries);
+}
+
+/**
+ * Set, or remove if the value is a none value, properties on all the
+ * entries matched by a collection in a single transaction.
+ */
+static void
+xmms_medialib_client_set_collection_properties (xmms_medialib_t *medialib,
+                                                xmmsv_coll_t *coll,
+                                                const gchar *source,
+                                                xmmsv_t *properties,
+                                                xmms_error_t *error)
+{
+	xmms_medialib_session_t *session;
+	xmms_coll_dag_t *dag;
+	xmmsv_dict_iter_t *it;
+	xmmsv_t *order, *value;
+	const gchar *key;
+	GList *ids, *n, *entries = NULL;
+	guint32 sourceid;
+
+	if (!xmms_medialib_property_source_valid (source, error)) {
+		return;
+	}
+
+	if (!xmmsv_get_dict_iter (properties, &it)) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "properties must be a dict");
+		return;
+	}
+
+	for (; xmmsv_dict_iter_valid (it); xmmsv_dict_iter_next (it)) {
+		xmmsv_dict_iter_pair (it, NULL, &value);
+		if (!xmms_medialib_property_value_valid (value)) {
+			xmms_error_set (error, XMMS_ERROR_INVAL,
+			                "property values must be strings or integers");
+			return;
+		}
+	}
+
+	order = xmmsv_new_list ();
+	dag = xmms_playlist_colldag_get (medialib->playlist);
+	ids = xmms_collection_query_ids (dag, coll, 0, 0, order, error);
+	xmmsv_unref (order);
+
+	if (xmms_error_iserror (error)) {
+		return;
+	}
+
+	session = xmms_medialib_begin_write ();
+	sourceid = xmms_medialib_source_to_id (session, source);
+
+	for (n = ids; n; n = g_list_next (n)) {
+		gint32 entry;
+
+		xmmsv_get_int (n->data, &entry);
+
+		for (xmmsv_dict_iter_first (it);
+		     xmmsv_dict_iter_valid (it);
+		     xmmsv_dict_iter_next (it)) {
+			xmmsv_dict_iter_pair (it, &key, &value);
+			if (xmms_medialib_property_apply (session, entry, key, value,
+			                                  sourceid)) {
+				entries = g_list_prepend (entries, GINT_TO_POINTER (entry));
+			}
+		}
+
+		xmmsv_unref (n->data);
+	}
+
+	xmms_medialib_end (session);
+
+	g_list_free (ids);
+
+	entries = g_list_sort (entries, xmms_medialib_entry_compare);
+	xmms_medialib_entries_send_update (entries);
+	g_list_free (entries);
+}
+
+/**
+ * Queue the entries matched by a collection for loudness analysis.
+ */
+static gint32
+xmms_medialib_client_scan_gain (xmms_medialib_t *medialib, xmmsv_coll_t *coll,
+                                xmms_error_t *error)
+{
+	xmms_coll_dag_t *dag;
+	xmmsv_t *order;
+	GList *ids, *n, *entries = NULL;
+	gint32 entry, ret;
+
+	order = xmmsv_new_list ();
+	dag = xmms_playlist_colldag_get (medialib->playlist);
+	ids = xmms_collection_query_ids (dag, coll, 0, 0, order, error);
+	xmmsv_unref (order);
+
+	if (xmms_error_iserror (error)) {
+		return 0;
+	}
+
+	for (n = ids; n; n = g_list_next (n)) {
+		xmmsv_get_int (n->data, &entry);
+		entries = g_list_prepend (entries, GINT_TO_POINTER (entry));
+		xmmsv_unref (n->data);
+	}
+	g_list_free (ids);
+
+	entries = g_list_reverse (entries);
+	ret = xmms_gainscan_queue (entries);
+	g_list_free (entries);
+
+	return ret;
+}
+
 /**
  * Get a list of GHashTables 's that matches the query.
  *
@@ -0,0 +1,877 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Local cache behind remote transports.
+ *
+ * Everything read from the source is written to a sparse file at its
+ * offset, reads and seeks into ranges that were fetched before are
+ * served from that file. Once every byte has been seen the file is
+ * kept in the cache directory, keyed by the URL, the size and the
+ * modification time or entity tag the transport reported, so playing
+ * the track again reads nothing from the source. Streams without
+ * either are not cached, a changed file couldn't be told apart. The
+ * directory is bounded in size, the least recently used files are
+ * removed first.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "xmms/xmms_log.h"
+#include "xmms/xmms_medialib.h"
+#include "xmmspriv/xmms_config.h"
+#include "xmmspriv/xmms_netcache.h"
+#include "xmmspriv/xmms_utils.h"
+#include "xmmspriv/xmms_xform.h"
+
+#define XMMS_NETCACHE_MAGIC "XNC1"
+
+/** Cached files are named by a 64 bit hash of their key, in hex */
+#define XMMS_NETCACHE_NAME_LEN 16
+
+/** Largest share of the cache a single file may take */
+#define XMMS_NETCACHE_MAX_SHARE 4
+
+typedef struct xmms_netcache_range_St {
+	gint64 start;
+	gint64 end;
+} xmms_netcache_range_t;
+
+typedef struct xmms_netcache_priv_St {
+	gint fd;
+	gchar *name;
+	/** Set while the file is incomplete */
+	gchar *tmppath;
+	/** File offset of the first byte of the stream */
+	gint64 header;
+
+	gint64 size;
+	gint64 pos;
+	gint64 source_pos;
+
+	/** Fetched ranges, sorted and neither overlapping nor adjacent */
+	GArray *ranges;
+} xmms_netcache_priv_t;
+
+typedef struct xmms_netcache_file_St {
+	gchar *name;
+	gint64 size;
+	time_t mtime;
+} xmms_netcache_file_t;
+
+static struct {
+	const gchar *dir;
+	xmms_config_property_t *enabled;
+	xmms_config_property_t *size;
+
+	/** Protects everything below */
+	GMutex *mutex;
+
+	/** name -> link in the lru queue */
+	GHashTable *files;
+	/** Complete files, most recently used first */
+	GQueue *lru;
+	gint64 used;
+
+	guint hits;
+	guint misses;
+	guint64 saved;
+	guint64 fetched;
+} netcache;
+
+static xmms_xform_plugin_t *netcache_plugin;
+
+static gint64
+xmms_netcache_limit (void)
+{
+	return (gint64) xmms_config_property_get_int (netcache.size) * 1024 * 1024;
+}
+
+static void
+xmms_netcache_file_free (xmms_netcache_file_t *file)
+{
+	g_free (file->name);
+	g_free (file);
+}
+
+/* called with the mutex held */
+static void
+xmms_netcache_evict (void)
+{
+	xmms_netcache_file_t *file;
+	gint64 limit;
+	gchar *path;
+
+	limit = xmms_netcache_limit ();
+
+	while (netcache.used > limit && (file = g_queue_pop_tail (netcache.lru))) {
+		path = g_build_filename (netcache.dir, file->name, NULL);
+		g_unlink (path);
+		g_free (path);
+
+		g_hash_table_remove (netcache.files, file->name);
+		netcache.used -= file->size;
+		xmms_netcache_file_free (file);
+	}
+}
+
+/* called with the mutex held */
+static void
+xmms_netcache_insert (const gchar *name, gint64 size, time_t mtime,
+                      gboolean recent)
+{
+	xmms_netcache_file_t *file;
+	GList *link;
+
+	link = g_hash_table_lookup (netcache.files, name);
+	if (link) {
+		file = link->data;
+		g_hash_table_remove (netcache.files, name);
+		g_queue_delete_link (netcache.lru, link);
+		netcache.used -= file->size;
+		xmms_netcache_file_free (file);
+	}
+
+	file = g_new0 (xmms_netcache_file_t, 1);
+	file->name = g_strdup (name);
+	file->size = size;
+	file->mtime = mtime;
+
+	if (recent) {
+		g_queue_push_head (netcache.lru, file);
+		link = g_queue_peek_head_link (netcache.lru);
+	} else {
+		g_queue_push_tail (netcache.lru, file);
+		link = g_queue_peek_tail_link (netcache.lru);
+	}
+
+	g_hash_table_insert (netcache.files, file->name, link);
+	netcache.used += size;
+}
+
+/* called with the mutex held */
+static void
+xmms_netcache_touch (const gchar *name)
+{
+	GList *link;
+	gchar *path;
+
+	link = g_hash_table_lookup (netcache.files, name);
+	if (link) {
+		g_queue_unlink (netcache.lru, link);
+		g_queue_push_head_link (netcache.lru, link);
+	}
+
+	/* the order is rebuilt from the modification times on startup */
+	path = g_build_filename (netcache.dir, name, NULL);
+	utime (path, NULL);
+	g_free (path);
+}
+
+/* TRUE if name starts with a cache file name, ie a hash in hex */
+static gboolean
+xmms_netcache_name_prefix (const gchar *name)
+{
+	gint i;
+
+	for (i = 0; i < XMMS_NETCACHE_NAME_LEN; i++) {
+		if (!g_ascii_isxdigit (name[i])) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gint
+xmms_netcache_file_cmp (gconstpointer a, gconstpointer b)
+{
+	const xmms_netcache_file_t *fa = a, *fb = b;
+
+	return fb->mtime > fa->mtime ? 1 : (fb->mtime < fa->mtime ? -1 : 0);
+}
+
+static void
+xmms_netcache_scan (void)
+{
+	xmms_netcache_file_t *file;
+	GList *files = NULL, *n;
+	struct stat st;
+	const gchar *name;
+	gchar *path;
+	GDir *dir;
+
+	dir = g_dir_open (netcache.dir, 0, NULL);
+	if (!dir) {
+		return;
+	}
+
+	while ((name = g_dir_read_name (dir))) {
+		/* not ours, leave it alone */
+		if (!xmms_netcache_name_prefix (name)) {
+			continue;
+		}
+
+		path = g_build_filename (netcache.dir, name, NULL);
+
+		if (strlen (name) == XMMS_NETCACHE_NAME_LEN + 12 &&
+		           g_str_has_prefix (name + XMMS_NETCACHE_NAME_LEN,
+		                             ".part-")) {
+			/* left behind by a chain that didn't finish */
+			g_unlink (path);
+		} else if (strlen (name) == XMMS_NETCACHE_NAME_LEN &&
+		           g_stat (path, &st) == 0 && S_ISREG (st.st_mode)) {
+			file = g_new0 (xmms_netcache_file_t, 1);
+			file->name = g_strdup (name);
+			file->size = st.st_size;
+			file->mtime = st.st_mtime;
+			files = g_list_prepend (files, file);
+		}
+
+		g_free (path);
+	}
+
+	g_dir_close (dir);
+
+	files = g_list_sort (files, xmms_netcache_file_cmp);
+
+	g_mutex_lock (netcache.mutex);
+	for (n = files; n; n = g_list_next (n)) {
+		file = n->data;
+		xmms_netcache_insert (file->name, file->size, file->mtime, FALSE);
+		xmms_netcache_file_free (file);
+	}
+	xmms_netcache_evict ();
+	g_mutex_unlock (netcache.mutex);
+
+	g_list_free (files);
+}
+
+void
+xmms_netcache_init (void)
+{
+	xmms_config_property_t *cv;
+	gchar *tmp;
+
+	tmp = XMMS_BUILD_PATH ("netcache");
+	cv = xmms_config_property_register ("netcache.path", tmp, NULL, NULL);
+	g_free (tmp);
+
+	netcache.dir = xmms_config_property_get_string (cv);
+
+	netcache.enabled = xmms_config_property_register ("netcache.enabled",
+	                                                  "1", NULL, NULL);
+	/* in MiB */
+	netcache.size = xmms_config_property_register ("netcache.size",
+	                                               "256", NULL, NULL);
+
+	netcache.mutex = g_mutex_new ();
+	netcache.files = g_hash_table_new (g_str_hash, g_str_equal);
+	netcache.lru = g_queue_new ();
+
+	xmms_netcache_scan ();
+}
+
+/**
+ * Counters of the cache since startup, for the stats command.
+ */
+xmmsv_t *
+xmms_netcache_stats (void)
+{
+	xmmsv_t *dict;
+
+	g_mutex_lock (netcache.mutex);
+	dict = xmmsv_build_dict (
+	        XMMSV_DICT_ENTRY_INT ("hits", netcache.hits),
+	        XMMSV_DICT_ENTRY_INT ("misses", netcache.misses),
+	        XMMSV_DICT_ENTRY_INT ("files", g_queue_get_length (netcache.lru)),
+	        XMMSV_DICT_ENTRY_INT ("used_kib", netcache.used / 1024),
+	        XMMSV_DICT_ENTRY_INT ("saved_kib", netcache.saved / 1024),
+	        XMMSV_DICT_ENTRY_INT ("fetched_kib", netcache.fetched / 1024),
+	        XMMSV_DICT_END);
+	g_mutex_unlock (netcache.mutex);
+
+	return dict;
+}
+
+static void
+xmms_netcache_count (guint64 *counter, gint len)
+{
+	g_mutex_lock (netcache.mutex);
+	*counter += len;
+	g_mutex_unlock (netcache.mutex);
+}
+
+static void
+xmms_netcache_range_add (GArray *ranges, gint64 start, gint64 end)
+{
+	xmms_netcache_range_t r, *p;
+	guint i = 0, j;
+
+	r.start = start;
+	r.end = end;
+
+	while (i < ranges->len &&
+	       g_array_index (ranges, xmms_netcache_range_t, i).end < start) {
+		i++;
+	}
+
+	for (j = i; j < ranges->len; j++) {
+		p = &g_array_index (ranges, xmms_netcache_range_t, j);
+		if (p->start > end) {
+			break;
+		}
+		r.start = MIN (r.start, p->start);
+		r.end = MAX (r.end, p->end);
+	}
+
+	if (j > i) {
+		g_array_remove_range (ranges, i, j - i);
+	}
+	g_array_insert_val (ranges, i, r);
+}
+
+/* bytes available in the file from pos on */
+static gint64
+xmms_netcache_range_avail (GArray *ranges, gint64 pos)
+{
+	xmms_netcache_range_t *p;
+	guint i;
+
+	for (i = 0; i < ranges->len; i++) {
+		p = &g_array_index (ranges, xmms_netcache_range_t, i);
+		if (p->start > pos) {
+			break;
+		}
+		if (p->end > pos) {
+			return p->end - pos;
+		}
+	}
+
+	return 0;
+}
+
+/* start of the next fetched range after pos */
+static gint64
+xmms_netcache_range_next (GArray *ranges, gint64 pos, gint64 size)
+{
+	xmms_netcache_range_t *p;
+	guint i;
+
+	for (i = 0; i < ranges->len; i++) {
+		p = &g_array_index (ranges, xmms_netcache_range_t, i);
+		if (p->start > pos) {
+			return p->start;
+		}
+	}
+
+	return size;
+}
+
+static gboolean
+xmms_netcache_pread (gint fd, gpointer buf, gint len, gint64 offset)
+{
+	gint ret;
+
+	if (lseek (fd, offset, SEEK_SET) == -1) {
+		return FALSE;
+	}
+
+	while (len > 0) {
+		ret = read (fd, buf, len);
+		if (ret <= 0) {
+			if (ret == -1 && errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		buf = (gchar *) buf + ret;
+		len -= ret;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+xmms_netcache_pwrite (gint fd, gconstpointer buf, gint len, gint64 offset)
+{
+	gint ret;
+
+	if (lseek (fd, offset, SEEK_SET) == -1) {
+		return FALSE;
+	}
+
+	while (len > 0) {
+		ret = write (fd, buf, len);
+		if (ret <= 0) {
+			if (ret == -1 && errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		buf = (const gchar *) buf + ret;
+		len -= ret;
+	}
+
+	return TRUE;
+}
+
+/* stop caching this stream, everything is read from the source */
+static void
+xmms_netcache_drop (xmms_netcache_priv_t *priv)
+{
+	if (priv->fd != -1) {
+		close (priv->fd);
+		priv->fd = -1;
+	}
+
+	if (priv->tmppath) {
+		g_unlink (priv->tmppath);
+		g_free (priv->tmppath);
+		priv->tmppath = NULL;
+	}
+
+	g_array_set_size (priv->ranges, 0);
+}
+
+static void
+xmms_netcache_finish (xmms_netcache_priv_t *priv)
+{
+	gchar *path;
+
+	path = g_build_filename (netcache.dir, priv->name, NULL);
+
+	if (g_rename (priv->tmppath, path) == -1) {
+		xmms_log_error ("Couldn't move %s to %s", priv->tmppath, path);
+		g_free (path);
+		return;
+	}
+
+	g_free (priv->tmppath);
+	priv->tmppath = NULL;
+	g_free (path);
+
+	g_mutex_lock (netcache.mutex);
+	xmms_netcache_insert (priv->name, priv->header + priv->size,
+	                      time (NULL), TRUE);
+	xmms_netcache_evict ();
+	g_mutex_unlock (netcache.mutex);
+}
+
+static void
+xmms_netcache_store (xmms_netcache_priv_t *priv, gconstpointer buf,
+                     gint len, gint64 offset)
+{
+	xmms_netcache_range_t *r;
+
+	if (priv->fd == -1 || !priv->tmppath) {
+		return;
+	}
+
+	if (!xmms_netcache_pwrite (priv->fd, buf, len, priv->header + offset)) {
+		xmms_log_error ("Couldn't write to %s: %s", priv->tmppath,
+		                strerror (errno));
+		xmms_netcache_drop (priv);
+		return;
+	}
+
+	xmms_netcache_range_add (priv->ranges, offset, offset + len);
+
+	r = &g_array_index (priv->ranges, xmms_netcache_range_t, 0);
+	if (priv->ranges->len == 1 && r->start == 0 && r->end == priv->size) {
+		xmms_netcache_finish (priv);
+	}
+}
+
+/* the header holds the whole key, a hash collision is not a hit */
+static GString *
+xmms_netcache_header (const gchar *key)
+{
+	GString *str;
+	guint32 len;
+
+	len = GUINT32_TO_LE (strlen (key));
+
+	str = g_string_new (XMMS_NETCACHE_MAGIC);
+	g_string_append_len (str, (gchar *) &len, sizeof (len));
+	g_string_append (str, key);
+
+	return str;
+}
+
+static gboolean
+xmms_netcache_open_complete (xmms_netcache_priv_t *priv, GString *header)
+{
+	struct stat st;
+	gchar *path, *buf;
+	gboolean ret = FALSE;
+
+	path = g_build_filename (netcache.dir, priv->name, NULL);
+	priv->fd = g_open (path, O_RDONLY, 0);
+	g_free (path);
+
+	if (priv->fd == -1) {
+		return FALSE;
+	}
+
+	buf = g_malloc (header->len);
+	if (fstat (priv->fd, &st) == 0 &&
+	    st.st_size == priv->header + priv->size &&
+	    xmms_netcache_pread (priv->fd, buf, header->len, 0) &&
+	    memcmp (buf, header->str, header->len) == 0) {
+		ret = TRUE;
+	}
+	g_free (buf);
+
+	if (!ret) {
+		close (priv->fd);
+		priv->fd = -1;
+		return FALSE;
+	}
+
+	xmms_netcache_range_add (priv->ranges, 0, priv->size);
+
+	g_mutex_lock (netcache.mutex);
+	netcache.hits++;
+	xmms_netcache_touch (priv->name);
+	g_mutex_unlock (netcache.mutex);
+
+	return TRUE;
+}
+
+static gboolean
+xmms_netcache_open_partial (xmms_netcache_priv_t *priv, GString *header)
+{
+	gchar *tmp;
+
+	if (!g_file_test (netcache.dir, G_FILE_TEST_IS_DIR) &&
+	    g_mkdir_with_parents (netcache.dir, 0755) == -1) {
+		xmms_log_error ("Couldn't create %s", netcache.dir);
+		return FALSE;
+	}
+
+	tmp = g_strconcat (priv->name, ".part-XXXXXX", NULL);
+	priv->tmppath = g_build_filename (netcache.dir, tmp, NULL);
+	g_free (tmp);
+
+	priv->fd = g_mkstemp (priv->tmppath);
+	if (priv->fd == -1 ||
+	    !xmms_netcache_pwrite (priv->fd, header->str, header->len, 0)) {
+		xmms_log_error ("Couldn't create %s", priv->tmppath);
+		xmms_netcache_drop (priv);
+		return FALSE;
+	}
+
+	g_mutex_lock (netcache.mutex);
+	netcache.misses++;
+	g_mutex_unlock (netcache.mutex);
+
+	return TRUE;
+}
+
+/* FNV-1a */
+static gchar *
+xmms_netcache_name (const gchar *key)
+{
+	guint64 hash = G_GINT64_CONSTANT (0xcbf29ce484222325U);
+
+	for (; *key; key++) {
+		hash ^= (guchar) *key;
+		hash *= G_GINT64_CONSTANT (0x100000001b3U);
+	}
+
+	return g_strdup_printf ("%016" G_GINT64_MODIFIER "x", hash);
+}
+
+static gboolean
+xmms_netcache_plugin_init (xmms_xform_t *xform)
+{
+	xmms_netcache_priv_t *priv;
+	const gchar *url, *mime, *etag = NULL;
+	gboolean has_lmod;
+	gint32 size, lmod = 0;
+	GString *header;
+	gchar *key;
+
+	if (!xmms_config_property_get_int (netcache.enabled)) {
+		return FALSE;
+	}
+
+	/* radio streams have no size and wouldn't fit anyway */
+	if (!xmms_xform_metadata_get_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
+	                                  &size) || size <= 0 ||
+	    size > xmms_netcache_limit () / XMMS_NETCACHE_MAX_SHARE) {
+		return FALSE;
+	}
+
+	mime = xmms_xform_indata_get_str (xform, XMMS_STREAM_TYPE_MIMETYPE);
+	if (mime && strcmp (mime, "application/x-icy-stream") == 0) {
+		return FALSE;
+	}
+
+	url = xmms_xform_get_url (xform);
+	if (!url) {
+		return FALSE;
+	}
+
+	has_lmod = xmms_xform_metadata_get_int (xform,
+	                                        XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD,
+	                                        &lmod);
+	xmms_xform_metadata_get_str (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_ETAG,
+	                             &etag);
+
+	/* nothing tells us when the source changes */
+	if (!has_lmod && !etag) {
+		return FALSE;
+	}
+
+	key = g_strdup_printf ("%s\n%d\n%d\n%s", url, size, lmod,
+	                       etag ? etag : "");
+	header = xmms_netcache_header (key);
+
+	priv = g_new0 (xmms_netcache_priv_t, 1);
+	priv->fd = -1;
+	priv->name = xmms_netcache_name (key);
+	priv->header = header->len;
+	priv->size = size;
+	priv->ranges = g_array_new (FALSE, FALSE, sizeof (xmms_netcache_range_t));
+
+	g_free (key);
+
+	if (!xmms_netcache_open_complete (priv, header) &&
+	    !xmms_netcache_open_partial (priv, header)) {
+		g_string_free (header, TRUE);
+		g_array_free (priv->ranges, TRUE);
+		g_free (priv->name);
+		g_free (priv);
+		return FALSE;
+	}
+
+	g_string_free (header, TRUE);
+
+	xmms_xform_private_data_set (xform, priv);
+	xmms_xform_outdata_type_copy (xform);
+
+	return TRUE;
+}
+
+static void
+xmms_netcache_plugin_destroy (xmms_xform_t *xform)
+{
+	xmms_netcache_priv_t *priv;
+
+	priv = xmms_xform_private_data_get (xform);
+
+	xmms_netcache_drop (priv);
+
+	g_array_free (priv->ranges, TRUE);
+	g_free (priv->name);
+	g_free (priv);
+}
+
+/* bring the source to our position, by seeking or by reading up to it */
+static gboolean
+xmms_netcache_sync (xmms_xform_t *xform, xmms_netcache_priv_t *priv,
+                    xmms_error_t *error)
+{
+	gchar buf[4096];
+	gint ret;
+
+	if (priv->source_pos == priv->pos) {
+		return TRUE;
+	}
+
+	if (xmms_xform_seek (xform, priv->pos, XMMS_XFORM_SEEK_SET,
+	                     error) == priv->pos) {
+		priv->source_pos = priv->pos;
+		return TRUE;
+	}
+
+	if (priv->source_pos > priv->pos) {
+		return FALSE;
+	}
+
+	xmms_error_reset (error);
+
+	/* what is skipped over is still worth keeping */
+	while (priv->source_pos < priv->pos) {
+		ret = xmms_xform_read (xform, buf,
+		                       MIN (sizeof (buf), priv->pos - priv->source_pos),
+		                       error);
+		if (ret <= 0) {
+			if (ret == 0) {
+				xmms_error_set (error, XMMS_ERROR_GENERIC, "Source ended early");
+			}
+			return FALSE;
+		}
+
+		xmms_netcache_store (priv, buf, ret, priv->source_pos);
+		xmms_netcache_count (&netcache.fetched, ret);
+		priv->source_pos += ret;
+	}
+
+	return TRUE;
+}
+
+static gint
+xmms_netcache_plugin_read (xmms_xform_t *xform, void *buffer, gint len,
+                           xmms_error_t *error)
+{
+	xmms_netcache_priv_t *priv;
+	gint64 avail;
+	gint ret;
+
+	priv = xmms_xform_private_data_get (xform);
+
+	if (priv->pos >= priv->size) {
+		return 0;
+	}
+
+	len = MIN (len, priv->size - priv->pos);
+
+	avail = xmms_netcache_range_avail (priv->ranges, priv->pos);
+	if (avail > 0) {
+		len = MIN (len, avail);
+		if (xmms_netcache_pread (priv->fd, buffer, len,
+		                         priv->header + priv->pos)) {
+			priv->pos += len;
+			xmms_netcache_count (&netcache.saved, len);
+			return len;
+		}
+
+		xmms_log_error ("Couldn't read from cache, using the source");
+		xmms_netcache_drop (priv);
+	}
+
+	/* don't fetch what is already there again */
+	len = MIN (len, xmms_netcache_range_next (priv->ranges, priv->pos,
+	                                          priv->size) - priv->pos);
+
+	if (!xmms_netcache_sync (xform, priv, error)) {
+		return -1;
+	}
+
+	ret = xmms_xform_read (xform, buffer, len, error);
+	if (ret > 0) {
+		xmms_netcache_store (priv, buffer, ret, priv->pos);
+		xmms_netcache_count (&netcache.fetched, ret);
+		priv->pos += ret;
+		priv->source_pos += ret;
+	}
+
+	return ret;
+}
+
+static gint64
+xmms_netcache_plugin_seek (xmms_xform_t *xform, gint64 offset,
+                           xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_netcache_priv_t *priv;
+	gint64 res;
+
+	priv = xmms_xform_private_data_get (xform);
+
+	if (whence == XMMS_XFORM_SEEK_CUR) {
+		offset += priv->pos;
+	} else if (whence == XMMS_XFORM_SEEK_END) {
+		offset += priv->size;
+	}
+
+	if (offset < 0 || offset > priv->size) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Seek out of range");
+		return -1;
+	}
+
+	/* forward seeks can always be served by reading on, backwards
+	 * the source has to be able to seek unless the data is cached
+	 */
+	if (offset < priv->source_pos && offset < priv->size &&
+	    !xmms_netcache_range_avail (priv->ranges, offset)) {
+		res = xmms_xform_seek (xform, offset, XMMS_XFORM_SEEK_SET, error);
+		if (res == -1) {
+			return -1;
+		}
+		priv->source_pos = res;
+	}
+
+	priv->pos = offset;
+
+	return offset;
+}
+
+static gboolean
+xmms_netcache_plugin_setup (xmms_xform_plugin_t *xform_plugin)
+{
+	xmms_xform_methods_t methods;
+
+	XMMS_XFORM_METHODS_INIT (methods);
+	methods.init = xmms_netcache_plugin_init;
+	methods.destroy = xmms_netcache_plugin_destroy;
+	methods.read = xmms_netcache_plugin_read;
+	methods.seek = xmms_netcache_plugin_seek;
+
+	xmms_xform_plugin_methods_set (xform_plugin, &methods);
+
+	/* no indata, it's never picked by type, only put behind the
+	 * transport by xmms_netcache_xform_wrap
+	 */
+	netcache_plugin = xform_plugin;
+
+	return TRUE;
+}
+
+/**
+ * Put a cache behind a transport if it reads from the network and the
+ * stream can be cached. Takes over the reference to prev and returns
+ * the new end of the chain, which is prev itself if nothing was added.
+ */
+xmms_xform_t *
+xmms_netcache_xform_wrap (xmms_xform_t *prev, xmms_medialib_entry_t entry,
+                          GList *goal_hints)
+{
+	xmms_xform_t *xform;
+	const gchar *url;
+
+	url = xmms_xform_get_url (prev);
+	if (!netcache_plugin || !url ||
+	    g_ascii_strncasecmp (url, "file://", 7) == 0) {
+		return prev;
+	}
+
+	xform = xmms_xform_new (netcache_plugin, prev, entry, goal_hints);
+	if (!xform) {
+		return prev;
+	}
+
+	xmms_object_unref (prev);
+
+	return xform;
+}
+
+XMMS_XFORM_BUILTIN (netcache,
+                    "Network cache",
+                    XMMS_VERSION,
+                    "Disk cache for remote sources",
+                    xmms_netcache_plugin_setup);
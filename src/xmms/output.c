@@ -30,6 +30,7 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_outputplugin.h"
 #include "xmmspriv/xmms_thread_name.h"
+#include "xmmspriv/xmms_ipc.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_ipc.h"
 #include "xmms/xmms_object.h"
@@ -148,6 +149,10 @@ struct xmms_output_St {
 	 */
 	gint32 buffer_underruns;
 
+	/** Values published by the plugin with #xmms_output_stats_set */
+	GMutex *stats_mutex;
+	GHashTable *plugin_stats;
+
 	GThread *monitor_volume_thread;
 	gboolean monitor_volume_running;
 };
@@ -221,6 +226,8 @@ static void
 update_playtime (xmms_output_t *output, int advance)
 {
 	guint buffersize = 0;
+	guint ms = 0;
+	gboolean changed = FALSE;
 
 	g_mutex_lock (output->playtime_mutex);
 	output->played += advance;
@@ -235,20 +242,22 @@ update_playtime (xmms_output_t *output, int advance)
 	g_mutex_lock (output->playtime_mutex);
 
 	if (output->format) {
-		guint ms = xmms_sample_bytes_to_ms (output->format,
-		                                    output->played - buffersize);
-		if ((ms / 100) != (output->played_time / 100)) {
-			xmms_object_emit_f (XMMS_OBJECT (output),
-			                    XMMS_IPC_SIGNAL_PLAYBACK_PLAYTIME,
-			                    XMMSV_TYPE_INT32,
-			                    ms);
-		}
+		ms = xmms_sample_bytes_to_ms (output->format,
+		                              output->played - buffersize);
+		changed = (ms / 100) != (output->played_time / 100);
 		output->played_time = ms;
 
 	}
 
 	g_mutex_unlock (output->playtime_mutex);
 
+	/* emit without holding the lock, and only when a client waits */
+	if (changed && xmms_ipc_has_pending (XMMS_IPC_SIGNAL_PLAYBACK_PLAYTIME)) {
+		xmms_object_emit_f (XMMS_OBJECT (output),
+		                    XMMS_IPC_SIGNAL_PLAYBACK_PLAYTIME,
+		                    XMMSV_TYPE_INT32,
+		                    ms);
+	}
 }
 
 void
@@ -268,9 +277,26 @@ xmms_output_set_error (xmms_output_t *output, xmms_error_t *error)
 typedef struct {
 	xmms_output_t *output;
 	xmms_xform_t *chain;
+	xmms_medialib_entry_t entry;
 	gboolean flush;
 } xmms_output_song_changed_arg_t;
 
+static xmms_output_song_changed_arg_t *
+song_changed_arg_new (xmms_output_t *output, xmms_xform_t *chain,
+                      xmms_medialib_entry_t entry, gboolean flush)
+{
+	xmms_output_song_changed_arg_t *arg;
+
+	arg = g_new0 (xmms_output_song_changed_arg_t, 1);
+	arg->output = output;
+	arg->chain = chain;
+	arg->entry = entry;
+	arg->flush = flush;
+	xmms_object_ref (chain);
+
+	return arg;
+}
+
 static void
 song_changed_arg_free (void *data)
 {
@@ -287,7 +313,10 @@ song_changed (void *data)
 	xmms_medialib_entry_t entry;
 	xmms_stream_type_t *type;
 
-	entry = xmms_xform_entry_get (arg->chain);
+	/* a chain continued with the next segment has its entry changed
+	 * before this runs, so the entry is remembered separately
+	 */
+	entry = arg->entry;
 
 	XMMS_DBG ("Running hotspot! Song changed!! %d", entry);
 
@@ -466,11 +495,7 @@ xmms_output_filler (void *arg)
 				continue;
 			}
 
-			hsarg = g_new0 (xmms_output_song_changed_arg_t, 1);
-			hsarg->output = output;
-			hsarg->chain = chain;
-			hsarg->flush = last_was_kill;
-			xmms_object_ref (chain);
+			hsarg = song_changed_arg_new (output, chain, entry, last_was_kill);
 
 			last_was_kill = FALSE;
 
@@ -501,15 +526,39 @@ xmms_output_filler (void *arg)
 				                         output->filler_mutex);
 			}
 		} else {
+			xmms_medialib_entry_t next = 0;
+			xmms_output_song_changed_arg_t *hsarg;
+
 			if (ret == -1) {
 				/* print error */
 				xmms_error_reset (&err);
 			}
-			xmms_object_unref (chain);
-			chain = NULL;
 			if (!xmms_playlist_advance (output->playlist)) {
 				XMMS_DBG ("End of playlist");
 				output->filler_state = FILLER_STOP;
+			} else if (ret == 0) {
+				next = xmms_playlist_current_entry (output->playlist);
+			}
+
+			/* the next track of a cue sheet can keep using the
+			 * decoder that just finished the previous one
+			 */
+			if (next) {
+				g_mutex_unlock (output->filler_mutex);
+				if (!xmms_xform_chain_continue (chain, next)) {
+					next = 0;
+				}
+				g_mutex_lock (output->filler_mutex);
+			}
+
+			if (next && output->filler_state == FILLER_RUN) {
+				XMMS_DBG ("Continuing with adjacent segment %d", next);
+				hsarg = song_changed_arg_new (output, chain, next, FALSE);
+				xmms_ringbuf_hotspot_set (output->filler_buffer, song_changed,
+				                          song_changed_arg_free, hsarg);
+			} else {
+				xmms_object_unref (chain);
+				chain = NULL;
 			}
 		}
 
@@ -558,6 +607,52 @@ xmms_output_read (xmms_output_t *output, char *buffer, gint len)
 	return ret;
 }
 
+void
+xmms_output_stats_set (xmms_output_t *output, const gchar *key, gint value)
+{
+	g_return_if_fail (output);
+	g_return_if_fail (key);
+
+	g_mutex_lock (output->stats_mutex);
+	g_hash_table_insert (output->plugin_stats, g_strdup (key),
+	                     GINT_TO_POINTER (value));
+	g_mutex_unlock (output->stats_mutex);
+}
+
+static void
+xmms_output_stats_foreach (gpointer key, gpointer value, gpointer udata)
+{
+	xmmsv_t *dict = udata;
+	xmmsv_t *val;
+
+	val = xmmsv_new_int (GPOINTER_TO_INT (value));
+	xmmsv_dict_set (dict, key, val);
+	xmmsv_unref (val);
+}
+
+/**
+ * Get the statistics of the output and the values published by the
+ * output plugin.
+ */
+xmmsv_t *
+xmms_output_stats (xmms_output_t *output)
+{
+	xmmsv_t *ret;
+
+	g_return_val_if_fail (output, NULL);
+
+	ret = xmmsv_build_dict (
+	        XMMSV_DICT_ENTRY_INT ("bytes_written", output->bytes_written),
+	        XMMSV_DICT_ENTRY_INT ("underruns", output->buffer_underruns),
+	        XMMSV_DICT_END);
+
+	g_mutex_lock (output->stats_mutex);
+	g_hash_table_foreach (output->plugin_stats, xmms_output_stats_foreach, ret);
+	g_mutex_unlock (output->stats_mutex);
+
+	return ret;
+}
+
 gint
 xmms_output_bytes_available (xmms_output_t *output)
 {
@@ -875,6 +970,8 @@ xmms_output_destroy (xmms_object_t *object)
 	g_mutex_free (output->status_mutex);
 	g_mutex_free (output->playtime_mutex);
 	g_mutex_free (output->filler_mutex);
+	g_mutex_free (output->stats_mutex);
+	g_hash_table_destroy (output->plugin_stats);
 	g_cond_free (output->filler_state_cond);
 	xmms_ringbuf_destroy (output->filler_buffer);
 
@@ -941,6 +1038,9 @@ xmms_output_new (xmms_output_plugin_t *plugin, xmms_playlist_t *playlist)
 
 	output->status_mutex = g_mutex_new ();
 	output->playtime_mutex = g_mutex_new ();
+	output->stats_mutex = g_mutex_new ();
+	output->plugin_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+	                                              g_free, NULL);
 
 	prop = xmms_config_property_register ("output.buffersize", "32768", NULL, NULL);
 	size = xmms_config_property_get_int (prop);
@@ -1044,6 +1144,10 @@ set_plugin (xmms_output_t *output, xmms_output_plugin_t *plugin)
 	}
 	xmms_output_format_list_clear (output);
 
+	g_mutex_lock (output->stats_mutex);
+	g_hash_table_remove_all (output->plugin_stats);
+	g_mutex_unlock (output->stats_mutex);
+
 	/* output->plugin needs to be set before we can call the
 	 * NEW method
 	 */
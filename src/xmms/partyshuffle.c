@@ -0,0 +1,566 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+/** @file
+ *  Keeps the candidate entries of each party shuffle playlist, so that
+ *  picking the next random entry does not have to query the whole source
+ *  collection.
+ *
+ *  The candidates are queried once, and then only the entries reported as
+ *  added, updated or removed by the medialib are checked against the
+ *  source collection again. Any change to the collections drops all the
+ *  candidate sets.
+ *
+ *  If the party shuffle playlist has a "weight" attribute, the entries are
+ *  drawn with a probability proportional to one plus the value of that
+ *  (integer) property, e.g. "rating". The weights are kept in a Fenwick
+ *  tree, so drawing and updating an entry are O(log n). Without weights
+ *  an entry is drawn in constant time.
+ */
+
+#include "xmmspriv/xmms_partyshuffle.h"
+#include "xmms/xmms_log.h"
+#include <glib.h>
+#include <string.h>
+
+/* Check this many changed entries against the source in a single query */
+#define XMMS_PARTYSHUFFLE_CHECK_BATCH 1000
+
+/* Query everything again rather than checking that many changed entries */
+#define XMMS_PARTYSHUFFLE_MAX_PENDING 50000
+
+typedef struct {
+	/* the party shuffle playlist and its source, both referenced */
+	xmmsv_coll_t *plcoll;
+	xmmsv_coll_t *source;
+	gchar *weight;
+
+	gboolean valid;
+
+	/* entries changed in the medialib since the last draw */
+	GHashTable *pending;
+	gboolean overflow;
+
+	GArray *ids;
+	GArray *weights;
+	GArray *tree;       /* Fenwick tree of the weights, 1-based */
+	GHashTable *slots;  /* id -> index in ids + 1 */
+} xmms_partyshuffle_cache_t;
+
+struct xmms_partyshuffle_St {
+	/* protects the pending entries and the generation, which are updated
+	 * from signal handlers that may run with the collection DAG locked */
+	GMutex *mutex;
+	guint generation;
+
+	/* plcoll -> xmms_partyshuffle_cache_t, only changed while drawing,
+	 * which always happens with the playlist locked */
+	GHashTable *caches;
+	guint caches_generation;
+};
+
+static void
+xmms_partyshuffle_cache_free (gpointer data)
+{
+	xmms_partyshuffle_cache_t *cache = data;
+
+	xmmsv_coll_unref (cache->plcoll);
+	xmmsv_coll_unref (cache->source);
+	g_free (cache->weight);
+
+	g_hash_table_destroy (cache->pending);
+	g_hash_table_destroy (cache->slots);
+	g_array_free (cache->ids, TRUE);
+	g_array_free (cache->weights, TRUE);
+	g_array_free (cache->tree, TRUE);
+
+	g_free (cache);
+}
+
+/**
+ * Create the party shuffle candidate caches.
+ */
+xmms_partyshuffle_t *
+xmms_partyshuffle_new (void)
+{
+	xmms_partyshuffle_t *ps;
+
+	ps = g_new0 (xmms_partyshuffle_t, 1);
+	ps->mutex = g_mutex_new ();
+	ps->caches = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+	                                    xmms_partyshuffle_cache_free);
+
+	return ps;
+}
+
+void
+xmms_partyshuffle_free (xmms_partyshuffle_t *ps)
+{
+	g_return_if_fail (ps);
+
+	g_hash_table_destroy (ps->caches);
+	g_mutex_free (ps->mutex);
+	g_free (ps);
+}
+
+/**
+ * Tell the caches that an entry was added, updated or removed from
+ * the medialib. The entry is checked against the sources on the next draw.
+ */
+void
+xmms_partyshuffle_entry_changed (xmms_partyshuffle_t *ps,
+                                 xmms_medialib_entry_t entry)
+{
+	xmms_partyshuffle_cache_t *cache;
+	GHashTableIter iter;
+
+	g_return_if_fail (ps);
+
+	g_mutex_lock (ps->mutex);
+
+	g_hash_table_iter_init (&iter, ps->caches);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &cache)) {
+		if (cache->overflow) {
+			continue;
+		}
+
+		if (g_hash_table_size (cache->pending) >= XMMS_PARTYSHUFFLE_MAX_PENDING) {
+			g_hash_table_remove_all (cache->pending);
+			cache->overflow = TRUE;
+		} else {
+			g_hash_table_insert (cache->pending, GINT_TO_POINTER (entry),
+			                     GINT_TO_POINTER (entry));
+		}
+	}
+
+	g_mutex_unlock (ps->mutex);
+}
+
+/**
+ * Drop all the candidate sets, as the collections they came from changed.
+ */
+void
+xmms_partyshuffle_invalidate (xmms_partyshuffle_t *ps)
+{
+	g_return_if_fail (ps);
+
+	g_mutex_lock (ps->mutex);
+	ps->generation++;
+	g_mutex_unlock (ps->mutex);
+}
+
+/**
+ * Whether the source reaches the content of a playlist, which changes
+ * without any collection nor medialib signal we could watch.
+ */
+static gboolean
+xmms_partyshuffle_refs_playlist (xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
+                                 gint depth)
+{
+	xmmsv_list_iter_t *it;
+	xmmsv_coll_t *op;
+	xmmsv_t *tmp;
+	gchar *target, *ns;
+	gboolean ret = FALSE;
+
+	/* should not happen in a validated DAG, but better safe than sorry */
+	if (depth > 64) {
+		return TRUE;
+	}
+
+	if (xmmsv_coll_get_type (coll) == XMMS_COLLECTION_TYPE_REFERENCE &&
+	    xmmsv_coll_attribute_get (coll, "reference", &target) &&
+	    xmmsv_coll_attribute_get (coll, "namespace", &ns) &&
+	    strcmp (target, "All Media") != 0) {
+		if (xmms_collection_get_namespace_id (ns) != XMMS_COLLECTION_NSID_COLLECTIONS) {
+			return TRUE;
+		}
+
+		op = xmms_collection_get_pointer (dag, target,
+		                                  XMMS_COLLECTION_NSID_COLLECTIONS);
+		if (op != NULL &&
+		    xmms_partyshuffle_refs_playlist (dag, op, depth + 1)) {
+			return TRUE;
+		}
+	}
+
+	xmmsv_get_list_iter (xmmsv_coll_operands_get (coll), &it);
+	for (; !ret && xmmsv_list_iter_valid (it); xmmsv_list_iter_next (it)) {
+		xmmsv_list_iter_entry (it, &tmp);
+		if (xmmsv_get_coll (tmp, &op)) {
+			ret = xmms_partyshuffle_refs_playlist (dag, op, depth + 1);
+		}
+	}
+	xmmsv_list_iter_explicit_destroy (it);
+
+	return ret;
+}
+
+static gint64
+tree_prefix_sum (GArray *tree, guint pos)
+{
+	gint64 sum = 0;
+
+	for (; pos > 0; pos -= pos & -pos) {
+		sum += g_array_index (tree, gint64, pos);
+	}
+
+	return sum;
+}
+
+static void
+tree_add (GArray *tree, guint pos, gint64 delta)
+{
+	for (; pos < tree->len; pos += pos & -pos) {
+		g_array_index (tree, gint64, pos) += delta;
+	}
+}
+
+static void
+tree_append (GArray *tree, gint64 weight)
+{
+	guint pos = tree->len;
+	gint64 node;
+
+	/* the new node covers the range (pos - lowbit (pos), pos] */
+	node = weight + tree_prefix_sum (tree, pos - 1)
+	       - tree_prefix_sum (tree, pos - (pos & -pos));
+	g_array_append_val (tree, node);
+}
+
+/** Find the slot whose range of cumulated weights contains target. */
+static guint
+tree_find (GArray *tree, gint64 target)
+{
+	guint pos = 0, step;
+
+	for (step = 1; step * 2 < tree->len; step *= 2);
+
+	for (; step > 0; step /= 2) {
+		if (pos + step < tree->len &&
+		    g_array_index (tree, gint64, pos + step) <= target) {
+			pos += step;
+			target -= g_array_index (tree, gint64, pos);
+		}
+	}
+
+	return pos;
+}
+
+static gint64
+xmms_partyshuffle_weight (xmms_partyshuffle_cache_t *cache, xmmsv_t *dict)
+{
+	gint32 value;
+
+	if (cache->weight == NULL ||
+	    !xmmsv_dict_entry_get_int (dict, cache->weight, &value)) {
+		return 1;
+	}
+
+	return MAX (value, 0) + 1;
+}
+
+static void
+xmms_partyshuffle_cache_set (xmms_partyshuffle_cache_t *cache,
+                             xmms_medialib_entry_t id, gint64 weight)
+{
+	guint slot;
+
+	slot = GPOINTER_TO_UINT (g_hash_table_lookup (cache->slots,
+	                                              GINT_TO_POINTER (id)));
+	if (slot > 0) {
+		tree_add (cache->tree, slot,
+		          weight - g_array_index (cache->weights, gint64, slot - 1));
+		g_array_index (cache->weights, gint64, slot - 1) = weight;
+		return;
+	}
+
+	g_array_append_val (cache->ids, id);
+	g_array_append_val (cache->weights, weight);
+	tree_append (cache->tree, weight);
+	g_hash_table_insert (cache->slots, GINT_TO_POINTER (id),
+	                     GUINT_TO_POINTER (cache->ids->len));
+}
+
+static void
+xmms_partyshuffle_cache_remove (xmms_partyshuffle_cache_t *cache,
+                                xmms_medialib_entry_t id)
+{
+	xmms_medialib_entry_t last_id;
+	gint64 weight, last_weight;
+	guint slot, last;
+
+	slot = GPOINTER_TO_UINT (g_hash_table_lookup (cache->slots,
+	                                              GINT_TO_POINTER (id)));
+	if (slot == 0) {
+		return;
+	}
+
+	g_hash_table_remove (cache->slots, GINT_TO_POINTER (id));
+
+	/* move the last entry into the freed slot */
+	last = cache->ids->len;
+	last_id = g_array_index (cache->ids, xmms_medialib_entry_t, last - 1);
+	last_weight = g_array_index (cache->weights, gint64, last - 1);
+	weight = g_array_index (cache->weights, gint64, slot - 1);
+
+	tree_add (cache->tree, last, -last_weight);
+	if (slot != last) {
+		tree_add (cache->tree, slot, last_weight - weight);
+		g_array_index (cache->ids, xmms_medialib_entry_t, slot - 1) = last_id;
+		g_array_index (cache->weights, gint64, slot - 1) = last_weight;
+		g_hash_table_insert (cache->slots, GINT_TO_POINTER (last_id),
+		                     GUINT_TO_POINTER (slot));
+	}
+
+	g_array_set_size (cache->ids, last - 1);
+	g_array_set_size (cache->weights, last - 1);
+	g_array_set_size (cache->tree, last);
+}
+
+static void
+xmms_partyshuffle_cache_clear (xmms_partyshuffle_cache_t *cache)
+{
+	gint64 zero = 0;
+
+	g_hash_table_remove_all (cache->slots);
+	g_array_set_size (cache->ids, 0);
+	g_array_set_size (cache->weights, 0);
+	g_array_set_size (cache->tree, 0);
+	g_array_append_val (cache->tree, zero);
+}
+
+/**
+ * Query the given collection and add the resulting entries with their
+ * weights to the cache.
+ */
+static gboolean
+xmms_partyshuffle_cache_query (xmms_partyshuffle_cache_t *cache,
+                               xmms_coll_dag_t *dag, xmmsv_coll_t *coll,
+                               GHashTable *found)
+{
+	xmmsv_t *order, *fetch, *group;
+	xmms_error_t err;
+	GList *res;
+	gint32 id;
+
+	xmms_error_reset (&err);
+
+	order = xmmsv_new_list ();
+	group = xmmsv_new_list ();
+	fetch = xmmsv_new_list ();
+	xmmsv_list_append_string (fetch, "id");
+	if (cache->weight != NULL) {
+		xmmsv_list_append_string (fetch, cache->weight);
+	}
+
+	res = xmms_collection_query_infos (dag, coll, 0, 0, order, fetch, group,
+	                                   &err);
+
+	xmmsv_unref (order);
+	xmmsv_unref (group);
+	xmmsv_unref (fetch);
+
+	for (; res; res = g_list_delete_link (res, res)) {
+		if (xmmsv_dict_entry_get_int (res->data, "id", &id)) {
+			xmms_partyshuffle_cache_set (cache, id,
+			                             xmms_partyshuffle_weight (cache,
+			                                                       res->data));
+			if (found != NULL) {
+				g_hash_table_insert (found, GINT_TO_POINTER (id),
+				                     GINT_TO_POINTER (id));
+			}
+		}
+		xmmsv_unref (res->data);
+	}
+
+	return !xmms_error_iserror (&err);
+}
+
+static gboolean
+xmms_partyshuffle_cache_rebuild (xmms_partyshuffle_cache_t *cache,
+                                 xmms_coll_dag_t *dag)
+{
+	XMMS_DBG ("Querying party shuffle candidates");
+
+	xmms_partyshuffle_cache_clear (cache);
+
+	return xmms_partyshuffle_cache_query (cache, dag, cache->source, NULL);
+}
+
+/**
+ * Check the changed entries against the source, adding, reweighting or
+ * removing them from the candidates.
+ */
+static gboolean
+xmms_partyshuffle_cache_check (xmms_partyshuffle_cache_t *cache,
+                               xmms_coll_dag_t *dag, GHashTable *pending)
+{
+	xmmsv_coll_t *inter, *idlist;
+	GHashTable *found;
+	GHashTableIter iter;
+	GList *ids = NULL, *n;
+	gpointer key;
+	gboolean ret = TRUE;
+	guint count;
+
+	found = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	g_hash_table_iter_init (&iter, pending);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ids = g_list_prepend (ids, key);
+	}
+
+	for (n = ids; n && ret; ) {
+		inter = xmmsv_coll_new (XMMS_COLLECTION_TYPE_INTERSECTION);
+		idlist = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+
+		for (count = 0; n && count < XMMS_PARTYSHUFFLE_CHECK_BATCH;
+		     n = n->next, count++) {
+			xmmsv_coll_idlist_append (idlist, GPOINTER_TO_INT (n->data));
+		}
+
+		xmmsv_coll_add_operand (inter, cache->source);
+		xmmsv_coll_add_operand (inter, idlist);
+
+		ret = xmms_partyshuffle_cache_query (cache, dag, inter, found);
+
+		xmmsv_coll_unref (idlist);
+		xmmsv_coll_unref (inter);
+	}
+
+	if (ret) {
+		for (n = ids; n; n = n->next) {
+			if (!g_hash_table_lookup (found, n->data)) {
+				xmms_partyshuffle_cache_remove (cache,
+				                                GPOINTER_TO_INT (n->data));
+			}
+		}
+	}
+
+	g_list_free (ids);
+	g_hash_table_destroy (found);
+
+	return ret;
+}
+
+static xmms_partyshuffle_cache_t *
+xmms_partyshuffle_cache_new (xmmsv_coll_t *plcoll, xmmsv_coll_t *source)
+{
+	xmms_partyshuffle_cache_t *cache;
+	gchar *weight;
+
+	cache = g_new0 (xmms_partyshuffle_cache_t, 1);
+
+	cache->plcoll = xmmsv_coll_ref (plcoll);
+	cache->source = xmmsv_coll_ref (source);
+	if (xmmsv_coll_attribute_get (plcoll, "weight", &weight) && *weight) {
+		cache->weight = g_strdup (weight);
+	}
+
+	cache->pending = g_hash_table_new (g_direct_hash, g_direct_equal);
+	cache->slots = g_hash_table_new (g_direct_hash, g_direct_equal);
+	cache->ids = g_array_new (FALSE, FALSE, sizeof (xmms_medialib_entry_t));
+	cache->weights = g_array_new (FALSE, FALSE, sizeof (gint64));
+	cache->tree = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+	xmms_partyshuffle_cache_clear (cache);
+
+	return cache;
+}
+
+/**
+ * Draw a random entry from the source of a party shuffle playlist.
+ * Must be called with the playlist locked.
+ *
+ * @param ps  The party shuffle caches.
+ * @param dag  The collection DAG.
+ * @param plcoll  The party shuffle playlist.
+ * @param source  The source collection of the playlist.
+ * @returns  A random entry of the source, 0 if it is empty.
+ */
+xmms_medialib_entry_t
+xmms_partyshuffle_draw (xmms_partyshuffle_t *ps, xmms_coll_dag_t *dag,
+                        xmmsv_coll_t *plcoll, xmmsv_coll_t *source)
+{
+	xmms_partyshuffle_cache_t *cache;
+	GHashTable *pending = NULL;
+	gboolean rebuild = FALSE;
+	guint slot;
+	gint64 total, target;
+
+	g_return_val_if_fail (ps, 0);
+
+	if (xmms_partyshuffle_refs_playlist (dag, source, 0)) {
+		return xmms_collection_get_random_media (dag, source);
+	}
+
+	g_mutex_lock (ps->mutex);
+
+	/* also drops the caches of playlists that were removed */
+	if (ps->caches_generation != ps->generation) {
+		g_hash_table_remove_all (ps->caches);
+		ps->caches_generation = ps->generation;
+	}
+
+	cache = g_hash_table_lookup (ps->caches, plcoll);
+	if (cache != NULL && cache->source != source) {
+		g_hash_table_remove (ps->caches, plcoll);
+		cache = NULL;
+	}
+
+	if (cache == NULL) {
+		cache = xmms_partyshuffle_cache_new (plcoll, source);
+		g_hash_table_insert (ps->caches, plcoll, cache);
+	}
+
+	if (!cache->valid || cache->overflow) {
+		g_hash_table_remove_all (cache->pending);
+		cache->overflow = FALSE;
+		rebuild = TRUE;
+	} else if (g_hash_table_size (cache->pending) > 0) {
+		pending = cache->pending;
+		cache->pending = g_hash_table_new (g_direct_hash, g_direct_equal);
+	}
+
+	g_mutex_unlock (ps->mutex);
+
+	/* the cache itself is only used with the playlist locked */
+	if (rebuild) {
+		cache->valid = xmms_partyshuffle_cache_rebuild (cache, dag);
+	} else if (pending != NULL) {
+		cache->valid = xmms_partyshuffle_cache_check (cache, dag, pending);
+	}
+
+	if (pending != NULL) {
+		g_hash_table_destroy (pending);
+	}
+
+	if (cache->ids->len == 0) {
+		return 0;
+	}
+
+	if (cache->weight == NULL) {
+		slot = g_random_int_range (0, cache->ids->len);
+	} else {
+		total = tree_prefix_sum (cache->tree, cache->ids->len);
+		target = (gint64) (g_random_double () * total);
+		slot = tree_find (cache->tree, MIN (target, total - 1));
+	}
+
+	return g_array_index (cache->ids, xmms_medialib_entry_t, slot);
+}
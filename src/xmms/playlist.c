@@ -31,7 +31,9 @@
 #include "xmms/xmms_ipc.h"
 #include "xmms/xmms_config.h"
 #include "xmmspriv/xmms_medialib.h"
+#include "xmmspriv/xmms_watcher.h"
 #include "xmmspriv/xmms_collection.h"
+#include "xmmspriv/xmms_partyshuffle.h"
 #include "xmms/xmms_log.h"
 /*
 #include "xmms/plsplugins.h"
@@ -107,9 +109,13 @@ struct xmms_playlist_St {
 	GMutex *mutex;
 
 	xmms_mediainfo_reader_t *mediainfordr;
+	xmms_watcher_t *watcher;
 
 	gboolean update_flag;
 	xmms_medialib_t *medialib;
+
+	/* random entry candidates of the party shuffle playlists */
+	xmms_partyshuffle_t *partyshuffle;
 };
 
 #include "playlist_ipc.c"
@@ -257,7 +263,8 @@ xmms_playlist_update_partyshuffle (xmms_playlist_t *playlist,
 	size = xmms_playlist_coll_get_size (coll);
 	while (size < currpos + 1 + upcoming) {
 		xmms_medialib_entry_t randentry;
-		randentry = xmms_collection_get_random_media (playlist->colldag, src);
+		randentry = xmms_partyshuffle_draw (playlist->partyshuffle,
+		                                    playlist->colldag, coll, src);
 		if (randentry == 0) {
 			break;  /* No media found in the collection, give up */
 		}
@@ -270,6 +277,25 @@ xmms_playlist_update_partyshuffle (xmms_playlist_t *playlist,
 	playlist->update_flag = FALSE;
 }
 
+static void
+on_medialib_entry_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_playlist_t *playlist = udata;
+	gint32 entry;
+
+	if (xmmsv_get_int (val, &entry)) {
+		xmms_partyshuffle_entry_changed (playlist->partyshuffle, entry);
+	}
+}
+
+static void
+on_collection_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_playlist_t *playlist = udata;
+
+	xmms_partyshuffle_invalidate (playlist->partyshuffle);
+}
+
 /**
  * Initializes a new xmms_playlist_t.
  */
@@ -306,6 +332,21 @@ xmms_playlist_init (void)
 	ret->medialib = xmms_medialib_init (ret);
 	ret->colldag = xmms_collection_init (ret);
 	ret->mediainfordr = xmms_mediainfo_reader_start ();
+	ret->watcher = xmms_watcher_start (ret->medialib);
+
+	ret->partyshuffle = xmms_partyshuffle_new ();
+
+	xmms_object_connect (XMMS_OBJECT (ret->medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                     on_medialib_entry_changed, ret);
+
+	xmms_object_connect (XMMS_OBJECT (ret->medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_UPDATE,
+	                     on_medialib_entry_changed, ret);
+
+	xmms_object_connect (XMMS_OBJECT (ret->colldag),
+	                     XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
+	                     on_collection_changed, ret);
 
 	return ret;
 }
@@ -673,6 +714,8 @@ xmms_playlist_remove_by_entry (xmms_playlist_t *playlist,
 	playlist_remove_info_t rminfo;
 	g_return_val_if_fail (playlist, FALSE);
 
+	xmms_partyshuffle_entry_changed (playlist->partyshuffle, entry);
+
 	g_mutex_lock (playlist->mutex);
 
 	rminfo.pls = playlist;
@@ -1006,8 +1049,10 @@ xmms_playlist_client_add_idlist (xmms_playlist_t *playlist,
 {
 	xmms_medialib_entry_t entry;
 	xmmsv_list_iter_t *it;
+	xmmsv_t *ids;
 
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (coll), &it);
+	ids = xmmsv_coll_idlist_copy (coll);
+	xmmsv_get_list_iter (ids, &it);
 	for (xmmsv_list_iter_first (it);
 	     xmmsv_list_iter_valid (it);
 	     xmmsv_list_iter_next (it)) {
@@ -1017,6 +1062,7 @@ xmms_playlist_client_add_idlist (xmms_playlist_t *playlist,
 			xmms_error_set (err, XMMS_ERROR_NOENT,
 			                "Idlist contains invalid medialib id!");
 			xmmsv_list_iter_explicit_destroy (it);
+			xmmsv_unref (ids);
 			return;
 		}
 	}
@@ -1029,6 +1075,7 @@ xmms_playlist_client_add_idlist (xmms_playlist_t *playlist,
 		xmms_playlist_add_entry (playlist, plname, entry, err);
 	}
 	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (ids);
 
 }
 
@@ -1237,61 +1284,74 @@ xmms_playlist_client_set_next_rel (xmms_playlist_t *playlist, gint32 pos,
 	return mid;
 }
 
+/* Sorting fetches the properties in batches of that many ids */
+#define XMMS_PLAYLIST_SORT_FETCH_BATCH 10000
+
+/* Ranges smaller than this are not worth sorting in a separate thread */
+#define XMMS_PLAYLIST_SORT_PARALLEL_MIN 16384
+#define XMMS_PLAYLIST_SORT_PARALLEL_DEPTH 2
+
+typedef struct {
+	xmmsv_type_t type;  /* XMMSV_TYPE_NONE if the property is missing */
+	gint32 intval;
+	gchar *key;         /* collation key of casefolded strings */
+} sortval_t;
+
 typedef struct {
 	xmms_medialib_entry_t id;
 	guint position;
-	GList *val;  /* List of (xmmsv_t *) prop values */
-	gboolean current;
+	sortval_t *vals;    /* one per sort property, shared by equal ids */
 } sortdata_t;
 
+typedef struct {
+	gint nprops;
+	gboolean *reverse;
+} sortprops_t;
+
+typedef struct {
+	sortprops_t *props;
+	sortdata_t *entries;
+	sortdata_t *tmp;
+	guint len;
+	gint depth;
+} sortjob_t;
+
 
 /**
  * Sort helper function.
- * Performs a case insesitive comparation between two entries.
- * We compare each pair of values in the list of prop values.
+ * Compares each pair of precomputed property values of two entries,
+ * strings by their case insensitive and numeric aware collation key.
  */
 static gint
-xmms_playlist_entry_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+xmms_playlist_entry_compare (const sortdata_t *data1, const sortdata_t *data2,
+                             sortprops_t *props)
 {
-	GList *n1, *n2;
-	xmmsv_t *val1, *val2, *properties, *propval;
-	xmmsv_list_iter_t *propit;
-	sortdata_t *data1 = (sortdata_t *) a;
-	sortdata_t *data2 = (sortdata_t *) b;
-	int s1, s2, res;
-	const gchar *propstr, *str1, *str2;
-
-	properties = (xmmsv_t *) user_data;
-	for (n1 = data1->val, n2 = data2->val, xmmsv_get_list_iter (properties, &propit);
-	     n1 && n2 && xmmsv_list_iter_valid (propit);
-	     n1 = n1->next, n2 = n2->next, xmmsv_list_iter_next (propit)) {
-
-		xmmsv_list_iter_entry (propit, &propval);
-		xmmsv_get_string (propval, &propstr);
-		if (propstr[0] == '-') {
-			val2 = n1->data;
-			val1 = n2->data;
+	const sortval_t *val1, *val2;
+	gint i, res;
+
+	for (i = 0; i < props->nprops; i++) {
+		if (props->reverse[i]) {
+			val1 = &data2->vals[i];
+			val2 = &data1->vals[i];
 		} else {
-			val1 = n1->data;
-			val2 = n2->data;
+			val1 = &data1->vals[i];
+			val2 = &data2->vals[i];
 		}
 
-		if (!val1) {
-			if (!val2)
+		if (val1->type == XMMSV_TYPE_NONE) {
+			if (val2->type == XMMSV_TYPE_NONE)
 				continue;
 			else
 				return -1;
 		}
 
-		if (!val2) {
+		if (val2->type == XMMSV_TYPE_NONE) {
 			return 1;
 		}
 
-		if (xmmsv_get_type (val1) == XMMSV_TYPE_STRING &&
-		    xmmsv_get_type (val2) == XMMSV_TYPE_STRING) {
-			xmmsv_get_string (val1, &str1);
-			xmmsv_get_string (val2, &str2);
-			res = g_utf8_collate (str1, str2);
+		if (val1->type == XMMSV_TYPE_STRING &&
+		    val2->type == XMMSV_TYPE_STRING) {
+			res = strcmp (val1->key, val2->key);
 			/* keep comparing next pair if equal */
 			if (res == 0)
 				continue;
@@ -1299,15 +1359,11 @@ xmms_playlist_entry_compare (gconstpointer a, gconstpointer b, gpointer user_dat
 				return res;
 		}
 
-		if (xmmsv_get_type (val1) == XMMSV_TYPE_INT32 &&
-		    xmmsv_get_type (val2) == XMMSV_TYPE_INT32)
-		{
-			xmmsv_get_int (val1, &s1);
-			xmmsv_get_int (val2, &s2);
-
-			if (s1 < s2)
+		if (val1->type == XMMSV_TYPE_INT32 &&
+		    val2->type == XMMSV_TYPE_INT32) {
+			if (val1->intval < val2->intval)
 				return -1;
-			else if (s1 > s2)
+			else if (val1->intval > val2->intval)
 				return 1;
 			else
 				continue;  /* equal, compare next pair of properties */
@@ -1322,49 +1378,180 @@ xmms_playlist_entry_compare (gconstpointer a, gconstpointer b, gpointer user_dat
 	return 0;
 }
 
+static gpointer xmms_playlist_sort_merge (gpointer udata);
+
 /**
- * Unwind helper function.
- * Frees the sortdata elements.
+ * Stable merge sort of the entries of a job, using tmp as scratch space.
+ * The left half is sorted in another thread while the job depth allows it.
  */
+static gpointer
+xmms_playlist_sort_merge (gpointer udata)
+{
+	sortjob_t *job = udata;
+	sortjob_t left, right;
+	GThread *thread = NULL;
+	guint half, i, j, k;
+
+	if (job->len < 2) {
+		return NULL;
+	}
+
+	half = job->len / 2;
+
+	left = *job;
+	left.len = half;
+	left.depth = job->depth - 1;
+
+	right = left;
+	right.entries = job->entries + half;
+	right.tmp = job->tmp + half;
+	right.len = job->len - half;
+
+	if (job->depth > 0 && job->len >= XMMS_PLAYLIST_SORT_PARALLEL_MIN) {
+		thread = g_thread_create (xmms_playlist_sort_merge, &left, TRUE, NULL);
+	}
+
+	if (thread == NULL) {
+		xmms_playlist_sort_merge (&left);
+	}
+	xmms_playlist_sort_merge (&right);
+
+	if (thread != NULL) {
+		g_thread_join (thread);
+	}
+
+	/* merge, taking from the left half on equality to keep it stable */
+	for (i = 0, j = half, k = 0; i < half && j < job->len; k++) {
+		if (xmms_playlist_entry_compare (&job->entries[j], &job->entries[i],
+		                                 job->props) < 0) {
+			job->tmp[k] = job->entries[j++];
+		} else {
+			job->tmp[k] = job->entries[i++];
+		}
+	}
+	while (i < half) {
+		job->tmp[k++] = job->entries[i++];
+	}
+	while (j < job->len) {
+		job->tmp[k++] = job->entries[j++];
+	}
+
+	memcpy (job->entries, job->tmp, job->len * sizeof (sortdata_t));
+
+	return NULL;
+}
+
 static void
-xmms_playlist_sorted_free (gpointer data, gpointer userdata)
+xmms_playlist_sortvals_free (gpointer data)
+{
+	sortval_t *vals = data;
+	gint i;
+
+	/* the number of values is stored in front of them */
+	for (i = 0; i < GPOINTER_TO_INT (((gpointer *) vals)[-1]); i++) {
+		g_free (vals[i].key);
+	}
+	g_free ((gpointer *) vals - 1);
+}
+
+/**
+ * Turn a dict of fetched properties into precomputed sort values.
+ */
+static sortval_t *
+xmms_playlist_sortvals_new (xmmsv_t *dict, xmmsv_t *fetch, gint nprops)
 {
-	GList *n;
-	sortdata_t *sorted = (sortdata_t *) data;
+	sortval_t *vals;
+	gpointer *mem;
+	const gchar *name, *str;
+	gchar *casefold;
+	xmmsv_t *val;
+	gint i;
+
+	mem = g_malloc0 (sizeof (gpointer) + nprops * sizeof (sortval_t));
+	mem[0] = GINT_TO_POINTER (nprops);
+	vals = (sortval_t *) (mem + 1);
+
+	/* the fetch list starts with the id */
+	for (i = 0; i < nprops; i++) {
+		xmmsv_list_get_string (fetch, i + 1, &name);
 
-	for (n = sorted->val; n; n = n->next) {
-		if (n->data) {
-			xmmsv_unref (n->data);
+		vals[i].type = XMMSV_TYPE_NONE;
+		if (!xmmsv_dict_get (dict, name, &val)) {
+			continue;
+		}
+
+		if (xmmsv_get_string (val, &str)) {
+			casefold = g_utf8_casefold (str, -1);
+			vals[i].key = g_utf8_collate_key_for_filename (casefold, -1);
+			vals[i].type = XMMSV_TYPE_STRING;
+			g_free (casefold);
+		} else if (xmmsv_get_int (val, &vals[i].intval)) {
+			vals[i].type = XMMSV_TYPE_INT32;
 		}
 	}
-	g_list_free (sorted->val);
-	g_free (sorted);
+
+	return vals;
 }
 
 /**
- * Unwind helper function.
- * Fills the playlist with the new sorted data.
+ * Fetch the sort properties of all the given ids, in as few medialib
+ * queries as possible.
+ *
+ * @return A hashtable mapping the ids to their sort values.
  */
-static void
-xmms_playlist_sorted_unwind (gpointer data, gpointer userdata)
+static GHashTable *
+xmms_playlist_sort_fetch (xmms_playlist_t *playlist, sortdata_t *entries,
+                          guint size, xmmsv_t *fetch, gint nprops,
+                          xmms_error_t *err)
 {
-	gint size;
-	sortdata_t *sorted = (sortdata_t *) data;
-	xmmsv_coll_t *playlist = (xmmsv_coll_t *)userdata;
+	GHashTable *sortvals;
+	xmmsv_coll_t *batch;
+	xmmsv_t *order, *group;
+	GList *res;
+	guint i, j;
+
+	sortvals = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+	                                  xmms_playlist_sortvals_free);
+
+	order = xmmsv_new_list ();
+	group = xmmsv_new_list ();
 
-	xmmsv_coll_idlist_append (playlist, sorted->id);
+	for (i = 0; i < size && !xmms_error_iserror (err); i = j) {
+		batch = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+		for (j = i; j < size && j < i + XMMS_PLAYLIST_SORT_FETCH_BATCH; j++) {
+			xmmsv_coll_idlist_append (batch, entries[j].id);
+		}
+
+		res = xmms_collection_query_infos (playlist->colldag, batch, 0, 0,
+		                                   order, fetch, group, err);
+		while (res) {
+			gint id;
+
+			if (xmmsv_dict_entry_get_int (res->data, "id", &id) &&
+			    !g_hash_table_lookup (sortvals, GINT_TO_POINTER (id))) {
+				g_hash_table_insert (sortvals, GINT_TO_POINTER (id),
+				                     xmms_playlist_sortvals_new (res->data, fetch,
+				                                                 nprops));
+			}
+
+			xmmsv_unref (res->data);
+			res = g_list_delete_link (res, res);
+		}
 
-	if (sorted->current) {
-		size = xmmsv_coll_idlist_get_size (playlist);
-		xmms_collection_set_int_attr (playlist, "position", size - 1);
+		xmmsv_coll_unref (batch);
 	}
 
-	xmms_playlist_sorted_free (sorted, NULL);
+	xmmsv_unref (order);
+	xmmsv_unref (group);
+
+	return sortvals;
 }
 
 /** Sorts the playlist by properties.
  *
- *  This will sort the list.
+ *  This will sort the list. The properties are fetched and the entries
+ *  sorted without holding the playlist lock, which is only taken again
+ *  to replace the entries of the (unchanged) playlist.
  *  @param playlist The playlist to sort.
  *  @param properties Tells xmms_playlist_sort which properties it
  *  should use when sorting.
@@ -1376,42 +1563,33 @@ static void
 xmms_playlist_client_sort (xmms_playlist_t *playlist, const gchar *plname,
                            xmmsv_t *properties, xmms_error_t *err)
 {
-	guint32 i;
-	GList *tmp = NULL, *n;
-	sortdata_t *data;
+	guint i;
+	sortdata_t *entries;
+	sortjob_t job;
+	sortprops_t props;
+	sortval_t *nonevals;
+	GHashTable *sortvals;
 	const gchar *str;
-	xmmsv_t *val;
-	xmms_medialib_session_t *session;
 	gboolean list_changed = FALSE;
 	xmmsv_coll_t *plcoll;
-	gint currpos, size;
-	xmmsv_t *valstr;
+	gint currpos, oldpos, size;
+	xmms_medialib_entry_t id;
+	xmmsv_t *valstr, *fetch;
 	xmmsv_list_iter_t *propit;
 
 	g_return_if_fail (playlist);
 	g_return_if_fail (properties);
 
-	g_mutex_lock (playlist->mutex);
-
-	plcoll = xmms_playlist_get_coll (playlist, plname, err);
-	if (plcoll == NULL) {
-		xmms_error_set (err, XMMS_ERROR_NOENT, "no such playlist!");
-		g_mutex_unlock (playlist->mutex);
-		return;
-	}
-
 	/* check for invalid property strings */
 	if (!check_string_list (properties)) {
 		xmms_error_set (err, XMMS_ERROR_NOENT,
 		                "invalid list of properties to sort by!");
-		g_mutex_unlock (playlist->mutex);
 		return;
 	}
 
 	if (xmmsv_list_get_size (properties) < 1) {
 		xmms_error_set (err, XMMS_ERROR_NOENT,
 		                "empty list of properties to sort by!");
-		g_mutex_unlock (playlist->mutex);
 		return;
 	}
 
@@ -1420,7 +1598,15 @@ xmms_playlist_client_sort (xmms_playlist_t *playlist, const gchar *plname,
 	xmmsv_get_string (valstr, &str);
 	XMMS_DBG ("Sorting on %s (and maybe more)", str);
 
-	currpos = xmms_playlist_coll_get_currpos (plcoll);
+	g_mutex_lock (playlist->mutex);
+
+	plcoll = xmms_playlist_get_coll (playlist, plname, err);
+	if (plcoll == NULL) {
+		xmms_error_set (err, XMMS_ERROR_NOENT, "no such playlist!");
+		g_mutex_unlock (playlist->mutex);
+		return;
+	}
+
 	size = xmms_playlist_coll_get_size (plcoll);
 
 	/* check whether we need to do any sorting at all */
@@ -1429,74 +1615,116 @@ xmms_playlist_client_sort (xmms_playlist_t *playlist, const gchar *plname,
 		return;
 	}
 
-	session = xmms_medialib_begin ();
+	/* work on a copy of the entries, without holding the lock */
+	entries = g_new (sortdata_t, size);
+	for (i = 0; i < size; i++) {
+		xmmsv_coll_idlist_get_index (plcoll, i, &entries[i].id);
+		entries[i].position = i;
+	}
+
+	g_mutex_unlock (playlist->mutex);
+
+	/* fetch the id and the sort properties, without their '-' prefix */
+	props.nprops = xmmsv_list_get_size (properties);
+	props.reverse = g_new (gboolean, props.nprops);
+
+	fetch = xmmsv_new_list ();
+	xmmsv_list_append_string (fetch, "id");
 
 	xmmsv_get_list_iter (properties, &propit);
-	for (i = 0; i < size; i++) {
-		data = g_new (sortdata_t, 1);
-
-		xmmsv_coll_idlist_get_index (plcoll, i, &data->id);
-		data->position = i;
-
-		/* save the list of values corresponding to the list of sort props */
-		data->val = NULL;
-		for (xmmsv_list_iter_first (propit);
-		     xmmsv_list_iter_valid (propit);
-		     xmmsv_list_iter_next (propit)) {
-
-			xmmsv_list_iter_entry (propit, &valstr);
-			xmmsv_get_string (valstr, &str);
-			if (str[0] == '-')
-				str++;
-
-			val = xmms_medialib_entry_property_get_value (session,
-			                                              data->id,
-			                                              str);
-
-			if (val && xmmsv_get_type (val) == XMMSV_TYPE_STRING) {
-				gchar *casefold;
-				/* replace val by casefolded-string (beware of new/free order)*/
-				xmmsv_get_string (val, &str);
-				casefold = g_utf8_casefold (str, strlen (str));
-				xmmsv_unref (val);
-
-				val = xmmsv_new_string (casefold);
-				g_free (casefold);
-			}
+	for (i = 0; xmmsv_list_iter_valid (propit); i++, xmmsv_list_iter_next (propit)) {
+		xmmsv_list_iter_entry (propit, &valstr);
+		xmmsv_get_string (valstr, &str);
 
-			data->val = g_list_prepend (data->val, val);
-		}
-		data->val = g_list_reverse (data->val);
+		props.reverse[i] = (str[0] == '-');
+		xmmsv_list_append_string (fetch, props.reverse[i] ? str + 1 : str);
+	}
+	xmmsv_list_iter_explicit_destroy (propit);
 
-		data->current = (currpos == i);
+	sortvals = xmms_playlist_sort_fetch (playlist, entries, size, fetch,
+	                                     props.nprops, err);
+	xmmsv_unref (fetch);
 
-		tmp = g_list_prepend (tmp, data);
+	if (xmms_error_iserror (err)) {
+		g_hash_table_destroy (sortvals);
+		g_free (props.reverse);
+		g_free (entries);
+		return;
 	}
 
-	xmms_medialib_end (session);
+	/* entries missing from the medialib have none of the properties */
+	nonevals = g_new0 (sortval_t, props.nprops);
+	for (i = 0; i < size; i++) {
+		entries[i].vals = g_hash_table_lookup (sortvals,
+		                                       GINT_TO_POINTER (entries[i].id));
+		if (entries[i].vals == NULL) {
+			entries[i].vals = nonevals;
+		}
+	}
+
+	job.props = &props;
+	job.entries = entries;
+	job.tmp = g_new (sortdata_t, size);
+	job.len = size;
+	job.depth = XMMS_PLAYLIST_SORT_PARALLEL_DEPTH;
+
+	xmms_playlist_sort_merge (&job);
 
-	tmp = g_list_reverse (tmp);
-	tmp = g_list_sort_with_data (tmp, xmms_playlist_entry_compare, properties);
+	g_free (job.tmp);
+	g_free (nonevals);
+	g_hash_table_destroy (sortvals);
+	g_free (props.reverse);
 
 	/* check whether there was any change */
-	for (i = 0, n = tmp; n; i++, n = g_list_next (n)) {
-		if (((sortdata_t*)n->data)->position != i) {
+	for (i = 0; i < size; i++) {
+		if (entries[i].position != i) {
 			list_changed = TRUE;
 			break;
 		}
 	}
 
 	if (!list_changed) {
-		g_list_foreach (tmp, xmms_playlist_sorted_free, NULL);
-		g_list_free (tmp);
+		g_free (entries);
+		return;
+	}
+
+	g_mutex_lock (playlist->mutex);
+
+	/* the playlist may have been changed or removed while sorting */
+	plcoll = xmms_playlist_get_coll (playlist, plname, NULL);
+	if (plcoll == NULL || xmms_playlist_coll_get_size (plcoll) != size) {
+		xmms_error_set (err, XMMS_ERROR_GENERIC,
+		                "playlist changed while sorting!");
 		g_mutex_unlock (playlist->mutex);
+		g_free (entries);
 		return;
 	}
 
+	for (i = 0; i < size; i++) {
+		xmmsv_coll_idlist_get_index (plcoll, entries[i].position, &id);
+		if (id != entries[i].id) {
+			xmms_error_set (err, XMMS_ERROR_GENERIC,
+			                "playlist changed while sorting!");
+			g_mutex_unlock (playlist->mutex);
+			g_free (entries);
+			return;
+		}
+	}
+
+	oldpos = xmms_playlist_coll_get_currpos (plcoll);
+	currpos = oldpos;
+
 	xmmsv_coll_idlist_clear (plcoll);
-	g_list_foreach (tmp, xmms_playlist_sorted_unwind, plcoll);
+	for (i = 0; i < size; i++) {
+		xmmsv_coll_idlist_append (plcoll, entries[i].id);
 
-	g_list_free (tmp);
+		if (entries[i].position == oldpos) {
+			xmms_collection_set_int_attr (plcoll, "position", i);
+			currpos = i;
+		}
+	}
+
+	g_free (entries);
 
 	XMMS_PLAYLIST_CHANGED_MSG (XMMS_PLAYLIST_CHANGED_SORT, 0, plname);
 	XMMS_PLAYLIST_CURRPOS_MSG (currpos, plname);
@@ -1514,6 +1742,7 @@ xmms_playlist_client_list_entries (xmms_playlist_t *playlist, const gchar *plnam
 	xmmsv_coll_t *plcoll;
 	xmms_medialib_entry_t entry;
 	xmmsv_list_iter_t *it;
+	xmmsv_t *ids;
 
 	g_return_val_if_fail (playlist, NULL);
 
@@ -1525,7 +1754,8 @@ xmms_playlist_client_list_entries (xmms_playlist_t *playlist, const gchar *plnam
 		return NULL;
 	}
 
-	xmmsv_get_list_iter (xmmsv_coll_idlist_get (plcoll), &it);
+	ids = xmmsv_coll_idlist_copy (plcoll);
+	xmmsv_get_list_iter (ids, &it);
 	for (xmmsv_list_iter_first (it);
 	     xmmsv_list_iter_valid (it);
 	     xmmsv_list_iter_next (it)) {
@@ -1534,6 +1764,7 @@ xmms_playlist_client_list_entries (xmms_playlist_t *playlist, const gchar *plnam
 		entries = g_list_prepend (entries, xmmsv_new_int (entry));
 	}
 	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (ids);
 
 	g_mutex_unlock (playlist->mutex);
 
@@ -1551,6 +1782,15 @@ xmms_playlist_mediainfo_reader_get (xmms_playlist_t *playlist)
 	return playlist->mediainfordr;
 }
 
+/** returns pointer to the collection DAG. */
+xmms_coll_dag_t *
+xmms_playlist_colldag_get (xmms_playlist_t *playlist)
+{
+	g_return_val_if_fail (playlist, NULL);
+
+	return playlist->colldag;
+}
+
 /** @} */
 
 /** Free the playlist and other memory in the xmms_playlist_t
@@ -1573,9 +1813,22 @@ xmms_playlist_destroy (xmms_object_t *object)
 	val = xmms_config_lookup ("playlist.repeat_all");
 	xmms_config_property_callback_remove (val, on_playlist_r_all_changed, playlist);
 
+	xmms_object_disconnect (XMMS_OBJECT (playlist->medialib),
+	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                        on_medialib_entry_changed, playlist);
+	xmms_object_disconnect (XMMS_OBJECT (playlist->medialib),
+	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_UPDATE,
+	                        on_medialib_entry_changed, playlist);
+	xmms_object_disconnect (XMMS_OBJECT (playlist->colldag),
+	                        XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
+	                        on_collection_changed, playlist);
+
+	xmms_object_unref (playlist->watcher);
 	xmms_object_unref (playlist->colldag);
 	xmms_object_unref (playlist->mediainfordr);
 
+	xmms_partyshuffle_free (playlist->partyshuffle);
+
 	xmms_playlist_unregister_ipc_commands ();
 }
 
@@ -197,12 +197,14 @@ static void
 xmms_plugin_add_builtin_plugins (void)
 {
 	extern const xmms_plugin_desc_t xmms_builtin_ringbuf;
+	extern const xmms_plugin_desc_t xmms_builtin_netcache;
 	extern const xmms_plugin_desc_t xmms_builtin_magic;
 	extern const xmms_plugin_desc_t xmms_builtin_converter;
 	extern const xmms_plugin_desc_t xmms_builtin_segment;
 	extern const xmms_plugin_desc_t xmms_builtin_visualization;
 
 	xmms_plugin_load (&xmms_builtin_ringbuf, NULL);
+	xmms_plugin_load (&xmms_builtin_netcache, NULL);
 	xmms_plugin_load (&xmms_builtin_magic, NULL);
 	xmms_plugin_load (&xmms_builtin_converter, NULL);
 	xmms_plugin_load (&xmms_builtin_segment, NULL);
@@ -324,6 +326,8 @@ xmms_plugin_load (const xmms_plugin_desc_t *desc, GModule *module)
 	plugin->module = module;
 
 	xmms_plugin_list = g_list_prepend (xmms_plugin_list, plugin);
+	xmms_xform_plan_cache_invalidate ();
+
 	return TRUE;
 }
 
@@ -0,0 +1,343 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/**
+ * @file
+ * Sync points (sample, byte offset) reported by decoders while they
+ * decode a stream. They are kept in a small file per medialib entry so
+ * that later seeks can jump to a known frame boundary instead of
+ * estimating the position from the bitrate.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "xmms/xmms_log.h"
+#include "xmmspriv/xmms_config.h"
+#include "xmmspriv/xmms_seekindex.h"
+#include "xmmspriv/xmms_utils.h"
+
+/** Minimum distance in samples between two stored sync points */
+#define XMMS_SEEK_INDEX_INTERVAL 32768
+
+#define XMMS_SEEK_INDEX_MAGIC "XSI1"
+
+typedef struct xmms_seek_point_St {
+	gint64 sample;
+	gint64 offset;
+} xmms_seek_point_t;
+
+struct xmms_seek_index_St {
+	gchar *path;
+	gchar *decoder;
+	gint64 size;
+	gint64 mtime;
+	gboolean dirty;
+
+	/** Sync points ordered by sample */
+	GArray *points;
+};
+
+static const gchar *seek_index_dir;
+
+void
+xmms_seek_index_init (void)
+{
+	xmms_config_property_t *cv;
+	gchar *tmp;
+
+	tmp = XMMS_BUILD_PATH ("seekindex");
+	cv = xmms_config_property_register ("seekindex.path", tmp, NULL, NULL);
+	g_free (tmp);
+
+	seek_index_dir = xmms_config_property_get_string (cv);
+}
+
+static gchar *
+xmms_seek_index_path (xmms_medialib_entry_t entry)
+{
+	gchar name[32];
+
+	g_snprintf (name, sizeof (name), "%d", entry);
+
+	return g_build_filename (seek_index_dir, name, NULL);
+}
+
+static void
+put_varint (GString *str, guint64 val)
+{
+	while (val >= 0x80) {
+		g_string_append_c (str, (val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	g_string_append_c (str, val);
+}
+
+static gboolean
+get_varint (const guchar **ptr, const guchar *end, guint64 *val)
+{
+	guint shift = 0;
+
+	*val = 0;
+
+	while (*ptr < end && shift < 64) {
+		guchar c = *(*ptr)++;
+
+		*val |= ((guint64) (c & 0x7f)) << shift;
+		if (!(c & 0x80)) {
+			return TRUE;
+		}
+		shift += 7;
+	}
+
+	return FALSE;
+}
+
+/* file layout: magic, then varints for size, mtime, decoder name
+ * length, the name itself, the number of points and finally every
+ * point as the delta to the previous one
+ */
+static void
+xmms_seek_index_parse (xmms_seek_index_t *idx, const guchar *data, gsize len)
+{
+	const guchar *ptr = data, *end = data + len;
+	xmms_seek_point_t point = { 0, 0 };
+	guint64 size, mtime, namelen, count, ds, doff;
+	guint64 i;
+
+	if (len < 4 || memcmp (ptr, XMMS_SEEK_INDEX_MAGIC, 4)) {
+		return;
+	}
+	ptr += 4;
+
+	if (!get_varint (&ptr, end, &size) || !get_varint (&ptr, end, &mtime) ||
+	    !get_varint (&ptr, end, &namelen) || namelen > (guint64) (end - ptr)) {
+		return;
+	}
+
+	/* an index for an older version of the file or for another
+	 * decoder is useless, it will be overwritten
+	 */
+	if (size != idx->size || mtime != idx->mtime ||
+	    namelen != strlen (idx->decoder) ||
+	    memcmp (ptr, idx->decoder, namelen)) {
+		XMMS_DBG ("Discarding stale seek index %s", idx->path);
+		return;
+	}
+	ptr += namelen;
+
+	if (!get_varint (&ptr, end, &count)) {
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!get_varint (&ptr, end, &ds) || !get_varint (&ptr, end, &doff)) {
+			g_array_set_size (idx->points, 0);
+			return;
+		}
+		point.sample += ds;
+		point.offset += doff;
+		g_array_append_val (idx->points, point);
+	}
+}
+
+/**
+ * Get the seek index of an entry, as decoded by a specific decoder.
+ *
+ * The size and modification time of the file guard against using an
+ * index that was built for other contents. Returns an empty index if
+ * none was stored before.
+ */
+xmms_seek_index_t *
+xmms_seek_index_load (xmms_medialib_entry_t entry, const gchar *decoder,
+                      gint64 size, gint64 mtime)
+{
+	xmms_seek_index_t *idx;
+	gchar *contents;
+	gsize len;
+
+	g_return_val_if_fail (entry, NULL);
+	g_return_val_if_fail (decoder, NULL);
+
+	if (!seek_index_dir) {
+		return NULL;
+	}
+
+	idx = g_new0 (xmms_seek_index_t, 1);
+	idx->path = xmms_seek_index_path (entry);
+	idx->decoder = g_strdup (decoder);
+	idx->size = size;
+	idx->mtime = mtime;
+	idx->points = g_array_new (FALSE, FALSE, sizeof (xmms_seek_point_t));
+
+	if (g_file_get_contents (idx->path, &contents, &len, NULL)) {
+		xmms_seek_index_parse (idx, (guchar *) contents, len);
+		g_free (contents);
+	}
+
+	return idx;
+}
+
+/** Write the index back if it gained new points since it was loaded. */
+void
+xmms_seek_index_save (xmms_seek_index_t *idx)
+{
+	xmms_seek_point_t prev = { 0, 0 };
+	GError *error = NULL;
+	GString *str;
+	guint i;
+
+	g_return_if_fail (idx);
+
+	if (!idx->dirty) {
+		return;
+	}
+
+	if (!g_file_test (seek_index_dir, G_FILE_TEST_IS_DIR) &&
+	    g_mkdir_with_parents (seek_index_dir, 0755) == -1) {
+		xmms_log_error ("Couldn't create %s", seek_index_dir);
+		return;
+	}
+
+	str = g_string_new (XMMS_SEEK_INDEX_MAGIC);
+	put_varint (str, idx->size);
+	put_varint (str, idx->mtime);
+	put_varint (str, strlen (idx->decoder));
+	g_string_append (str, idx->decoder);
+	put_varint (str, idx->points->len);
+
+	for (i = 0; i < idx->points->len; i++) {
+		xmms_seek_point_t *p = &g_array_index (idx->points, xmms_seek_point_t, i);
+
+		put_varint (str, p->sample - prev.sample);
+		put_varint (str, p->offset - prev.offset);
+		prev = *p;
+	}
+
+	if (!g_file_set_contents (idx->path, str->str, str->len, &error)) {
+		xmms_log_error ("Couldn't write seek index: %s", error->message);
+		g_error_free (error);
+	} else {
+		idx->dirty = FALSE;
+	}
+
+	g_string_free (str, TRUE);
+}
+
+/** Delete the stored index of a medialib entry that is being removed. */
+void
+xmms_seek_index_remove (xmms_medialib_entry_t entry)
+{
+	gchar *path;
+
+	if (!seek_index_dir) {
+		return;
+	}
+
+	path = xmms_seek_index_path (entry);
+	g_unlink (path);
+	g_free (path);
+}
+
+void
+xmms_seek_index_free (xmms_seek_index_t *idx)
+{
+	g_return_if_fail (idx);
+
+	g_array_free (idx->points, TRUE);
+	g_free (idx->decoder);
+	g_free (idx->path);
+	g_free (idx);
+}
+
+/**
+ * Record that a frame starting at sample begins at byte offset in the
+ * decoder's input. Cheap enough to call for every frame, points closer
+ * than #XMMS_SEEK_INDEX_INTERVAL to the last one are dropped. Points
+ * before the end of the index are already covered and ignored.
+ */
+void
+xmms_seek_index_add (xmms_seek_index_t *idx, gint64 sample, gint64 offset)
+{
+	xmms_seek_point_t point;
+
+	if (idx->points->len) {
+		xmms_seek_point_t *last;
+
+		last = &g_array_index (idx->points, xmms_seek_point_t,
+		                       idx->points->len - 1);
+		if (sample < last->sample + XMMS_SEEK_INDEX_INTERVAL ||
+		    offset <= last->offset) {
+			return;
+		}
+	} else if (sample != 0) {
+		/* every index starts at the first frame */
+		return;
+	}
+
+	point.sample = sample;
+	point.offset = offset;
+	g_array_append_val (idx->points, point);
+
+	idx->dirty = TRUE;
+}
+
+/**
+ * Find the last sync point at or before sample.
+ *
+ * @param found the sample the sync point is at
+ * @param offset where the frame starting at found begins
+ * @returns FALSE if the index doesn't cover the sample
+ */
+gboolean
+xmms_seek_index_lookup (xmms_seek_index_t *idx, gint64 sample,
+                        gint64 *found, gint64 *offset)
+{
+	xmms_seek_point_t *p;
+	guint lo = 0, hi;
+
+	if (!idx->points->len) {
+		return FALSE;
+	}
+
+	p = &g_array_index (idx->points, xmms_seek_point_t, idx->points->len - 1);
+
+	/* decoding from the last point is exact but slow when the target
+	 * is far beyond it, leave that to the decoder's own estimate
+	 */
+	if (sample >= p->sample + XMMS_SEEK_INDEX_INTERVAL) {
+		return FALSE;
+	}
+
+	hi = idx->points->len;
+	while (hi - lo > 1) {
+		guint mid = (lo + hi) / 2;
+
+		p = &g_array_index (idx->points, xmms_seek_point_t, mid);
+		if (p->sample <= sample) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	p = &g_array_index (idx->points, xmms_seek_point_t, lo);
+	*found = p->sample;
+	*offset = p->offset;
+
+	return TRUE;
+}
@@ -204,6 +204,41 @@ xmms_segment_init (xmms_xform_t *xform)
 	return TRUE;
 }
 
+/**
+ * Turn a segment that has been played to its end into the segment
+ * from startms to stopms, which has to start where the old one ended.
+ */
+gboolean
+xmms_segment_continue (xmms_xform_t *xform, gint startms, gint stopms)
+{
+	xmms_segment_data_t *data;
+	gint samplerate;
+
+	g_return_val_if_fail (xform, FALSE);
+
+	data = xmms_xform_private_data_get (xform);
+	if (!data) {
+		return FALSE;
+	}
+
+	samplerate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+
+	if (data->current_bytes != data->stop_bytes ||
+	    ms_to_bytes (samplerate, data->unit, startms) != data->stop_bytes) {
+		return FALSE;
+	}
+
+	data->start_bytes = data->stop_bytes;
+	data->stop_bytes = ms_to_bytes (samplerate, data->unit, stopms);
+
+	if (stopms != INT_MAX) {
+		xmms_xform_metadata_set_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_DURATION,
+		                             stopms - startms);
+	}
+
+	return TRUE;
+}
+
 static void
 xmms_segment_destroy (xmms_xform_t *xform)
 {
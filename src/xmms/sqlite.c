@@ -34,71 +34,10 @@
 #include <glib.h>
 
 /* increment this whenever there are incompatible db structure changes */
-#define DB_VERSION 36
+#define DB_VERSION 39
 
 const char set_version_stm[] = "PRAGMA user_version=" XMMS_STRINGIFY (DB_VERSION);
 
-/* Tables and unique constraints */
-const char *tables[] = {
-	/* Media */
-	"CREATE TABLE Media (id INTEGER, key, value, source INTEGER, "
-	                    "intval INTEGER DEFAULT NULL)",
-	/* Media unique constraint */
-	"CREATE UNIQUE INDEX key_idx ON Media (id, key, source)",
-
-	/* Sources */
-	"CREATE TABLE Sources (id INTEGER PRIMARY KEY AUTOINCREMENT, source)",
-
-	/* CollectionAttributes */
-	"CREATE TABLE CollectionAttributes (collid INTEGER, key TEXT, value TEXT)",
-	/* CollectionAttributes unique constraint */
-	"CREATE UNIQUE INDEX collectionattributes_idx "
-	       "ON CollectionAttributes (collid, key)",
-
-	/* CollectionConnections */
-	"CREATE TABLE CollectionConnections (from_id INTEGER, to_id INTEGER)",
-	/* CollectionConnections unique constraint */
-	"CREATE UNIQUE INDEX collectionconnections_idx "
-	       "ON CollectionConnections (from_id, to_id)",
-
-	/* CollectionIdlists */
-	"CREATE TABLE CollectionIdlists (collid INTEGER, position INTEGER, "
-	                                "mid INTEGER)",
-	/* CollectionIdlists unique constraint */
-	"CREATE UNIQUE INDEX collectionidlists_idx "
-	       "ON CollectionIdlists (collid, position)",
-
-	/* CollectionLabels */
-	"CREATE TABLE CollectionLabels (collid INTEGER, namespace INTEGER, "
-	                               "name TEXT)",
-
-	/* CollectionOperators */
-	"CREATE TABLE CollectionOperators (id INTEGER PRIMARY KEY AUTOINCREMENT, "
-	                                  "type INTEGER)",
-	NULL
-};
-
-const char *views[] = {
-	NULL
-};
-
-const char *triggers[] = {
-	NULL
-};
-
-const char *indices[] = {
-	/* Media idices */
-	"CREATE INDEX id_key_value_1x ON Media (id, key, value COLLATE BINARY)",
-	"CREATE INDEX id_key_value_2x ON Media (id, key, value COLLATE NOCASE)",
-	"CREATE INDEX key_value_1x ON Media (key, value COLLATE BINARY)",
-	"CREATE INDEX key_value_2x ON Media (key, value COLLATE NOCASE)",
-
-	/* Collections DAG index */
-	"CREATE INDEX collectionlabels_idx ON CollectionLabels (collid)",
-
-	NULL
-};
-
 const char create_CollectionAttributes_stm[] = "create table CollectionAttributes (collid integer, key text, value text)";
 const char create_CollectionConnections_stm[] = "create table CollectionConnections (from_id integer, to_id integer)";
 const char create_CollectionIdlists_stm[] = "create table CollectionIdlists (collid integer, position integer, mid integer)";
@@ -109,8 +48,7 @@ const char create_CollectionOperators_stm[] = "create table CollectionOperators
  * This magic numbers are taken from ANALYZE on a big database, if we change the db
  * layout drasticly we need to redo them!
  */
-const char fill_stats[] = "INSERT INTO sqlite_stat1 VALUES('Media', 'key_idx', '199568 14 1 1');"
-                          "INSERT INTO sqlite_stat1 VALUES('Media', 'prop_idx', '199568 6653 3');"
+const char fill_stats[] = "INSERT INTO sqlite_stat1 VALUES('MediaProperties', 'mediaproperties_idx', '199568 14 1 1');"
                           "INSERT INTO sqlite_stat1 VALUES('PlaylistEntries', 'playlistentries_idx', '12784 12784 1');"
                           "INSERT INTO sqlite_stat1 VALUES('Playlist', 'playlist_idx', '2 1');"
                           "INSERT INTO sqlite_stat1 VALUES('Playlist', 'sqlite_autoindex_Playlist_1', '2 1');"
@@ -306,6 +244,72 @@ upgrade_v35_to_v36 (sqlite3 *sql)
 	XMMS_DBG ("done");
 }
 
+static void
+upgrade_v36_to_v37 (sqlite3 *sql)
+{
+	XMMS_DBG ("upgrade v36->v37 (index collections for delta sync)");
+	sqlite3_exec (sql, "CREATE INDEX collectionlabels_name_idx "
+	                   "ON CollectionLabels (namespace, name);"
+	                   "CREATE INDEX collectionconnections_to_idx "
+	                   "ON CollectionConnections (to_id);", NULL, NULL, NULL);
+	XMMS_DBG ("done");
+}
+
+static void
+upgrade_v37_to_v38 (sqlite3 *sql)
+{
+	XMMS_DBG ("upgrade v37->v38 (intern property names and values)");
+
+	sqlite3_exec (sql, "BEGIN", NULL, NULL, NULL);
+
+	sqlite3_exec (sql,
+	              "CREATE TABLE PropertyKeys (id INTEGER PRIMARY KEY, "
+	                                         "key UNIQUE NOT NULL);"
+	              "CREATE TABLE PropertyValues (id INTEGER PRIMARY KEY, "
+	                                           "value UNIQUE NOT NULL);"
+	              "CREATE TABLE MediaProperties (id INTEGER, key INTEGER, "
+	                                            "value INTEGER, source INTEGER, "
+	                                            "intval INTEGER DEFAULT NULL);"
+	              "INSERT INTO PropertyKeys (key) "
+	                     "SELECT DISTINCT key FROM Media WHERE key NOT NULL;"
+	              "INSERT INTO PropertyValues (value) "
+	                     "SELECT DISTINCT value FROM Media WHERE value NOT NULL;"
+	              /* rows without a value keep a NULL reference, rows
+	               * without a key can't be addressed and are dropped */
+	              "INSERT INTO MediaProperties (id, key, value, source, intval) "
+	                     "SELECT m.id, k.id, v.id, m.source, m.intval "
+	                     "FROM Media AS m "
+	                     "JOIN PropertyKeys AS k ON k.key = m.key "
+	                     "LEFT JOIN PropertyValues AS v ON v.value = m.value;"
+	              "DROP TABLE Media;"
+	              "CREATE UNIQUE INDEX mediaproperties_idx "
+	                     "ON MediaProperties (id, key, source);"
+	              "CREATE INDEX mediaproperties_key_value_idx "
+	                     "ON MediaProperties (key, value);"
+	              "CREATE INDEX mediaproperties_key_intval_idx "
+	                     "ON MediaProperties (key, intval);"
+	              "CREATE INDEX propertyvalues_nocase_idx "
+	                     "ON PropertyValues (value COLLATE NOCASE);",
+	              NULL, NULL, NULL);
+
+	xmms_sqlite_schema_create_views (sql);
+
+	sqlite3_exec (sql, "COMMIT", NULL, NULL, NULL);
+
+	XMMS_DBG ("done");
+}
+
+static void
+upgrade_v38_to_v39 (sqlite3 *sql)
+{
+	XMMS_DBG ("upgrade v38->v39 (import stat cache)");
+	sqlite3_exec (sql, "CREATE TABLE ImportCache (path TEXT PRIMARY KEY, "
+	                                             "id INTEGER, stat TEXT);"
+	                   "CREATE INDEX importcache_id_idx ON ImportCache (id);",
+	              NULL, NULL, NULL);
+	XMMS_DBG ("done");
+}
+
 static gboolean
 try_upgrade (sqlite3 *sql, gint version)
 {
@@ -332,6 +336,12 @@ try_upgrade (sqlite3 *sql, gint version)
 			upgrade_v34_to_v35 (sql);
 		case 35:
 			upgrade_v35_to_v36 (sql);
+		case 36:
+			upgrade_v36_to_v37 (sql);
+		case 37:
+			upgrade_v37_to_v38 (sql);
+		case 38:
+			upgrade_v38_to_v39 (sql);
 			break; /* remember to (re)move this! We want fallthrough */
 		default:
 			can_upgrade = FALSE;
@@ -370,7 +380,6 @@ xmms_sqlite_create (gboolean *create)
 	const gchar *dbpath;
 	gint version = 0;
 	sqlite3 *sql;
-	guint i;
 
 	*create = FALSE;
 
@@ -415,6 +424,7 @@ xmms_sqlite_create (gboolean *create)
 		analyze = xmms_config_property_get_int (cv);
 		if (analyze) {
 			xmms_log_info ("Analyzing db, please wait a few seconds");
+			xmms_sqlite_prune_values (sql);
 			sqlite3_exec (sql, "ANALYZE", NULL, NULL, NULL);
 			xmms_log_info ("Done with analyze");
 		}
@@ -459,29 +469,9 @@ xmms_sqlite_create (gboolean *create)
 		 */
 		sqlite3_exec (sql, fill_stats, NULL, NULL, NULL);
 		/**
-		 * Create the tables and unique constraints
+		 * Create the tables, views and indices
 		 */
-		for (i = 0; tables[i]; i++) {
-			sqlite3_exec (sql, tables[i], NULL, NULL, NULL);
-		}
-		/**
-		 * Create the views
-		 */
-		for (i = 0; views[i]; i++) {
-			sqlite3_exec (sql, views[i], NULL, NULL, NULL);
-		}
-		/**
-		 * Create the triggers
-		 */
-		for (i = 0; triggers[i]; i++) {
-			sqlite3_exec (sql, triggers[i], NULL, NULL, NULL);
-		}
-		/**
-		 * Create indices
-		 */
-		for (i = 0; indices[i]; i++) {
-			sqlite3_exec (sql, indices[i], NULL, NULL, NULL);
-		}
+		xmms_sqlite_schema_create (sql);
 		/**
 		 * Add the server source
 		 */
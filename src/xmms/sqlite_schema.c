@@ -0,0 +1,197 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * The medialib database schema.
+ *
+ * Kept apart from the rest of the sqlite backend so it can be set up
+ * on any sqlite handle, such as an in-memory database in the tests.
+ */
+
+#include <sqlite3.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_sqlite.h"
+
+/* Tables and unique constraints */
+static const char *tables[] = {
+	/* PropertyKeys, interned property names */
+	"CREATE TABLE PropertyKeys (id INTEGER PRIMARY KEY, key UNIQUE NOT NULL)",
+
+	/* PropertyValues, interned property values */
+	"CREATE TABLE PropertyValues (id INTEGER PRIMARY KEY, "
+	                             "value UNIQUE NOT NULL)",
+
+	/* MediaProperties */
+	"CREATE TABLE MediaProperties (id INTEGER, key INTEGER, value INTEGER, "
+	                              "source INTEGER, intval INTEGER DEFAULT NULL)",
+	/* MediaProperties unique constraint */
+	"CREATE UNIQUE INDEX mediaproperties_idx "
+	       "ON MediaProperties (id, key, source)",
+
+	/* Sources */
+	"CREATE TABLE Sources (id INTEGER PRIMARY KEY AUTOINCREMENT, source)",
+
+	/* CollectionAttributes */
+	"CREATE TABLE CollectionAttributes (collid INTEGER, key TEXT, value TEXT)",
+	/* CollectionAttributes unique constraint */
+	"CREATE UNIQUE INDEX collectionattributes_idx "
+	       "ON CollectionAttributes (collid, key)",
+
+	/* CollectionConnections */
+	"CREATE TABLE CollectionConnections (from_id INTEGER, to_id INTEGER)",
+	/* CollectionConnections unique constraint */
+	"CREATE UNIQUE INDEX collectionconnections_idx "
+	       "ON CollectionConnections (from_id, to_id)",
+
+	/* CollectionIdlists */
+	"CREATE TABLE CollectionIdlists (collid INTEGER, position INTEGER, "
+	                                "mid INTEGER)",
+	/* CollectionIdlists unique constraint */
+	"CREATE UNIQUE INDEX collectionidlists_idx "
+	       "ON CollectionIdlists (collid, position)",
+
+	/* CollectionLabels */
+	"CREATE TABLE CollectionLabels (collid INTEGER, namespace INTEGER, "
+	                               "name TEXT)",
+
+	/* CollectionOperators */
+	"CREATE TABLE CollectionOperators (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+	                                  "type INTEGER)",
+
+	/* ImportCache, stat info of imported files keyed by url */
+	"CREATE TABLE ImportCache (path TEXT PRIMARY KEY, id INTEGER, stat TEXT)",
+	NULL
+};
+
+static const char *views[] = {
+	/* Media, the properties with their names and values resolved */
+	"CREATE VIEW Media AS "
+	"SELECT p.id AS id, k.key AS key, v.value AS value, "
+	       "p.source AS source, p.intval AS intval "
+	"FROM MediaProperties AS p "
+	"JOIN PropertyKeys AS k ON k.id = p.key "
+	"LEFT JOIN PropertyValues AS v ON v.id = p.value",
+	NULL
+};
+
+/* Make the Media view writable. The names and values are interned with
+ * NOT EXISTS rather than OR IGNORE, as the conflict clause of the outer
+ * statement (e.g. INSERT OR REPLACE) overrides those of the triggers.
+ * A NULL value is kept as a NULL reference. */
+static const char *triggers[] = {
+	"CREATE TRIGGER media_insert INSTEAD OF INSERT ON Media BEGIN "
+	"INSERT INTO PropertyKeys (key) SELECT NEW.key WHERE NOT EXISTS "
+	       "(SELECT 1 FROM PropertyKeys WHERE key = NEW.key); "
+	"INSERT INTO PropertyValues (value) SELECT NEW.value "
+	       "WHERE NEW.value NOT NULL AND NOT EXISTS "
+	       "(SELECT 1 FROM PropertyValues WHERE value = NEW.value); "
+	"INSERT INTO MediaProperties (id, key, value, source, intval) VALUES "
+	       "(NEW.id, (SELECT id FROM PropertyKeys WHERE key = NEW.key), "
+	        "(SELECT id FROM PropertyValues WHERE value = NEW.value), "
+	        "NEW.source, NEW.intval); "
+	"END",
+
+	"CREATE TRIGGER media_update INSTEAD OF UPDATE ON Media BEGIN "
+	"INSERT INTO PropertyKeys (key) SELECT NEW.key WHERE NOT EXISTS "
+	       "(SELECT 1 FROM PropertyKeys WHERE key = NEW.key); "
+	"INSERT INTO PropertyValues (value) SELECT NEW.value "
+	       "WHERE NEW.value NOT NULL AND NOT EXISTS "
+	       "(SELECT 1 FROM PropertyValues WHERE value = NEW.value); "
+	"UPDATE MediaProperties SET id = NEW.id, "
+	       "key = (SELECT id FROM PropertyKeys WHERE key = NEW.key), "
+	       "value = (SELECT id FROM PropertyValues WHERE value = NEW.value), "
+	       "source = NEW.source, intval = NEW.intval "
+	"WHERE id = OLD.id AND source = OLD.source AND "
+	      "key = (SELECT id FROM PropertyKeys WHERE key = OLD.key); "
+	"END",
+
+	"CREATE TRIGGER media_delete INSTEAD OF DELETE ON Media BEGIN "
+	"DELETE FROM MediaProperties "
+	"WHERE id = OLD.id AND source = OLD.source AND "
+	      "key = (SELECT id FROM PropertyKeys WHERE key = OLD.key); "
+	"END",
+
+	NULL
+};
+
+static const char *indices[] = {
+	/* Media indices, lookups by id are covered by the unique constraint */
+	"CREATE INDEX mediaproperties_key_value_idx "
+	       "ON MediaProperties (key, value)",
+	"CREATE INDEX mediaproperties_key_intval_idx "
+	       "ON MediaProperties (key, intval)",
+	"CREATE INDEX propertyvalues_nocase_idx "
+	       "ON PropertyValues (value COLLATE NOCASE)",
+
+	/* Collections DAG index */
+	"CREATE INDEX collectionlabels_idx ON CollectionLabels (collid)",
+	"CREATE INDEX collectionlabels_name_idx "
+	       "ON CollectionLabels (namespace, name)",
+	"CREATE INDEX collectionconnections_to_idx "
+	       "ON CollectionConnections (to_id)",
+
+	/* ImportCache lookup on entry removal */
+	"CREATE INDEX importcache_id_idx ON ImportCache (id)",
+
+	NULL
+};
+
+static void
+xmms_sqlite_exec_all (sqlite3 *sql, const char **stms)
+{
+	gint i;
+
+	for (i = 0; stms[i]; i++) {
+		sqlite3_exec (sql, stms[i], NULL, NULL, NULL);
+	}
+}
+
+/**
+ * Create the tables, views, triggers and indices of an empty database.
+ */
+void
+xmms_sqlite_schema_create (sqlite3 *sql)
+{
+	xmms_sqlite_exec_all (sql, tables);
+	xmms_sqlite_schema_create_views (sql);
+	xmms_sqlite_exec_all (sql, indices);
+}
+
+/**
+ * Create the Media view over the interned properties, and the triggers
+ * that make it writable.
+ */
+void
+xmms_sqlite_schema_create_views (sqlite3 *sql)
+{
+	xmms_sqlite_exec_all (sql, views);
+	xmms_sqlite_exec_all (sql, triggers);
+}
+
+/**
+ * Drop the interned values no longer referenced by any property.
+ * Properties without a value reference NULL, so this can't be written
+ * as NOT IN, which never matches once the subquery yields a NULL.
+ */
+void
+xmms_sqlite_prune_values (sqlite3 *sql)
+{
+	sqlite3_exec (sql, "DELETE FROM PropertyValues WHERE NOT EXISTS "
+	                   "(SELECT 1 FROM MediaProperties "
+	                    "WHERE value = PropertyValues.id)",
+	              NULL, NULL, NULL);
+}
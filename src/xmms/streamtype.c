@@ -189,7 +189,31 @@ xmms_stream_type_get_int (const xmms_stream_type_t *st, xmms_stream_type_key_t k
 	return -1;
 }
 
+/**
+ * Serialize the values of a stream type into a string.
+ *
+ * Two stream types with the same key match exactly the same set of
+ * plugins, which makes it usable for caching match results.
+ */
+gchar *
+xmms_stream_type_key (const xmms_stream_type_t *st)
+{
+	GString *str;
+	GList *n;
+
+	str = g_string_new (NULL);
+
+	for (n = st->list; n; n = g_list_next (n)) {
+		xmms_stream_type_val_t *val = n->data;
+		if (val->type == STRING) {
+			g_string_append_printf (str, "%d=%s;", val->key, val->d.string);
+		} else {
+			g_string_append_printf (str, "%d:%d;", val->key, val->d.num);
+		}
+	}
 
+	return g_string_free (str, FALSE);
+}
 
 
 static gboolean
@@ -32,6 +32,7 @@
 
 static gboolean xmms_vis_init (xmms_xform_t *xform);
 static void xmms_vis_destroy (xmms_xform_t *xform);
+static gboolean xmms_vis_reinit (xmms_xform_t *xform);
 static gint xmms_vis_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
                           xmms_error_t *error);
 static gint64 xmms_vis_seek (xmms_xform_t *xform, gint64 offset,
@@ -48,6 +49,7 @@ xmms_vis_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.destroy = xmms_vis_destroy;
 	methods.read = xmms_vis_read;
 	methods.seek = xmms_vis_seek;
+	methods.reinit = xmms_vis_reinit;
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -87,6 +89,12 @@ xmms_vis_destroy (xmms_xform_t *xform)
 	g_return_if_fail (xform);
 }
 
+static gboolean
+xmms_vis_reinit (xmms_xform_t *xform)
+{
+	return TRUE;
+}
+
 static gint
 xmms_vis_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
               xmms_error_t *error)
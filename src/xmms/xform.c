@@ -20,6 +20,8 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h>
 
 #include "xmmspriv/xmms_plugin.h"
 #include "xmmspriv/xmms_xform.h"
@@ -27,6 +29,8 @@
 #include "xmmspriv/xmms_medialib.h"
 #include "xmmspriv/xmms_utils.h"
 #include "xmmspriv/xmms_xform_plugin.h"
+#include "xmmspriv/xmms_seekindex.h"
+#include "xmmspriv/xmms_netcache.h"
 #include "xmms/xmms_ipc.h"
 #include "xmms/xmms_log.h"
 #include "xmms/xmms_object.h"
@@ -69,6 +73,9 @@ struct xmms_xform_St {
 	xmmsv_t *browse_dict;
 	gint browse_index;
 
+	xmms_seek_index_t *seek_index;
+	gboolean seek_index_loaded;
+
 	/** used for line reading */
 	struct {
 		gchar buf[XMMS_XFORM_MAX_LINE_SIZE];
@@ -84,6 +91,15 @@ typedef struct xmms_xform_hotspot_St {
 
 #define READ_CHUNK 4096
 
+/**
+ * Which plugin xmms_xform_find picked for a given stream type. The
+ * choice only depends on the stream type and the plugin priorities,
+ * so most chains can skip the search over all plugins. A NULL value
+ * records that no plugin matched.
+ */
+static GHashTable *plan_cache;
+static GMutex *plan_lock;
+
 
 xmms_xform_t *xmms_xform_find (xmms_xform_t *prev, xmms_medialib_entry_t entry,
                                GList *goal_hints);
@@ -321,10 +337,23 @@ xmms_xform_client_browse (xmms_xform_object_t *obj, const gchar *url,
 	return xmms_xform_browse (url, error);
 }
 
+static void
+plan_cache_value_free (gpointer data)
+{
+	if (data) {
+		xmms_object_unref (data);
+	}
+}
+
 static void
 xmms_xform_object_destroy (xmms_object_t *obj)
 {
 	xmms_xform_unregister_ipc_commands ();
+
+	g_hash_table_destroy (plan_cache);
+	plan_cache = NULL;
+	g_mutex_free (plan_lock);
+	plan_lock = NULL;
 }
 
 xmms_xform_object_t *
@@ -336,6 +365,13 @@ xmms_xform_object_init (void)
 
 	xmms_xform_register_ipc_commands (XMMS_OBJECT (obj));
 
+	plan_lock = g_mutex_new ();
+	plan_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                    plan_cache_value_free);
+
+	xmms_seek_index_init ();
+	xmms_netcache_init ();
+
 	effect_callbacks_init ();
 
 	return obj;
@@ -355,6 +391,11 @@ xmms_xform_destroy (xmms_object_t *object)
 		}
 	}
 
+	if (xform->seek_index) {
+		xmms_seek_index_save (xform->seek_index);
+		xmms_seek_index_free (xform->seek_index);
+	}
+
 	g_hash_table_destroy (xform->metadata);
 
 	g_hash_table_destroy (xform->privdata);
@@ -1017,6 +1058,60 @@ xmms_xform_this_read (xmms_xform_t *xform, gpointer buf, gint siz,
 	return read;
 }
 
+static xmms_seek_index_t *
+xmms_xform_seek_index_get (xmms_xform_t *xform)
+{
+	gint32 size, mtime;
+
+	if (xform->seek_index_loaded) {
+		return xform->seek_index;
+	}
+
+	xform->seek_index_loaded = TRUE;
+
+	/* only local files can be told apart from their older versions */
+	if (xform->entry &&
+	    xmms_xform_metadata_get_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE, &size) &&
+	    xmms_xform_metadata_get_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_LMOD, &mtime)) {
+		xform->seek_index = xmms_seek_index_load (xform->entry,
+		                                          xmms_xform_shortname (xform),
+		                                          size, mtime);
+	}
+
+	return xform->seek_index;
+}
+
+void
+xmms_xform_seek_index_add (xmms_xform_t *xform, gint64 sample, gint64 offset)
+{
+	xmms_seek_index_t *idx;
+
+	g_return_if_fail (xform);
+
+	idx = xmms_xform_seek_index_get (xform);
+	if (idx) {
+		xmms_seek_index_add (idx, sample, offset);
+	}
+}
+
+gboolean
+xmms_xform_seek_index_lookup (xmms_xform_t *xform, gint64 sample,
+                              gint64 *found, gint64 *offset)
+{
+	xmms_seek_index_t *idx;
+
+	g_return_val_if_fail (xform, FALSE);
+	g_return_val_if_fail (found, FALSE);
+	g_return_val_if_fail (offset, FALSE);
+
+	idx = xmms_xform_seek_index_get (xform);
+	if (!idx) {
+		return FALSE;
+	}
+
+	return xmms_seek_index_lookup (idx, sample, found, offset);
+}
+
 gint64
 xmms_xform_this_seek (xmms_xform_t *xform, gint64 offset,
                       xmms_xform_seek_mode_t whence, xmms_error_t *err)
@@ -1179,12 +1274,102 @@ xmms_xform_match (xmms_plugin_t *plugin, gpointer user_data)
 	return TRUE;
 }
 
+/**
+ * Forget all cached plugin choices, has to be called whenever the set
+ * of plugins or their priorities change.
+ */
+void
+xmms_xform_plan_cache_invalidate (void)
+{
+	if (!plan_lock) {
+		return;
+	}
+
+	g_mutex_lock (plan_lock);
+	g_hash_table_remove_all (plan_cache);
+	g_mutex_unlock (plan_lock);
+}
+
+static gchar *
+plan_cache_key (const xmms_stream_type_t *type)
+{
+	/* the url is unique to every chain, caching on it is pointless */
+	if (xmms_stream_type_get_str (type, XMMS_STREAM_TYPE_URL)) {
+		return NULL;
+	}
+
+	return xmms_stream_type_key (type);
+}
+
+static gboolean
+plan_cache_lookup (const gchar *key, xmms_xform_plugin_t **plugin)
+{
+	gpointer value;
+	gboolean found = FALSE;
+
+	*plugin = NULL;
+
+	if (!plan_lock) {
+		return FALSE;
+	}
+
+	g_mutex_lock (plan_lock);
+	if (g_hash_table_lookup_extended (plan_cache, key, NULL, &value)) {
+		if (value) {
+			xmms_object_ref (value);
+		}
+		*plugin = value;
+		found = TRUE;
+	}
+	g_mutex_unlock (plan_lock);
+
+	return found;
+}
+
+static void
+plan_cache_insert (const gchar *key, xmms_xform_plugin_t *plugin)
+{
+	if (!plan_lock) {
+		return;
+	}
+
+	if (plugin) {
+		xmms_object_ref (plugin);
+	}
+
+	g_mutex_lock (plan_lock);
+	g_hash_table_insert (plan_cache, g_strdup (key), plugin);
+	g_mutex_unlock (plan_lock);
+}
+
 xmms_xform_t *
 xmms_xform_find (xmms_xform_t *prev, xmms_medialib_entry_t entry,
                  GList *goal_hints)
 {
 	match_state_t state;
+	xmms_xform_plugin_t *cached = NULL;
 	xmms_xform_t *xform = NULL;
+	gchar *key;
+
+	key = plan_cache_key (prev->out_type);
+
+	if (key && plan_cache_lookup (key, &cached)) {
+		if (!cached) {
+			XMMS_DBG ("Found no matching plugin (cached)...");
+			g_free (key);
+			return NULL;
+		}
+
+		xform = xmms_xform_new (cached, prev, entry, goal_hints);
+		if (xform) {
+			xmms_object_unref (cached);
+			g_free (key);
+			return xform;
+		}
+
+		XMMS_DBG ("Cached plugin '%s' failed, searching again",
+		          xmms_plugin_shortname_get ((xmms_plugin_t *) cached));
+	}
 
 	state.out_type = prev->out_type;
 	state.match = NULL;
@@ -1192,12 +1377,24 @@ xmms_xform_find (xmms_xform_t *prev, xmms_medialib_entry_t entry,
 
 	xmms_plugin_foreach (XMMS_PLUGIN_TYPE_XFORM, xmms_xform_match, &state);
 
-	if (state.match) {
+	if (key) {
+		plan_cache_insert (key, state.match);
+		g_free (key);
+	}
+
+	/* if the search ends up at the cached plugin again it has
+	 * already been tried, no point in initializing it twice
+	 */
+	if (state.match && state.match != cached) {
 		xform = xmms_xform_new (state.match, prev, entry, goal_hints);
-	} else {
+	} else if (!state.match) {
 		XMMS_DBG ("Found no matching plugin...");
 	}
 
+	if (cached) {
+		xmms_object_unref (cached);
+	}
+
 	return xform;
 }
 
@@ -1287,45 +1484,59 @@ outdata_type_metadata_collect (xmms_xform_t *xform)
 	}
 }
 
-static xmms_xform_t *
-chain_setup (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats)
+/* Split an entry url into its decoded location and the decoded
+ * "key=value" arguments after the '?', NULL when there are none.
+ */
+static gchar *
+url_split (const gchar *url, gchar ***params)
 {
-	xmms_xform_t *xform, *last;
 	gchar *durl, *args;
 
-	if (!entry) {
-		entry = 1; /* FIXME: this is soooo ugly, don't do this */
-	}
-
-	xform = xmms_xform_new (NULL, NULL, 0, goal_formats);
+	*params = NULL;
 
 	durl = g_strdup (url);
 
 	args = strchr (durl, '?');
 	if (args) {
-		gchar **params;
-		gint i;
 		*args = 0;
 		args++;
 		xmms_medialib_decode_url (args);
 
-		params = g_strsplit (args, "&", 0);
-
-		for (i = 0; params && params[i]; i++) {
-			gchar *v;
-			v = strchr (params[i], '=');
-			if (v) {
-				*v = 0;
-				v++;
-				xmms_xform_metadata_set_str (xform, params[i], v);
-			} else {
-				xmms_xform_metadata_set_int (xform, params[i], 1);
-			}
-		}
-		g_strfreev (params);
+		*params = g_strsplit (args, "&", 0);
 	}
 	xmms_medialib_decode_url (durl);
 
+	return durl;
+}
+
+static xmms_xform_t *
+chain_setup (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats)
+{
+	xmms_xform_t *xform, *last;
+	gchar *durl, **params;
+	gint i;
+
+	if (!entry) {
+		entry = 1; /* FIXME: this is soooo ugly, don't do this */
+	}
+
+	xform = xmms_xform_new (NULL, NULL, 0, goal_formats);
+
+	durl = url_split (url, &params);
+
+	for (i = 0; params && params[i]; i++) {
+		gchar *v;
+		v = strchr (params[i], '=');
+		if (v) {
+			*v = 0;
+			v++;
+			xmms_xform_metadata_set_str (xform, params[i], v);
+		} else {
+			xmms_xform_metadata_set_int (xform, params[i], 1);
+		}
+	}
+	g_strfreev (params);
+
 	xmms_xform_outdata_type_add (xform, XMMS_STREAM_TYPE_MIMETYPE,
 	                             "application/x-url", XMMS_STREAM_TYPE_URL,
 	                             durl, XMMS_STREAM_TYPE_END);
@@ -1343,6 +1554,10 @@ chain_setup (xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats)
 
 			return NULL;
 		}
+		/* keep what a remote transport fetches */
+		if (!last->prev) {
+			xform = xmms_netcache_xform_wrap (xform, entry, goal_formats);
+		}
 		xmms_object_unref (last);
 		last = xform;
 	} while (!has_goalformat (xform, goal_formats));
@@ -1401,9 +1616,10 @@ xmms_xform_chain_setup (xmms_medialib_entry_t entry, GList *goal_formats,
 	return xform;
 }
 
-xmms_xform_t *
-xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
-                            GList *goal_formats, gboolean rehash)
+/* Decoder chain for url, with the segment plugin on top when it fits. */
+static xmms_xform_t *
+chain_setup_segment (xmms_medialib_entry_t entry, const gchar *url,
+                     GList *goal_formats)
 {
 	xmms_xform_t *last;
 	xmms_plugin_t *plugin;
@@ -1432,9 +1648,20 @@ xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
 	/* add segment plugin to the chain if it can be added */
 	if (add_segment) {
 		last = xmms_xform_new_effect (last, entry, goal_formats, "segment");
-		if (!last) {
-			return NULL;
-		}
+	}
+
+	return last;
+}
+
+xmms_xform_t *
+xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
+                            GList *goal_formats, gboolean rehash)
+{
+	xmms_xform_t *last;
+
+	last = chain_setup_segment (entry, url, goal_formats);
+	if (!last) {
+		return NULL;
 	}
 
 	/* if not rehashing, also initialize all the effect plugins */
@@ -1449,6 +1676,135 @@ xmms_xform_chain_setup_url (xmms_medialib_entry_t entry, const gchar *url,
 	return last;
 }
 
+/**
+ * Set up a chain that only decodes entry, for looking at its samples.
+ * There are no effects, and unlike a rehash the metadata found on the
+ * way is not stored in the medialib.
+ */
+xmms_xform_t *
+xmms_xform_chain_setup_decoder (xmms_medialib_entry_t entry,
+                                GList *goal_formats)
+{
+	xmms_xform_t *last;
+	gchar *url;
+
+	if (!(url = get_url_for_entry (entry))) {
+		return NULL;
+	}
+
+	last = chain_setup_segment (entry, url, goal_formats);
+	g_free (url);
+
+	return last;
+}
+
+/**
+ * Move a chain that has played a segment to its end on to the next
+ * entry, if that entry is the adjacent segment of the same source.
+ * This keeps the decoder running, so consecutive tracks of a cue sheet
+ * play without reopening the file or seeking. Every effect in the
+ * chain has to support reinit, to pick up the state of the new entry.
+ *
+ * @returns TRUE if the chain now plays entry, FALSE if a new chain has
+ * to be set up.
+ */
+gboolean
+xmms_xform_chain_continue (xmms_xform_t *chain, xmms_medialib_entry_t entry)
+{
+	xmms_xform_t *root, *segment = NULL, *x;
+	const gchar *src, *stopstr;
+	gchar *url, *durl, **params, tmp[16];
+	gint startms = -1, stopms = -1, i;
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (chain, FALSE);
+
+	for (root = chain; root->prev; root = root->prev) {
+		if (!segment && root->plugin &&
+		    !strcmp (xmms_xform_shortname (root), "segment")) {
+			segment = root;
+		}
+	}
+
+	if (!segment || !xmms_xform_metadata_get_str (root, XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS, &stopstr)) {
+		return FALSE;
+	}
+
+	/* the effects have to follow the entry change */
+	for (x = chain; x != segment; x = x->prev) {
+		if (!xmms_xform_plugin_can_reinit (x->plugin)) {
+			XMMS_DBG ("Effect '%s' can't continue with the next entry",
+			          xmms_xform_shortname (x));
+			return FALSE;
+		}
+	}
+
+	if (!(url = get_url_for_entry (entry))) {
+		return FALSE;
+	}
+
+	durl = url_split (url, &params);
+	for (i = 0; params && params[i]; i++) {
+		if (g_str_has_prefix (params[i], "startms=")) {
+			startms = strtol (params[i] + 8, NULL, 10);
+		} else if (g_str_has_prefix (params[i], "stopms=")) {
+			stopms = strtol (params[i] + 7, NULL, 10);
+		}
+	}
+	g_strfreev (params);
+
+	src = xmms_stream_type_get_str (root->out_type, XMMS_STREAM_TYPE_URL);
+
+	if (!src || strcmp (src, durl) || startms != strtol (stopstr, NULL, 10)) {
+		goto out;
+	}
+
+	/* the last segment runs until the end of the source */
+	if (stopms == -1) {
+		g_hash_table_remove (root->metadata, XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS);
+		if (!xmms_xform_metadata_get_int (segment->prev,
+		                                  XMMS_MEDIALIB_ENTRY_PROPERTY_DURATION,
+		                                  &stopms)) {
+			stopms = INT_MAX;
+		}
+	} else {
+		g_snprintf (tmp, sizeof (tmp), "%d", stopms);
+		xmms_xform_metadata_set_str (root, XMMS_MEDIALIB_ENTRY_PROPERTY_STOPMS, tmp);
+	}
+
+	g_snprintf (tmp, sizeof (tmp), "%d", startms);
+	xmms_xform_metadata_set_str (root, XMMS_MEDIALIB_ENTRY_PROPERTY_STARTMS, tmp);
+
+	if (!xmms_segment_continue (segment, startms, stopms)) {
+		goto out;
+	}
+
+	for (x = chain; x; x = x->prev) {
+		x->entry = entry;
+	}
+
+	/* everything from the segment up has seen the end of the
+	 * previous segment
+	 */
+	for (x = chain; x != segment->prev; x = x->prev) {
+		x->eos = FALSE;
+	}
+
+	ret = TRUE;
+
+	for (x = chain; x != segment; x = x->prev) {
+		if (!xmms_xform_plugin_reinit (x->plugin, x)) {
+			ret = FALSE;
+		}
+	}
+
+out:
+	g_free (durl);
+	g_free (url);
+
+	return ret;
+}
+
 xmms_config_property_t *
 xmms_xform_config_lookup (xmms_xform_t *xform, const gchar *path)
 {
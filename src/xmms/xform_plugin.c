@@ -75,6 +75,12 @@ xmms_xform_plugin_verify (xmms_plugin_t *_plugin)
 	return TRUE;
 }
 
+static void
+priority_changed (xmms_object_t *object, xmmsv_t *data, gpointer userdata)
+{
+	xmms_xform_plan_cache_invalidate ();
+}
+
 void
 xmms_xform_plugin_indata_add (xmms_xform_plugin_t *plugin, ...)
 {
@@ -93,7 +99,8 @@ xmms_xform_plugin_indata_add (xmms_xform_plugin_t *plugin, ...)
 	priority = xmms_stream_type_get_int (t, XMMS_STREAM_TYPE_PRIORITY);
 	g_snprintf (config_value, sizeof (config_value), "%d", priority);
 	xmms_xform_plugin_config_property_register (plugin, config_key,
-	                                            config_value, NULL, NULL);
+	                                            config_value,
+	                                            priority_changed, NULL);
 	g_free (config_key);
 
 	plugin->in_types = g_list_prepend (plugin->in_types, t);
@@ -181,6 +188,12 @@ xmms_xform_plugin_can_destroy (const xmms_xform_plugin_t *plugin)
 	return !!plugin->methods.destroy;
 }
 
+gboolean
+xmms_xform_plugin_can_reinit (const xmms_xform_plugin_t *plugin)
+{
+	return !!plugin->methods.reinit;
+}
+
 gboolean
 xmms_xform_plugin_init (const xmms_xform_plugin_t *plugin, xmms_xform_t *xform)
 {
@@ -216,3 +229,9 @@ xmms_xform_plugin_destroy (const xmms_xform_plugin_t *plugin, xmms_xform_t *xfor
 	plugin->methods.destroy (xform);
 }
 
+gboolean
+xmms_xform_plugin_reinit (const xmms_xform_plugin_t *plugin, xmms_xform_t *xform)
+{
+	return plugin->methods.reinit (xform);
+}
+
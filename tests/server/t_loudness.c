@@ -0,0 +1,134 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include "xmmspriv/xmms_loudness.h"
+
+SETUP (loudness) {
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+/* feed seconds of a sine at freq Hz and amplitude in dBFS, on all channels */
+static void
+feed_sine (xmms_loudness_t *meter, gint channels, gint rate,
+           gdouble freq, gdouble dbfs, gdouble phase, gint seconds)
+{
+	gfloat buf[1024 * 2];
+	gdouble amplitude;
+	gint i, c, n = 0, frames;
+
+	amplitude = pow (10.0, dbfs / 20.0);
+	frames = G_N_ELEMENTS (buf) / channels;
+
+	while (n < rate * seconds) {
+		for (i = 0; i < frames; i++, n++) {
+			for (c = 0; c < channels; c++) {
+				buf[i * channels + c] = amplitude * sin (2 * M_PI * freq * n / rate + phase);
+			}
+		}
+		xmms_loudness_add_frames (meter, buf, frames);
+	}
+}
+
+/* EBU Tech 3341, case 1: -23 dBFS stereo sine is -23 LUFS */
+CASE (test_sine_48k)
+{
+	xmms_loudness_t *meter;
+
+	meter = xmms_loudness_new (2, 48000);
+	feed_sine (meter, 2, 48000, 1000, -23.0, 0, 20);
+	CU_ASSERT_DOUBLE_EQUAL (-23.0, xmms_loudness_integrated (&meter, 1), 0.1);
+
+	xmms_loudness_free (meter);
+}
+
+CASE (test_sine_44k)
+{
+	xmms_loudness_t *meter;
+
+	meter = xmms_loudness_new (2, 44100);
+	feed_sine (meter, 2, 44100, 1000, -33.0, 0, 20);
+	CU_ASSERT_DOUBLE_EQUAL (-33.0, xmms_loudness_integrated (&meter, 1), 0.1);
+
+	xmms_loudness_free (meter);
+}
+
+CASE (test_silence)
+{
+	xmms_loudness_t *meter;
+	gfloat buf[4800];
+
+	memset (buf, 0, sizeof (buf));
+
+	meter = xmms_loudness_new (1, 48000);
+	xmms_loudness_add_frames (meter, buf, G_N_ELEMENTS (buf));
+	CU_ASSERT_DOUBLE_EQUAL (XMMS_LOUDNESS_SILENCE, xmms_loudness_integrated (&meter, 1), 0.001);
+	CU_ASSERT_DOUBLE_EQUAL (0.0, xmms_loudness_true_peak (meter), 0.001);
+
+	xmms_loudness_free (meter);
+}
+
+/* EBU Tech 3341, case 3: the quiet part falls below the relative gate */
+CASE (test_relative_gate)
+{
+	xmms_loudness_t *meter;
+
+	meter = xmms_loudness_new (2, 48000);
+	feed_sine (meter, 2, 48000, 1000, -36.0, 0, 10);
+	feed_sine (meter, 2, 48000, 1000, -23.0, 0, 60);
+	feed_sine (meter, 2, 48000, 1000, -36.0, 0, 10);
+	CU_ASSERT_DOUBLE_EQUAL (-23.0, xmms_loudness_integrated (&meter, 1), 0.1);
+
+	xmms_loudness_free (meter);
+}
+
+/* the album is gated as a whole, the quiet track falls below the gate */
+CASE (test_album)
+{
+	xmms_loudness_t *meters[2];
+
+	meters[0] = xmms_loudness_new (2, 48000);
+	feed_sine (meters[0], 2, 48000, 1000, -20.0, 0, 20);
+	meters[1] = xmms_loudness_new (2, 48000);
+	feed_sine (meters[1], 2, 48000, 1000, -40.0, 0, 20);
+
+	CU_ASSERT_DOUBLE_EQUAL (-40.0, xmms_loudness_integrated (&meters[1], 1), 0.1);
+	CU_ASSERT_DOUBLE_EQUAL (-20.0, xmms_loudness_integrated (meters, 2), 0.1);
+
+	xmms_loudness_free (meters[0]);
+	xmms_loudness_free (meters[1]);
+}
+
+/* a quarter of the rate sampled between its peaks reads 3 dB low */
+CASE (test_true_peak)
+{
+	xmms_loudness_t *meter;
+
+	meter = xmms_loudness_new (1, 48000);
+	feed_sine (meter, 1, 48000, 12000, -6.0, M_PI / 4, 1);
+	CU_ASSERT_DOUBLE_EQUAL (pow (10.0, -6.0 / 20.0), xmms_loudness_true_peak (meter), 0.01);
+
+	xmms_loudness_free (meter);
+}
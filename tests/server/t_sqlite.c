@@ -0,0 +1,94 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2011 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <sqlite3.h>
+#include <glib.h>
+
+#include "xmmspriv/xmms_sqlite.h"
+
+static sqlite3 *db;
+
+SETUP (sqlite) {
+	if (sqlite3_open (":memory:", &db) != SQLITE_OK) {
+		return 1;
+	}
+	xmms_sqlite_schema_create (db);
+	return 0;
+}
+
+CLEANUP () {
+	sqlite3_close (db);
+	db = NULL;
+	return 0;
+}
+
+static gint
+count_values (const gchar *value)
+{
+	sqlite3_stmt *stm;
+	gint ret = -1;
+
+	sqlite3_prepare_v2 (db, "SELECT COUNT(*) FROM PropertyValues "
+	                        "WHERE value = ?", -1, &stm, NULL);
+	sqlite3_bind_text (stm, 1, value, -1, SQLITE_STATIC);
+	if (sqlite3_step (stm) == SQLITE_ROW) {
+		ret = sqlite3_column_int (stm, 0);
+	}
+	sqlite3_finalize (stm);
+
+	return ret;
+}
+
+static void
+exec (const gchar *query)
+{
+	CU_ASSERT_EQUAL (SQLITE_OK, sqlite3_exec (db, query, NULL, NULL, NULL));
+}
+
+CASE (test_prune_removed_value)
+{
+	exec ("INSERT INTO Media (id, key, value, source) "
+	      "VALUES (1, 'title', 'gone', 1)");
+	exec ("INSERT INTO Media (id, key, value, source) "
+	      "VALUES (1, 'artist', 'kept', 1)");
+	/* a property without a value references NULL */
+	exec ("INSERT INTO Media (id, key, value, source, intval) "
+	      "VALUES (1, 'size', NULL, 1, 42)");
+
+	CU_ASSERT_EQUAL (1, count_values ("gone"));
+
+	exec ("DELETE FROM Media WHERE id = 1 AND key = 'title'");
+	CU_ASSERT_EQUAL (1, count_values ("gone"));
+
+	xmms_sqlite_prune_values (db);
+
+	CU_ASSERT_EQUAL (0, count_values ("gone"));
+	CU_ASSERT_EQUAL (1, count_values ("kept"));
+}
+
+CASE (test_prune_updated_value)
+{
+	exec ("INSERT INTO Media (id, key, value, source) "
+	      "VALUES (2, 'album', 'old', 1)");
+	exec ("UPDATE Media SET value = 'new' WHERE id = 2 AND key = 'album'");
+
+	xmms_sqlite_prune_values (db);
+
+	CU_ASSERT_EQUAL (0, count_values ("old"));
+	CU_ASSERT_EQUAL (1, count_values ("new"));
+}
@@ -316,3 +316,40 @@ CASE (test_coerce)
 	xmms_object_unref (to);
 }
 
+
+CASE (test_key)
+{
+	xmms_stream_type_t *st1, *st2, *st3;
+	gchar *k1, *k2, *k3;
+
+	st1 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_FORMAT, XMMS_SAMPLE_FORMAT_S16,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                             XMMS_STREAM_TYPE_END);
+	st2 = _xmms_stream_type_new ("other",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_FORMAT, XMMS_SAMPLE_FORMAT_S16,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                             XMMS_STREAM_TYPE_END);
+	st3 = _xmms_stream_type_new ("dummy",
+	                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                             XMMS_STREAM_TYPE_FMT_FORMAT, XMMS_SAMPLE_FORMAT_S16,
+	                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, 48000,
+	                             XMMS_STREAM_TYPE_END);
+
+	k1 = xmms_stream_type_key (st1);
+	k2 = xmms_stream_type_key (st2);
+	k3 = xmms_stream_type_key (st3);
+
+	CU_ASSERT_STRING_EQUAL (k1, k2);
+	CU_ASSERT_STRING_NOT_EQUAL (k1, k3);
+
+	g_free (k1);
+	g_free (k2);
+	g_free (k3);
+
+	xmms_object_unref (st1);
+	xmms_object_unref (st2);
+	xmms_object_unref (st3);
+}
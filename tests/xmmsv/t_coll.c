@@ -331,3 +331,155 @@ CASE (test_coll_legacy_idlist)
 
 	xmmsv_coll_unref (c);
 }
+
+static int
+idlist_matches (xmmsv_coll_t *c, int32_t *ref, int size)
+{
+	xmmsv_list_iter_t *it;
+	xmmsv_t *copy;
+	int32_t v;
+	int i;
+
+	if (xmmsv_coll_idlist_get_size (c) != size) {
+		return 0;
+	}
+
+	for (i = 0; i < size; i++) {
+		if (!xmmsv_coll_idlist_get_index (c, i, &v) || v != ref[i]) {
+			return 0;
+		}
+	}
+
+	if (xmmsv_list_get_size (xmmsv_coll_idlist_get (c)) != size) {
+		return 0;
+	}
+
+	xmmsv_get_list_iter (xmmsv_coll_idlist_get (c), &it);
+	for (i = 0; xmmsv_list_iter_valid (it); xmmsv_list_iter_next (it), i++) {
+		if (!xmmsv_list_iter_entry_int (it, &v) || v != ref[i]) {
+			xmmsv_list_iter_explicit_destroy (it);
+			return 0;
+		}
+	}
+	xmmsv_list_iter_explicit_destroy (it);
+
+	copy = xmmsv_coll_idlist_copy (c);
+	xmmsv_get_list_iter (copy, &it);
+	for (i = 0; xmmsv_list_iter_valid (it); xmmsv_list_iter_next (it), i++) {
+		if (!xmmsv_list_iter_entry_int (it, &v) || v != ref[i]) {
+			break;
+		}
+	}
+	xmmsv_list_iter_explicit_destroy (it);
+	xmmsv_unref (copy);
+
+	return i == size;
+}
+
+CASE (test_coll_idlist_large)
+{
+	xmmsv_coll_t *c;
+	int32_t *ref, v;
+	unsigned int seed = 42;
+	int size = 0;
+	int i, pos, newpos;
+
+	c = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+	ref = malloc (20000 * sizeof (int32_t));
+
+	/* grow through appends and inserts at random positions */
+	for (i = 1; i <= 20000; i++) {
+		seed = seed * 1103515245 + 12345;
+		if (i % 3) {
+			CU_ASSERT_TRUE (xmmsv_coll_idlist_append (c, i));
+			ref[size++] = i;
+		} else {
+			pos = (seed >> 8) % (size + 1);
+			CU_ASSERT_TRUE (xmmsv_coll_idlist_insert (c, pos, i));
+			memmove (ref + pos + 1, ref + pos, (size - pos) * sizeof (int32_t));
+			ref[pos] = i;
+			size++;
+		}
+	}
+	CU_ASSERT_TRUE (idlist_matches (c, ref, size));
+
+	/* shuffle through moves, in both directions */
+	for (i = 0; i < 5000; i++) {
+		seed = seed * 1103515245 + 12345;
+		pos = (seed >> 8) % size;
+		seed = seed * 1103515245 + 12345;
+		newpos = (seed >> 8) % size;
+
+		CU_ASSERT_TRUE (xmmsv_coll_idlist_move (c, pos, newpos));
+		v = ref[pos];
+		if (pos < newpos) {
+			memmove (ref + pos, ref + pos + 1, (newpos - pos) * sizeof (int32_t));
+		} else {
+			memmove (ref + newpos + 1, ref + newpos, (pos - newpos) * sizeof (int32_t));
+		}
+		ref[newpos] = v;
+	}
+	CU_ASSERT_TRUE (idlist_matches (c, ref, size));
+
+	/* overwrite some ids */
+	for (i = 0; i < size; i += 7) {
+		CU_ASSERT_TRUE (xmmsv_coll_idlist_set_index (c, i, -i));
+		ref[i] = -i;
+	}
+	CU_ASSERT_TRUE (idlist_matches (c, ref, size));
+
+	/* shrink through removals at random positions, and from the end */
+	while (size > 0) {
+		seed = seed * 1103515245 + 12345;
+		if (size % 2) {
+			pos = (seed >> 8) % size;
+			CU_ASSERT_TRUE (xmmsv_coll_idlist_remove (c, pos));
+		} else {
+			pos = size - 1;
+			CU_ASSERT_TRUE (xmmsv_coll_idlist_remove (c, -1));
+		}
+		memmove (ref + pos, ref + pos + 1, (size - pos - 1) * sizeof (int32_t));
+		size--;
+
+		if (size % 2500 == 0) {
+			CU_ASSERT_TRUE (idlist_matches (c, ref, size));
+		}
+	}
+
+	CU_ASSERT_EQUAL (xmmsv_coll_idlist_get_size (c), 0);
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_remove (c, 0));
+
+	free (ref);
+	xmmsv_coll_unref (c);
+}
+
+CASE (test_coll_idlist_positions)
+{
+	xmmsv_coll_t *c;
+	int32_t v;
+	int i;
+
+	c = xmmsv_coll_new (XMMS_COLLECTION_TYPE_IDLIST);
+
+	/* inserting right after the end is allowed, further is not */
+	CU_ASSERT_TRUE (xmmsv_coll_idlist_insert (c, 0, 1));
+	CU_ASSERT_TRUE (xmmsv_coll_idlist_insert (c, 1, 3));
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_insert (c, 3, 4));
+	CU_ASSERT_TRUE (xmmsv_coll_idlist_insert (c, -1, 2));
+
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT_TRUE (xmmsv_coll_idlist_get_index (c, i, &v));
+		CU_ASSERT_EQUAL (i + 1, v);
+	}
+
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_move (c, 0, 3));
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_move (c, -4, 0));
+	CU_ASSERT_TRUE (xmmsv_coll_idlist_move (c, -1, 0));
+	CU_ASSERT_TRUE (xmmsv_coll_idlist_get_index (c, 0, &v));
+	CU_ASSERT_EQUAL (3, v);
+
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_set_index (c, 3, 0));
+	CU_ASSERT_FALSE (xmmsv_coll_idlist_get_index (c, -4, &v));
+
+	xmmsv_coll_unref (c);
+}
@@ -0,0 +1,155 @@
+#!/usr/bin/env python
+#
+# Decoder throughput benchmark and regression check.
+#
+# Runs xmms2-decode-bench (configure with --with-decode-bench) over
+# every file below the corpus directories and prints MB/s, realtime
+# factor, allocations per second and p99 read latency per file, grouped
+# by decoder chain. Put a few files of every format in the corpus;
+# decoders from the list below that no file went through are reported
+# as not covered.
+#
+# With -s the results are saved as JSON. With -b they are compared to
+# a saved baseline, and the script exits with 1 when a file got slower
+# or allocates more than the tolerance allows.
+#
+# When benching an uninstalled build, point -p at the build's plugin
+# tree (e.g. _build_/default/src/plugins); the plugins are gathered in
+# a temporary directory, as the bench only scans one directory.
+#
+#   bench_decoders.py [-B bench] [-p plugins] [-r rounds] [-s out.json]
+#                     [-b baseline.json] [-t percent] [-D key=value] dir...
+
+import os
+import sys
+import json
+import shutil
+import tempfile
+import subprocess
+from optparse import OptionParser
+
+DECODERS = ["mad", "mpg123", "vorbis", "tremor", "flac", "faad", "avcodec",
+            "wavpack", "musepack", "tta", "speex", "mac"]
+
+def gather_plugins(root):
+    tmp = tempfile.mkdtemp(prefix="xmms2-bench-plugins-")
+    for dirpath, dirs, files in os.walk(root):
+        for f in files:
+            if f.startswith("lib") and f.endswith(".so"):
+                dst = os.path.join(tmp, f)
+                if not os.path.exists(dst):
+                    os.symlink(os.path.abspath(os.path.join(dirpath, f)), dst)
+    return tmp
+
+def corpus(dirs):
+    files = []
+    for d in dirs:
+        for dirpath, subdirs, names in os.walk(d):
+            subdirs.sort()
+            files += [os.path.join(dirpath, n) for n in sorted(names)]
+    return files
+
+def run_bench(opts, files):
+    out = tempfile.NamedTemporaryFile(prefix="xmms2-bench-", suffix=".json")
+    cmd = [opts.bench, "-r", str(opts.rounds), "-o", out.name]
+    if opts.plugindir:
+        cmd += ["-p", opts.plugindir]
+    for d in opts.defines:
+        cmd += ["-D", d]
+    subprocess.check_call(cmd + files, stdout=open(os.devnull, "w"))
+    return [json.loads(l) for l in open(out.name) if l.startswith("{")]
+
+def decoder_of(chain):
+    for p in chain.split(":"):
+        if p in DECODERS:
+            return p
+    return chain
+
+def report(results):
+    bychain = {}
+    for r in results:
+        bychain.setdefault(r.get("chain", "-"), []).append(r)
+
+    for chain in sorted(bychain):
+        print chain
+        for r in bychain[chain]:
+            if "error" in r:
+                print "  %-40s %s" % (os.path.basename(r["file"])[:40], r["error"])
+                continue
+            print "  %-40s %7.1f MB/s %7.1fx %9.0f allocs/s %8.1f us p99" % (
+                os.path.basename(r["file"])[:40], r["pcm_mb_per_s"],
+                r["realtime"], r["allocs_per_s"], r["read_p99_us"])
+
+    seen = set(decoder_of(r.get("chain", "")) for r in results)
+    missing = [d for d in DECODERS if d not in seen]
+    if missing:
+        print
+        print "not covered by the corpus: %s" % ", ".join(missing)
+
+def compare(results, baseline, tolerance):
+    base = dict((r["file"], r) for r in baseline if "error" not in r)
+    regressions = 0
+
+    for r in results:
+        b = base.get(r["file"])
+        if not b:
+            continue
+        if "error" in r:
+            print "REGRESSION %s: %s" % (r["file"], r["error"])
+            regressions += 1
+            continue
+
+        checks = [("realtime", r["realtime"] < b["realtime"] * (1 - tolerance)),
+                  ("allocs_per_s", r["allocs_per_s"] > b["allocs_per_s"] * (1 + tolerance)),
+                  ("read_p99_us", r["read_p99_us"] > b["read_p99_us"] * (1 + tolerance))]
+        for key, worse in checks:
+            if worse:
+                print "REGRESSION %s: %s %.1f -> %.1f" % (r["file"], key,
+                                                          b[key], r[key])
+                regressions += 1
+
+    return regressions
+
+def main():
+    parser = OptionParser(usage="%prog [options] dir...")
+    parser.add_option("-B", dest="bench", default="xmms2-decode-bench",
+                      help="path to xmms2-decode-bench")
+    parser.add_option("-p", dest="plugins", default=None,
+                      help="plugin directory, or tree of plugins")
+    parser.add_option("-r", dest="rounds", type="int", default=3,
+                      help="times to decode every file")
+    parser.add_option("-s", dest="save", default=None,
+                      help="save the results to this file")
+    parser.add_option("-b", dest="baseline", default=None,
+                      help="compare against these saved results")
+    parser.add_option("-t", dest="tolerance", type="float", default=10,
+                      help="percent a value may get worse than the baseline")
+    parser.add_option("-D", dest="defines", action="append", default=[],
+                      help="config value for the bench, key=value")
+    opts, args = parser.parse_args()
+    if not args:
+        parser.error("no corpus given")
+
+    opts.plugindir = None
+    tmp = None
+    if opts.plugins:
+        opts.plugindir = tmp = gather_plugins(opts.plugins)
+
+    try:
+        results = run_bench(opts, corpus(args))
+    finally:
+        if tmp:
+            shutil.rmtree(tmp)
+
+    report(results)
+
+    if opts.save:
+        json.dump(results, open(opts.save, "w"), indent=1)
+
+    if opts.baseline:
+        baseline = json.load(open(opts.baseline))
+        if compare(results, baseline, opts.tolerance / 100.0):
+            sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+#
+# Benchmark for incremental medialib imports.
+#
+# Creates a tree of empty files, imports it into a running daemon,
+# touches a fraction of the files and times the re-import. Use a
+# throwaway daemon (XMMS_PATH / a separate config dir) as every file
+# ends up in its medialib.
+#
+#   bench_import.py [-n files] [-c percent changed] [-d dir]
+
+import os
+import sys
+import time
+import shutil
+import random
+import tempfile
+import urllib
+from optparse import OptionParser
+
+import xmmsclient
+
+FILES_PER_DIR = 100
+
+def make_tree(root, count):
+    paths = []
+    for i in xrange(count):
+        d = os.path.join(root, "%03d" % (i / (FILES_PER_DIR * 100)),
+                         "%03d" % (i / FILES_PER_DIR % 100))
+        if i % FILES_PER_DIR == 0 and not os.path.isdir(d):
+            os.makedirs(d)
+        p = os.path.join(d, "%06d.ogg" % i)
+        open(p, "w").close()
+        paths.append(p)
+    return paths
+
+def touch(paths, percent):
+    changed = random.sample(paths, len(paths) * percent / 100)
+    for p in changed:
+        f = open(p, "a")
+        f.write("x")
+        f.close()
+    return len(changed)
+
+def timed_import(xmms, root):
+    url = "file://" + urllib.quote(root)
+    start = time.time()
+    xmms.medialib_import_path(url, encoded=True)
+    return time.time() - start
+
+def main():
+    parser = OptionParser()
+    parser.add_option("-n", dest="files", type="int", default=200000,
+                      help="number of files in the tree")
+    parser.add_option("-c", dest="changed", type="int", default=1,
+                      help="percentage of files changed before re-import")
+    parser.add_option("-d", dest="dir", default=None,
+                      help="directory to create the tree in")
+    opts, args = parser.parse_args()
+
+    xmms = xmmsclient.XMMSSync("bench_import")
+    xmms.connect(os.getenv("XMMS_PATH"))
+
+    root = tempfile.mkdtemp(prefix="xmms2-import-", dir=opts.dir)
+    try:
+        print "creating %d files in %s" % (opts.files, root)
+        paths = make_tree(root, opts.files)
+
+        print "initial import:   %8.2fs" % timed_import(xmms, root)
+        print "unchanged import: %8.2fs" % timed_import(xmms, root)
+
+        n = touch(paths, opts.changed)
+        print "changed %d files" % n
+        print "re-import:        %8.2fs" % timed_import(xmms, root)
+    finally:
+        shutil.rmtree(root)
+
+if __name__ == "__main__":
+    main()
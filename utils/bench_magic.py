@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+#
+# Benchmark for type detection of a corpus of media files.
+#
+# Imports every file below the given directories into a running
+# daemon, waits for the mediainfo reader to resolve them and prints
+# the time it took along with how many files were detected as each
+# mime type. Run it against a corpus with a few files of every
+# supported format; the mime table doubles as a regression check
+# when comparing two builds. Use a throwaway daemon as every file
+# ends up in its medialib.
+#
+#   bench_magic.py [-r rounds] dir...
+
+import os
+import sys
+import time
+import urllib
+from optparse import OptionParser
+
+import xmmsclient
+from xmmsclient import collections as coll
+
+STATUS_OK = 1
+STATUS_NOT_AVAILABLE = 3
+
+def corpus_query(root):
+    url = "file://" + urllib.quote(os.path.abspath(root)) + "/*"
+    return coll.Match(field="url", value=url)
+
+def pending(xmms, query):
+    infos = xmms.coll_query_infos(query, ["status"])
+    return len([i for i in infos
+                if i["status"] not in (STATUS_OK, STATUS_NOT_AVAILABLE)])
+
+def wait_resolved(xmms, dirs):
+    for d in dirs:
+        while pending(xmms, corpus_query(d)):
+            time.sleep(0.05)
+
+def timed_import(xmms, dirs):
+    start = time.time()
+    for d in dirs:
+        url = "file://" + urllib.quote(os.path.abspath(d))
+        xmms.medialib_import_path(url, encoded=True)
+    wait_resolved(xmms, dirs)
+    return time.time() - start
+
+def timed_rehash(xmms, dirs):
+    start = time.time()
+    for d in dirs:
+        for id in xmms.coll_query_ids(corpus_query(d)):
+            xmms.medialib_rehash(id)
+    wait_resolved(xmms, dirs)
+    return time.time() - start
+
+def mime_table(xmms, dirs):
+    counts = {}
+    for d in dirs:
+        for i in xmms.coll_query_infos(corpus_query(d), ["mime"]):
+            mime = i["mime"] or "(none)"
+            counts[mime] = counts.get(mime, 0) + 1
+    return counts
+
+def main():
+    parser = OptionParser(usage="%prog [-r rounds] dir...")
+    parser.add_option("-r", dest="rounds", type="int", default=3,
+                      help="number of rehash rounds after the import")
+    opts, args = parser.parse_args()
+    if not args:
+        parser.error("no corpus directory given")
+
+    xmms = xmmsclient.XMMSSync("bench_magic")
+    xmms.connect(os.getenv("XMMS_PATH"))
+
+    print "import:  %8.2fs" % timed_import(xmms, args)
+    for r in xrange(opts.rounds):
+        print "rehash:  %8.2fs" % timed_rehash(xmms, args)
+
+    counts = mime_table(xmms, args)
+    for mime in sorted(counts):
+        print "%6d %s" % (counts[mime], mime)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+#
+# Compares the cost of watching a tree with the server side inotify
+# watcher against xmms2-mlib-updater.
+#
+# Creates a tree of directories with empty files, points either
+# medialib.watch_dir (the server watcher) or
+# clients.mlibupdater.watch_dirs (the updater) at it and samples the
+# watching process through /proc until all directories carry an
+# inotify watch. Pass the pid of xmms2d or of xmms2-mlib-updater
+# accordingly. Use a throwaway daemon, the tree is imported into its
+# medialib. fs.inotify.max_user_watches must exceed the directory count.
+#
+#   bench_watcher.py -p pid [-u] [-n dirs] [-f files per dir] [-d dir]
+
+import os
+import sys
+import time
+import shutil
+import tempfile
+from optparse import OptionParser
+
+import xmmsclient
+
+def make_tree(root, dirs, files):
+    for i in xrange(dirs):
+        d = os.path.join(root, "%03d" % (i / 1000), "%03d" % (i % 1000))
+        os.makedirs(d)
+        for j in xrange(files):
+            open(os.path.join(d, "%02d.ogg" % j), "w").close()
+    return dirs + (dirs + 999) / 1000 + 1
+
+def cpu_time(pid):
+    f = open("/proc/%d/stat" % pid)
+    fields = f.read().rsplit(")", 1)[1].split()
+    f.close()
+    return (int(fields[11]) + int(fields[12])) / float(os.sysconf("SC_CLK_TCK"))
+
+def memory(pid):
+    ret = {}
+    f = open("/proc/%d/status" % pid)
+    for line in f:
+        key, value = line.split(":", 1)
+        if key in ("VmRSS", "VmHWM"):
+            ret[key] = int(value.split()[0])
+    f.close()
+    return ret
+
+def watches(pid):
+    count = 0
+    fddir = "/proc/%d/fdinfo" % pid
+    for fd in os.listdir(fddir):
+        try:
+            f = open(os.path.join(fddir, fd))
+        except IOError:
+            continue
+        count += sum(1 for line in f if line.startswith("inotify wd:"))
+        f.close()
+    return count
+
+def main():
+    parser = OptionParser()
+    parser.add_option("-p", dest="pid", type="int",
+                      help="pid of the watching process")
+    parser.add_option("-u", dest="updater", action="store_true",
+                      default=False, help="configure xmms2-mlib-updater "
+                      "instead of the server watcher")
+    parser.add_option("-n", dest="dirs", type="int", default=40000,
+                      help="number of directories in the tree")
+    parser.add_option("-f", dest="files", type="int", default=5,
+                      help="number of files per directory")
+    parser.add_option("-d", dest="dir", default=None,
+                      help="directory to create the tree in")
+    opts, args = parser.parse_args()
+
+    if not opts.pid:
+        parser.error("no pid given")
+
+    xmms = xmmsclient.XMMSSync("bench_watcher")
+    xmms.connect(os.getenv("XMMS_PATH"))
+
+    if opts.updater:
+        key = "clients.mlibupdater.watch_dirs"
+    else:
+        key = "medialib.watch_dir"
+
+    root = tempfile.mkdtemp(prefix="xmms2-watch-", dir=opts.dir)
+    try:
+        print "creating %d directories in %s" % (opts.dirs, root)
+        expected = make_tree(root, opts.dirs, opts.files)
+
+        before = memory(opts.pid)
+        cpu = cpu_time(opts.pid)
+        start = time.time()
+        xmms.config_set_value(key, root)
+
+        while watches(opts.pid) < expected:
+            time.sleep(0.1)
+
+        after = memory(opts.pid)
+        print "watches:   %8d" % watches(opts.pid)
+        print "wall time: %8.2fs" % (time.time() - start)
+        print "cpu time:  %8.2fs" % (cpu_time(opts.pid) - cpu)
+        print "rss:       %8d kB (+%d kB)" % (after["VmRSS"],
+                                              after["VmRSS"] - before["VmRSS"])
+        print "peak rss:  %8d kB" % after["VmHWM"]
+
+        xmms.config_set_value(key, "")
+    finally:
+        shutil.rmtree(root)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,125 @@
+#!/usr/bin/env python
+#
+# Connects a number of listeners to the httpstream output plugin and
+# reports how much each of them got, the icy titles seen and whether
+# the audio data starts with a valid ogg or wav header. With -s some
+# of the listeners stop reading, they should be dropped by the server
+# once they are a backlog behind while the others keep going.
+#
+#   http_stream_listeners.py [-n listeners] [-t seconds] [-s slow] url
+
+import sys
+import time
+import socket
+import select
+import urlparse
+from optparse import OptionParser
+
+class Listener(object):
+    def __init__(self, host, port, path, icy, slow):
+        self.sock = socket.create_connection((host, port))
+        self.sock.sendall("GET %s HTTP/1.0\r\nHost: %s\r\n%s\r\n" %
+                          (path, host, icy and "Icy-MetaData: 1\r\n" or ""))
+        self.sock.setblocking(0)
+        self.slow = slow
+        self.buf = ""
+        self.headers = None
+        self.metaint = 0
+        self.metaleft = 0
+        self.audio = 0
+        self.start = ""
+        self.titles = []
+        self.closed = False
+
+    def fileno(self):
+        return self.sock.fileno()
+
+    def feed(self):
+        try:
+            data = self.sock.recv(65536)
+        except socket.error:
+            data = ""
+        if not data:
+            self.closed = True
+            return
+        self.buf += data
+
+        if self.headers is None:
+            if "\r\n\r\n" not in self.buf:
+                return
+            head, self.buf = self.buf.split("\r\n\r\n", 1)
+            lines = head.split("\r\n")
+            self.status = lines[0]
+            self.headers = dict((k.strip().lower(), v.strip()) for k, v in
+                                (l.split(":", 1) for l in lines[1:] if ":" in l))
+            self.metaint = self.metaleft = int(self.headers.get("icy-metaint", 0))
+
+        while self.buf:
+            if self.metaint and not self.metaleft:
+                size = ord(self.buf[0]) * 16
+                if len(self.buf) < size + 1:
+                    return
+                meta = self.buf[1:size + 1].rstrip("\0")
+                if meta:
+                    self.titles.append(meta)
+                self.buf = self.buf[size + 1:]
+                self.metaleft = self.metaint
+                continue
+
+            n = len(self.buf)
+            if self.metaint:
+                n = min(n, self.metaleft)
+                self.metaleft -= n
+            if len(self.start) < 4:
+                self.start += self.buf[:4 - len(self.start)]
+            self.audio += n
+            self.buf = self.buf[n:]
+
+    def report(self, i, elapsed):
+        fmt = {"OggS": "ogg", "RIFF": "wav"}.get(self.start[:4], "bad start %r" % self.start[:4])
+        print "%3d %-24s %8d bytes %7.1f kbit/s %-4s %s %s" % (
+            i, self.headers and self.status or "no response", self.audio,
+            self.audio * 8 / elapsed / 1000, fmt,
+            self.closed and "closed" or "open",
+            self.titles and self.titles[-1] or "")
+
+def main():
+    parser = OptionParser(usage="%prog [-n listeners] [-t seconds] [-s slow] url")
+    parser.add_option("-n", dest="listeners", type="int", default=10,
+                      help="number of listeners")
+    parser.add_option("-t", dest="time", type="float", default=10,
+                      help="seconds to listen")
+    parser.add_option("-s", dest="slow", type="int", default=0,
+                      help="number of listeners that never read")
+    parser.add_option("-m", dest="icy", action="store_false", default=True,
+                      help="don't ask for icy metadata")
+    opts, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error("no url given")
+
+    url = urlparse.urlparse(args[0])
+    listeners = [Listener(url.hostname, url.port or 80, url.path or "/",
+                          opts.icy, i < opts.slow)
+                 for i in range(opts.listeners)]
+
+    start = time.time()
+    while time.time() - start < opts.time:
+        active = [l for l in listeners if not l.closed and not l.slow]
+        if not active:
+            break
+        ready, _, _ = select.select(active, [], [], 0.5)
+        for l in ready:
+            l.feed()
+
+    elapsed = time.time() - start
+    # find out whether the slow ones were dropped
+    for l in listeners:
+        if l.slow:
+            while not l.closed and select.select([l], [], [], 0)[0]:
+                l.feed()
+
+    for i, l in enumerate(listeners):
+        l.report(i, elapsed)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+#
+# Minimal HTTP server to exercise the curl transport.
+#
+# Serves the files below a directory over HTTP/1.1 with keep-alive and
+# byte range support and logs every request together with the client
+# port, so connection reuse between tracks and range requests on seek
+# show up in the log. Add the served files to a playlist with
+#
+#   xmms2 add http://localhost:8000/some.mp3
+#
+#   http_stub_server.py [-p port] [-n] [-r bytes/s] dir
+
+import os
+import re
+import sys
+import time
+import SocketServer
+import BaseHTTPServer
+from optparse import OptionParser
+
+RANGE_RE = re.compile(r"bytes=(\d*)-(\d*)$")
+CHUNK = 16384
+
+class Handler(BaseHTTPServer.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write("[%d] %s\n" % (self.client_address[1], fmt % args))
+
+    def do_GET(self):
+        path = os.path.join(self.server.root, self.path.lstrip("/"))
+        path = os.path.normpath(path)
+        if not path.startswith(self.server.root) or not os.path.isfile(path):
+            self.send_error(404)
+            return
+
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+
+        m = RANGE_RE.match(self.headers.get("Range", ""))
+        if m and self.server.ranges:
+            if m.group(1):
+                start = int(m.group(1))
+                if m.group(2):
+                    end = min(int(m.group(2)), end)
+            else:
+                start = max(size - int(m.group(2)), 0)
+            if start >= size:
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */%d" % size)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header("Content-Range",
+                             "bytes %d-%d/%d" % (start, end, size))
+        else:
+            self.send_response(200)
+
+        if self.server.ranges:
+            self.send_header("Accept-Ranges", "bytes")
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(end - start + 1))
+        self.end_headers()
+
+        f = open(path, "rb")
+        try:
+            f.seek(start)
+            left = end - start + 1
+            while left > 0:
+                buf = f.read(min(CHUNK, left))
+                if not buf:
+                    break
+                self.wfile.write(buf)
+                left -= len(buf)
+                if self.server.rate:
+                    time.sleep(float(len(buf)) / self.server.rate)
+        finally:
+            f.close()
+
+class Server(SocketServer.ThreadingMixIn, BaseHTTPServer.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+def main():
+    parser = OptionParser(usage="%prog [-p port] [-n] [-r bytes/s] dir")
+    parser.add_option("-p", dest="port", type="int", default=8000,
+                      help="port to listen on")
+    parser.add_option("-n", dest="ranges", action="store_false", default=True,
+                      help="ignore Range headers, like many radio servers")
+    parser.add_option("-r", dest="rate", type="int", default=0,
+                      help="limit every transfer to this many bytes/s")
+    opts, args = parser.parse_args()
+    if len(args) != 1:
+        parser.error("no directory given")
+
+    server = Server(("127.0.0.1", opts.port), Handler)
+    server.root = os.path.abspath(args[0])
+    server.ranges = opts.ranges
+    server.rate = opts.rate
+
+    print "serving %s on http://127.0.0.1:%d/" % (server.root, opts.port)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == "__main__":
+    main()
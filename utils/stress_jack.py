@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+#
+# Stress test for the jack output.
+#
+# Expects jackd running with the dummy driver, for instance
+#
+#   jackd -d dummy -r 44100 -p 64
+#
+# and a daemon using the jack output with something in the playlist.
+# Starts playback, keeps a number of busy processes running to load
+# the machine and prints the underrun and late callback counters the
+# plugin publishes in the server stats.
+#
+#   stress_jack.py [-t seconds] [-l load processes]
+
+import os
+import sys
+import time
+from optparse import OptionParser
+
+import xmmsclient
+
+def burn():
+    while True:
+        pass
+
+def counters(xmms):
+    out = xmms.stats().get("output", {})
+    return (out.get("jack.underruns", 0), out.get("jack.late_callbacks", 0),
+            out.get("underruns", 0))
+
+def main():
+    parser = OptionParser(usage="%prog [-t seconds] [-l load processes]")
+    parser.add_option("-t", dest="time", type="int", default=30,
+                      help="seconds to play")
+    parser.add_option("-l", dest="load", type="int", default=4,
+                      help="number of busy processes to start")
+    opts, args = parser.parse_args()
+
+    xmms = xmmsclient.XMMSSync("stress_jack")
+    xmms.connect(os.getenv("XMMS_PATH"))
+
+    pids = []
+    for i in range(opts.load):
+        pid = os.fork()
+        if pid == 0:
+            burn()
+        pids.append(pid)
+
+    try:
+        start = counters(xmms)
+        xmms.playback_start()
+
+        print "   time  jack underruns  late callbacks  output underruns"
+        for t in range(opts.time):
+            time.sleep(1)
+            now = counters(xmms)
+            print "%6ds  %14d  %14d  %16d" % ((t + 1,) +
+                  tuple(n - s for n, s in zip(now, start)))
+    finally:
+        for pid in pids:
+            os.kill(pid, 9)
+            os.waitpid(pid, 0)
+        xmms.playback_stop()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,130 @@
+#!/usr/bin/env python
+#
+# Playback test for the alsa output against ALSA's file PCM.
+#
+# Expects a daemon using the alsa output. Points alsa.device at a
+# file PCM (which plays into the null device), plays a generated WAV
+# file and checks that the raw samples ALSA wrote match the ones in
+# the WAV file. Prints the stats the plugin publishes on the way.
+# Replaygain is disabled for the run so that samples pass unchanged.
+# Exits with a non-zero status on failure.
+#
+#   test_alsa_file.py [-b buffer time] [-p period time] [-s seconds]
+
+import os
+import sys
+import time
+import wave
+import struct
+import shutil
+import urllib
+import tempfile
+from optparse import OptionParser
+
+import xmmsclient
+
+RATE = 44100
+CHANNELS = 2
+
+def make_wav(path, seconds):
+    frames = []
+    for i in xrange(RATE * seconds):
+        v = (i * 37) % 65536 - 32768
+        frames.append(struct.pack("<hh", v, -v - 1))
+    data = "".join(frames)
+
+    w = wave.open(path, "wb")
+    w.setnchannels(CHANNELS)
+    w.setsampwidth(2)
+    w.setframerate(RATE)
+    w.writeframes(data)
+    w.close()
+
+    return data
+
+def play(xmms, url, timeout):
+    xmms.playback_stop()
+    xmms.playlist_clear()
+    xmms.playlist_add_url(url, encoded=True)
+    xmms.playback_start()
+
+    stats = {}
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        time.sleep(0.2)
+        out = xmms.stats().get("output", {})
+        if out:
+            stats = out
+        if xmms.playback_status() == xmmsclient.PLAYBACK_STATUS_STOP:
+            break
+    else:
+        xmms.playback_stop()
+        return None
+
+    return stats
+
+def main():
+    parser = OptionParser()
+    parser.add_option("-b", dest="buffer_time", type="int", default=500000,
+                      help="alsa.buffer_time in microseconds")
+    parser.add_option("-p", dest="period_time", type="int", default=0,
+                      help="alsa.period_time in microseconds")
+    parser.add_option("-s", dest="seconds", type="int", default=3,
+                      help="length of the test signal")
+    opts, args = parser.parse_args()
+
+    xmms = xmmsclient.XMMSSync("test_alsa_file")
+    xmms.connect(os.getenv("XMMS_PATH"))
+
+    keys = ("alsa.device", "alsa.buffer_time", "alsa.period_time",
+            "replaygain.enabled")
+    config = xmms.config_list_values()
+    saved = dict((k, config[k]) for k in keys if k in config)
+
+    root = tempfile.mkdtemp(prefix="xmms2-alsa-")
+    ok = False
+    try:
+        src = os.path.join(root, "signal.wav")
+        raw = os.path.join(root, "out.raw")
+        expected = make_wav(src, opts.seconds)
+
+        xmms.config_set_value("alsa.device", "file:FILE=%s,FORMAT=raw" % raw)
+        xmms.config_set_value("alsa.buffer_time", str(opts.buffer_time))
+        xmms.config_set_value("alsa.period_time", str(opts.period_time))
+        xmms.config_set_value("replaygain.enabled", "0")
+
+        stats = play(xmms, "file://" + urllib.quote(src), opts.seconds + 10)
+        if stats is None:
+            print "FAIL: playback did not stop"
+            return 1
+
+        for k in sorted(stats):
+            print "%-24s %d" % (k, stats[k])
+
+        got = open(raw, "rb").read()
+        frame = 2 * CHANNELS
+        slack = stats.get("alsa.buffer_frames", RATE) * frame
+
+        if got != expected[:len(got)]:
+            pos = 0
+            while got[pos] == expected[pos]:
+                pos += 1
+            print "FAIL: samples differ at frame %d" % (pos / frame)
+        elif len(got) + slack < len(expected):
+            print "FAIL: only %d of %d frames written" % (len(got) / frame,
+                                                        len(expected) / frame)
+        elif stats.get("alsa.xruns", 0):
+            print "FAIL: %d xruns" % stats["alsa.xruns"]
+        else:
+            print "OK: %d of %d frames written" % (len(got) / frame,
+                                                 len(expected) / frame)
+            ok = True
+    finally:
+        for k, v in saved.items():
+            xmms.config_set_value(k, v)
+        shutil.rmtree(root)
+
+    return not ok
+
+if __name__ == "__main__":
+    sys.exit(main())